@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libaccl/endian.hpp"
+#include "libaccl/sequence_data_generator.hpp"
+#include "libsethnetkit/udp_packet.hpp"
+#include "packet_switch.hpp"
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compression levels to benchmark for each packet format
+static constexpr std::array<int, 4> BENCHMARK_LZ4_LEVELS{1, 5, 10, 20};
+static constexpr std::array<int, 5> BENCHMARK_ZSTD_LEVELS{1, 3, 6, 9, 15};
+// Minimum number of bytes to encode for each packet format and level, the frames are replayed until we get there
+static constexpr size_t BENCHMARK_BYTES{256 * 1024 * 1024};
+// Number of frames encoded before the encoded packets are returned to the pool
+static constexpr size_t BENCHMARK_BATCH{64};
+// Number of synthetic frames generated when no capture is given
+static constexpr size_t BENCHMARK_SYNTHETIC_FRAMES{10000};
+
+/**
+ * @brief Read the ethernet frames from a classic pcap capture.
+ *
+ * @param filename Capture file.
+ * @param max_size Maximum size of a frame, larger frames are skipped.
+ * @return std::vector<std::string> Frames.
+ */
+static std::vector<std::string> read_pcap(const std::string &filename, size_t max_size) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error(std::format("Failed to open '{}'", filename));
+	}
+
+	uint32_t header[6];
+	if (!file.read(reinterpret_cast<char *>(header), sizeof(header))) {
+		throw std::runtime_error(std::format("Failed to read pcap header from '{}'", filename));
+	}
+	// Captures are written in the byte order of the host which made them, microsecond and nanosecond captures only differ in
+	// their timestamps which we don't use
+	bool swapped;
+	if (header[0] == 0xa1b2c3d4 || header[0] == 0xa1b23c4d) {
+		swapped = false;
+	} else if (header[0] == 0xd4c3b2a1 || header[0] == 0x4d3cb2a1) {
+		swapped = true;
+	} else {
+		throw std::runtime_error(std::format("File '{}' is not a pcap capture", filename));
+	}
+	auto value = [swapped](uint32_t v) { return swapped ? accl::bswap32(v) : v; };
+	// Link type 1 is ethernet
+	if (value(header[5]) != 1) {
+		throw std::runtime_error(std::format("Capture '{}' does not contain ethernet frames", filename));
+	}
+
+	std::vector<std::string> frames;
+	uint32_t record[4];
+	while (file.read(reinterpret_cast<char *>(record), sizeof(record))) {
+		std::string frame(value(record[2]), '\0');
+		if (!file.read(frame.data(), frame.size())) {
+			break;
+		}
+		if (frame.size() >= SETH_PACKET_ETHERNET_HEADER_LEN && frame.size() <= max_size) {
+			frames.push_back(std::move(frame));
+		}
+	}
+	return frames;
+}
+
+/**
+ * @brief Generate synthetic frames, a mix of text which compresses well, sequences and random payloads which don't compress.
+ *
+ * @return std::vector<std::string> Frames.
+ */
+static std::vector<std::string> generate_frames() {
+	std::mt19937 rng(BENCHMARK_SYNTHETIC_FRAMES);
+	std::uniform_int_distribution<int> byte_dist(0, 255);
+	std::uniform_int_distribution<size_t> size_dist(64, 1400);
+
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < BENCHMARK_SYNTHETIC_FRAMES; ++i) {
+		size_t size = size_dist(rng);
+		std::vector<uint8_t> payload;
+		switch (i % 4) {
+			case 0:
+			case 1:
+				while (payload.size() < size) {
+					std::string line = "GET /objects/" + std::to_string(rng() % 1000) +
+									   " HTTP/1.1\r\nHost: www.example.com\r\nAccept: */*\r\n\r\n";
+					payload.insert(payload.end(), line.begin(), line.end());
+				}
+				payload.resize(size);
+				break;
+			case 2:
+				payload = accl::SequenceDataGenerator(size).asBytes();
+				break;
+			default:
+				payload.resize(size);
+				for (auto &byte : payload) {
+					byte = static_cast<uint8_t>(byte_dist(rng));
+				}
+		}
+
+		UDPv4Packet packet;
+		packet.setDstMac({0x01, 0x02, 0x03, 0x04, 0x05, 0x06});
+		packet.setSrcMac({0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f});
+		packet.setDstAddr({192, 168, 10, 1});
+		packet.setSrcAddr({172, 16, 101, 102});
+		packet.setSrcPort(10000 + (i % 64));
+		packet.setDstPort(54321);
+		packet.addPayload(payload);
+		frames.push_back(packet.asBinary());
+	}
+	return frames;
+}
+
+/**
+ * @brief Encode the frames with a packet format and compression level and report the results.
+ *
+ * @param frames Frames to encode.
+ * @param format Packet format.
+ * @param level Compression level, 0 for the default level.
+ */
+static void benchmark_encoder(const std::vector<std::string> &frames, PacketHeaderOptionFormatType format, int level) {
+	uint16_t l2mtu = get_l2mtu_from_mtu(1500);
+	uint16_t l4mtu = 1500 - 20 - 8;
+	uint16_t buffer_size = l2mtu + (l2mtu / 10);
+	auto avail_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, BENCHMARK_BATCH * 4);
+	auto enc_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size);
+
+	PacketEncoder encoder(l2mtu, l4mtu, enc_buffer_pool, avail_buffer_pool);
+	encoder.setPacketFormat(format);
+	// We want to measure the compressor, not which frames adaptive compression skips
+	encoder.setAdaptiveCompression(false);
+	encoder.setCompressionLevel(level);
+
+	auto recycle = [&]() {
+		std::deque<std::unique_ptr<PacketBuffer>> packets = enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		for (auto &packet : packets) {
+			packet->clear();
+		}
+		avail_buffer_pool->push(packets);
+	};
+
+	uint64_t bytes = 0;
+	uint64_t frame_count = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (bytes < BENCHMARK_BYTES) {
+		for (auto &frame : frames) {
+			auto buffer = avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			encoder.encode(std::move(buffer));
+			bytes += frame.length();
+			if (++frame_count % BENCHMARK_BATCH == 0) {
+				recycle();
+			}
+		}
+	}
+	encoder.flush();
+	recycle();
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const PacketEncoderCompressionStats &stats = encoder.getCompressionStats();
+	double ratio = stats.compressed_bytes ? static_cast<double>(stats.compressed_wire_bytes) / stats.compressed_bytes : 1.0;
+	double compress_ns = stats.compressed_frames ? static_cast<double>(stats.compress_time) / stats.compressed_frames : 0.0;
+
+	std::cout << std::format("  {:<10} {:>5} {:>10.1f} MB/s {:>7.3f} ratio {:>8.1f} ns/frame {:>8.1f} ns/frame compressing",
+							 PacketHeaderOptionFormatTypeToString(format), level ? std::to_string(level) : "-",
+							 bytes / elapsed / 1e6, ratio, elapsed * 1e9 / frame_count, compress_ns)
+			  << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> frames;
+	try {
+		frames = argc > 1 ? read_pcap(argv[1], get_l2mtu_from_mtu(1500)) : generate_frames();
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	if (frames.empty()) {
+		std::cerr << "No frames to encode" << std::endl;
+		return 1;
+	}
+
+	size_t frame_bytes = 0;
+	for (auto &frame : frames) {
+		frame_bytes += frame.length();
+	}
+	std::cout << std::format("{} {} frames, {:.1f} bytes on average", frames.size(), argc > 1 ? "captured" : "synthetic",
+							 static_cast<double>(frame_bytes) / frames.size())
+			  << std::endl;
+
+	benchmark_encoder(frames, PacketHeaderOptionFormatType::NONE, 0);
+	for (auto level : BENCHMARK_LZ4_LEVELS) {
+		benchmark_encoder(frames, PacketHeaderOptionFormatType::COMPRESSED_LZ4, level);
+	}
+	for (auto level : BENCHMARK_ZSTD_LEVELS) {
+		benchmark_encoder(frames, PacketHeaderOptionFormatType::COMPRESSED_ZSTD, level);
+	}
+	for (auto level : BENCHMARK_LZ4_LEVELS) {
+		benchmark_encoder(frames, PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH, level);
+	}
+	for (auto level : BENCHMARK_ZSTD_LEVELS) {
+		benchmark_encoder(frames, PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH, level);
+	}
+
+	return 0;
+}
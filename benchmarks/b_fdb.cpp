@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "fdb.hpp"
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Number of MAC addresses to benchmark with
+static constexpr std::array<size_t, 3> BENCHMARK_MAC_COUNTS{1000, 100000, 1000000};
+// Number of lookups to do for each MAC address count
+static constexpr size_t BENCHMARK_LOOKUPS{10000000};
+
+/**
+ * @brief FDB as it was implemented before the open-addressing table, used as the baseline.
+ *
+ */
+class MapFDB {
+	public:
+		struct Entry {
+				std::shared_ptr<RemoteNode> dest;
+				std::chrono::steady_clock::time_point last_seen;
+		};
+
+		void add(const FDBMACAddress *mac, std::shared_ptr<RemoteNode> dest) {
+			std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> key;
+			std::memcpy(key.data(), mac->bytes, SETH_PACKET_ETHERNET_MAC_LEN);
+			if (this->fdb.find(key) != this->fdb.end()) {
+				return;
+			}
+			this->fdb[key] = std::make_shared<Entry>(Entry{dest, std::chrono::steady_clock::now()});
+		}
+
+		std::shared_ptr<Entry> get(const FDBMACAddress *mac) const {
+			std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> key;
+			std::memcpy(key.data(), mac->bytes, SETH_PACKET_ETHERNET_MAC_LEN);
+			auto it = this->fdb.find(key);
+			if (it == this->fdb.end()) {
+				return nullptr;
+			}
+			return it->second;
+		}
+
+	private:
+		std::map<std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN>, std::shared_ptr<Entry>> fdb;
+};
+
+/**
+ * @brief Generate random locally administered unicast MAC addresses.
+ *
+ * @param count Number of MAC addresses.
+ * @return std::vector<FDBMACAddress> MAC addresses.
+ */
+static std::vector<FDBMACAddress> generate_macs(size_t count) {
+	std::mt19937_64 rng(count);
+	std::vector<FDBMACAddress> macs(count);
+	for (auto &mac : macs) {
+		uint64_t value = rng();
+		std::memcpy(mac.bytes, &value, SETH_PACKET_ETHERNET_MAC_LEN);
+		mac.bytes[0] = (mac.bytes[0] & 0xfc) | 0x02;
+	}
+	return macs;
+}
+
+/**
+ * @brief Generate the order MAC addresses are looked up in.
+ *
+ * @param count Number of MAC addresses.
+ * @return std::vector<uint32_t> Indexes of the MAC addresses to look up.
+ */
+static std::vector<uint32_t> generate_lookups(size_t count) {
+	std::mt19937 rng(count);
+	std::uniform_int_distribution<uint32_t> dist(0, count - 1);
+	std::vector<uint32_t> lookups(BENCHMARK_LOOKUPS);
+	for (auto &lookup : lookups) {
+		lookup = dist(rng);
+	}
+	return lookups;
+}
+
+/**
+ * @brief Time a lookup function over all the lookups.
+ *
+ * @param name Name of the implementation.
+ * @param lookups Indexes of the MAC addresses to look up.
+ * @param lookup Function doing the lookup, it returns true if the MAC address was found.
+ */
+template <typename F> static void time_lookups(const std::string &name, const std::vector<uint32_t> &lookups, F lookup) {
+	size_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto index : lookups) {
+		found += lookup(index);
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::format("  {:<10} {:>12.0f} lookups/s {:>8.1f} ns/lookup {:>10} found", name, lookups.size() / elapsed,
+							 elapsed * 1e9 / lookups.size(), found)
+			  << std::endl;
+}
+
+int main() {
+	for (auto count : BENCHMARK_MAC_COUNTS) {
+		std::cout << std::format("{} MAC addresses, {} random lookups", count, BENCHMARK_LOOKUPS) << std::endl;
+
+		auto macs = generate_macs(count);
+		auto lookups = generate_lookups(count);
+
+		MapFDB map_fdb;
+		FDB fdb;
+		for (auto &mac : macs) {
+			map_fdb.add(&mac, nullptr);
+			fdb.add(&mac, nullptr);
+		}
+
+		time_lookups("std::map", lookups, [&](uint32_t index) { return map_fdb.get(&macs[index]) != nullptr; });
+		FDBEntry entry;
+		time_lookups("FDB", lookups, [&](uint32_t index) { return fdb.get(&macs[index], entry); });
+	}
+
+	return 0;
+}
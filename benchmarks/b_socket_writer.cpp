@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "packet_buffer.hpp"
+#include "packet_switch_options.hpp"
+#include "socket_writer.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Number of packets to send per mode
+static constexpr size_t BENCHMARK_PACKETS{500000};
+// Number of packets handed to the writer at a time
+static constexpr size_t BENCHMARK_BATCH{64};
+// Size of each packet
+static constexpr size_t BENCHMARK_PACKET_SIZE{1400};
+
+/**
+ * @brief Create a UDP socket bound to the IPv6 loopback address.
+ *
+ * @param addr Address the socket was bound to.
+ * @return int Socket.
+ */
+static int create_socket(sockaddr_storage &addr) {
+	int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (fd == -1) {
+		throw std::runtime_error(std::format("Failed to create socket: {}", strerror(errno)));
+	}
+
+	int buffer_size = 32 * 1024 * 1024;
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+	std::memset(&addr, 0, sizeof(addr));
+	sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+	addr6->sin6_family = AF_INET6;
+	addr6->sin6_addr = in6addr_loopback;
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(sockaddr_in6)) == -1) {
+		throw std::runtime_error(std::format("Failed to bind socket: {}", strerror(errno)));
+	}
+	socklen_t addr_len = sizeof(sockaddr_in6);
+	getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+
+	return fd;
+}
+
+/**
+ * @brief Run the benchmark for a socket write mode.
+ *
+ * @param mode Socket write mode to benchmark.
+ */
+static void run_benchmark(SocketWriteMode mode) {
+	sockaddr_storage rx_addr, tx_addr;
+	int rx_socket = create_socket(rx_addr);
+	int tx_socket = create_socket(tx_addr);
+
+	// Don't block forever in the receiver
+	timeval timeout{0, 200000};
+	setsockopt(rx_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	// Drain the receive socket so we measure a realistic path
+	std::atomic<size_t> received{0};
+	std::thread receiver([rx_socket, &received]() {
+		char buffer[BENCHMARK_PACKET_SIZE];
+		while (recv(rx_socket, buffer, sizeof(buffer), 0) > 0) {
+			++received;
+		}
+	});
+
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	for (size_t i = 0; i < BENCHMARK_BATCH; ++i) {
+		auto buffer = std::make_unique<PacketBuffer>(BENCHMARK_PACKET_SIZE);
+		buffer->setDataSize(BENCHMARK_PACKET_SIZE);
+		buffers.push_back(std::move(buffer));
+	}
+
+	SocketWriter writer(tx_socket, mode);
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t sent = 0; sent < BENCHMARK_PACKETS; sent += BENCHMARK_BATCH) {
+		writer.write(&rx_addr, buffers);
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	receiver.join();
+	close(rx_socket);
+	close(tx_socket);
+
+	std::cout << std::format("{:<10} {:>12.0f} pps {:>8.3f} syscalls/packet {:>10} sent {:>10} received",
+							 SocketWriteModeToString(writer.getMode()), writer.getPacketCount() / elapsed,
+							 static_cast<double>(writer.getSyscallCount()) / writer.getPacketCount(), writer.getPacketCount(),
+							 received.load())
+			  << std::endl;
+}
+
+int main() {
+	std::cout << std::format("Sending {} packets of {} bytes over loopback in batches of {}", BENCHMARK_PACKETS,
+							 BENCHMARK_PACKET_SIZE, BENCHMARK_BATCH)
+			  << std::endl;
+
+	for (auto mode : {SocketWriteMode::SENDTO, SocketWriteMode::SENDMMSG, SocketWriteMode::GSO}) {
+		run_benchmark(mode);
+	}
+
+	return 0;
+}
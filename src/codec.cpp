@@ -14,7 +14,66 @@ std::string PacketHeaderOptionFormatTypeToString(PacketHeaderOptionFormatType ty
 		return "lz4";
 	case PacketHeaderOptionFormatType::COMPRESSED_ZSTD:
 		return "zstd";
+	case PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH:
+		return "lz4-batch";
+	case PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH:
+		return "zstd-batch";
 	default:
 		return "unknown";
 	}
 }
+
+
+/**
+ * @brief Parse a packet format from the name of its compression algorithm.
+ *
+ * @param str String to parse.
+ * @param type Packet format parsed.
+ * @return true If the string was a valid compression algorithm.
+ * @return false If the string was not a valid compression algorithm.
+ */
+bool PacketHeaderOptionFormatTypeFromString(const std::string &str, PacketHeaderOptionFormatType &type) {
+	if (str == "none") {
+		type = PacketHeaderOptionFormatType::NONE;
+	} else if (str == "lz4") {
+		type = PacketHeaderOptionFormatType::COMPRESSED_LZ4;
+	} else if (str == "zstd") {
+		type = PacketHeaderOptionFormatType::COMPRESSED_ZSTD;
+	} else if (str == "lz4-batch") {
+		type = PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH;
+	} else if (str == "zstd-batch") {
+		type = PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Check if a packet format compresses batches of frames together.
+ *
+ * @param type Packet format.
+ * @return true If frames are compressed in batches.
+ * @return false If frames are compressed one at a time, or not at all.
+ */
+bool PacketHeaderOptionFormatTypeIsBatch(PacketHeaderOptionFormatType type) {
+	return type == PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH ||
+		   type == PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH;
+}
+
+/**
+ * @brief Get the packet format used to compress a single frame with the same compression algorithm as a packet format.
+ *
+ * @param type Packet format.
+ * @return PacketHeaderOptionFormatType Packet format which compresses frames one at a time.
+ */
+PacketHeaderOptionFormatType PacketHeaderOptionFormatTypeUnbatched(PacketHeaderOptionFormatType type) {
+	switch (type) {
+	case PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH:
+		return PacketHeaderOptionFormatType::COMPRESSED_LZ4;
+	case PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH:
+		return PacketHeaderOptionFormatType::COMPRESSED_ZSTD;
+	default:
+		return type;
+	}
+}
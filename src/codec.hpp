@@ -31,12 +31,16 @@ inline constexpr uint16_t SETH_PACKET_MAX_SIZE = UINT16_MAX - SETH_PACKET_ETHERN
  *	- C: 1 bit, packet contains critical options that MUST be parsed.
  *	- Packet Format: 8 bits, this indicates the packet payload format.
  *	- Channel: 8 bits, Network channel to use.
+ *
+ * Flood packets carry a single complete frame sent to all the remote nodes, they are not part of the packet sequence of the node
+ * and their payload is compressed on its own, so they can be decoded without any stream state.
  */
 
 inline constexpr uint8_t SETH_PACKET_HEADER_VERSION_V1{0x1};
 
 enum class PacketHeaderFormat : uint8_t {
 	ENCAPSULATED = 0x1,
+	ENCAPSULATED_FLOOD = 0x2,
 };
 
 struct PacketHeader {
@@ -68,7 +72,20 @@ struct PacketHeader {
  *	  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  *	  |     Type      |           Packet Size         |     Format    |
  *	  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
- *    |        Payload Length         |     Part      |      RSVD     |
+ *    |        Payload Length         |     Part      |  Dictionary   |
+ *	  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ *	- Dictionary: 8 bits, ID of the dictionary a compressed payload was compressed with, 0 if none was used. This is always 0
+ *	  for uncompressed payloads. Payloads compressed with a dictionary we don't have cannot be decoded.
+ *
+ * Batch formats compress multiple complete frames together in one go, these are always sent as a complete packet. The packet size
+ * is the size of the batch once decompressed, which is made up of each frame prefixed by its 16 bit size. Each batch is
+ * compressed on its own, so the compression streams are reset before it.
+ *
+ *	  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	  |           Frame Size          |                               ~
+ *	  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+                               ~
+ *	  ~                  Frame, repeated for each frame               ~
  *	  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  *
  */
@@ -97,6 +114,8 @@ enum class PacketHeaderOptionFormatType : uint8_t {
 	NONE = 0x0,
 	COMPRESSED_LZ4 = 0x1,
 	COMPRESSED_ZSTD = 0x2,
+	COMPRESSED_LZ4_BATCH = 0x3,
+	COMPRESSED_ZSTD_BATCH = 0x4,
 };
 
 // Set default packet header option format
@@ -104,7 +123,13 @@ inline constexpr PacketHeaderOptionFormatType SETH_DEFAULT_PACKET_FORMAT{PacketH
 
 #define SETH_PACKET_HEADER_OPTION_FORMAT_IS_COMPRESSED(packet_header_option)                                                       \
 	(packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_LZ4 ||                                               \
-	 packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD)
+	 packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD ||                                              \
+	 SETH_PACKET_HEADER_OPTION_FORMAT_IS_BATCH(packet_header_option))
+
+// Check if the packet header option format is a batch of frames compressed together
+#define SETH_PACKET_HEADER_OPTION_FORMAT_IS_BATCH(packet_header_option)                                                            \
+	(packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH ||                                         \
+	 packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH)
 
 struct PacketHeaderOption {
 		PacketHeaderOptionType type;
@@ -112,7 +137,10 @@ struct PacketHeaderOption {
 		PacketHeaderOptionFormatType format;
 		accl::be16_t payload_length;
 		uint8_t part;
-		uint8_t reserved;
+		uint8_t dictionary;
 } ACCL_PACKED_ATTRIBUTES;
 
 extern std::string PacketHeaderOptionFormatTypeToString(PacketHeaderOptionFormatType type);
+extern bool PacketHeaderOptionFormatTypeFromString(const std::string &str, PacketHeaderOptionFormatType &type);
+extern bool PacketHeaderOptionFormatTypeIsBatch(PacketHeaderOptionFormatType type);
+extern PacketHeaderOptionFormatType PacketHeaderOptionFormatTypeUnbatched(PacketHeaderOptionFormatType type);
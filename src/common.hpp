@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 
@@ -18,9 +19,107 @@ constexpr uint16_t SETH_DEFAULT_PORT{58023};
 // Default buffer count
 inline constexpr size_t SETH_BUFFER_COUNT{5000};
 
+// Default buffer count when using TAP offloads, these buffers are large enough to hold GSO frames
+inline constexpr size_t SETH_TAP_OFFLOAD_BUFFER_COUNT{1024};
+
+// Number of buffers each thread caches from the available buffer pools
+inline constexpr size_t SETH_BUFFER_CACHE_SIZE{64};
+
 // Number of messages to get at maximum from recvmm
 inline constexpr uint32_t SETH_MAX_RECVMM_MESSAGES{256};
 
+// Number of messages to get at maximum from recvmm when using UDP GRO, each message can hold a GRO super-packet
+inline constexpr uint32_t SETH_MAX_GRO_MESSAGES{32};
+// Size and number of the buffers UDP GRO super-packets are received into, these are held until all their segments are decoded
+inline constexpr size_t SETH_GRO_BUFFER_SIZE{65535};
+inline constexpr size_t SETH_GRO_BUFFER_COUNT{256};
+// Most segments the kernel coalesces into a single UDP GRO super-packet
+inline constexpr size_t SETH_GRO_MAX_SEGMENTS{64};
+// Number of segment views each socket reader keeps ready when using UDP GRO, this covers every segment the GRO buffers can hold so
+// a socket reader never has more views out than this
+inline constexpr size_t SETH_GRO_VIEW_COUNT{SETH_GRO_BUFFER_COUNT * SETH_GRO_MAX_SEGMENTS};
+
+// Number of messages to send at maximum using sendmmsg
+inline constexpr uint32_t SETH_MAX_SENDMM_MESSAGES{256};
+// Number of IO vectors used at maximum across all messages sent using sendmmsg
+inline constexpr uint32_t SETH_MAX_SENDMM_IOVECS{1024};
+
+// Maximum number of segments and payload bytes in a UDP GSO super-packet
+inline constexpr uint32_t SETH_MAX_GSO_SEGMENTS{64};
+inline constexpr uint32_t SETH_MAX_GSO_SIZE{65000};
+
+// Number of submission queue entries in each io_uring, twice as many operations can be in flight
+inline constexpr unsigned int SETH_IO_URING_ENTRIES{512};
+// Number of TAP reads and socket receives kept in flight when using io_uring
+inline constexpr size_t SETH_IO_URING_TAP_READS{64};
+inline constexpr size_t SETH_IO_URING_SOCKET_RECVS{256};
+
+// Maximum number of TAP interface queues, each queue gets its own read and write thread
+inline constexpr size_t SETH_MAX_TAP_QUEUES{16};
+
+// Maximum number of SO_REUSEPORT sockets we receive on, each socket gets its own read thread
+inline constexpr size_t SETH_MAX_SOCKET_READ_THREADS{16};
+
+// Maximum number of worker threads encoding and decoding packets for the remote nodes
+inline constexpr size_t SETH_MAX_WORKER_THREADS{256};
+// Maximum number of buffers a worker processes for a remote node in one go before moving on to other work
+inline constexpr size_t SETH_WORKER_BATCH_SIZE{256};
+// Maximum number of channels per remote node, each channel has its own encoder, decoder and packet sequence
+inline constexpr size_t SETH_MAX_CHANNELS{16};
+// Time the encoder waits for more frames before sending a partially filled packet
+inline constexpr std::chrono::milliseconds SETH_ENCODER_FLUSH_TIMEOUT{1};
+// Minimum size of a frame referenced instead of copied when using zero-copy, smaller frames are cheaper to copy
+inline constexpr size_t SETH_ZERO_COPY_MIN_SIZE{256};
+// Number of frame views each decoder can have out at once when zero-copy decoding, frames are copied while these are all in use
+inline constexpr size_t SETH_ZERO_COPY_VIEW_COUNT{512};
+// Number of views of flooded frames each remote node can have queued, once these are all in use the views are allocated
+inline constexpr size_t SETH_FLOOD_VIEW_COUNT{512};
+// Minimum size of a message sent using MSG_ZEROCOPY, below this pinning the pages costs more than copying them
+inline constexpr size_t SETH_ZERO_COPY_SEND_MIN_SIZE{8192};
+
+// Number of flows each encoder tracks the compression of, this must be a power of 2
+inline constexpr size_t SETH_COMPRESSION_FLOW_COUNT{1024};
+// Number of frames of a flow which doesn't compress that are sent uncompressed before we try compress the flow again
+inline constexpr uint16_t SETH_COMPRESSION_BYPASS_FRAMES{128};
+// Compressed size as a percentage of the original size at which a flow is not worth compressing
+inline constexpr uint16_t SETH_COMPRESSION_BYPASS_RATIO{95};
+// Frames are sampled for their byte entropy after this offset, skipping over most of the headers
+inline constexpr size_t SETH_COMPRESSION_ENTROPY_SAMPLE_OFFSET{64};
+// Minimum and maximum number of bytes sampled for the byte entropy
+inline constexpr size_t SETH_COMPRESSION_ENTROPY_SAMPLE_MIN{128};
+inline constexpr size_t SETH_COMPRESSION_ENTROPY_SAMPLE_MAX{256};
+// Byte entropy in bits per byte at which a sample looks random and is not worth compressing
+inline constexpr float SETH_COMPRESSION_ENTROPY_THRESHOLD{7.0f};
+
+// Maximum size of a batch of frames compressed together, this is their size before being compressed
+inline constexpr size_t SETH_COMPRESSION_BATCH_MAX_SIZE{32 * 1024};
+// Percentage of the space left in a packet we expect a batch to fill once compressed before we compress it
+inline constexpr size_t SETH_COMPRESSION_BATCH_FILL{90};
+
+// Compression levels we accept for LZ4, this is the acceleration where higher is faster but compresses less
+inline constexpr int SETH_COMPRESSION_LEVEL_LZ4_MIN{1};
+inline constexpr int SETH_COMPRESSION_LEVEL_LZ4_MAX{65537};
+// Compression levels we accept for ZSTD, higher compresses better but is slower
+inline constexpr int SETH_COMPRESSION_LEVEL_ZSTD_MIN{1};
+inline constexpr int SETH_COMPRESSION_LEVEL_ZSTD_MAX{22};
+
+// Maximum size of a compression dictionary we load
+inline constexpr size_t SETH_COMPRESSION_DICTIONARY_MAX_SIZE{1024 * 1024};
+// Size of the compression dictionaries we train, LZ4 only uses the last 64KB
+inline constexpr size_t SETH_COMPRESSION_DICTIONARY_SIZE{32 * 1024};
+// Number of frames captured from the TAP interface to train a compression dictionary on
+inline constexpr size_t SETH_COMPRESSION_DICTIONARY_SAMPLES{20000};
+
+// Maximum length of a command sent to the control socket
+inline constexpr size_t SETH_CONTROL_SOCKET_MAX_COMMAND{1024};
+// Time a control socket client can sit idle before we disconnect it, clients are served one at a time
+inline constexpr std::chrono::seconds SETH_CONTROL_SOCKET_TIMEOUT{30};
+// How often the control socket thread checks if we're stopping
+inline constexpr std::chrono::milliseconds SETH_CONTROL_SOCKET_POLL_INTERVAL{500};
+
+// Initial number of slots in the FDB table, this must be a power of 2, the table grows as needed
+inline constexpr size_t SETH_FDB_INITIAL_CAPACITY{1024};
+
 // Minimum transmission packet size
 inline constexpr uint16_t SETH_MIN_TXSIZE{1200};
 
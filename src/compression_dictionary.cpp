@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "compression_dictionary.hpp"
+#include "common.hpp"
+#include "exceptions.hpp"
+#include <format>
+#include <fstream>
+#include <iterator>
+
+extern "C" {
+#include <zdict.h>
+}
+
+/**
+ * @brief Load a compression dictionary from a file.
+ *
+ * @param path Path of the dictionary file.
+ * @return std::string Dictionary.
+ * @throw SuperEthernetTunnelConfigException If the file cannot be read, is empty or is too big.
+ */
+std::string load_compression_dictionary(const std::string &path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw SuperEthernetTunnelConfigException(std::format("Cannot open compression dictionary '{}'", path));
+	}
+
+	std::string dictionary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (file.bad()) {
+		throw SuperEthernetTunnelConfigException(std::format("Cannot read compression dictionary '{}'", path));
+	}
+	if (dictionary.empty() || dictionary.size() > SETH_COMPRESSION_DICTIONARY_MAX_SIZE) {
+		throw SuperEthernetTunnelConfigException(std::format("Compression dictionary '{}' should be between 1 and {} bytes",
+															 path, SETH_COMPRESSION_DICTIONARY_MAX_SIZE));
+	}
+
+	return dictionary;
+}
+
+/**
+ * @brief Save a compression dictionary to a file.
+ *
+ * @param path Path of the dictionary file.
+ * @param dictionary Dictionary.
+ * @throw SuperEthernetTunnelRuntimeException If the file cannot be written.
+ */
+void save_compression_dictionary(const std::string &path, const std::string &dictionary) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(dictionary.data(), dictionary.size());
+	if (!file) {
+		throw SuperEthernetTunnelRuntimeException(std::format("Cannot write compression dictionary '{}'", path));
+	}
+}
+
+/**
+ * @brief Get the ID of a compression dictionary, this is sent with each compressed payload.
+ *
+ * The ID is a hash of the dictionary, so nodes with the same dictionary get the same ID without any configuration. As the ID
+ * is only 8 bits, two different dictionaries share an ID about once in 255 pairs. Nodes can't tell these dictionaries apart,
+ * and LZ4 decompresses with the wrong dictionary without reporting an error, so when changing dictionaries the ID can be set
+ * explicitly instead, and get_compression_dictionary_hash() gives a full hash to compare dictionaries with.
+ *
+ * @param dictionary Dictionary.
+ * @return uint8_t Dictionary ID between 1 and 255, or 0 if the dictionary is empty.
+ */
+uint8_t get_compression_dictionary_id(const std::string &dictionary) {
+	if (dictionary.empty()) {
+		return 0;
+	}
+
+	// FNV-1a
+	uint32_t hash = 2166136261;
+	for (char c : dictionary) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 16777619;
+	}
+	return static_cast<uint8_t>(hash % 255 + 1);
+}
+
+/**
+ * @brief Get a 64-bit hash of a compression dictionary, this is logged so dictionaries can be compared between nodes.
+ *
+ * @param dictionary Dictionary.
+ * @return uint64_t Hash of the dictionary.
+ */
+uint64_t get_compression_dictionary_hash(const std::string &dictionary) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (char c : dictionary) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * @brief Train a compression dictionary on sample frames.
+ *
+ * The dictionary is a ZSTD dictionary, LZ4 uses the content at the end of it.
+ *
+ * @param samples Sample frames, these should be representative of the traffic going over the tunnel.
+ * @param dictionary_size Maximum size of the dictionary.
+ * @return std::string Dictionary.
+ * @throw SuperEthernetTunnelRuntimeException If training failed, this happens when there are too few samples.
+ */
+std::string train_compression_dictionary(const std::vector<std::string> &samples, size_t dictionary_size) {
+	// ZDICT wants the samples one after the other with a list of their sizes
+	std::string sample_buffer;
+	std::vector<size_t> sample_sizes;
+	sample_sizes.reserve(samples.size());
+	for (auto &sample : samples) {
+		sample_buffer.append(sample);
+		sample_sizes.push_back(sample.size());
+	}
+
+	std::string dictionary(dictionary_size, '\0');
+	size_t result = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), sample_buffer.data(), sample_sizes.data(),
+										  static_cast<unsigned int>(sample_sizes.size()));
+	if (ZDICT_isError(result)) {
+		throw SuperEthernetTunnelRuntimeException(
+			std::format("Failed to train compression dictionary: {}", ZDICT_getErrorName(result)));
+	}
+	dictionary.resize(result);
+
+	return dictionary;
+}
@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+std::string load_compression_dictionary(const std::string &path);
+void save_compression_dictionary(const std::string &path, const std::string &dictionary);
+
+uint8_t get_compression_dictionary_id(const std::string &dictionary);
+uint64_t get_compression_dictionary_hash(const std::string &dictionary);
+
+std::string train_compression_dictionary(const std::vector<std::string> &samples, size_t dictionary_size);
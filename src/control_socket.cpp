@@ -0,0 +1,184 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "control_socket.hpp"
+#include "common.hpp"
+#include "exceptions.hpp"
+#include "libaccl/logger.hpp"
+#include "util.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @brief Construct a new ControlSocket object, the socket is created straight away and only root can connect to it.
+ *
+ * @param path Path of the socket, a stale socket left at this path is replaced.
+ * @param handler Command handler, this is called from the control socket thread.
+ * @throw SuperEthernetTunnelRuntimeException If the socket cannot be created.
+ */
+ControlSocket::ControlSocket(const std::string &path, CommandHandler handler)
+	: path(path), handler(handler), fd(-1), stop_flag(false) {
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.empty() || path.length() >= sizeof(addr.sun_path)) {
+		throw SuperEthernetTunnelRuntimeException(
+			std::format("Control socket path '{}' should be between 1 and {} characters", path, sizeof(addr.sun_path) - 1));
+	}
+	std::memcpy(addr.sun_path, path.data(), path.length());
+
+	// Remove a socket left behind by a previous run, but never anything else
+	struct stat path_stat;
+	if (lstat(path.c_str(), &path_stat) == 0) {
+		if (!S_ISSOCK(path_stat.st_mode)) {
+			throw SuperEthernetTunnelRuntimeException(std::format("Control socket path '{}' exists and is not a socket", path));
+		}
+		unlink(path.c_str());
+	}
+
+	if ((this->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+		throw SuperEthernetTunnelRuntimeException(std::format("Control socket creation failed: {}", strerror(errno)));
+	}
+	if (bind(this->fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || chmod(path.c_str(), S_IRUSR | S_IWUSR) < 0 ||
+		listen(this->fd, 4) < 0) {
+		int err = errno;
+		close(this->fd);
+		unlink(path.c_str());
+		throw SuperEthernetTunnelRuntimeException(std::format("Control socket '{}' setup failed: {}", path, strerror(err)));
+	}
+}
+
+/**
+ * @brief Destroy the ControlSocket object, removing the socket.
+ *
+ */
+ControlSocket::~ControlSocket() {
+	this->stop();
+	this->wait();
+	close(this->fd);
+	unlink(this->path.c_str());
+}
+
+/**
+ * @brief Start the thread accepting commands.
+ *
+ */
+void ControlSocket::start() { this->thread = std::make_unique<std::thread>(&ControlSocket::control_socket_handler, this); }
+
+/**
+ * @brief Stop accepting commands, the thread exits within SETH_CONTROL_SOCKET_POLL_INTERVAL.
+ *
+ * This only sets a flag, so it can be called from a signal handler.
+ */
+void ControlSocket::stop() { this->stop_flag = true; }
+
+/**
+ * @brief Wait for the thread accepting commands to exit.
+ *
+ */
+void ControlSocket::wait() {
+	if (this->thread && this->thread->joinable()) {
+		this->thread->join();
+	}
+}
+
+/**
+ * @brief Thread accepting clients and handling their commands.
+ *
+ */
+void ControlSocket::control_socket_handler() {
+	LOG_DEBUG_INTERNAL("Control socket thread started for '", this->path, "'");
+
+	while (!this->stop_flag) {
+		if (!this->_poll(this->fd)) {
+			continue;
+		}
+
+		int client_fd = accept4(this->fd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (client_fd < 0) {
+			if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+				LOG_ERROR("Control socket accept failed: ", strerror(errno));
+			}
+			continue;
+		}
+		this->_handleClient(client_fd);
+		close(client_fd);
+	}
+
+	LOG_DEBUG_INTERNAL("Exiting control socket thread");
+}
+
+/**
+ * @brief Internal method to wait for a file descriptor to become readable.
+ *
+ * @param poll_fd File descriptor to wait on.
+ * @return true If the file descriptor is readable or has been closed.
+ * @return false If nothing happened within SETH_CONTROL_SOCKET_POLL_INTERVAL.
+ */
+bool ControlSocket::_poll(int poll_fd) {
+	pollfd pfd{poll_fd, POLLIN, 0};
+	int res = poll(&pfd, 1, static_cast<int>(SETH_CONTROL_SOCKET_POLL_INTERVAL.count()));
+	return res > 0;
+}
+
+/**
+ * @brief Internal method to read the commands of a client and send back the replies, until it disconnects or goes idle.
+ *
+ * @param client_fd Client socket.
+ */
+void ControlSocket::_handleClient(int client_fd) {
+	std::string input;
+	char buffer[512];
+	auto last_activity = std::chrono::steady_clock::now();
+
+	while (!this->stop_flag) {
+		if (!this->_poll(client_fd)) {
+			if (std::chrono::steady_clock::now() - last_activity > SETH_CONTROL_SOCKET_TIMEOUT) {
+				LOG_DEBUG_INTERNAL("Control socket client idle, disconnecting");
+				return;
+			}
+			continue;
+		}
+
+		ssize_t bytes_read = recv(client_fd, buffer, sizeof(buffer), 0);
+		if (bytes_read <= 0) {
+			if (bytes_read < 0 && errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		last_activity = std::chrono::steady_clock::now();
+		input.append(buffer, bytes_read);
+
+		// Handle each complete line we have
+		size_t end;
+		while ((end = input.find('\n')) != std::string::npos) {
+			std::vector<std::string> args = splitByDelimiters(input.substr(0, end), " \t\r");
+			input.erase(0, end + 1);
+			if (args.empty()) {
+				continue;
+			}
+
+			std::string reply = this->handler(args) + "\n";
+			if (send(client_fd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0) {
+				return;
+			}
+		}
+
+		if (input.size() > SETH_CONTROL_SOCKET_MAX_COMMAND) {
+			std::string reply = "ERROR: Command too long\n";
+			send(client_fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+			return;
+		}
+	}
+}
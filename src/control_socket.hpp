@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Unix socket accepting line based commands used to change settings at runtime.
+ *
+ * Each line is split into its arguments and handed to the command handler, the reply is sent back as a line. Clients are served
+ * one at a time.
+ *
+ */
+class ControlSocket {
+	public:
+		// Command handler, this gets the arguments of a command and returns the reply
+		using CommandHandler = std::function<std::string(const std::vector<std::string> &args)>;
+
+		ControlSocket(const std::string &path, CommandHandler handler);
+		~ControlSocket();
+
+		void start();
+		void stop();
+		void wait();
+
+		inline const std::string &getPath() const;
+
+	private:
+		std::string path;
+		CommandHandler handler;
+		int fd;
+
+		std::atomic<bool> stop_flag;
+		std::unique_ptr<std::thread> thread;
+
+		void control_socket_handler();
+
+		bool _poll(int poll_fd);
+		void _handleClient(int client_fd);
+};
+
+/**
+ * @brief Get the path of the control socket.
+ *
+ * @return const std::string& Path.
+ */
+inline const std::string &ControlSocket::getPath() const { return path; }
\ No newline at end of file
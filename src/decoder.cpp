@@ -6,10 +6,13 @@
 
 #include "decoder.hpp"
 #include "codec.hpp"
+#include "common.hpp"
+#include "compression_dictionary.hpp"
 #include "libaccl/logger.hpp"
 #include "libaccl/stream_compressor_lz4.hpp"
 #include "util.hpp"
 #include <cassert>
+#include <cstring>
 
 /*
  * Packet decoder
@@ -38,6 +41,21 @@ void PacketDecoder::_getTxBuffer() {
 	this->_clearState();
 }
 
+/**
+ * @brief Internal method to push a completed TX buffer to a TX buffer pool, picking the pool using the flow of the frame.
+ *
+ * @param buffer Buffer holding the frame.
+ */
+void PacketDecoder::_pushTxBuffer(std::unique_ptr<PacketBuffer> buffer) {
+	size_t pool = 0;
+	if (this->tx_buffer_pools.size() > 1 && buffer->getDataSize() > this->frame_header_size) {
+		pool = get_ethernet_flow_hash(buffer->getData() + this->frame_header_size,
+									  buffer->getDataSize() - this->frame_header_size) %
+			   this->tx_buffer_pools.size();
+	}
+	this->tx_buffer_pools[pool]->push(std::move(buffer));
+}
+
 /**
  * @brief Internal method to flush inflight buffers to the buffer pool.
  *
@@ -64,6 +82,11 @@ void PacketDecoder::_flushInflight() {
  * @param packetBuffer
  */
 void PacketDecoder::_pushInflight(std::unique_ptr<PacketBuffer> &packetBuffer) {
+	// Views don't belong to our buffer pool, releasing them drops their reference on the buffer they were received into
+	if (packetBuffer->isView()) {
+		packetBuffer.reset();
+		return;
+	}
 	// Push buffer into inflight list
 	this->inflight_buffers.push_back(std::move(packetBuffer));
 	LOG_DEBUG_INTERNAL("  - INFLIGHT: Packet added");
@@ -77,6 +100,237 @@ void PacketDecoder::_clearStateAndFlushInflight(std::unique_ptr<PacketBuffer> &p
 	this->_flushInflight();
 }
 
+/**
+ * @brief Internal method to switch our decompressors to the dictionary the payloads of a packet were compressed with.
+ *
+ * Remote nodes without a dictionary send payloads compressed without one, so we turn our dictionary off for those. Switching
+ * resets the decompression streams, an encoder only ever uses one dictionary so this only happens when a remote node changes its
+ * dictionary.
+ *
+ * @param dictionary Dictionary ID from the packet header option.
+ * @return true If we can decompress the payloads.
+ * @return false If we don't have the dictionary.
+ */
+bool PacketDecoder::_useDictionary(uint8_t dictionary) {
+	if (dictionary && dictionary != this->dictionary_id) {
+		return false;
+	}
+
+	bool enabled = dictionary != 0;
+	if (this->compressorLZ4->getDictionaryEnabled() != enabled) {
+		LOG_DEBUG_INTERNAL("DICTIONARY: Switching dictionary ", enabled ? "on" : "off");
+		this->compressorLZ4->setDictionaryEnabled(enabled);
+		this->compressorZSTD->setDictionaryEnabled(enabled);
+		this->compressorLZ4->resetDecompressionStream();
+		this->compressorZSTD->resetDecompressionStream();
+	}
+
+	return true;
+}
+
+/**
+ * @brief Internal method to decode a batch of frames compressed together and push each of the frames to the TX buffer pools.
+ *
+ * @param packetBuffer Packet buffer holding the batch.
+ * @param packet_header_option Packet header option of the batch.
+ * @param packet_pos Position of the compressed batch in the packet buffer.
+ * @param sequence Packet sequence, used for logging.
+ * @return true If the batch was decoded.
+ * @return false If the batch is invalid, frames before the invalid frame were already pushed.
+ */
+bool PacketDecoder::_decodeBatch(PacketBuffer &packetBuffer, const PacketHeaderOption *packet_header_option, uint16_t packet_pos,
+								 uint32_t sequence) {
+	uint16_t batch_size = accl::be_to_cpu_16(packet_header_option->packet_size);
+	uint16_t payload_length = accl::be_to_cpu_16(packet_header_option->payload_length);
+
+	if (batch_size > this->batch_buffer->getBufferSize()) {
+		LOG_ERROR("{seq=", sequence, "}: Batch size ", batch_size, " exceeds maximum batch size ",
+				  this->batch_buffer->getBufferSize());
+		return false;
+	}
+	// Batches need not be at the start of the packet, so we only know which dictionary they were compressed with here
+	if (!this->_useDictionary(packet_header_option->dictionary)) {
+		LOG_ERROR("{seq=", sequence, "}: Batch was compressed with unknown dictionary ",
+				  static_cast<unsigned int>(packet_header_option->dictionary));
+		return false;
+	}
+
+	// Each batch is compressed on its own, so our stream is reset before and after it like the encoder does
+	accl::StreamCompressor *compressor;
+	if (packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH) {
+		compressor = this->compressorLZ4;
+	} else {
+		compressor = this->compressorZSTD;
+	}
+	compressor->resetDecompressionStream();
+	int decompressed_size = compressor->decompress(packetBuffer.getData() + packet_pos, payload_length,
+												   this->batch_buffer->getData(), this->batch_buffer->getBufferSize());
+	compressor->resetDecompressionStream();
+	if (decompressed_size != batch_size) {
+		LOG_ERROR("{seq=", sequence, "}: Batch decompressed to ", decompressed_size, " bytes but should be ", batch_size);
+		return false;
+	}
+
+	LOG_DEBUG_INTERNAL("{seq=", sequence, "}: Decompressed batch, size=", batch_size, ", payload_length=", payload_length);
+
+	// Split the batch into its frames, each one is prefixed by its size
+	const char *batch = this->batch_buffer->getData();
+	size_t batch_pos = 0;
+	while (batch_pos < batch_size) {
+		if (batch_pos + sizeof(accl::be16_t) > batch_size) {
+			LOG_ERROR("{seq=", sequence, "}: Batch frame size at offset ", batch_pos, " exceeds batch size ", batch_size);
+			return false;
+		}
+		accl::be16_t batch_frame_size;
+		std::memcpy(&batch_frame_size, batch + batch_pos, sizeof(batch_frame_size));
+		uint16_t frame_size = accl::be_to_cpu_16(batch_frame_size);
+		batch_pos += sizeof(batch_frame_size);
+
+		if (frame_size > this->l2mtu || batch_pos + frame_size > batch_size) {
+			LOG_ERROR("{seq=", sequence, "}: Batch frame size ", frame_size, " at offset ", batch_pos,
+					  " is invalid, batch size is ", batch_size);
+			return false;
+		}
+
+		this->tx_buffer->append(batch + batch_pos, frame_size);
+		this->tx_buffer->setPacketSource(packetBuffer.getPacketSource());
+		this->_pushTxBuffer(std::move(this->tx_buffer));
+		this->_getTxBuffer();
+
+		batch_pos += frame_size;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Internal method to decode a flood packet, these hold a single frame compressed on its own so our state is left as is.
+ *
+ * @param packetBuffer Packet buffer, this is released once decoded.
+ */
+void PacketDecoder::_decodeFlood(std::unique_ptr<PacketBuffer> &packetBuffer) {
+	const size_t header_size = sizeof(PacketHeader) + sizeof(PacketHeaderOption);
+
+	PacketHeader *packet_header = (PacketHeader *)packetBuffer->getData();
+	if (packet_header->opt_len != 1 || packetBuffer->getDataSize() < header_size) {
+		LOG_ERROR("Flood packet should have a single packet header option, opt_len=",
+				  static_cast<unsigned int>(packet_header->opt_len), ", size=", packetBuffer->getDataSize(), ", DROPPING!");
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+
+	PacketHeaderOption *packet_header_option = (PacketHeaderOption *)(packetBuffer->getData() + sizeof(PacketHeader));
+	uint16_t orig_packet_size = accl::be_to_cpu_16(packet_header_option->packet_size);
+	uint16_t payload_length = accl::be_to_cpu_16(packet_header_option->payload_length);
+
+	// Flood packets always hold a single complete packet
+	if (packet_header_option->type != PacketHeaderOptionType::COMPLETE_PACKET || packet_header_option->part) {
+		LOG_ERROR("Flood packet header option is invalid, type=",
+				  std::format("{:02X}", static_cast<unsigned int>(packet_header_option->type)),
+				  ", part=", static_cast<unsigned int>(packet_header_option->part), ", DROPPING!");
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+	// We can only decompress the payload if we have the dictionary it was compressed with
+	uint8_t dictionary = packet_header_option->dictionary;
+	if (dictionary &&
+		(!SETH_PACKET_HEADER_OPTION_FORMAT_IS_COMPRESSED(packet_header_option) || dictionary != this->dictionary_id)) {
+		LOG_ERROR("Flood packet was compressed with unknown dictionary ", static_cast<unsigned int>(dictionary), ", DROPPING!");
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+	if (orig_packet_size > this->l2mtu) {
+		LOG_ERROR("Flood packet too big for interface L2MTU, ", orig_packet_size, " > ", this->l2mtu, ", DROPPING!");
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+	if (header_size + payload_length > packetBuffer->getDataSize()) {
+		LOG_ERROR("Flood packet payload length ", payload_length, " would exceed encapsulating packet size ",
+				  packetBuffer->getDataSize(), ", DROPPING!");
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+
+	// Decode into a buffer of its own, so we don't disturb any partial packet we're busy with
+	auto frame_buffer = this->available_buffer_pool->pop_wait();
+	frame_buffer->clear();
+	const char *payload = packetBuffer->getData() + header_size;
+	int decompressed_size;
+	if (packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_LZ4) {
+		this->floodCompressorLZ4->setDictionaryEnabled(dictionary != 0);
+		this->floodCompressorLZ4->resetDecompressionStream();
+		decompressed_size = this->floodCompressorLZ4->decompress(payload, payload_length, frame_buffer->getData(),
+																 frame_buffer->getBufferSize());
+	} else if (packet_header_option->format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD) {
+		this->floodCompressorZSTD->setDictionaryEnabled(dictionary != 0);
+		this->floodCompressorZSTD->resetDecompressionStream();
+		decompressed_size = this->floodCompressorZSTD->decompress(payload, payload_length, frame_buffer->getData(),
+																  frame_buffer->getBufferSize());
+	} else if (packet_header_option->format == PacketHeaderOptionFormatType::NONE) {
+		frame_buffer->append(payload, payload_length);
+		decompressed_size = payload_length;
+	} else {
+		LOG_ERROR("Flood packet has invalid format ",
+				  std::format("{:02X}", static_cast<unsigned int>(packet_header_option->format)), ", DROPPING!");
+		this->available_buffer_pool->push(std::move(frame_buffer));
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+
+	// The result must match the original packet size, this also catches decompression errors
+	if (decompressed_size != orig_packet_size) {
+		LOG_ERROR("Flood packet decoded to ", decompressed_size, " bytes but should be ", orig_packet_size, ", DROPPING!");
+		this->available_buffer_pool->push(std::move(frame_buffer));
+		this->_releaseBuffer(packetBuffer);
+		return;
+	}
+
+	LOG_DEBUG_INTERNAL("FLOOD DECODE: size=", orig_packet_size,
+					   ", format=", static_cast<unsigned int>(packet_header_option->format));
+
+	frame_buffer->setDataSize(decompressed_size);
+	frame_buffer->setPacketSource(packetBuffer->getPacketSource());
+	this->_pushTxBuffer(std::move(frame_buffer));
+
+	this->_releaseBuffer(packetBuffer);
+}
+
+/**
+ * @brief Internal method to release a packet buffer we're done with.
+ *
+ * @param packetBuffer Buffer to release, views are released and other buffers are pushed back into the available buffer pool.
+ */
+void PacketDecoder::_releaseBuffer(std::unique_ptr<PacketBuffer> &packetBuffer) {
+	if (packetBuffer->isView()) {
+		packetBuffer.reset();
+		return;
+	}
+	this->available_buffer_pool->push(std::move(packetBuffer));
+}
+
+/**
+ * @brief Internal method to create a view of a frame in a packet buffer, so it can be pushed to the TX buffer pools as is.
+ *
+ * The first time a packet is viewed it is shared and replaced by a view of the whole packet, which is released as normal once
+ * decoded. The packet is pushed back into the available buffer pool once it and all the views of it are released. Packets
+ * received using UDP GRO are already views of the super-packet they were received in, so views of them are views of that.
+ *
+ * @param packetBuffer Packet buffer holding the frame.
+ * @param offset Offset of the frame in the packet.
+ * @param size Size of the frame.
+ * @return std::unique_ptr<PacketBuffer> View of the frame.
+ */
+std::unique_ptr<PacketBuffer> PacketDecoder::_viewFrame(std::unique_ptr<PacketBuffer> &packetBuffer, size_t offset, size_t size) {
+	if (!packetBuffer->isView()) {
+		size_t data_size = packetBuffer->getDataSize();
+		PacketBuffer *packet = packetBuffer.release();
+		packet->share(this->available_buffer_pool);
+		packetBuffer = PacketBuffer::createView(this->view_arena, packet, 0, data_size);
+		packet->unshare();
+	}
+	return PacketBuffer::createView(this->view_arena, packetBuffer.get(), offset, size);
+}
+
 /**
  * @brief Construct a new packet decoder object
  *
@@ -85,20 +339,42 @@ void PacketDecoder::_clearStateAndFlushInflight(std::unique_ptr<PacketBuffer> &p
  * @param available_buffer_pool Available buffer pool.
  */
 PacketDecoder::PacketDecoder(uint16_t l2mtu, std::shared_ptr<accl::BufferPool<PacketBuffer>> tx_buffer_pool,
+							 std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool)
+	: PacketDecoder(l2mtu, std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>>{tx_buffer_pool}, available_buffer_pool) {}
+
+/**
+ * @brief Construct a new packet decoder object which spreads the decoded frames over multiple TX buffer pools.
+ *
+ * @param l2mtu Layer 2 MTU size.
+ * @param tx_buffer_pools TX buffer pools, frames of the same flow are always pushed to the same pool.
+ * @param available_buffer_pool Available buffer pool.
+ */
+PacketDecoder::PacketDecoder(uint16_t l2mtu, const std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> &tx_buffer_pools,
 							 std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool) {
 	// As the constructor parameters have the same names as our data members, lets just use this-> for everything during init
 	this->l2mtu = l2mtu;
+	this->frame_header_size = 0;
+	this->zero_copy = false;
+	// The arena holding our views is only created once zero-copy decoding is enabled
+	this->view_arena = nullptr;
+	this->channel = 0;
 	this->first_packet = true;
 
 	// Initialize our compressors
 	this->compressorLZ4 = new accl::StreamCompressorLZ4();
 	this->compressorZSTD = new accl::StreamCompressorZSTD();
+	this->floodCompressorLZ4 = new accl::StreamCompressorLZ4();
+	this->floodCompressorZSTD = new accl::StreamCompressorZSTD();
+	this->dictionary_id = 0;
+
+	// Batches are bigger than a packet, so they get a buffer of their own
+	this->batch_buffer = std::make_unique<PacketBuffer>(SETH_COMPRESSION_BATCH_MAX_SIZE);
 
 	// Grab a buffer to use for decompression
 	dcomp_buffer = available_buffer_pool->pop_wait();
 
 	// Setup buffer pools
-	this->tx_buffer_pool = tx_buffer_pool;
+	this->tx_buffer_pools = tx_buffer_pools;
 	this->available_buffer_pool = available_buffer_pool;
 
 	// Initialize the TX buffer for first use
@@ -112,8 +388,28 @@ PacketDecoder::PacketDecoder(uint16_t l2mtu, std::shared_ptr<accl::BufferPool<Pa
 PacketDecoder::~PacketDecoder() {
 	delete this->compressorLZ4;
 	delete this->compressorZSTD;
+	delete this->floodCompressorLZ4;
+	delete this->floodCompressorZSTD;
+	// Views still out there keep the arena around until they are released
+	if (this->view_arena) {
+		this->view_arena->release();
+	}
 };
 
+/**
+ * @brief Enable or disable zero-copy decoding, uncompressed frames are pushed as views of the packet they were received in.
+ *
+ * The packet is only released once all the views of it are released, views must never be pushed into a buffer pool.
+ *
+ * @param enable Enable zero-copy decoding.
+ */
+void PacketDecoder::setZeroCopy(bool enable) {
+	if (enable && !this->view_arena) {
+		this->view_arena = accl::BufferArena::createSlots(sizeof(PacketBuffer), alignof(PacketBuffer), SETH_ZERO_COPY_VIEW_COUNT);
+	}
+	this->zero_copy = enable;
+}
+
 /**
  * @brief Decode buffer.
  *
@@ -125,7 +421,9 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 	// Make sure packet is big enough to contain our header
 	if (packetBuffer->getDataSize() < sizeof(PacketHeader)) {
 		LOG_ERROR("Packet too small, should be > ", sizeof(PacketHeader));
-		this->available_buffer_pool->push(std::move(packetBuffer));
+		if (!packetBuffer->isView()) {
+			this->available_buffer_pool->push(std::move(packetBuffer));
+		}
 		this->tx_buffer->clear();
 		return;
 	}
@@ -151,15 +449,16 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 		return;
 	}
 	// We only support encapsulated packets at the moment
-	if (static_cast<uint8_t>(packet_header->format) != static_cast<uint8_t>(PacketHeaderFormat::ENCAPSULATED)) {
+	if (packet_header->format != PacketHeaderFormat::ENCAPSULATED &&
+		packet_header->format != PacketHeaderFormat::ENCAPSULATED_FLOOD) {
 		LOG_ERROR("Packet in invalid format ", std::format("{:02X}", static_cast<unsigned int>(packet_header->format)),
 				  ", DROPPING!");
 		// Clear current state and flush inflight buffers
 		this->_clearStateAndFlushInflight(packetBuffer);
 		return;
 	}
-	// Make sure the channel is not set
-	if (packet_header->channel) {
+	// Make sure the packet is for our channel
+	if (packet_header->channel != this->channel) {
 		LOG_ERROR("Packet specifies invalid channel ", std::format("{:02X}", static_cast<unsigned int>(packet_header->channel)),
 				  ", DROPPING!");
 		// Clear current state and flush inflight buffers
@@ -167,6 +466,12 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 		return;
 	}
 
+	// Flood packets are not part of the packet sequence and are decoded on their own
+	if (packet_header->format == PacketHeaderFormat::ENCAPSULATED_FLOOD) {
+		this->_decodeFlood(packetBuffer);
+		return;
+	}
+
 	// Decode sequence
 	uint32_t sequence = accl::be_to_cpu_32(packet_header->sequence);
 
@@ -219,10 +524,19 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 		}
 		// Overlay the option header
 		PacketHeaderOption *packet_header_option = (PacketHeaderOption *)(packetBuffer->getData() + cur_pos);
-		// Check for invalid header, where the reserved bits are set
-		if (packet_header_option->reserved) {
+		// Check for invalid header, where a dictionary is set on a payload that is not compressed
+		if (packet_header_option->dictionary && !SETH_PACKET_HEADER_OPTION_FORMAT_IS_COMPRESSED(packet_header_option)) {
 			LOG_ERROR("{seq=", sequence, "}: Packet header option number ", static_cast<unsigned int>(header_num + 1),
-					  " is invalid, reserved bits set");
+					  " is invalid, dictionary set on uncompressed payload");
+			// Clear current state and flush inflight buffers
+			this->_clearStateAndFlushInflight(packetBuffer);
+			return;
+		}
+		// Make sure we have the dictionary the payload was compressed with
+		if (SETH_PACKET_HEADER_OPTION_FORMAT_IS_COMPRESSED(packet_header_option) &&
+			!this->_useDictionary(packet_header_option->dictionary)) {
+			LOG_ERROR("{seq=", sequence, "}: Packet header option number ", static_cast<unsigned int>(header_num + 1),
+					  " was compressed with unknown dictionary ", static_cast<unsigned int>(packet_header_option->dictionary));
 			// Clear current state and flush inflight buffers
 			this->_clearStateAndFlushInflight(packetBuffer);
 			return;
@@ -282,7 +596,6 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 
 	// This flag indicates if we're going to be flushing the inflight buffers
 	bool flush_inflight = true;
-
 	// Loop while the packet_header_pos is not the end of the encapsulated packet
 	while (packet_header_pos < packetBuffer->getDataSize()) {
 
@@ -292,8 +605,8 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 		uint16_t orig_packet_size = accl::be_to_cpu_16(packet_header_option->packet_size);
 		uint16_t payload_length = accl::be_to_cpu_16(packet_header_option->payload_length);
 
-		// Make sure final packet size does not exceed the l2mtu
-		if (orig_packet_size > this->l2mtu) {
+		// Make sure final packet size does not exceed the l2mtu, batches hold multiple frames which are checked when split
+		if (!SETH_PACKET_HEADER_OPTION_FORMAT_IS_BATCH(packet_header_option) && orig_packet_size > this->l2mtu) {
 			LOG_ERROR("{seq=", sequence, "}: Packet too big for interface L2MTU, ", orig_packet_size, " > ", this->l2mtu);
 			// Clear current state and flush inflight buffers
 			this->_clearStateAndFlushInflight(packetBuffer);
@@ -336,6 +649,40 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 				return;
 			}
 
+			// Batches hold multiple frames, these are split and pushed straight away
+			if (SETH_PACKET_HEADER_OPTION_FORMAT_IS_BATCH(packet_header_option)) {
+				if (!this->_decodeBatch(*packetBuffer, packet_header_option, packet_pos, sequence)) {
+					// Clear current state and flush inflight buffers
+					this->_clearStateAndFlushInflight(packetBuffer);
+					return;
+				}
+				packet_header_pos = packet_pos + payload_length;
+				continue;
+			}
+
+			// Uncompressed frames are pushed as views of the packet, small frames are cheaper to copy and we copy frames while all
+			// our views are in use, so the number of views we have out stays bounded for sizing the TX buffer pools
+			if (this->zero_copy && packet_header_option->format == PacketHeaderOptionFormatType::NONE &&
+				payload_length >= SETH_ZERO_COPY_MIN_SIZE &&
+				this->view_arena->getFreeSlotCount() >= (packetBuffer->isView() ? 1U : 2U)) {
+				if (payload_length != orig_packet_size) {
+					LOG_ERROR("{seq=", sequence, "}: Payload length ", payload_length, " does not match the packet size of ",
+							  orig_packet_size, ", DROPPING!!!");
+					// Clear current state and flush inflight buffers
+					this->_clearStateAndFlushInflight(packetBuffer);
+					return;
+				}
+
+				LOG_DEBUG_INTERNAL("{seq=", sequence, "}: Pushing view of complete uncompressed packet at pos ", packet_pos,
+								   " with size ", payload_length);
+
+				auto frame_buffer = this->_viewFrame(packetBuffer, packet_pos, payload_length);
+				frame_buffer->setPacketSource(packetBuffer->getPacketSource());
+				this->_pushTxBuffer(std::move(frame_buffer));
+				packet_header_pos = packet_pos + payload_length;
+				continue;
+			}
+
 			// Next we check if its compressed
 			if (SETH_PACKET_HEADER_OPTION_FORMAT_IS_COMPRESSED(packet_header_option)) {
 
@@ -396,7 +743,7 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 
 			// Buffer ready, push to tx pool
 			this->tx_buffer->setPacketSource(packetBuffer->getPacketSource());
-			this->tx_buffer_pool->push(std::move(this->tx_buffer));
+			this->_pushTxBuffer(std::move(this->tx_buffer));
 
 			// We're now outsie the path of direct IO, so get a new buffer here so we can be ready for when we're in the
 			// direct IO path
@@ -559,7 +906,7 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 								   "}:   - Entire packet read... dumping into tx_buffer_pool & flushing inflight");
 				// Buffer ready, push to TX pool
 				this->tx_buffer->setPacketSource(packetBuffer->getPacketSource());
-				this->tx_buffer_pool->push(std::move(this->tx_buffer));
+				this->_pushTxBuffer(std::move(this->tx_buffer));
 				// We're now outsie the path of direct IO (maybe), so get a new buffer here so we can be ready for when we're in
 				// the direct IO path
 				this->_getTxBuffer();
@@ -589,3 +936,19 @@ void PacketDecoder::decode(std::unique_ptr<PacketBuffer> packetBuffer) {
 		this->_flushInflight();
 	}
 }
+
+/**
+ * @brief Set the dictionary used to decompress payloads compressed with a dictionary, payloads compressed without one can still be
+ * decoded.
+ *
+ * @param dictionary Compression dictionary, or nullptr to not use a dictionary.
+ * @param id ID sent with payloads compressed with the dictionary, 0 derives the ID from the dictionary.
+ */
+void PacketDecoder::setCompressionDictionary(std::shared_ptr<const std::string> dictionary, uint8_t id) {
+	const std::string &data = dictionary ? *dictionary : std::string();
+	this->compressorLZ4->setDictionary(data);
+	this->compressorZSTD->setDictionary(data);
+	this->floodCompressorLZ4->setDictionary(data);
+	this->floodCompressorZSTD->setDictionary(data);
+	this->dictionary_id = dictionary ? (id ? id : get_compression_dictionary_id(data)) : 0;
+}
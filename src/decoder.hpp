@@ -14,6 +14,8 @@
 #include "packet_buffer.hpp"
 #include <deque>
 #include <memory>
+#include <string>
+#include <vector>
 
 /*
  * Packet decoder
@@ -24,6 +26,8 @@ class PacketDecoder {
 	public:
 		PacketDecoder(uint16_t l2mtu, std::shared_ptr<accl::BufferPool<PacketBuffer>> tx_buffer_pool,
 					  std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool);
+		PacketDecoder(uint16_t l2mtu, const std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> &tx_buffer_pools,
+					  std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool);
 		~PacketDecoder();
 
 		void decode(std::unique_ptr<PacketBuffer> packetBuffer);
@@ -31,9 +35,27 @@ class PacketDecoder {
 		inline void setLastSequence(uint32_t seq);
 		inline uint32_t getLastSequence() const;
 
+		inline void setFrameHeaderSize(uint16_t size);
+
+		void setZeroCopy(bool enable);
+		inline bool getZeroCopy() const;
+
+		inline void setChannel(uint8_t channel);
+		inline uint8_t getChannel() const;
+
+		void setCompressionDictionary(std::shared_ptr<const std::string> dictionary, uint8_t id = 0);
+
 	private:
 		// Interface MTU
 		uint16_t l2mtu;
+		// Size of the header in front of each decoded ethernet frame
+		uint16_t frame_header_size;
+		// Complete uncompressed frames are pushed as views of the packet they were received in instead of being copied
+		bool zero_copy;
+		// Arena the views are created in, so they need no allocation
+		accl::BufferArena *view_arena;
+		// Channel we decode, packets for other channels are dropped
+		uint8_t channel;
 
 		// Sequence counter
 		bool first_packet;
@@ -50,19 +72,35 @@ class PacketDecoder {
 		accl::StreamCompressorLZ4 *compressorLZ4;
 		accl::StreamCompressorZSTD *compressorZSTD;
 		std::unique_ptr<PacketBuffer> dcomp_buffer;
-
-		// Buffer pool to push buffers to
-		std::shared_ptr<accl::BufferPool<PacketBuffer>> tx_buffer_pool;
+		// Flood packet compressors, these are reset for each packet so they don't disturb our stream state
+		accl::StreamCompressorLZ4 *floodCompressorLZ4;
+		accl::StreamCompressorZSTD *floodCompressorZSTD;
+		// ID of the dictionary our compressors are primed with, 0 if we don't have one
+		uint8_t dictionary_id;
+		// Buffer batches of frames compressed together are decompressed into before being split into frames
+		std::unique_ptr<PacketBuffer> batch_buffer;
+
+		// Buffer pools to push buffers to, frames are spread over these by flow
+		std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> tx_buffer_pools;
 		// Buffer pool to get buffers from
 		std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool;
 
 		void _clearState();
 
 		void _getTxBuffer();
+		void _pushTxBuffer(std::unique_ptr<PacketBuffer> buffer);
 
 		void _flushInflight();
 		void _pushInflight(std::unique_ptr<PacketBuffer> &packetBuffer);
 		void _clearStateAndFlushInflight(std::unique_ptr<PacketBuffer> &packetBuffer);
+
+		bool _useDictionary(uint8_t dictionary);
+
+		bool _decodeBatch(PacketBuffer &packetBuffer, const PacketHeaderOption *packet_header_option, uint16_t packet_pos,
+						  uint32_t sequence);
+		void _decodeFlood(std::unique_ptr<PacketBuffer> &packetBuffer);
+		void _releaseBuffer(std::unique_ptr<PacketBuffer> &packetBuffer);
+		std::unique_ptr<PacketBuffer> _viewFrame(std::unique_ptr<PacketBuffer> &packetBuffer, size_t offset, size_t size);
 };
 
 /**
@@ -80,4 +118,33 @@ inline void PacketDecoder::setLastSequence(uint32_t seq) {
  *
  * @return uint32_t Last packet sequence.
  */
-inline uint32_t PacketDecoder::getLastSequence() const { return last_sequence; }
\ No newline at end of file
+inline uint32_t PacketDecoder::getLastSequence() const { return last_sequence; }
+
+/**
+ * @brief Set the size of the header in front of each decoded ethernet frame, this is skipped when working out the flow of a frame.
+ *
+ * @param size Header size.
+ */
+inline void PacketDecoder::setFrameHeaderSize(uint16_t size) { frame_header_size = size; }
+
+/**
+ * @brief Check if zero-copy decoding is enabled.
+ *
+ * @return true If complete uncompressed frames are pushed as views of the packets.
+ * @return false If frames are copied out of the packets.
+ */
+inline bool PacketDecoder::getZeroCopy() const { return zero_copy; }
+
+/**
+ * @brief Set the channel we decode, each channel has its own packet sequence so needs its own decoder.
+ *
+ * @param channel Channel.
+ */
+inline void PacketDecoder::setChannel(uint8_t channel) { this->channel = channel; }
+
+/**
+ * @brief Get the channel we decode.
+ *
+ * @return uint8_t Channel.
+ */
+inline uint8_t PacketDecoder::getChannel() const { return channel; }
@@ -6,12 +6,18 @@
 
 #include "encoder.hpp"
 #include "codec.hpp"
+#include "common.hpp"
+#include "compression_dictionary.hpp"
 #include "libaccl/buffer_pool.hpp"
 #include "libaccl/logger.hpp"
 #include "libaccl/stream_compressor_lz4.hpp"
 #include "libaccl/stream_compressor_zstd.hpp"
 #include "packet_buffer.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <memory>
 
@@ -25,7 +31,7 @@
  */
 void PacketEncoder::_flush() {
 	// Check if we have data in the tx_buffer, other than the header we add automatically
-	if (this->tx_buffer->getDataSize() == sizeof(PacketHeader))
+	if (this->tx_buffer->getPacketSize() == sizeof(PacketHeader))
 		return;
 
 	// Check sequence is not about to wrap
@@ -41,12 +47,12 @@ void PacketEncoder::_flush() {
 	packet_header->critical = 0;
 	packet_header->oam = 0;
 	packet_header->format = PacketHeaderFormat::ENCAPSULATED;
-	packet_header->channel = 0;
+	packet_header->channel = this->channel;
 	packet_header->sequence = accl::cpu_to_be_32(this->sequence++);
 
 	// Dump the header into the tx buffer
 	LOG_DEBUG_INTERNAL("{seq=", this->sequence - 1, "}:  - FLUSH: ADDING HEADER: opts=", this->opt_len);
-	LOG_DEBUG_INTERNAL("{seq=", this->sequence - 1, "}:  - FLUSH: DEST BUFFER SIZE: ", this->tx_buffer->getDataSize());
+	LOG_DEBUG_INTERNAL("{seq=", this->sequence - 1, "}:  - FLUSH: DEST BUFFER SIZE: ", this->tx_buffer->getPacketSize());
 
 	// Flush buffer to the tx pool
 	this->tx_buffer_pool->push(std::move(this->tx_buffer));
@@ -81,14 +87,14 @@ uint16_t PacketEncoder::_getMaxPayloadSize(uint16_t size) const {
 	int32_t max_payload_size = this->l4mtu;
 
 	// If there is no data in the buffer, we're going to need a packet header
-	if (!this->tx_buffer->getDataSize()) {
+	if (!this->tx_buffer->getPacketSize()) {
 		max_payload_size -= sizeof(PacketHeader);
 	}
 	// Each packet needs a packet header
 	max_payload_size -= sizeof(PacketHeaderOption);
 
 	// Next we add the current buffer size, as this is overhead we've already incurred
-	max_payload_size -= this->tx_buffer->getDataSize();
+	max_payload_size -= this->tx_buffer->getPacketSize();
 
 	// Intermdiate check if we've got no space
 	if (max_payload_size <= 0) {
@@ -103,6 +109,17 @@ uint16_t PacketEncoder::_getMaxPayloadSize(uint16_t size) const {
 	return static_cast<uint16_t>(max_payload_size);
 }
 
+/**
+ * @brief Internal method to check if the tx buffer is as full as it will get.
+ *
+ * @return true If the tx buffer should be flushed.
+ * @return false If there is still space for more data.
+ */
+bool PacketEncoder::_isTxBufferFull() const {
+	// NK: We need to make provision for a header
+	return this->_getMaxPayloadSize(SETH_PACKET_MAX_SIZE) < sizeof(PacketHeader) + (sizeof(PacketHeaderOption) * 10);
+}
+
 /**
  * @brief Flush inflight buffers to the buffer pool.
  *
@@ -119,6 +136,8 @@ void PacketEncoder::_flushInflight() {
 					   "}:  - INFLIGHT: Flusing inflight buffers: avail pool=", this->available_buffer_pool->getBufferCount(),
 					   ", inflight count=", this->inflight_buffers.size());
 
+	// Views don't belong to our buffer pool, releasing them drops their reference on the frame they share
+	std::erase_if(this->inflight_buffers, [](const std::unique_ptr<PacketBuffer> &buffer) { return buffer->isView(); });
 	// Flush inflight buffers to the buffer pool
 	this->available_buffer_pool->push(this->inflight_buffers);
 
@@ -144,6 +163,256 @@ void PacketEncoder::_pushInflight(std::unique_ptr<PacketBuffer> &packetBuffer) {
 	LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - INFLIGHT: Packet added");
 }
 
+/**
+ * @brief Release a buffer we're done with back to the available buffer pool.
+ *
+ * @param packetBuffer Buffer to release, views are released and other buffers are pushed back into the available buffer pool.
+ */
+void PacketEncoder::_releaseBuffer(std::unique_ptr<PacketBuffer> &packetBuffer) {
+	if (packetBuffer->isView()) {
+		packetBuffer.reset();
+		return;
+	}
+	this->available_buffer_pool->push(std::move(packetBuffer));
+}
+
+/**
+ * @brief Internal method to get the compression state of the flow a frame belongs to.
+ *
+ * Flows share slots in our table by their hash, a flow taking over a slot starts off being compressed.
+ *
+ * @param packetBuffer Buffer holding the frame.
+ * @return FlowState* Compression state of the flow, or nullptr if adaptive compression is disabled.
+ */
+PacketEncoder::FlowState *PacketEncoder::_getFlowState(PacketBuffer &packetBuffer) {
+	if (this->flows.empty()) {
+		return nullptr;
+	}
+
+	uint32_t flow_hash = 0;
+	if (packetBuffer.getDataSize() > this->frame_header_size) {
+		flow_hash = get_ethernet_flow_hash(packetBuffer.getData() + this->frame_header_size,
+										   packetBuffer.getDataSize() - this->frame_header_size);
+	}
+
+	FlowState &flow = this->flows[flow_hash & (this->flows.size() - 1)];
+	if (flow.flow_hash != flow_hash) {
+		flow = FlowState{flow_hash, 0, 0};
+	}
+	return &flow;
+}
+
+/**
+ * @brief Internal method to check if a frame should be sent uncompressed as its flow does not compress.
+ *
+ * Frames of a flow which did not compress are sent uncompressed until SETH_COMPRESSION_BYPASS_FRAMES have passed, after which the
+ * flow is checked again. We also take a quick look at the byte entropy of the frame, as random looking data won't compress.
+ *
+ * @param packetBuffer Buffer holding the frame.
+ * @param flow Compression state of the flow the frame belongs to.
+ * @return true If the frame should be sent uncompressed.
+ * @return false If the frame should be compressed.
+ */
+bool PacketEncoder::_bypassCompression(PacketBuffer &packetBuffer, FlowState &flow) {
+	if (flow.bypass_frames) {
+		--flow.bypass_frames;
+		return true;
+	}
+
+	// Sample the frame after the headers, frames too small to get a decent sample are left to the compression ratio check
+	size_t size = packetBuffer.getDataSize();
+	if (size >= SETH_COMPRESSION_ENTROPY_SAMPLE_OFFSET + SETH_COMPRESSION_ENTROPY_SAMPLE_MIN) {
+		size_t sample_size = std::min(size - SETH_COMPRESSION_ENTROPY_SAMPLE_OFFSET, SETH_COMPRESSION_ENTROPY_SAMPLE_MAX);
+		float entropy = get_byte_entropy(packetBuffer.getData() + SETH_COMPRESSION_ENTROPY_SAMPLE_OFFSET, sample_size);
+		if (entropy >= SETH_COMPRESSION_ENTROPY_THRESHOLD) {
+			LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - COMPRESSION BYPASS: flow=", flow.flow_hash, ", entropy=", entropy);
+			// We don't know how well the flow would compress, so we assume it wouldn't have made a difference
+			flow.bypass_frames = SETH_COMPRESSION_BYPASS_FRAMES;
+			flow.ratio = 100;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Internal method to update the compression state of a flow after compressing one of its frames.
+ *
+ * @param flow Compression state of the flow.
+ * @param original_size Size of the frame.
+ * @param compressed_size Size of the frame after compression.
+ */
+void PacketEncoder::_updateFlowState(FlowState &flow, uint16_t original_size, uint16_t compressed_size) {
+	flow.ratio = static_cast<uint16_t>(static_cast<uint32_t>(compressed_size) * 100 / original_size);
+	if (flow.ratio >= SETH_COMPRESSION_BYPASS_RATIO) {
+		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - COMPRESSION BYPASS: flow=", flow.flow_hash, ", ratio=", flow.ratio);
+		flow.bypass_frames = SETH_COMPRESSION_BYPASS_FRAMES;
+	}
+}
+
+/**
+ * @brief Internal method to add a frame to the batch of frames compressed together.
+ *
+ * The batch is compressed once we expect it to fill the rest of the packet, using the compression ratio of the last batch.
+ *
+ * @param packetBuffer Buffer holding the frame, it is copied into the batch and released.
+ */
+void PacketEncoder::_batchFrame(std::unique_ptr<PacketBuffer> &packetBuffer) {
+	uint16_t frame_size = packetBuffer->getDataSize();
+
+	// Make sure the frame fits into the batch
+	if (this->batch_buffer->getDataSize() + sizeof(accl::be16_t) + frame_size > this->batch_buffer->getBufferSize()) {
+		this->_flushBatch();
+	}
+
+	LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - BATCH: adding frame, size=", frame_size,
+					   ", batch_size=", this->batch_buffer->getDataSize(), ", batch_frames=", this->batch_offsets.size());
+
+	this->batch_offsets.push_back(this->batch_buffer->getDataSize());
+	accl::be16_t batch_frame_size = accl::cpu_to_be_16(frame_size);
+	this->batch_buffer->append(reinterpret_cast<const char *>(&batch_frame_size), sizeof(batch_frame_size));
+	this->batch_buffer->append(packetBuffer->getData(), frame_size);
+	_releaseBuffer(packetBuffer);
+
+	size_t expected_size = this->batch_buffer->getDataSize() * this->batch_ratio / 100;
+	if (expected_size >= this->_getMaxPayloadSize(SETH_PACKET_MAX_SIZE) * SETH_COMPRESSION_BATCH_FILL / 100) {
+		this->_flushBatch();
+	}
+}
+
+/**
+ * @brief Internal method to compress the batch of frames into as few packets as we can.
+ *
+ * If the batch doesn't fit into the space left in the packet, we try again with half the frames until they fit. A frame which
+ * doesn't fit into an empty packet once compressed is sent uncompressed.
+ *
+ */
+void PacketEncoder::_flushBatch() {
+	size_t first = 0;
+	while (first < this->batch_offsets.size()) {
+		size_t count = this->batch_offsets.size() - first;
+		while (!this->_writeBatch(first, count)) {
+			if (count > 1) {
+				count = (count + 1) / 2;
+			} else if (this->packet_count) {
+				// Not even a single frame fits, so start off with an empty packet and try all the frames again
+				this->_flush();
+				this->_flushInflight();
+				count = this->batch_offsets.size() - first;
+			} else {
+				this->_writeBatchFrame(first);
+				break;
+			}
+		}
+		first += count;
+
+		if (this->_isTxBufferFull()) {
+			this->_flush();
+			this->_flushInflight();
+		}
+	}
+
+	this->batch_buffer->clear();
+	this->batch_offsets.clear();
+}
+
+/**
+ * @brief Internal method to compress frames from the batch into the tx buffer.
+ *
+ * @param first Index of the first frame to compress.
+ * @param count Number of frames to compress.
+ * @return true If the frames were added to the tx buffer.
+ * @return false If the frames don't fit into the space left in the tx buffer once compressed.
+ */
+bool PacketEncoder::_writeBatch(size_t first, size_t count) {
+	size_t batch_start = this->batch_offsets[first];
+	size_t batch_end =
+		first + count < this->batch_offsets.size() ? this->batch_offsets[first + count] : this->batch_buffer->getDataSize();
+	size_t batch_size = batch_end - batch_start;
+	size_t cur_buffer_size = this->tx_buffer->getDataSize();
+	size_t max_payload_size = std::min<size_t>(this->_getMaxPayloadSize(SETH_PACKET_MAX_SIZE),
+											   this->tx_buffer->getBufferSize() - cur_buffer_size - sizeof(PacketHeaderOption));
+
+	// Compress the frames straight into the tx buffer, each batch is compressed on its own so the decoder can reset its streams
+	// too, the stream must also be reset afterwards as it refers to the batch buffer which we're going to overwrite
+	auto compress_start = std::chrono::steady_clock::now();
+	this->compressor->resetCompressionStream();
+	int compressed_size = this->compressor->compress(this->batch_buffer->getData() + batch_start, batch_size,
+													 this->tx_buffer->getData() + cur_buffer_size + sizeof(PacketHeaderOption),
+													 max_payload_size);
+	this->compressor->resetCompressionStream();
+	this->compression_stats.compress_time.fetch_add(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - compress_start).count(),
+		std::memory_order_relaxed);
+	if (compressed_size <= 0) {
+		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - BATCH: frames=", count, ", size=", batch_size,
+						   " don't fit into max_payload_size=", max_payload_size);
+		return false;
+	}
+
+	LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - BATCH: frames=", count, ", size=", batch_size,
+					   ", compressed_size=", compressed_size);
+
+	PacketHeaderOption *packet_header_option = reinterpret_cast<PacketHeaderOption *>(this->tx_buffer->getData() + cur_buffer_size);
+	packet_header_option->type = PacketHeaderOptionType::COMPLETE_PACKET;
+	packet_header_option->packet_size = accl::cpu_to_be_16(batch_size);
+	packet_header_option->format = this->packet_format;
+	packet_header_option->payload_length = accl::cpu_to_be_16(compressed_size);
+	packet_header_option->part = 0;
+	packet_header_option->dictionary = this->dictionary_id;
+
+	// Only bump option len if this is the first packet at the beginning of the encap packet
+	if (!this->packet_count) {
+		this->opt_len++;
+	}
+	this->packet_count++;
+
+	this->tx_buffer->setDataSize(cur_buffer_size + sizeof(PacketHeaderOption) + compressed_size);
+
+	this->compression_stats.compressed_frames.fetch_add(count, std::memory_order_relaxed);
+	this->compression_stats.compressed_bytes.fetch_add(batch_size - count * sizeof(accl::be16_t), std::memory_order_relaxed);
+	this->compression_stats.compressed_wire_bytes.fetch_add(compressed_size, std::memory_order_relaxed);
+	this->batch_ratio = std::max<uint16_t>(1, static_cast<uint32_t>(compressed_size) * 100 / batch_size);
+	this->statCompressionRatio.add(static_cast<float>(compressed_size) / static_cast<float>(batch_size) * 100.0f);
+
+	return true;
+}
+
+/**
+ * @brief Internal method to add a frame from the batch to the tx buffer uncompressed.
+ *
+ * Frames are only batched if they fit into an empty packet uncompressed, so this always fits into an empty tx buffer.
+ *
+ * @param index Index of the frame in the batch.
+ */
+void PacketEncoder::_writeBatchFrame(size_t index) {
+	size_t frame_start = this->batch_offsets[index] + sizeof(accl::be16_t);
+	size_t frame_end =
+		index + 1 < this->batch_offsets.size() ? this->batch_offsets[index + 1] : this->batch_buffer->getDataSize();
+	uint16_t frame_size = frame_end - frame_start;
+	size_t cur_buffer_size = this->tx_buffer->getDataSize();
+
+	LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - BATCH: frame does not compress, size=", frame_size);
+
+	PacketHeaderOption *packet_header_option = reinterpret_cast<PacketHeaderOption *>(this->tx_buffer->getData() + cur_buffer_size);
+	packet_header_option->type = PacketHeaderOptionType::COMPLETE_PACKET;
+	packet_header_option->packet_size = accl::cpu_to_be_16(frame_size);
+	packet_header_option->format = PacketHeaderOptionFormatType::NONE;
+	packet_header_option->payload_length = accl::cpu_to_be_16(frame_size);
+	packet_header_option->part = 0;
+	packet_header_option->dictionary = 0;
+
+	// Only bump option len if this is the first packet at the beginning of the encap packet
+	if (!this->packet_count) {
+		this->opt_len++;
+	}
+	this->packet_count++;
+
+	this->tx_buffer->setDataSize(cur_buffer_size + sizeof(PacketHeaderOption));
+	this->tx_buffer->append(this->batch_buffer->getData() + frame_start, frame_size);
+}
+
 /**
  * @brief Construct a new Packet Encoder:: Packet Encoder object
  *
@@ -159,11 +428,24 @@ PacketEncoder::PacketEncoder(uint16_t l2mtu, uint16_t l4mtu, std::shared_ptr<acc
 	// As the constructor parameters have the same names as our data members, lets just use this-> for everything during init
 	this->l2mtu = l2mtu;
 	this->l4mtu = l4mtu;
+	this->channel = 0;
 	this->sequence = 1;
 
 	// Initialize our compressor
 	this->packet_format = PacketHeaderOptionFormatType::NONE;
 	this->compressor = nullptr;
+	this->compression_level = 0;
+	this->dictionary_id = 0;
+
+	// Frames compressed together when using a batch format are copied into a buffer of their own, as they're bigger than a packet
+	this->batch_buffer = std::make_unique<PacketBuffer>(SETH_COMPRESSION_BATCH_MAX_SIZE);
+	this->batch_ratio = 100;
+
+	// Frames have no header in front of them by default
+	this->frame_header_size = 0;
+
+	// Frames are copied into the packets by default
+	this->zero_copy = false;
 
 	// Grab a buffer to use for the compressor
 	this->comp_buffer = available_buffer_pool->pop_wait();
@@ -197,32 +479,57 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 
 	LOG_DEBUG_INTERNAL("====================");
 	LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}: INCOMING PACKET: size=", original_size, " [l2mtu: ", this->l2mtu,
-					   ", l4mtu: ", this->l4mtu, "], buffer_size=", tx_buffer->getDataSize(), ", packet_count=", this->packet_count,
-					   ", opt_len=", this->opt_len);
+					   ", l4mtu: ", this->l4mtu, "], buffer_size=", tx_buffer->getPacketSize(),
+					   ", packet_count=", this->packet_count, ", opt_len=", this->opt_len);
 
 	// Make sure we cannot receive a packet that is greater than our MTU size
 	if (original_size > this->l2mtu) {
 		LOG_ERROR("Packet size ", original_size, " exceeds L2MTU size ", this->l2mtu, "?");
 		// Free buffer to available pool
-		this->available_buffer_pool->push(std::move(rawPacketBuffer));
+		_releaseBuffer(rawPacketBuffer);
 		return;
 	}
 
 	// Create a packet buffer pointer, this is what we use to point to the data queued to encode
 	std::unique_ptr<PacketBuffer> packetBuffer;
-	uint8_t packet_header_option_format = static_cast<uint8_t>(this->packet_format);
+	// Frames we compress on their own when using a batch format use the same compression algorithm
+	PacketHeaderOptionFormatType frame_format = PacketHeaderOptionFormatTypeUnbatched(this->packet_format);
+	uint8_t packet_header_option_format = static_cast<uint8_t>(frame_format);
 
-	// Check if we need to compress the packet
+	// Work out if the flow this frame belongs to is worth compressing
+	FlowState *flow = nullptr;
+	bool bypass = false;
 	if (this->packet_format != PacketHeaderOptionFormatType::NONE) {
+		flow = this->_getFlowState(*rawPacketBuffer);
+		bypass = flow && this->_bypassCompression(*rawPacketBuffer, *flow);
+	}
+
+	// Batch formats compress frames together, frames which don't fit into an empty packet uncompressed are compressed on their own
+	if (PacketHeaderOptionFormatTypeIsBatch(this->packet_format)) {
+		if (!bypass &&
+			original_size <= this->l4mtu - sizeof(PacketHeader) - sizeof(PacketHeaderOption) - sizeof(accl::be16_t)) {
+			this->_batchFrame(rawPacketBuffer);
+			return;
+		}
+		// Frames we send on their own must come after the frames we're holding onto
+		this->_flushBatch();
+	}
+
+	// Check if we need to compress the packet
+	if (this->packet_format != PacketHeaderOptionFormatType::NONE && !bypass) {
 		// Compress th raw packet buffer we got into the compressed packet buffer
+		auto compress_start = std::chrono::steady_clock::now();
 		int compressed_size = this->compressor->compress(rawPacketBuffer->getData(), original_size, this->comp_buffer->getData(),
 														 this->comp_buffer->getBufferSize());
+		this->compression_stats.compress_time.fetch_add(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - compress_start).count(),
+			std::memory_order_relaxed);
 		// Check if we were indeed compressed
 		// NK: We don't care if our size exceeds the original size as the header savings would be worth it if there is a second
 		// packet coming
 		if (compressed_size) {
 			// Mark the packet as compressed
-			packet_header_option_format = static_cast<uint8_t>(this->packet_format);
+			packet_header_option_format = static_cast<uint8_t>(frame_format);
 			LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - COMPRESSED: size=", compressed_size,
 							   ", format=", static_cast<unsigned int>(packet_header_option_format));
 			this->comp_buffer->setDataSize(compressed_size);
@@ -232,6 +539,14 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 			// Add buffer to inflight list, we need to keep it around for the duration of the stream compression run as some
 			// algorithms require all buffers to be available.
 			_pushInflight(rawPacketBuffer);
+			// The frame is now part of the compression stream, so it must be sent compressed even if it didn't compress well,
+			// but we can stop compressing the rest of the flow
+			this->compression_stats.compressed_frames.fetch_add(1, std::memory_order_relaxed);
+			this->compression_stats.compressed_bytes.fetch_add(original_size, std::memory_order_relaxed);
+			this->compression_stats.compressed_wire_bytes.fetch_add(compressed_size, std::memory_order_relaxed);
+			if (flow) {
+				this->_updateFlowState(*flow, original_size, compressed_size);
+			}
 		} else {
 			LOG_ERROR("{seq=", this->sequence, "}: Failed to compress packet with error ", compressed_size, ": ",
 					  this->compressor->strerror(compressed_size));
@@ -247,9 +562,22 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 						   static_cast<float>(compressed_size) / static_cast<float>(original_size) * 100.0f);
 
 	} else {
+		if (bypass) {
+			LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - UNCOMPRESSED: flow does not compress");
+			packet_header_option_format = static_cast<uint8_t>(PacketHeaderOptionFormatType::NONE);
+			this->compression_stats.bypassed_frames.fetch_add(1, std::memory_order_relaxed);
+			this->compression_stats.bypassed_bytes.fetch_add(original_size, std::memory_order_relaxed);
+			this->compression_stats.bypass_wire_delta.fetch_add(
+				static_cast<int64_t>(original_size) - static_cast<int64_t>(original_size) * flow->ratio / 100,
+				std::memory_order_relaxed);
+		}
 		packetBuffer = std::move(rawPacketBuffer);
 	}
 
+	// Payloads we compressed carry the ID of the dictionary they were compressed with
+	uint8_t packet_header_option_dictionary =
+		packet_header_option_format != static_cast<uint8_t>(PacketHeaderOptionFormatType::NONE) ? this->dictionary_id : 0;
+
 	// Handle packets that are larger than the MSS
 	if (packetBuffer->getDataSize() > this->_getMaxPayloadSize(packetBuffer->getDataSize())) {
 		// Start off at packet part 1 and position 0...
@@ -280,7 +608,7 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 			packet_header_option->format = static_cast<PacketHeaderOptionFormatType>(packet_header_option_format);
 			packet_header_option->payload_length = accl::cpu_to_be_16(part_size);
 			packet_header_option->part = part;
-			packet_header_option->reserved = 0;
+			packet_header_option->dictionary = packet_header_option_dictionary;
 
 			// Add packet header option
 			cur_buffer_size += sizeof(PacketHeaderOption);
@@ -298,7 +626,7 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 			this->tx_buffer->append(packetBuffer->getData() + packet_pos, part_size);
 
 			LOG_DEBUG_INTERNAL("{seq=", this->sequence,
-							   "}:    - After partial add: tx_buffer_size=", this->tx_buffer->getDataSize());
+							   "}:    - After partial add: tx_buffer_size=", this->tx_buffer->getPacketSize());
 
 			// Check if we have finished the packet, if we have, mark this one complete
 			if (!(packet_left - part_size)) {
@@ -309,7 +637,7 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 			}
 
 			// If the buffer is full, flush it
-			if (this->tx_buffer->getDataSize() == this->l4mtu) {
+			if (this->tx_buffer->getPacketSize() == this->l4mtu) {
 				LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:    - Buffer full, flushing");
 				this->_flush();
 			}
@@ -323,7 +651,7 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 		// _pushInflight(packetBuffer);
 		this->_flushInflight();
 
-		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - PARTIAL END: buffer size is ", this->tx_buffer->getDataSize(),
+		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - PARTIAL END: buffer size is ", this->tx_buffer->getPacketSize(),
 						   " (packets: ", this->packet_count, ")");
 
 	} else {
@@ -339,7 +667,7 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 		packet_header_option->format = static_cast<PacketHeaderOptionFormatType>(packet_header_option_format);
 		packet_header_option->payload_length = accl::cpu_to_be_16(packetBuffer->getDataSize());
 		packet_header_option->part = 0;
-		packet_header_option->reserved = 0;
+		packet_header_option->dictionary = packet_header_option_dictionary;
 
 		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - OPTION HEADER: packet_bufer_size=", packetBuffer->getDataSize(),
 						   ", max_payload_size=", this->_getMaxPayloadSize(packetBuffer->getDataSize()),
@@ -357,19 +685,23 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 		// Once we're done messing with the buffer, set its size
 		this->tx_buffer->setDataSize(cur_buffer_size);
 
-		this->tx_buffer->append(packetBuffer->getData(), packetBuffer->getDataSize());
+		// Larger frames are referenced rather than copied when using zero-copy, the packet holds onto them until its sent
+		if (this->zero_copy && packetBuffer->getDataSize() >= SETH_ZERO_COPY_MIN_SIZE) {
+			this->tx_buffer->appendFragment(std::move(packetBuffer));
+		} else {
+			this->tx_buffer->append(packetBuffer->getData(), packetBuffer->getDataSize());
+		}
 		// // Set packet buffer to being inflight
 		// _pushInflight(packetBuffer);
 
-		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - FINAL DEST BUFFER SIZE: ", this->tx_buffer->getDataSize(),
+		LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:  - FINAL DEST BUFFER SIZE: ", this->tx_buffer->getPacketSize(),
 						   " (packets: ", this->packet_count, ")");
 	}
 
 	// If the buffer is full, flush it
-	// NK: We need to make provision for a header
 	LOG_DEBUG_INTERNAL("{seq=", this->sequence, "}:   - Flush check: ", this->_getMaxPayloadSize(SETH_PACKET_MAX_SIZE), " < ",
 					   sizeof(PacketHeader) + (sizeof(PacketHeaderOption) * 10));
-	if (this->_getMaxPayloadSize(SETH_PACKET_MAX_SIZE) < sizeof(PacketHeader) + (sizeof(PacketHeaderOption) * 10)) {
+	if (this->_isTxBufferFull()) {
 		// Packet is as full as it will get
 		this->_flush();
 		this->_flushInflight();
@@ -377,10 +709,10 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
 
 	// Check if we need a compressed packet buffer
 	if (this->packet_format != PacketHeaderOptionFormatType::NONE && this->comp_buffer == nullptr) {
-		// If we do, we can re-use the packet buffer
-		this->comp_buffer = std::move(packetBuffer);
-	} else {
-		this->available_buffer_pool->push(std::move(packetBuffer));
+		// If we do, we can re-use the packet buffer, unless the packet is holding onto it
+		this->comp_buffer = packetBuffer ? std::move(packetBuffer) : this->available_buffer_pool->pop_wait();
+	} else if (packetBuffer) {
+		_releaseBuffer(packetBuffer);
 	}
 }
 
@@ -390,33 +722,125 @@ void PacketEncoder::encode(std::unique_ptr<PacketBuffer> rawPacketBuffer) {
  */
 void PacketEncoder::flush() {
 	// When we get a flush, it means we probably can't fill the buffer anymore, so we can just dump it and the inflight buffers too
+	this->_flushBatch();
 	this->_flush();
 	this->_flushInflight();
 }
 
+/**
+ * @brief Release packets we encoded once they have been sent, the frames they reference are released along with them.
+ *
+ * @param buffers Buffers holding the packets, these are pushed back into the available buffer pool.
+ */
+void PacketEncoder::releaseTxBuffers(std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	for (auto &buffer : buffers) {
+		if (!buffer->hasFragments()) {
+			continue;
+		}
+		for (auto &fragment : buffer->getFragments()) {
+			_releaseBuffer(fragment.buffer);
+		}
+		buffer->clearFragments();
+	}
+	this->available_buffer_pool->push(buffers);
+}
+
 /**
  * @brief Set packet format.
  *
+ * The packet currently being encoded is flushed first, so the packet format can be changed while encoding frames and the remote
+ * node sees the change at a packet boundary with fresh compression streams.
+ *
  * @param format Packet format to set.
  */
 void PacketEncoder::setPacketFormat(PacketHeaderOptionFormatType format) {
+	// Finish off the packet using the current compressor
+	this->flush();
+
 	// Set packet format
 	this->packet_format = format;
 
+	// Get rid of the current compressor
+	if (this->compressor) {
+		delete this->compressor;
+		this->compressor = nullptr;
+	}
+
 	// Initialize compressor
 	if (this->packet_format == PacketHeaderOptionFormatType::NONE) {
 		// No compression
 		this->compressor = nullptr;
-	} else if (this->packet_format == PacketHeaderOptionFormatType::COMPRESSED_LZ4) {
+	} else if (PacketHeaderOptionFormatTypeUnbatched(this->packet_format) == PacketHeaderOptionFormatType::COMPRESSED_LZ4) {
 		// Initialize our compressor
 		this->compressor = new accl::StreamCompressorLZ4();
-	} else if (this->packet_format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD) {
+	} else if (PacketHeaderOptionFormatTypeUnbatched(this->packet_format) == PacketHeaderOptionFormatType::COMPRESSED_ZSTD) {
 		// Initialize our compressor
 		this->compressor = new accl::StreamCompressorZSTD();
 	} else {
 		LOG_ERROR("Unknown packet format ", static_cast<unsigned int>(format));
 		throw std::runtime_error("Unknown packet format");
 	}
+
+	// Set the level before the dictionary, as ZSTD digests the dictionary using the level
+	if (this->compressor && this->compression_level) {
+		this->compressor->setCompressionLevel(this->compression_level);
+	}
+	// Prime the new compressor with our dictionary
+	if (this->compressor && this->dictionary) {
+		this->compressor->setDictionary(*this->dictionary);
+	}
+}
+
+/**
+ * @brief Set the compression level, what the level means depends on the packet format.
+ *
+ * The level can be changed while encoding frames, it only affects how hard the compressor works so the remote node does not need
+ * to know about it.
+ *
+ * @param level Compression level, 0 uses the default level of the compressor.
+ */
+void PacketEncoder::setCompressionLevel(int level) {
+	this->compression_level = level;
+
+	if (!this->compressor) {
+		return;
+	}
+	if (level) {
+		this->compressor->setCompressionLevel(level);
+	} else {
+		// Start off with a new compressor to get back to its default level
+		this->setPacketFormat(this->packet_format);
+	}
+}
+
+/**
+ * @brief Set the dictionary frames are compressed with, the remote node must have the same dictionary to decode them.
+ *
+ * This should be set before encoding any frames.
+ *
+ * @param dictionary Compression dictionary, or nullptr to not use a dictionary.
+ * @param id ID sent with payloads compressed with the dictionary, 0 derives the ID from the dictionary.
+ */
+void PacketEncoder::setCompressionDictionary(std::shared_ptr<const std::string> dictionary, uint8_t id) {
+	this->dictionary = dictionary;
+	this->dictionary_id = dictionary ? (id ? id : get_compression_dictionary_id(*dictionary)) : 0;
+
+	if (this->compressor) {
+		this->compressor->setDictionary(dictionary ? *dictionary : std::string());
+	}
+}
+
+/**
+ * @brief Enable or disable adaptive compression, this sends frames of flows which don't compress uncompressed.
+ *
+ * @param enable Enable adaptive compression.
+ */
+void PacketEncoder::setAdaptiveCompression(bool enable) {
+	if (enable) {
+		this->flows.assign(SETH_COMPRESSION_FLOW_COUNT, FlowState{0, 0, 0});
+	} else {
+		this->flows.clear();
+	}
 }
 
 /**
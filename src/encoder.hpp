@@ -12,7 +12,31 @@
 #include "libaccl/statistic.hpp"
 #include "libaccl/stream_compressor.hpp"
 #include "packet_buffer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Compression statistics of a packet encoder, these can be read while the encoder is running.
+ *
+ */
+struct PacketEncoderCompressionStats {
+		// Frames we compressed, with their size before and after compression
+		std::atomic<uint64_t> compressed_frames{0};
+		std::atomic<uint64_t> compressed_bytes{0};
+		std::atomic<uint64_t> compressed_wire_bytes{0};
+		// Time spent compressing in nanoseconds
+		std::atomic<uint64_t> compress_time{0};
+		// Frames sent uncompressed as their flow does not compress
+		std::atomic<uint64_t> bypassed_frames{0};
+		std::atomic<uint64_t> bypassed_bytes{0};
+		// Bytes sending the bypassed frames uncompressed added to the wire, this is negative if it saved bytes, it is estimated
+		// using the last compression ratio of each flow
+		std::atomic<int64_t> bypass_wire_delta{0};
+};
 
 /*
  * Packet encoder
@@ -25,6 +49,8 @@ class PacketEncoder {
 		// Maximum layer 4 segment size, this is the maximum size our layer 4 transport can handle
 		uint16_t l4mtu;
 
+		// Channel set in the packet header, each channel has its own packet sequence
+		uint8_t channel;
 		// Sequence counter
 		uint32_t sequence;
 		// Active tx buffer that is not yet full
@@ -36,6 +62,17 @@ class PacketEncoder {
 		PacketHeaderOptionFormatType packet_format;
 		accl::StreamCompressor *compressor;
 		std::unique_ptr<PacketBuffer> comp_buffer;
+		// Compression level, 0 uses the default level of the compressor
+		int compression_level;
+		// Dictionary the compressor is primed with and its ID, the ID is 0 if we don't have one
+		std::shared_ptr<const std::string> dictionary;
+		uint8_t dictionary_id;
+		// Frames waiting to be compressed together when using a batch format, each frame is prefixed by its size
+		std::unique_ptr<PacketBuffer> batch_buffer;
+		// Offsets of the frames in the batch buffer
+		std::vector<size_t> batch_offsets;
+		// Compressed size of the last batch as a percentage of its original size, used to work out when a batch fills a packet
+		uint16_t batch_ratio;
 
 		// Active tx buffer header options length
 		uint16_t opt_len;
@@ -47,17 +84,49 @@ class PacketEncoder {
 		// TX buffer pool queued to send via socket
 		std::shared_ptr<accl::BufferPool<PacketBuffer>> tx_buffer_pool;
 
+		// Size of the header in front of each frame, this is skipped when working out the flow of a frame
+		size_t frame_header_size;
+
+		// Reference frames from the packets instead of copying them in, the packets are sent using scatter/gather IO
+		bool zero_copy;
+
+		/**
+		 * @brief Compression state of a flow, used to stop compressing flows which don't compress.
+		 *
+		 */
+		struct FlowState {
+				uint32_t flow_hash;
+				// Number of frames left to send uncompressed before we try compress the flow again
+				uint16_t bypass_frames;
+				// Compressed size as a percentage of the original size when we last compressed the flow
+				uint16_t ratio;
+		};
+		// Flows we're tracking indexed by their flow hash, this is empty if adaptive compression is disabled
+		std::vector<FlowState> flows;
+
 		// Statistics
 		accl::Statistic<float> statCompressionRatio;
+		PacketEncoderCompressionStats compression_stats;
 
 		void _flush();
 
 		void _getTxBuffer();
 
 		uint16_t _getMaxPayloadSize(uint16_t size) const;
+		bool _isTxBufferFull() const;
 
 		void _flushInflight();
 		void _pushInflight(std::unique_ptr<PacketBuffer> &packetBuffer);
+		void _releaseBuffer(std::unique_ptr<PacketBuffer> &packetBuffer);
+
+		FlowState *_getFlowState(PacketBuffer &packetBuffer);
+		bool _bypassCompression(PacketBuffer &packetBuffer, FlowState &flow);
+		void _updateFlowState(FlowState &flow, uint16_t original_size, uint16_t compressed_size);
+
+		void _batchFrame(std::unique_ptr<PacketBuffer> &packetBuffer);
+		void _flushBatch();
+		bool _writeBatch(size_t first, size_t count);
+		void _writeBatchFrame(size_t index);
 
 	public:
 		PacketEncoder(uint16_t l2mtu, uint16_t l4mtu, std::shared_ptr<accl::BufferPool<PacketBuffer>> tx_buffer_pool,
@@ -74,7 +143,27 @@ class PacketEncoder {
 		void setPacketFormat(PacketHeaderOptionFormatType format);
 		inline PacketHeaderOptionFormatType getPacketFormat() const;
 
+		void setCompressionLevel(int level);
+		inline int getCompressionLevel() const;
+
+		void setCompressionDictionary(std::shared_ptr<const std::string> dictionary, uint8_t id = 0);
+		inline uint8_t getCompressionDictionaryID() const;
+
+		void setAdaptiveCompression(bool enable);
+		inline bool getAdaptiveCompression() const;
+
+		inline void setFrameHeaderSize(size_t size);
+
+		inline void setZeroCopy(bool enable);
+		inline bool getZeroCopy() const;
+
+		inline void setChannel(uint8_t channel);
+		inline uint8_t getChannel() const;
+
+		void releaseTxBuffers(std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+
 		void getCompressionRatioStat(accl::StatisticResult<float> &result);
+		inline const PacketEncoderCompressionStats &getCompressionStats() const;
 };
 
 /**
@@ -100,3 +189,70 @@ inline uint32_t PacketEncoder::getSequence() const { return sequence; }
  * @return PacketHeaderOptionFormatType Packet format.
  */
 inline PacketHeaderOptionFormatType PacketEncoder::getPacketFormat() const { return packet_format; }
+
+/**
+ * @brief Get the compression level.
+ *
+ * @return int Compression level, 0 if the default level of the compressor is used.
+ */
+inline int PacketEncoder::getCompressionLevel() const { return compression_level; }
+
+/**
+ * @brief Get the ID of the dictionary frames are compressed with.
+ *
+ * @return uint8_t Dictionary ID, 0 if we don't have a dictionary.
+ */
+inline uint8_t PacketEncoder::getCompressionDictionaryID() const { return dictionary_id; }
+
+/**
+ * @brief Check if adaptive compression is enabled.
+ *
+ * @return true If flows which don't compress are sent uncompressed.
+ * @return false If all frames are compressed.
+ */
+inline bool PacketEncoder::getAdaptiveCompression() const { return !flows.empty(); }
+
+/**
+ * @brief Set the size of the header in front of each frame, such as a virtio-net header.
+ *
+ * @param size Size of the frame header.
+ */
+inline void PacketEncoder::setFrameHeaderSize(size_t size) { frame_header_size = size; }
+
+/**
+ * @brief Enable or disable zero-copy encoding, frames are referenced from the packets instead of being copied into them.
+ *
+ * Packets need to be sent using their IO vectors and released using releaseTxBuffers() once sent.
+ *
+ * @param enable Enable zero-copy encoding.
+ */
+inline void PacketEncoder::setZeroCopy(bool enable) { zero_copy = enable; }
+
+/**
+ * @brief Check if zero-copy encoding is enabled.
+ *
+ * @return true If frames are referenced from the packets.
+ * @return false If frames are copied into the packets.
+ */
+inline bool PacketEncoder::getZeroCopy() const { return zero_copy; }
+
+/**
+ * @brief Set the channel the packets are sent on, the decoder on the other side must be set to the same channel.
+ *
+ * @param channel Channel.
+ */
+inline void PacketEncoder::setChannel(uint8_t channel) { this->channel = channel; }
+
+/**
+ * @brief Get the channel the packets are sent on.
+ *
+ * @return uint8_t Channel.
+ */
+inline uint8_t PacketEncoder::getChannel() const { return channel; }
+
+/**
+ * @brief Get the compression statistics.
+ *
+ * @return const PacketEncoderCompressionStats& Compression statistics.
+ */
+inline const PacketEncoderCompressionStats &PacketEncoder::getCompressionStats() const { return compression_stats; }
@@ -8,97 +8,157 @@
 #include "fdb_entry.hpp"
 #include "libaccl/logger.hpp"
 #include "util.hpp"
-#include <cstring>
+#include <bit>
+#include <format>
+#include <limits>
 #include <memory>
 
+// Maximum load of the FDB table in percent before it is grown
+static constexpr size_t FDB_MAX_LOAD_PERCENT{70};
+
+// Smallest table we will create
+static constexpr size_t FDB_MIN_CAPACITY{16};
+
 /**
  * @brief Construct a new FDB::FDB object
  *
+ * @param capacity Initial number of slots in the table, this is rounded up to a power of 2
  */
-FDB::FDB() {}
+FDB::FDB(size_t capacity) : table(nullptr), sequence(0), count(0) {
+	_resize(std::bit_ceil(std::max(capacity, FDB_MIN_CAPACITY)));
+}
 
 /**
- * @brief Add a new entry to the FDB
+ * @brief Add a new entry to the FDB, if the MAC address already has an entry it is left as is
  *
- * @param mac
- * @param dest
- * @return std::shared_ptr<FDBEntry>
+ * @param mac MAC address
+ * @param dest Remote node the MAC address is behind, or nullptr if the MAC address is local
  */
-std::shared_ptr<FDBEntry> FDB::add(const FDBMACAddress *mac, std::shared_ptr<RemoteNode> dest) {
-	// Build MAC key to add to FDB
-	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> key;
-	memcpy(key.data(), mac->bytes, SETH_PACKET_ETHERNET_MAC_LEN);
-
-	// Check if entry already exists
-	auto it = fdb.find(key);
-	if (it != fdb.end()) {
-		// Entry already exists
-		return it->second;
+void FDB::add(const FDBMACAddress *mac, std::shared_ptr<RemoteNode> dest) {
+	uint64_t key = FDBEntry::getKey(mac);
+
+	std::lock_guard<std::mutex> lock(this->write_mtx);
+
+	// Check if entry already exists, another thread may have added it since the caller looked it up
+	if (_find(this->table.load(std::memory_order_relaxed), key) != this->table.load(std::memory_order_relaxed)->size) {
+		return;
 	}
 
-	// Create entry
-	std::shared_ptr<FDBEntry> entry = std::make_shared<FDBEntry>(mac, dest);
-	// Add entry
-	this->fdb[key] = entry;
+	// Grow the table if this entry would take us over the maximum load
+	size_t table_size = this->table.load(std::memory_order_relaxed)->size;
+	if ((this->count.load(std::memory_order_relaxed) + 1) * 100 > table_size * FDB_MAX_LOAD_PERCENT) {
+		_resize(table_size * 2);
+	}
+
+	FDBEntry entry;
+	entry.key = key;
+	entry.node = _holdNode(dest);
+	entry.last_seen = std::chrono::steady_clock::now().time_since_epoch().count();
 
-	return entry;
+	_writeBegin();
+	_insert(this->table.load(std::memory_order_relaxed), entry);
+	_writeEnd();
+	this->count.fetch_add(1, std::memory_order_relaxed);
 }
 
 /**
- * @brief Get an entry from the FDB
+ * @brief Get a copy of an entry from the FDB
  *
- * @param mac
- * @return std::shared_ptr<FDBEntry>
+ * @param mac MAC address
+ * @param entry Entry to copy the FDB entry into
+ * @return true If the MAC address was found
+ * @return false If there is no entry for the MAC address
  */
+bool FDB::get(const FDBMACAddress *mac, FDBEntry &entry) const {
+	uint64_t key = FDBEntry::getKey(mac);
 
-std::shared_ptr<FDBEntry> FDB::get(const FDBMACAddress *mac) const {
-	// Build MAC key to get from FDB
-	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> key;
-	memcpy(key.data(), mac->bytes, SETH_PACKET_ETHERNET_MAC_LEN);
+	bool found;
+	uint64_t sequence;
+	do {
+		sequence = _readBegin();
+		const Table *table = this->table.load(std::memory_order_acquire);
+		size_t slot = _find(table, key);
+		found = slot != table->size;
+		if (found) {
+			entry = table->entries[slot].load();
+		}
+	} while (_readRetry(sequence));
 
-	// Lookup entry
-	auto it = fdb.find(key);
-	if (it == fdb.end()) {
-		// Return nullptr if not found
-		return nullptr;
-	}
-	return it->second;
+	return found;
+}
+
+/**
+ * @brief Update the last time a MAC address was seen
+ *
+ * @param mac MAC address
+ * @param now Time the MAC address was seen
+ * @return true If the MAC address was found and updated
+ * @return false If there is no entry for the MAC address
+ */
+bool FDB::touch(const FDBMACAddress *mac, std::chrono::steady_clock::time_point now) {
+	uint64_t key = FDBEntry::getKey(mac);
+
+	bool found;
+	uint64_t sequence;
+	Table *table;
+	do {
+		sequence = _readBegin();
+		table = this->table.load(std::memory_order_acquire);
+		size_t slot = _find(table, key);
+		found = slot != table->size;
+		// If the entry moved while we were doing this we update it again where it is now
+		if (found) {
+			table->entries[slot].setLastSeen(now);
+			// Pairs with the fence in _resize(), either the resize carries this update over to the new table or we see the new
+			// table here and update it there too
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+	} while (_readRetry(sequence) || (found && this->table.load(std::memory_order_relaxed) != table));
+
+	return found;
 }
 
 /**
  * @brief Expire entries in the FDB
  *
+ * @param expire_time Number of seconds since an entry was last seen before it is removed
+ * @param now Current time
  */
-void FDB::expireEntries(int expire_time) {
-	auto now = std::chrono::steady_clock::now();
+void FDB::expireEntries(int expire_time, std::chrono::steady_clock::time_point now) {
+	std::lock_guard<std::mutex> lock(this->write_mtx);
 
-	// Iterate over all entries
-	for (auto it = fdb.begin(); it != fdb.end();) {
+	Table *table = this->table.load(std::memory_order_relaxed);
+	for (size_t slot = 0; slot < table->size;) {
+		FDBEntry entry = table->entries[slot].load();
 		// Check if entry is expired
-		auto diff = std::chrono::duration_cast<std::chrono::seconds>(now - it->second->getLastSeen()).count();
-		if (diff > expire_time) {
-			LOG_DEBUG_INTERNAL("FDB: Expired entry: ", it->second->getMAC()->toString());
-			// Remove entry
-			it = fdb.erase(it);
+		if (entry.isUsed() &&
+			std::chrono::duration_cast<std::chrono::seconds>(now - entry.getLastSeen()).count() > expire_time) {
+			LOG_DEBUG_INTERNAL("FDB: Expired entry: ", entry.getMAC().toString());
+			// Each entry is removed as its own update so lookups are only held up for a single removal
+			_writeBegin();
+			_erase(table, slot);
+			_writeEnd();
+			this->count.fetch_sub(1, std::memory_order_relaxed);
+			// Removing the entry may shift another entry into this slot, so we need to check it again
 		} else {
 			// Move to next entry
-			++it;
+			++slot;
 		}
 	}
 }
 
-const std::shared_ptr<FDBEntry> FDB::getRemoteNode(const FDBMACAddress *mac) const {
-	// Build MAC key to add to FDB
-	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> key;
-	memcpy(key.data(), mac->bytes, SETH_PACKET_ETHERNET_MAC_LEN);
-
-	// Check to see if we can find the remote node by MAC address
-	auto it = fdb.find(key);
-	if (it != fdb.end()) {
-		return it->second;
+/**
+ * @brief Get the remote node a MAC address is behind
+ *
+ * @param mac MAC address
+ * @return RemoteNode* Remote node or nullptr if the MAC address is unknown or local
+ */
+RemoteNode *FDB::getRemoteNode(const FDBMACAddress *mac) const {
+	FDBEntry entry;
+	if (!get(mac, entry)) {
+		return nullptr;
 	}
-
-	return nullptr;
+	return entry.node;
 }
 
 /**
@@ -108,25 +168,152 @@ const std::shared_ptr<FDBEntry> FDB::getRemoteNode(const FDBMACAddress *mac) con
 void FDB::dumpDebug() {
 	LOG_DEBUG_INTERNAL("@@@@@@@@@@@@@@@@@@@@ FDB: Dumping FDB @@@@@@@@@@@@@@@@@@@@");
 
+	std::lock_guard<std::mutex> lock(this->write_mtx);
+
 #ifdef DEBUG
 	auto now = std::chrono::steady_clock::now();
 #endif
-	for (auto &entry : this->fdb) {
-		const FDBMACAddress *mac = entry.second->getMAC();
+	const Table *table = this->table.load(std::memory_order_relaxed);
+	for (size_t slot = 0; slot < table->size; ++slot) {
+		FDBEntry entry = table->entries[slot].load();
+		if (!entry.isUsed()) {
+			continue;
+		}
+		FDBMACAddress mac = entry.getMAC();
 		// Build string from mac address .bytes
-		std::string mac_str = std::format("{:02X}:{:02X}:{:02X}:{:02X}:{:02X}:{:02X}", mac->bytes[0], mac->bytes[1], mac->bytes[2],
-										  mac->bytes[3], mac->bytes[4], mac->bytes[5]);
+		std::string mac_str = std::format("{:02X}:{:02X}:{:02X}:{:02X}:{:02X}:{:02X}", mac.bytes[0], mac.bytes[1], mac.bytes[2],
+										  mac.bytes[3], mac.bytes[4], mac.bytes[5]);
 
 		// Work out what the IP is
 		std::string ip_str;
-		if (entry.second->isLocal()) {
+		if (entry.isLocal()) {
 			ip_str = "LOCAL";
 		} else {
-			ip_str = get_ipstr(entry.second->getDestination()->getNodeAddr().get());
+			ip_str = get_ipstr(entry.node->getNodeAddr().get());
 		}
 #ifdef DEBUG
-		auto diff = std::chrono::duration_cast<std::chrono::seconds>(now - entry.second->getLastSeen()).count();
+		auto diff = std::chrono::duration_cast<std::chrono::seconds>(now - entry.getLastSeen()).count();
 #endif
 		LOG_DEBUG_INTERNAL("    - ", mac_str, " => ", ip_str, " (last seen: ", diff, "s)");
 	}
 }
+
+/**
+ * @brief Internal method to find the slot holding a key
+ *
+ * @param table Table to search
+ * @param key Key to look for
+ * @return size_t Slot or the table size if not found
+ */
+size_t FDB::_find(const Table *table, uint64_t key) const {
+	size_t mask = table->size - 1;
+	size_t slot = table->getSlot(key);
+	// The table is never full, but entries can move under lookups, so we don't probe more than the whole table
+	for (size_t probes = 0; probes < table->size; ++probes, slot = (slot + 1) & mask) {
+		uint64_t slot_key = std::atomic_ref<uint64_t>(table->entries[slot].key).load(std::memory_order_relaxed);
+		if (slot_key == key) {
+			return slot;
+		}
+		if (!slot_key) {
+			break;
+		}
+	}
+	return table->size;
+}
+
+/**
+ * @brief Internal method to insert an entry into the first free slot from its preferred slot
+ *
+ * @param table Table to insert into
+ * @param entry Entry to insert, the key must not already be in the table
+ */
+void FDB::_insert(Table *table, const FDBEntry &entry) {
+	size_t mask = table->size - 1;
+	size_t slot = table->getSlot(entry.key);
+	while (table->entries[slot].isUsed()) {
+		slot = (slot + 1) & mask;
+	}
+	table->entries[slot].store(entry);
+}
+
+/**
+ * @brief Internal method to erase an entry, entries after it are shifted back so lookups don't stop short
+ *
+ * @param table Table to erase the entry from
+ * @param slot Slot to erase
+ */
+void FDB::_erase(Table *table, size_t slot) {
+	size_t mask = table->size - 1;
+
+	for (size_t next = (slot + 1) & mask; table->entries[next].isUsed(); next = (next + 1) & mask) {
+		// Only move the entry back if the free slot is not before its preferred slot
+		size_t home = table->getSlot(table->entries[next].key);
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			table->entries[slot].store(table->entries[next].load());
+			slot = next;
+		}
+	}
+
+	table->entries[slot].store(FDBEntry{});
+}
+
+/**
+ * @brief Internal method to build a new table, re-insert all the entries and publish it, write_mtx must be held
+ *
+ * @param capacity New number of slots, this must be a power of 2
+ */
+void FDB::_resize(size_t capacity) {
+	auto new_table = std::make_unique<Table>();
+	new_table->entries = std::make_unique<FDBEntry[]>(capacity);
+	new_table->size = capacity;
+	new_table->shift = std::numeric_limits<uint64_t>::digits - std::countr_zero(capacity);
+
+	// Nobody can see the new table yet, so there is no need to bump the sequence while filling it
+	const Table *old_table = this->table.load(std::memory_order_relaxed);
+	if (old_table) {
+		for (size_t slot = 0; slot < old_table->size; ++slot) {
+			FDBEntry entry = old_table->entries[slot].load();
+			if (entry.isUsed()) {
+				_insert(new_table.get(), entry);
+			}
+		}
+	}
+
+	// Lookups on the old table stay consistent as only touches update it from here on, so publishing needs no update either
+	this->table.store(new_table.get(), std::memory_order_release);
+
+	// Touches which updated the old table after we copied it would be lost, so carry the last seen times over. Pairs with the
+	// fence in touch(), touches that don't see the new table have their update seen here
+	if (old_table) {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		for (size_t slot = 0; slot < old_table->size; ++slot) {
+			FDBEntry entry = old_table->entries[slot].load();
+			if (entry.isUsed()) {
+				new_table->entries[_find(new_table.get(), entry.key)].raiseLastSeen(entry.getLastSeen());
+			}
+		}
+	}
+
+	this->tables.push_back(std::move(new_table));
+}
+
+/**
+ * @brief Internal method to keep a reference to a remote node so entries can point to it, write_mtx must be held
+ *
+ * @param dest Remote node or nullptr for local
+ * @return RemoteNode* Remote node or nullptr for local
+ */
+RemoteNode *FDB::_holdNode(std::shared_ptr<RemoteNode> dest) {
+	if (!dest) {
+		return nullptr;
+	}
+
+	for (auto &node : this->nodes) {
+		if (node == dest) {
+			return node.get();
+		}
+	}
+
+	this->nodes.push_back(dest);
+	return dest.get();
+}
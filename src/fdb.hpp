@@ -6,33 +6,143 @@
 
 #pragma once
 
+#include "common.hpp"
 #include "fdb_entry.hpp"
 #include "libsethnetkit/ethernet_packet.hpp"
 #include "remote_node.hpp"
 #include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <mutex>
 #include <netinet/in.h>
+#include <vector>
 
 /**
  * @brief FDB class
  *
+ * Entries are stored inline in an open-addressing hash table using linear probing, keyed by the MAC address packed into a
+ * uint64_t. Removing entries shifts the entries after them back so no tombstones are needed.
+ *
+ * Lookups never take a lock. Updates are serialized by a writer mutex and bump a sequence counter before and after they touch
+ * the table, lookups retry if the counter changed while they were reading. When the table grows the new table is built on the
+ * side without holding up lookups and published atomically, touches which landed on the old table in the meantime are carried
+ * over afterwards. The old table is kept until the FDB is destroyed as lookups may still be reading it, the tables only ever
+ * double so this costs less memory than the current table.
  */
 class FDB {
 	public:
-		FDB();
+		FDB(size_t capacity = SETH_FDB_INITIAL_CAPACITY);
 		//~FDB();
 
-		std::shared_ptr<FDBEntry> add(const FDBMACAddress *mac, std::shared_ptr<RemoteNode> dest);
-		std::shared_ptr<FDBEntry> get(const FDBMACAddress *mac) const;
+		void add(const FDBMACAddress *mac, std::shared_ptr<RemoteNode> dest);
+		bool get(const FDBMACAddress *mac, FDBEntry &entry) const;
+		bool touch(const FDBMACAddress *mac, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+		void expireEntries(int expire_time, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
 
-		void expireEntries(int expire_time);
+		RemoteNode *getRemoteNode(const FDBMACAddress *dst_mac) const;
 
-		const std::shared_ptr<FDBEntry> getRemoteNode(const FDBMACAddress *dst_mac) const;
+		inline size_t getEntryCount() const;
+		inline size_t getCapacity() const;
 
 		void dumpDebug();
 
 	private:
-		// FDB entry map based on MAC address
-		std::map<std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN>, std::shared_ptr<FDBEntry>> fdb;
+		// FDB entry table, the size is always a power of 2
+		struct Table {
+				std::unique_ptr<FDBEntry[]> entries;
+				size_t size;
+				// Shift used to turn a hash into a table index
+				unsigned int shift;
+
+				inline size_t getSlot(uint64_t key) const;
+		};
+
+		// Current table, along with all the tables we've had so lookups on older tables stay valid
+		std::atomic<Table *> table;
+		std::vector<std::unique_ptr<Table>> tables;
+
+		// Sequence counter, this is odd while the table is being updated
+		std::atomic<uint64_t> sequence;
+		std::atomic<size_t> count;
+
+		// Destination nodes referenced by the entries, these are kept alive for as long as the FDB exists
+		std::vector<std::shared_ptr<RemoteNode>> nodes;
+
+		// Mutex serializing updates
+		std::mutex write_mtx;
+
+		inline uint64_t _readBegin() const;
+		inline bool _readRetry(uint64_t sequence) const;
+		inline void _writeBegin();
+		inline void _writeEnd();
+
+		size_t _find(const Table *table, uint64_t key) const;
+		void _insert(Table *table, const FDBEntry &entry);
+		void _erase(Table *table, size_t slot);
+		void _resize(size_t capacity);
+		RemoteNode *_holdNode(std::shared_ptr<RemoteNode> dest);
 };
+
+/**
+ * @brief Get the number of entries in the FDB
+ *
+ * @return size_t Number of entries
+ */
+inline size_t FDB::getEntryCount() const { return this->count.load(std::memory_order_relaxed); }
+
+/**
+ * @brief Get the number of entries the FDB table can hold before it needs to grow
+ *
+ * @return size_t Table size
+ */
+inline size_t FDB::getCapacity() const { return this->table.load(std::memory_order_acquire)->size; }
+
+/**
+ * @brief Get the preferred slot of a key using fibonacci hashing
+ *
+ * @param key Key
+ * @return size_t Slot
+ */
+inline size_t FDB::Table::getSlot(uint64_t key) const { return (key * 0x9E3779B97F4A7C15ULL) >> this->shift; }
+
+/**
+ * @brief Internal method to start a lookup, this waits for any update in progress to finish
+ *
+ * @return uint64_t Sequence the lookup started at
+ */
+inline uint64_t FDB::_readBegin() const {
+	uint64_t sequence;
+	while ((sequence = this->sequence.load(std::memory_order_acquire)) & 1) {
+	}
+	return sequence;
+}
+
+/**
+ * @brief Internal method to check if a lookup needs to be retried as the FDB was updated while it was reading
+ *
+ * @param sequence Sequence returned by _readBegin()
+ * @return true If the lookup must be retried
+ * @return false If what was read is consistent
+ */
+inline bool FDB::_readRetry(uint64_t sequence) const {
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return this->sequence.load(std::memory_order_relaxed) != sequence;
+}
+
+/**
+ * @brief Internal method to mark the start of an update, write_mtx must be held
+ *
+ */
+inline void FDB::_writeBegin() {
+	this->sequence.store(this->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ * @brief Internal method to mark the end of an update, write_mtx must be held
+ *
+ */
+inline void FDB::_writeEnd() { this->sequence.store(this->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
@@ -7,11 +7,12 @@
 #pragma once
 
 #include "libsethnetkit/ethernet_packet.hpp"
-#include "remote_node.hpp"
 #include <arpa/inet.h>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <netinet/in.h>
+#include <string>
 
 struct FDBMACAddress {
 		uint8_t bytes[SETH_PACKET_ETHERNET_MAC_LEN];
@@ -25,78 +26,134 @@ struct FDBMACAddress {
 		}
 } ACCL_PACKED_ATTRIBUTES;
 
+// Bit set in the key of FDB entries which are in use, the MAC address only takes up the lower 48 bits
+inline constexpr uint64_t FDB_ENTRY_USED{1ULL << 63};
+
+class RemoteNode;
+
 /**
- * @brief FDB Entry class
+ * @brief FDB entry, these are stored inline in the FDB table so they need no allocation of their own
  *
+ * The fields are read by lookups while the FDB is being updated, so all access to an entry which is in a table goes through
+ * the atomic load() and store() methods.
  */
-class FDBEntry {
-	public:
-		FDBEntry(const FDBMACAddress *mac, const std::shared_ptr<RemoteNode> dest);
-
-		void setDest(const std::shared_ptr<RemoteNode> dest);
-		inline const std::shared_ptr<RemoteNode> getDestination() const;
-
-		inline const FDBMACAddress *getMAC() const;
-		inline const std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> &getKey() const;
+struct FDBEntry {
+		// MAC address packed into the lower 48 bits with FDB_ENTRY_USED set, this is 0 if the entry is free
+		uint64_t key;
+		// Destination node, this is nullptr if the MAC address is local, the FDB keeps the node alive
+		RemoteNode *node;
+		// Last time the entry was seen in steady clock ticks
+		int64_t last_seen;
+
+		inline bool isUsed() const;
 		inline bool isLocal() const;
+		inline FDBMACAddress getMAC() const;
 
-		inline const std::chrono::steady_clock::time_point &getLastSeen() const;
-		inline void setLastSeen(std::chrono::steady_clock::time_point last_seen);
-		inline void updateLastSeen();
+		inline std::chrono::steady_clock::time_point getLastSeen() const;
+		inline void setLastSeen(std::chrono::steady_clock::time_point time);
+		inline void raiseLastSeen(std::chrono::steady_clock::time_point time);
 
-	private:
-		FDBMACAddress *mac; // Pointer to storage area of key
-		std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> key;
+		inline FDBEntry load() const;
+		inline void store(const FDBEntry &entry);
 
-		std::shared_ptr<RemoteNode> dest;
-		std::chrono::steady_clock::time_point last_seen;
+		static inline uint64_t getKey(const FDBMACAddress *mac);
 };
 
 /**
- * @brief Get the destination of the FDBEntry
+ * @brief Check if the entry is in use
+ *
+ * @return true
+ * @return false
+ */
+inline bool FDBEntry::isUsed() const { return this->key & FDB_ENTRY_USED; }
+
+/**
+ * @brief Check if the destination is local
  *
- * @return const sockaddr_storage*
+ * @return true
+ * @return false
  */
-inline const std::shared_ptr<RemoteNode> FDBEntry::getDestination() const { return this->dest; }
+inline bool FDBEntry::isLocal() const { return !this->node; }
 
 /**
  * @brief Get the MAC address of the FDBEntry
  *
- * @return const FDBMACAddress*
+ * @return FDBMACAddress
  */
-inline const FDBMACAddress *FDBEntry::getMAC() const { return this->mac; }
+inline FDBMACAddress FDBEntry::getMAC() const {
+	FDBMACAddress mac;
+	for (size_t i = 0; i < SETH_PACKET_ETHERNET_MAC_LEN; ++i) {
+		mac.bytes[i] = this->key >> ((SETH_PACKET_ETHERNET_MAC_LEN - 1 - i) * 8);
+	}
+	return mac;
+}
 
 /**
- * @brief Check if the destination is local
+ * @brief Get the last time the entry was seen
  *
- * @return true
- * @return false
+ * @return std::chrono::steady_clock::time_point
  */
-inline bool FDBEntry::isLocal() const { return this->dest == nullptr; }
+inline std::chrono::steady_clock::time_point FDBEntry::getLastSeen() const {
+	int64_t ticks = std::atomic_ref<int64_t>(const_cast<int64_t &>(this->last_seen)).load(std::memory_order_relaxed);
+	return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+}
 
 /**
- * @brief Get the key of the FDBEntry
+ * @brief Set the last time the entry was seen, this is safe to do while other threads are reading the entry
  *
- * @return const std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN>&
+ * @param time Time the entry was last seen
  */
-inline const std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> &FDBEntry::getKey() const { return this->key; }
+inline void FDBEntry::setLastSeen(std::chrono::steady_clock::time_point time) {
+	std::atomic_ref<int64_t>(this->last_seen).store(time.time_since_epoch().count(), std::memory_order_relaxed);
+}
 
 /**
- * @brief Get the last time the entry was seen
+ * @brief Move the last time the entry was seen forward, this is safe to do while other threads are setting it
+ *
+ * @param time Time the entry was seen, this is ignored if the entry was seen later
+ */
+inline void FDBEntry::raiseLastSeen(std::chrono::steady_clock::time_point time) {
+	std::atomic_ref<int64_t> last_seen(this->last_seen);
+	int64_t ticks = time.time_since_epoch().count();
+	int64_t current = last_seen.load(std::memory_order_relaxed);
+	while (current < ticks && !last_seen.compare_exchange_weak(current, ticks, std::memory_order_relaxed)) {
+	}
+}
+
+/**
+ * @brief Take a copy of the entry while it may be written to, the copy is only consistent if the FDB was not updated
  *
- * @return const std::chrono::steady_clock::time_point&
+ * @return FDBEntry Copy of the entry
  */
-inline const std::chrono::steady_clock::time_point &FDBEntry::getLastSeen() const { return this->last_seen; }
+inline FDBEntry FDBEntry::load() const {
+	FDBEntry entry;
+	entry.key = std::atomic_ref<uint64_t>(const_cast<uint64_t &>(this->key)).load(std::memory_order_relaxed);
+	entry.node = std::atomic_ref<RemoteNode *>(const_cast<RemoteNode *&>(this->node)).load(std::memory_order_relaxed);
+	entry.last_seen = std::atomic_ref<int64_t>(const_cast<int64_t &>(this->last_seen)).load(std::memory_order_relaxed);
+	return entry;
+}
 
 /**
- * @brief Set the last time the entry was seen
+ * @brief Overwrite the entry while it may be read
  *
- * @param last_seen
+ * @param entry Entry to copy
  */
-inline void FDBEntry::setLastSeen(std::chrono::steady_clock::time_point last_seen) { this->last_seen = last_seen; }
+inline void FDBEntry::store(const FDBEntry &entry) {
+	std::atomic_ref<uint64_t>(this->key).store(entry.key, std::memory_order_relaxed);
+	std::atomic_ref<RemoteNode *>(this->node).store(entry.node, std::memory_order_relaxed);
+	std::atomic_ref<int64_t>(this->last_seen).store(entry.last_seen, std::memory_order_relaxed);
+}
 
 /**
- * @brief Update the last time the entry was seen
+ * @brief Get the FDB key for a MAC address
  *
+ * @param mac MAC address
+ * @return uint64_t Key with the MAC address packed into the lower 48 bits and FDB_ENTRY_USED set
  */
-inline void FDBEntry::updateLastSeen() { this->last_seen = std::chrono::steady_clock::now(); }
\ No newline at end of file
+inline uint64_t FDBEntry::getKey(const FDBMACAddress *mac) {
+	uint64_t key = 0;
+	for (size_t i = 0; i < SETH_PACKET_ETHERNET_MAC_LEN; ++i) {
+		key = (key << 8) | mac->bytes[i];
+	}
+	return key | FDB_ENTRY_USED;
+}
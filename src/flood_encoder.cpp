@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "flood_encoder.hpp"
+#include "compression_dictionary.hpp"
+#include "libaccl/endian.hpp"
+#include "libaccl/logger.hpp"
+#include "libaccl/stream_compressor_lz4.hpp"
+#include "libaccl/stream_compressor_zstd.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * @brief Construct a new FloodEncoder object.
+ *
+ * @param l4mtu Layer 4 MTU.
+ * @param packet_format Packet format, frames which don't compress are sent uncompressed. Flood packets hold a single frame, so
+ * batch formats compress it on its own using the same compression algorithm.
+ * @exception std::runtime_error Unknown packet format.
+ */
+FloodEncoder::FloodEncoder(uint16_t l4mtu, PacketHeaderOptionFormatType packet_format)
+	: l4mtu(l4mtu), packet_format(PacketHeaderOptionFormatTypeUnbatched(packet_format)), dictionary_id(0) {
+
+	// Initialize compressor
+	if (this->packet_format == PacketHeaderOptionFormatType::COMPRESSED_LZ4) {
+		this->compressor = std::make_unique<accl::StreamCompressorLZ4>();
+	} else if (this->packet_format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD) {
+		this->compressor = std::make_unique<accl::StreamCompressorZSTD>();
+	} else if (this->packet_format != PacketHeaderOptionFormatType::NONE) {
+		LOG_ERROR("Unknown packet format ", static_cast<unsigned int>(packet_format));
+		throw std::runtime_error("Unknown packet format");
+	}
+}
+
+/**
+ * @brief Set the compression level.
+ *
+ * @param level Compression level, 0 uses the default level of the compressor.
+ */
+void FloodEncoder::setCompressionLevel(int level) {
+	if (this->compressor && level) {
+		this->compressor->setCompressionLevel(level);
+	}
+}
+
+/**
+ * @brief Set the dictionary frames are compressed with, the remote nodes must have the same dictionary to decode them.
+ *
+ * @param dictionary Compression dictionary, or nullptr to not use a dictionary.
+ * @param id ID sent with payloads compressed with the dictionary, 0 derives the ID from the dictionary.
+ */
+void FloodEncoder::setCompressionDictionary(std::shared_ptr<const std::string> dictionary, uint8_t id) {
+	if (!this->compressor) {
+		return;
+	}
+	this->compressor->setDictionary(dictionary ? *dictionary : std::string());
+	this->dictionary_id = dictionary ? (id ? id : get_compression_dictionary_id(*dictionary)) : 0;
+}
+
+/**
+ * @brief Encode a frame into a flood packet.
+ *
+ * @param frame Buffer holding the frame.
+ * @param packet Buffer to encode the packet into, this is cleared first.
+ * @return true If the frame was encoded.
+ * @return false If the frame does not fit into a single packet and needs to be encoded by each remote node instead.
+ */
+bool FloodEncoder::encode(const PacketBuffer &frame, PacketBuffer &packet) {
+	const size_t header_size = sizeof(PacketHeader) + sizeof(PacketHeaderOption);
+	size_t max_payload_size = std::min<size_t>(this->l4mtu, packet.getBufferSize());
+	if (max_payload_size <= header_size) {
+		return false;
+	}
+	max_payload_size -= header_size;
+
+	packet.clear();
+	char *payload = packet.getData() + header_size;
+	// Buffer is only ever read from, but getData() is not const
+	char *frame_data = const_cast<PacketBuffer &>(frame).getData();
+	size_t frame_size = frame.getDataSize();
+
+	// Compress the frame on its own, so it can be decompressed without any stream state, and only use it if its smaller
+	PacketHeaderOptionFormatType format = PacketHeaderOptionFormatType::NONE;
+	size_t payload_length = frame_size;
+	if (this->compressor) {
+		this->compressor->resetCompressionStream();
+		int compressed_size = this->compressor->compress(frame_data, frame_size, payload, max_payload_size);
+		if (compressed_size > 0 && static_cast<size_t>(compressed_size) < frame_size) {
+			format = this->packet_format;
+			payload_length = compressed_size;
+		}
+	}
+	if (format == PacketHeaderOptionFormatType::NONE) {
+		if (frame_size > max_payload_size) {
+			return false;
+		}
+		std::memcpy(payload, frame_data, frame_size);
+	}
+
+	PacketHeader *packet_header = reinterpret_cast<PacketHeader *>(packet.getData());
+	packet_header->ver = SETH_PACKET_HEADER_VERSION_V1;
+	packet_header->opt_len = 1;
+	packet_header->reserved = 0;
+	packet_header->critical = 0;
+	packet_header->oam = 0;
+	packet_header->format = PacketHeaderFormat::ENCAPSULATED_FLOOD;
+	packet_header->channel = 0;
+	// Flood packets are not part of the packet sequence
+	packet_header->sequence = 0;
+
+	PacketHeaderOption *packet_header_option = reinterpret_cast<PacketHeaderOption *>(packet.getData() + sizeof(PacketHeader));
+	packet_header_option->type = PacketHeaderOptionType::COMPLETE_PACKET;
+	packet_header_option->packet_size = accl::cpu_to_be_16(frame_size);
+	packet_header_option->format = format;
+	packet_header_option->payload_length = accl::cpu_to_be_16(payload_length);
+	packet_header_option->part = 0;
+	packet_header_option->dictionary = format != PacketHeaderOptionFormatType::NONE ? this->dictionary_id : 0;
+
+	packet.setDataSize(header_size + payload_length);
+
+	LOG_DEBUG_INTERNAL("FLOOD ENCODE: size=", frame_size, ", format=", static_cast<unsigned int>(format),
+					   ", payload_length=", payload_length);
+
+	return true;
+}
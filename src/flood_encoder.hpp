@@ -0,0 +1,57 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "codec.hpp"
+#include "libaccl/stream_compressor.hpp"
+#include "packet_buffer.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Encodes frames flooded to all the remote nodes into flood packets.
+ *
+ * Each frame is encoded on its own into a single packet, so the same packet can be sent to every remote node instead of each
+ * remote node encoding the frame.
+ */
+class FloodEncoder {
+	public:
+		FloodEncoder(uint16_t l4mtu, PacketHeaderOptionFormatType packet_format);
+
+		bool encode(const PacketBuffer &frame, PacketBuffer &packet);
+
+		void setCompressionLevel(int level);
+		void setCompressionDictionary(std::shared_ptr<const std::string> dictionary, uint8_t id = 0);
+
+		inline uint16_t getL4MTUSize() const;
+		inline PacketHeaderOptionFormatType getPacketFormat() const;
+
+	private:
+		// Maximum layer 4 segment size, this must fit the smallest of the remote nodes
+		uint16_t l4mtu;
+
+		// Compressor, this is reset for each frame
+		PacketHeaderOptionFormatType packet_format;
+		std::unique_ptr<accl::StreamCompressor> compressor;
+		// ID of the dictionary the compressor is primed with, 0 if we don't have one
+		uint8_t dictionary_id;
+};
+
+/**
+ * @brief Get the maximum layer 4 segment size.
+ *
+ * @return uint16_t L4MTU size.
+ */
+inline uint16_t FloodEncoder::getL4MTUSize() const { return l4mtu; }
+
+/**
+ * @brief Get the packet format.
+ *
+ * @return PacketHeaderOptionFormatType Packet format.
+ */
+inline PacketHeaderOptionFormatType FloodEncoder::getPacketFormat() const { return packet_format; }
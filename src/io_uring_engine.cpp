@@ -0,0 +1,278 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#ifdef HAVE_LIBURING
+
+#include "io_uring_engine.hpp"
+#include "exceptions.hpp"
+#include "libaccl/logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+/**
+ * @brief Construct a new IOUringEngine object.
+ *
+ * @param entries Number of submission queue entries, up to twice this number of operations can be in flight.
+ * @param fds Files we'll be operating on, these are referred to by their index.
+ * @param arenas Arenas our buffers are allocated from, null arenas are ignored.
+ * @exception SuperEthernetTunnelRuntimeException The ring could not be created.
+ */
+IOUringEngine::IOUringEngine(unsigned int entries, const std::vector<int> &fds,
+							 const std::vector<const accl::BufferArena *> &arenas)
+	: fds(fds), fixed_files(false), requests(entries * 2), syscall_count(0) {
+
+	int res = io_uring_queue_init(entries, &this->ring, 0);
+	if (res < 0) {
+		throw SuperEthernetTunnelRuntimeException(std::format("io_uring_queue_init failed: {}", strerror(-res)));
+	}
+
+	// Register our files so the kernel doesn't need to look them up on every operation
+	res = io_uring_register_files(&this->ring, this->fds.data(), this->fds.size());
+	if (res < 0) {
+		LOG_NOTICE("Could not register files with io_uring, using file descriptors: ", strerror(-res));
+	} else {
+		this->fixed_files = true;
+	}
+
+	// Register the arenas so the kernel doesn't need to map the buffer pages on every operation
+	for (auto arena : arenas) {
+		if (arena) {
+			this->fixed_buffers.push_back({arena->getSlab(), arena->getSlabSize()});
+		}
+	}
+	if (!this->fixed_buffers.empty()) {
+		res = io_uring_register_buffers(&this->ring, this->fixed_buffers.data(), this->fixed_buffers.size());
+		if (res < 0) {
+			LOG_NOTICE("Could not register buffers with io_uring, using normal reads and writes: ", strerror(-res));
+			this->fixed_buffers.clear();
+		}
+	}
+
+	// All requests are free to start off with
+	this->free_requests.reserve(this->requests.size());
+	for (size_t i = this->requests.size(); i > 0; --i) {
+		this->free_requests.push_back(i - 1);
+	}
+}
+
+/**
+ * @brief Destroy the IOUringEngine object, operations in flight are cancelled and their buffers released.
+ *
+ */
+IOUringEngine::~IOUringEngine() { io_uring_queue_exit(&this->ring); }
+
+/**
+ * @brief Check if the kernel supports io_uring.
+ *
+ * @return true If we can create a ring.
+ * @return false If io_uring is not available or not permitted.
+ */
+bool IOUringEngine::isSupported() {
+	io_uring ring;
+	if (io_uring_queue_init(2, &ring, 0) < 0) {
+		return false;
+	}
+	io_uring_queue_exit(&ring);
+	return true;
+}
+
+/**
+ * @brief Queue a read into a buffer, the data size of the buffer is set to the number of bytes read.
+ *
+ * @param file Index of the file to read from.
+ * @param buffer Buffer to read into.
+ * @exception SuperEthernetTunnelRuntimeException Too many operations are in flight.
+ */
+void IOUringEngine::read(unsigned int file, std::unique_ptr<PacketBuffer> buffer) {
+	_queueReadWrite(IOUringOp::READ, file, std::move(buffer));
+}
+
+/**
+ * @brief Queue a write of a buffer.
+ *
+ * @param file Index of the file to write to.
+ * @param buffer Buffer to write.
+ * @exception SuperEthernetTunnelRuntimeException Too many operations are in flight.
+ */
+void IOUringEngine::write(unsigned int file, std::unique_ptr<PacketBuffer> buffer) {
+	_queueReadWrite(IOUringOp::WRITE, file, std::move(buffer));
+}
+
+/**
+ * @brief Queue a receive of a datagram into a buffer, the packet source of the buffer is set to the sender.
+ *
+ * @param file Index of the socket to receive from.
+ * @param buffer Buffer to receive into.
+ * @exception SuperEthernetTunnelRuntimeException Too many operations are in flight.
+ */
+void IOUringEngine::recvmsg(unsigned int file, std::unique_ptr<PacketBuffer> buffer) {
+	size_t index = _allocRequest(IOUringOp::RECVMSG, file, std::move(buffer));
+	Request &request = this->requests[index];
+
+	request.iov.iov_base = request.buffer->getData();
+	request.iov.iov_len = request.buffer->getBufferSize();
+
+	std::memset(&request.msg, 0, sizeof(request.msg));
+	request.msg.msg_name = request.buffer->getPacketSourceData();
+	request.msg.msg_namelen = sizeof(sockaddr_storage);
+	request.msg.msg_iov = &request.iov;
+	request.msg.msg_iovlen = 1;
+
+	io_uring_sqe *sqe = _getSQE();
+	io_uring_prep_recvmsg(sqe, this->fixed_files ? file : this->fds[file], &request.msg, 0);
+	_queueRequest(sqe, index);
+}
+
+/**
+ * @brief Submit all queued operations and wait for at least one to complete, if any are in flight.
+ *
+ * @param completions List to add the completed operations to.
+ * @return size_t Number of operations completed.
+ * @exception SuperEthernetTunnelRuntimeException Submitting to the ring failed.
+ */
+size_t IOUringEngine::submitAndWait(std::deque<IOUringCompletion> &completions) {
+	int res = io_uring_submit_and_wait(&this->ring, getInflightCount() ? 1 : 0);
+	++this->syscall_count;
+	// If we were interrupted or the completion queue is backed up, we just reap what we have
+	if (res < 0 && res != -EINTR && res != -EAGAIN && res != -EBUSY) {
+		throw SuperEthernetTunnelRuntimeException(std::format("io_uring_submit_and_wait failed: {}", strerror(-res)));
+	}
+
+	io_uring_cqe *cqe;
+	unsigned int head;
+	unsigned int count = 0;
+	io_uring_for_each_cqe(&this->ring, head, cqe) {
+		size_t index = static_cast<size_t>(io_uring_cqe_get_data64(cqe));
+		Request &request = this->requests[index];
+
+		if (cqe->res >= 0 && request.op != IOUringOp::WRITE) {
+			request.buffer->setDataSize(cqe->res);
+		}
+		completions.push_back({request.op, request.file, cqe->res, std::move(request.buffer)});
+
+		this->free_requests.push_back(index);
+		++count;
+	}
+	io_uring_cq_advance(&this->ring, count);
+
+	return count;
+}
+
+/**
+ * @brief Internal method to take a free request for an operation.
+ *
+ * @param op Operation.
+ * @param file Index of the file.
+ * @param buffer Buffer for the operation.
+ * @return size_t Index of the request.
+ * @exception SuperEthernetTunnelRuntimeException Too many operations are in flight.
+ */
+size_t IOUringEngine::_allocRequest(IOUringOp op, unsigned int file, std::unique_ptr<PacketBuffer> buffer) {
+	if (this->free_requests.empty()) {
+		throw SuperEthernetTunnelRuntimeException(
+			std::format("Too many io_uring operations in flight, maximum is {}", this->requests.size()));
+	}
+
+	size_t index = this->free_requests.back();
+	this->free_requests.pop_back();
+
+	Request &request = this->requests[index];
+	request.op = op;
+	request.file = file;
+	request.buffer = std::move(buffer);
+
+	return index;
+}
+
+/**
+ * @brief Internal method to get a submission queue entry, submitting what we have queued if the queue is full.
+ *
+ * @return io_uring_sqe* Submission queue entry.
+ * @exception SuperEthernetTunnelRuntimeException Submitting to the ring failed.
+ */
+io_uring_sqe *IOUringEngine::_getSQE() {
+	io_uring_sqe *sqe = io_uring_get_sqe(&this->ring);
+	if (sqe) {
+		return sqe;
+	}
+
+	// Submission queue is full, hand what we have to the kernel to make space
+	int res = io_uring_submit(&this->ring);
+	++this->syscall_count;
+	if (res < 0) {
+		throw SuperEthernetTunnelRuntimeException(std::format("io_uring_submit failed: {}", strerror(-res)));
+	}
+
+	sqe = io_uring_get_sqe(&this->ring);
+	if (!sqe) {
+		throw SuperEthernetTunnelRuntimeException("io_uring submission queue is full");
+	}
+	return sqe;
+}
+
+/**
+ * @brief Internal method to link a prepared submission queue entry to its request.
+ *
+ * @param sqe Submission queue entry.
+ * @param index Index of the request.
+ */
+void IOUringEngine::_queueRequest(io_uring_sqe *sqe, size_t index) {
+	io_uring_sqe_set_data64(sqe, index);
+	if (this->fixed_files) {
+		io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+	}
+}
+
+/**
+ * @brief Internal method to work out which registered arena a buffer lives in.
+ *
+ * @param buffer Buffer to check.
+ * @return int Index of the registered arena or -1 if the buffer is not in one.
+ */
+int IOUringEngine::_getFixedBufferIndex(PacketBuffer &buffer) const {
+	const char *data = buffer.getData();
+	for (size_t i = 0; i < this->fixed_buffers.size(); ++i) {
+		const char *base = static_cast<const char *>(this->fixed_buffers[i].iov_base);
+		if (data >= base && data + buffer.getBufferSize() <= base + this->fixed_buffers[i].iov_len) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Internal method to queue a read or a write, using a fixed buffer operation if the buffer is in a registered arena.
+ *
+ * @param op Operation, either IOUringOp::READ or IOUringOp::WRITE.
+ * @param file Index of the file.
+ * @param buffer Buffer to read into or write.
+ */
+void IOUringEngine::_queueReadWrite(IOUringOp op, unsigned int file, std::unique_ptr<PacketBuffer> buffer) {
+	size_t index = _allocRequest(op, file, std::move(buffer));
+	PacketBuffer &request_buffer = *this->requests[index].buffer;
+
+	int fd = this->fixed_files ? file : this->fds[file];
+	int buffer_index = _getFixedBufferIndex(request_buffer);
+
+	io_uring_sqe *sqe = _getSQE();
+	if (op == IOUringOp::READ) {
+		if (buffer_index >= 0) {
+			io_uring_prep_read_fixed(sqe, fd, request_buffer.getData(), request_buffer.getBufferSize(), 0, buffer_index);
+		} else {
+			io_uring_prep_read(sqe, fd, request_buffer.getData(), request_buffer.getBufferSize(), 0);
+		}
+	} else {
+		if (buffer_index >= 0) {
+			io_uring_prep_write_fixed(sqe, fd, request_buffer.getData(), request_buffer.getDataSize(), 0, buffer_index);
+		} else {
+			io_uring_prep_write(sqe, fd, request_buffer.getData(), request_buffer.getDataSize(), 0);
+		}
+	}
+	_queueRequest(sqe, index);
+}
+
+#endif
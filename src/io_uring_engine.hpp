@@ -0,0 +1,141 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#ifdef HAVE_LIBURING
+
+#include "libaccl/buffer_arena.hpp"
+#include "packet_buffer.hpp"
+#include <cstdint>
+#include <deque>
+#include <liburing.h>
+#include <memory>
+#include <sys/socket.h>
+#include <vector>
+
+/**
+ * @brief Type of operation submitted to the io_uring.
+ *
+ */
+enum class IOUringOp {
+	READ,
+	WRITE,
+	RECVMSG,
+};
+
+/**
+ * @brief Completed io_uring operation, the buffer is handed back to the caller.
+ *
+ */
+struct IOUringCompletion {
+		IOUringOp op;
+		// Index of the file the operation was on
+		unsigned int file;
+		// Result of the operation, this is the number of bytes transferred or -errno
+		int result;
+		std::unique_ptr<PacketBuffer> buffer;
+};
+
+/**
+ * @brief I/O engine using io_uring to batch reads, writes and receives of packet buffers.
+ *
+ * The files used are registered with the ring and referred to by their index. Buffers which live in one of the arenas passed
+ * when creating the engine use fixed buffer reads and writes, which saves the kernel mapping the pages on every operation.
+ * Operations are queued and only submitted to the kernel on submitAndWait(), so a whole batch costs a single syscall.
+ */
+class IOUringEngine {
+	public:
+		IOUringEngine(unsigned int entries, const std::vector<int> &fds, const std::vector<const accl::BufferArena *> &arenas);
+		~IOUringEngine();
+
+		IOUringEngine(const IOUringEngine &) = delete;
+		IOUringEngine &operator=(const IOUringEngine &) = delete;
+
+		static bool isSupported();
+
+		void read(unsigned int file, std::unique_ptr<PacketBuffer> buffer);
+		void write(unsigned int file, std::unique_ptr<PacketBuffer> buffer);
+		void recvmsg(unsigned int file, std::unique_ptr<PacketBuffer> buffer);
+
+		size_t submitAndWait(std::deque<IOUringCompletion> &completions);
+
+		inline size_t getInflightCount() const;
+		inline size_t getCapacity() const;
+		inline bool hasFixedFiles() const;
+		inline bool hasFixedBuffers() const;
+		inline uint64_t getSyscallCount() const;
+
+	private:
+		// Operation in flight, the IO vector and message header must stay put until the operation completes
+		struct Request {
+				IOUringOp op;
+				unsigned int file;
+				std::unique_ptr<PacketBuffer> buffer;
+				iovec iov;
+				msghdr msg;
+		};
+
+		io_uring ring;
+
+		// Files we operate on, these are registered with the ring if possible
+		std::vector<int> fds;
+		bool fixed_files;
+
+		// Arena memory registered with the ring
+		std::vector<iovec> fixed_buffers;
+
+		// Requests indexed by the user data of their submission, along with the indexes of the ones free for use
+		std::vector<Request> requests;
+		std::vector<size_t> free_requests;
+
+		uint64_t syscall_count;
+
+		size_t _allocRequest(IOUringOp op, unsigned int file, std::unique_ptr<PacketBuffer> buffer);
+		io_uring_sqe *_getSQE();
+		void _queueRequest(io_uring_sqe *sqe, size_t index);
+		int _getFixedBufferIndex(PacketBuffer &buffer) const;
+		void _queueReadWrite(IOUringOp op, unsigned int file, std::unique_ptr<PacketBuffer> buffer);
+};
+
+/**
+ * @brief Get the number of operations queued or in flight.
+ *
+ * @return size_t Number of operations.
+ */
+inline size_t IOUringEngine::getInflightCount() const { return requests.size() - free_requests.size(); }
+
+/**
+ * @brief Get the maximum number of operations which can be queued or in flight at once.
+ *
+ * @return size_t Number of operations.
+ */
+inline size_t IOUringEngine::getCapacity() const { return requests.size(); }
+
+/**
+ * @brief Check if the files are registered with the ring.
+ *
+ * @return true If the files are registered.
+ * @return false If the file descriptors are used as is.
+ */
+inline bool IOUringEngine::hasFixedFiles() const { return fixed_files; }
+
+/**
+ * @brief Check if the arenas are registered with the ring.
+ *
+ * @return true If the arenas are registered.
+ * @return false If normal reads and writes are used for all buffers.
+ */
+inline bool IOUringEngine::hasFixedBuffers() const { return !fixed_buffers.empty(); }
+
+/**
+ * @brief Get the number of io_uring syscalls made.
+ *
+ * @return uint64_t Number of syscalls.
+ */
+inline uint64_t IOUringEngine::getSyscallCount() const { return syscall_count; }
+
+#endif
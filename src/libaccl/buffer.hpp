@@ -6,24 +6,58 @@
 
 #pragma once
 
+#include "buffer_arena.hpp"
+#include <atomic>
+#include <cstring>
 #include <format>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 namespace accl {
 
+class Buffer;
+
+/**
+ * @brief Interface of whatever a shared buffer is handed back to once the last view of it is released.
+ *
+ */
+class BufferReleaser {
+	public:
+		virtual ~BufferReleaser() = default;
+
+		virtual void releaseBuffer(Buffer *buffer) = 0;
+};
+
 class Buffer {
 	private:
+		// Storage we own, this is empty if we're using external storage
 		std::vector<char> content;
+		char *storage;
+		std::size_t bufferSize;
 		std::size_t dataSize;
+		// Buffer whose storage we are a view of, we hold a share of it for as long as we are around
+		Buffer *backing;
+		// Number of shares held on us by our views and whoever shared us, and who we're handed to once the last one is released
+		std::atomic<std::size_t> shares;
+		std::shared_ptr<BufferReleaser> releaser;
 
 	public:
 		inline Buffer(std::size_t size);
+		inline Buffer(std::size_t size, char *external_storage);
+		inline Buffer(Buffer *backing, std::size_t offset, std::size_t size);
 
 		// Copy constructor
 		inline Buffer(const Buffer &other);
 		// Copy assignment operator
 		inline Buffer &operator=(const Buffer &other);
 
+		inline ~Buffer();
+
+		// Share the buffer so views can be created of it
+		inline void share(std::shared_ptr<BufferReleaser> releaser);
+		inline void unshare();
+
 		// Add data to buffer
 		inline void append(const char *data, std::size_t size);
 
@@ -40,6 +74,14 @@ class Buffer {
 
 		// Clear the buffer
 		inline void clear();
+
+		// Check if this buffer is a view into another buffer
+		inline bool isView() const;
+
+		// Buffers may be constructed inside a BufferArena, in which case the arena owns the memory
+		inline static void *operator new(std::size_t size);
+		inline static void *operator new(std::size_t size, void *ptr) noexcept;
+		inline static void operator delete(void *ptr);
 };
 
 /**
@@ -47,29 +89,119 @@ class Buffer {
  *
  * @param size Size of buffer.
  */
-inline Buffer::Buffer(std::size_t size) : content(size), dataSize(0) {}
+inline Buffer::Buffer(std::size_t size)
+	: content(size), storage(content.data()), bufferSize(size), dataSize(0), backing(nullptr), shares(0) {}
 
 /**
- * @brief Construct a new Buffer object
+ * @brief Construct a new Buffer object using external storage.
+ *
+ * @param size Size of buffer.
+ * @param external_storage Storage to use for the buffer, this must be at least `size` bytes and outlive the buffer.
+ */
+inline Buffer::Buffer(std::size_t size, char *external_storage)
+	: storage(external_storage), bufferSize(size), dataSize(0), backing(nullptr), shares(0) {}
+
+/**
+ * @brief Construct a new Buffer object which is a view of part of another buffer, no data is copied.
+ *
+ * The view holds a share of the backing buffer, so the backing buffer is only released once all its views are gone. A view of a
+ * view is a view of the buffer the view is of.
+ *
+ * @param backing Buffer to create a view of, this must be shared using share() or be a view.
+ * @param offset Offset of the view in the backing buffer.
+ * @param size Size of the view, the view is created holding `size` bytes of data.
+ * @exception std::out_of_range The view would exceed the backing buffer.
+ * @exception std::invalid_argument The backing buffer is not shared.
+ */
+inline Buffer::Buffer(Buffer *backing, std::size_t offset, std::size_t size)
+	: bufferSize(size), dataSize(size), backing(backing), shares(0) {
+	if (offset > this->backing->bufferSize || size > this->backing->bufferSize - offset) {
+		throw std::out_of_range(std::format("Buffer view at offset {} of size {} exceeds backing buffer size {}", offset, size,
+											this->backing->bufferSize));
+	}
+	storage = this->backing->storage + offset;
+	if (this->backing->backing) {
+		this->backing = this->backing->backing;
+	}
+	if (!this->backing->releaser) {
+		throw std::invalid_argument("Buffer must be shared before views can be created of it");
+	}
+	this->backing->shares.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Construct a new Buffer object, the copy always owns its storage.
  *
  * @param other Buffer to copy.
  */
-inline Buffer::Buffer(const Buffer &other) : content(other.content), dataSize(other.dataSize) {}
+inline Buffer::Buffer(const Buffer &other)
+	: content(other.storage, other.storage + other.bufferSize), storage(content.data()), bufferSize(other.bufferSize),
+	  dataSize(other.dataSize), backing(nullptr), shares(0) {}
 
 /**
  * @brief Copy assignment operator.
  *
+ * Buffers using external storage keep their storage, so the data being copied must fit.
+ *
  * @param other Buffer to copy.
  * @return Buffer& Reference to this buffer.
  */
 inline Buffer &Buffer::operator=(const Buffer &other) {
-	if (this != &other) {
-		content = other.content;
-		dataSize = other.dataSize;
+	if (this == &other) {
+		return *this;
 	}
+	if (storage == content.data()) {
+		content.assign(other.storage, other.storage + other.bufferSize);
+		storage = content.data();
+		bufferSize = other.bufferSize;
+	} else {
+		if (other.dataSize > bufferSize) {
+			throw std::out_of_range(
+				std::format("Buffer size {} is too small to copy {} bytes of data into", bufferSize, other.dataSize));
+		}
+		std::memcpy(storage, other.storage, other.dataSize);
+	}
+	dataSize = other.dataSize;
 	return *this;
 }
 
+/**
+ * @brief Destroy the Buffer object, views release their share of the buffer they are a view of.
+ *
+ */
+inline Buffer::~Buffer() {
+	if (backing) {
+		backing->unshare();
+	}
+}
+
+/**
+ * @brief Share the buffer so views can be created of it.
+ *
+ * Whoever owned the buffer gives it up and holds a single share of it instead, which must be released using unshare() once done
+ * creating views. The buffer is handed to the releaser once the last share is released. Sharing needs no allocation, the share
+ * count lives in the buffer.
+ *
+ * @param releaser What to hand the buffer to once the last share is released.
+ */
+inline void Buffer::share(std::shared_ptr<BufferReleaser> releaser) {
+	this->shares.store(1, std::memory_order_relaxed);
+	this->releaser = std::move(releaser);
+}
+
+/**
+ * @brief Release a share of the buffer, handing the buffer to its releaser if this was the last share.
+ *
+ */
+inline void Buffer::unshare() {
+	if (shares.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+	// The buffer may be reused as soon as it is handed over, so we can't hold on to the releaser in it
+	std::shared_ptr<BufferReleaser> releaser = std::move(this->releaser);
+	releaser->releaseBuffer(this);
+}
+
 /**
  * @brief Append data to buffer.
  *
@@ -77,12 +209,12 @@ inline Buffer &Buffer::operator=(const Buffer &other) {
  * @param size Size of data to.
  */
 inline void Buffer::append(const char *data, std::size_t size) {
-	if (size > content.size() - dataSize) {
+	if (size > bufferSize - dataSize) {
 		// Make sure we cannot overflow the buffer
 		throw std::out_of_range(std::format("Buffer size {} would be exceeded with append of {} ontop of current size {}",
-											content.size(), size, dataSize));
+											bufferSize, size, dataSize));
 	}
-	std::copy(data, data + size, content.begin() + dataSize);
+	std::copy(data, data + size, storage + dataSize);
 	dataSize += size;
 }
 
@@ -91,14 +223,14 @@ inline void Buffer::append(const char *data, std::size_t size) {
  *
  * @return char* Pointer to buffer data.
  */
-inline char *Buffer::getData() { return content.data(); }
+inline char *Buffer::getData() { return storage; }
 
 /**
  * @brief Get buffer size.
  *
  * @return std::size_t Buffer size.
  */
-inline std::size_t Buffer::getBufferSize() const { return content.size(); };
+inline std::size_t Buffer::getBufferSize() const { return bufferSize; };
 
 /**
  * @brief Get size of data in buffer.
@@ -114,7 +246,7 @@ inline std::size_t Buffer::getDataSize() const { return dataSize; }
  */
 inline void Buffer::setDataSize(size_t size) {
 	// We cannot set the data size bigger than the buffer itself
-	if (size > content.size()) {
+	if (size > bufferSize) {
 		throw std::out_of_range("Buffer data size cannot exceed buffer size");
 	}
 	dataSize = size;
@@ -126,4 +258,38 @@ inline void Buffer::setDataSize(size_t size) {
  */
 inline void Buffer::clear() { dataSize = 0; }
 
+/**
+ * @brief Check if this buffer is a view into another buffer.
+ *
+ * @return true If the buffer is a view.
+ * @return false If the buffer has its own storage.
+ */
+inline bool Buffer::isView() const { return backing != nullptr; }
+
+/**
+ * @brief Allocate a buffer on the heap, recording that it does not live in a BufferArena.
+ *
+ * @param size Size of the buffer object.
+ * @return void* Memory for the buffer object.
+ */
+inline void *Buffer::operator new(std::size_t size) { return BufferArena::allocateObject(size); }
+
+/**
+ * @brief Construct a buffer in memory we were given, this is used to construct buffers in a BufferArena.
+ *
+ * @param size Size of the buffer object.
+ * @param ptr Memory for the buffer object.
+ * @return void* Memory for the buffer object.
+ */
+inline void *Buffer::operator new([[maybe_unused]] std::size_t size, void *ptr) noexcept { return ptr; }
+
+/**
+ * @brief Free a buffer, unless it lives in a BufferArena, in which case the arena is told the buffer is gone.
+ *
+ * The owner is recorded in front of the buffer object, so this needs neither a lock nor a search of the arenas.
+ *
+ * @param ptr Pointer to the buffer.
+ */
+inline void Buffer::operator delete(void *ptr) { BufferArena::releaseObject(ptr); }
+
 } // namespace accl
\ No newline at end of file
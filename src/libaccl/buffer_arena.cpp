@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "buffer_arena.hpp"
+#include <algorithm>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace accl {
+
+// Size of hugepages we round the slab up to
+static constexpr std::size_t BUFFER_ARENA_HUGEPAGE_SIZE{2 * 1024 * 1024};
+
+/**
+ * @brief Round a size up to a multiple of an alignment.
+ *
+ * @param size Size to round up.
+ * @param alignment Alignment to round up to.
+ * @return std::size_t Rounded up size.
+ */
+static std::size_t _round_up(std::size_t size, std::size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+/**
+ * @brief Construct a new BufferArena object.
+ *
+ * @param object_size Size of each object.
+ * @param object_alignment Alignment of each object.
+ * @param buffer_size Size of each buffer.
+ * @param count Number of buffers and objects.
+ * @param use_huge_pages Back the slab with hugepages, otherwise it is only rounded up to a page using normal pages.
+ * @exception std::bad_alloc The slab could not be mapped.
+ */
+BufferArena::BufferArena(std::size_t object_size, std::size_t object_alignment, std::size_t buffer_size, std::size_t count,
+						 bool use_huge_pages)
+	: object_offset(_round_up(BUFFER_ARENA_OBJECT_HEADER, object_alignment)),
+	  buffer_stride(_round_up(buffer_size, BUFFER_ARENA_ALIGNMENT)), count(count), huge_pages(use_huge_pages), refs(1) {
+	// Each object is preceded by its header, which records we own the object
+	this->object_size = _round_up(object_offset + object_size, std::max(object_alignment, BUFFER_ARENA_OBJECT_HEADER));
+
+	// Buffer data first, then the object array on its own cache line
+	std::size_t data_size = buffer_stride * count;
+	std::size_t objects_offset = _round_up(data_size, std::max(BUFFER_ARENA_ALIGNMENT, object_alignment));
+	slab_size = _round_up(objects_offset + this->object_size * count,
+						  use_huge_pages ? BUFFER_ARENA_HUGEPAGE_SIZE : static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+
+	// Try explicit hugepages first, these are normally only available if the admin reserved some
+	void *mem = MAP_FAILED;
+	if (use_huge_pages) {
+		mem = mmap(nullptr, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+	if (mem == MAP_FAILED) {
+		huge_pages = false;
+		mem = mmap(nullptr, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		// Transparent hugepages are just advisory, so we don't care if this fails
+		if (use_huge_pages) {
+			madvise(mem, slab_size, MADV_HUGEPAGE);
+		}
+	}
+
+	slab = static_cast<char *>(mem);
+	objects = slab + objects_offset;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		_getOwner(getObject(i)) = this;
+	}
+}
+
+/**
+ * @brief Destroy the BufferArena object, unmapping the slab.
+ *
+ */
+BufferArena::~BufferArena() { munmap(slab, slab_size); }
+
+/**
+ * @brief Create a new arena, the caller holds a reference which must be released using release().
+ *
+ * @param object_size Size of each object.
+ * @param object_alignment Alignment of each object.
+ * @param buffer_size Size of each buffer.
+ * @param count Number of buffers and objects.
+ * @return BufferArena* New arena.
+ */
+BufferArena *BufferArena::create(std::size_t object_size, std::size_t object_alignment, std::size_t buffer_size,
+								 std::size_t count) {
+	return new BufferArena(object_size, object_alignment, buffer_size, count, true);
+}
+
+/**
+ * @brief Create a new arena holding only objects, these are handed out using allocateSlot() and recycled when deleted.
+ *
+ * The caller holds a reference which must be released using release(). The slab is mapped using normal pages, as these arenas are
+ * small and would otherwise each take up a whole hugepage.
+ *
+ * @param object_size Size of each object.
+ * @param object_alignment Alignment of each object.
+ * @param count Number of objects.
+ * @return BufferArena* New arena.
+ */
+BufferArena *BufferArena::createSlots(std::size_t object_size, std::size_t object_alignment, std::size_t count) {
+	BufferArena *arena = new BufferArena(object_size, object_alignment, 0, count, false);
+	arena->free_slots = std::make_unique<MPMCRingQueue<std::size_t>>(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		arena->free_slots->tryPush(std::size_t{i});
+	}
+	return arena;
+}
+
+/**
+ * @brief Get memory for an object from the free list, the object holds a reference on the arena until it is deleted.
+ *
+ * @return void* Pointer to memory where the object can be constructed, or nullptr if all the objects are in use.
+ */
+void *BufferArena::allocateSlot() {
+	std::size_t index;
+	if (!free_slots || !free_slots->tryPop(index)) {
+		return nullptr;
+	}
+	retain();
+	return getObject(index);
+}
+
+/**
+ * @brief Internal method to put an object handed out using allocateSlot() back on the free list.
+ *
+ * @param ptr Pointer to the object.
+ */
+void BufferArena::_releaseSlot(void *ptr) {
+	std::size_t index = (static_cast<char *>(ptr) - object_offset - objects) / object_size;
+	// The free list can hold all our objects, so this never fails
+	free_slots->tryPush(std::move(index));
+}
+
+/**
+ * @brief Take a reference on the arena, this is done for each object constructed in it.
+ *
+ */
+void BufferArena::retain() { refs.fetch_add(1, std::memory_order_relaxed); }
+
+/**
+ * @brief Release a reference on the arena, destroying it when the last reference is gone.
+ *
+ */
+void BufferArena::release() {
+	if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete this;
+	}
+}
+
+} // namespace accl
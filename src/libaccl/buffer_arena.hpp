@@ -0,0 +1,182 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "ring_queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace accl {
+
+// Alignment of each buffer within the arena slab
+inline constexpr std::size_t BUFFER_ARENA_ALIGNMENT{64};
+// Space in front of each object recording the arena that owns it, objects on the heap get the same space with a null owner
+inline constexpr std::size_t BUFFER_ARENA_OBJECT_HEADER{alignof(std::max_align_t)};
+
+/**
+ * @brief Single slab of memory holding a number of buffers and their objects.
+ *
+ * The slab is split into two regions, the buffer data region where each buffer starts on a cache line, and a separate compact
+ * array holding the buffer objects themselves. We try use explicit hugepages first and fall back to transparent hugepages.
+ *
+ * The arena is reference counted, each object constructed in it holds a reference which is released when the object is
+ * deleted, and the creator holds one which is released using release(). The slab is unmapped once all references are gone.
+ *
+ * Each object is preceded by a header holding a pointer to the arena which owns it. Objects allocated on the heap using
+ * allocateObject() get the same header with a null owner, so releaseObject() can tell them apart without a lookup.
+ *
+ * An arena created using createSlots() has no buffers, its objects are handed out using allocateSlot() and go back on a free list
+ * when they are deleted, so short lived objects can be created and deleted without touching the heap. These arenas are small, so
+ * they are mapped using normal pages and leave the hugepages for the buffers.
+ */
+class BufferArena {
+	private:
+		std::size_t object_size;
+		std::size_t object_offset;
+		std::size_t buffer_stride;
+		std::size_t count;
+
+		char *slab;
+		std::size_t slab_size;
+		char *objects;
+		bool huge_pages;
+
+		std::atomic<std::size_t> refs;
+
+		// Indexes of the objects free to be handed out using allocateSlot(), this is only set for arenas created using
+		// createSlots()
+		std::unique_ptr<MPMCRingQueue<std::size_t>> free_slots;
+
+		BufferArena(std::size_t object_size, std::size_t object_alignment, std::size_t buffer_size, std::size_t count,
+					bool use_huge_pages);
+		~BufferArena();
+
+		static inline BufferArena *&_getOwner(void *ptr);
+		void _releaseSlot(void *ptr);
+
+	public:
+		BufferArena(const BufferArena &) = delete;
+		BufferArena &operator=(const BufferArena &) = delete;
+
+		static BufferArena *create(std::size_t object_size, std::size_t object_alignment, std::size_t buffer_size,
+								   std::size_t count);
+		static BufferArena *createSlots(std::size_t object_size, std::size_t object_alignment, std::size_t count);
+
+		void retain();
+		void release();
+
+		static void *allocateObject(std::size_t size);
+		static void releaseObject(void *ptr);
+
+		void *allocateSlot();
+		inline std::size_t getFreeSlotCount() const;
+
+		inline void *getObject(std::size_t index);
+		inline char *getStorage(std::size_t index);
+
+		inline std::size_t getCount() const;
+		inline char *getSlab() const;
+		inline std::size_t getSlabSize() const;
+		inline bool isHugePages() const;
+};
+
+/**
+ * @brief Get the owner recorded in the header in front of an object.
+ *
+ * @param ptr Pointer to the object.
+ * @return BufferArena*& Arena owning the object, this is null for objects on the heap.
+ */
+inline BufferArena *&BufferArena::_getOwner(void *ptr) {
+	return *reinterpret_cast<BufferArena **>(static_cast<char *>(ptr) - sizeof(BufferArena *));
+}
+
+/**
+ * @brief Allocate memory for an object on the heap, with a header recording it is not owned by an arena.
+ *
+ * @param size Size of the object.
+ * @return void* Pointer to memory where the object can be constructed.
+ */
+inline void *BufferArena::allocateObject(std::size_t size) {
+	void *ptr = static_cast<char *>(::operator new(size + BUFFER_ARENA_OBJECT_HEADER)) + BUFFER_ARENA_OBJECT_HEADER;
+	_getOwner(ptr) = nullptr;
+	return ptr;
+}
+
+/**
+ * @brief Release the memory of an object being deleted, objects in an arena release the reference they hold on it.
+ *
+ * Objects handed out using allocateSlot() are put back on the free list of their arena.
+ *
+ * @param ptr Pointer to the object, allocated using allocateObject() or constructed in an arena.
+ */
+inline void BufferArena::releaseObject(void *ptr) {
+	BufferArena *owner = _getOwner(ptr);
+	if (owner) {
+		if (owner->free_slots) {
+			owner->_releaseSlot(ptr);
+		}
+		owner->release();
+	} else {
+		::operator delete(static_cast<char *>(ptr) - BUFFER_ARENA_OBJECT_HEADER);
+	}
+}
+
+/**
+ * @brief Get the memory for an object in the arena.
+ *
+ * @param index Index of the object.
+ * @return void* Pointer to memory where the object can be constructed.
+ */
+inline void *BufferArena::getObject(std::size_t index) { return objects + index * object_size + object_offset; }
+
+/**
+ * @brief Get the buffer storage in the arena.
+ *
+ * @param index Index of the buffer.
+ * @return char* Pointer to the buffer storage, this is aligned to BUFFER_ARENA_ALIGNMENT.
+ */
+inline char *BufferArena::getStorage(std::size_t index) { return slab + index * buffer_stride; }
+
+/**
+ * @brief Get the number of objects free to be handed out using allocateSlot().
+ *
+ * @return std::size_t Number of free objects, this is 0 for arenas not created using createSlots().
+ */
+inline std::size_t BufferArena::getFreeSlotCount() const { return free_slots ? free_slots->size() : 0; }
+
+/**
+ * @brief Get the number of buffers in the arena.
+ *
+ * @return std::size_t Number of buffers.
+ */
+inline std::size_t BufferArena::getCount() const { return count; }
+
+/**
+ * @brief Get the start of the slab, this is useful to register the whole arena with the kernel.
+ *
+ * @return char* Pointer to the start of the slab.
+ */
+inline char *BufferArena::getSlab() const { return slab; }
+
+/**
+ * @brief Get the size of the slab.
+ *
+ * @return std::size_t Size of the slab in bytes.
+ */
+inline std::size_t BufferArena::getSlabSize() const { return slab_size; }
+
+/**
+ * @brief Check if the slab is backed by explicit hugepages.
+ *
+ * @return true If the slab was mapped using MAP_HUGETLB.
+ * @return false If the slab was mapped using normal pages.
+ */
+inline bool BufferArena::isHugePages() const { return huge_pages; }
+
+} // namespace accl
@@ -6,32 +6,126 @@
 
 #pragma once
 
-#include <condition_variable>
+#include "buffer.hpp"
+#include "buffer_arena.hpp"
+#include "futex_event.hpp"
+#include "ring_queue.hpp"
+#include <chrono>
+#include <cstdint>
 #include <deque>
-#include <shared_mutex>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
 namespace accl {
 
 // Inline constant to pass to pop() to allow popping all buffers
 inline constexpr size_t BUFFER_POOL_POP_ALL{0};
+// Default capacity of a buffer pool if one is not specified
+inline constexpr size_t BUFFER_POOL_DEFAULT_CAPACITY{8192};
 
-template <typename T> class BufferPool {
+/**
+ * @brief How the buffers of a pool are allocated apon construction.
+ *
+ */
+enum class BufferPoolAllocation {
+	// Each buffer is allocated individually on the heap
+	HEAP,
+	// All buffers are carved out of a single hugepage-backed BufferArena
+	ARENA,
+};
+
+/**
+ * @brief Statistics of the per-thread caches of a buffer pool.
+ *
+ */
+struct BufferPoolCacheStats {
+		// Number of pops and pushes served by a thread cache
+		uint64_t hits;
+		// Number of pops and pushes that had to go to the shared pool
+		uint64_t misses;
+		// Number of batches moved from the shared pool into a thread cache
+		uint64_t refills;
+		// Number of batches moved from a thread cache back into the shared pool
+		uint64_t spills;
+		// Number of buffers currently held in thread caches
+		size_t cached;
+};
+
+/**
+ * @brief Base class of a per-thread buffer pool cache, this allows a thread to release its caches on exit.
+ *
+ */
+class BufferPoolThreadCacheBase {
+	public:
+		BufferPoolThreadCacheBase(uint64_t pool_id) : pool_id(pool_id) {}
+		virtual ~BufferPoolThreadCacheBase() = default;
+
+		virtual void release() = 0;
+
+		// Unique ID of the pool this cache belongs to
+		const uint64_t pool_id;
+		// Set once the pool the cache belongs to has been destroyed
+		std::atomic<bool> detached{false};
+};
+
+/**
+ * @brief Thread local list of buffer pool caches, these are released back to their pools when the thread exits.
+ *
+ */
+struct BufferPoolThreadCaches {
+		std::vector<std::shared_ptr<BufferPoolThreadCacheBase>> caches;
+
+		~BufferPoolThreadCaches() {
+			for (auto &cache : caches) {
+				cache->release();
+			}
+		}
+};
+
+inline thread_local BufferPoolThreadCaches buffer_pool_thread_caches;
+
+// Next buffer pool ID, pool IDs are never reused so a thread cache can't be matched to the wrong pool
+inline std::atomic<uint64_t> buffer_pool_next_id{1};
+
+/**
+ * @brief Pool of buffers backed by a bounded lock-free ring queue.
+ *
+ * The pool never takes a lock on the hot path, threads only block on a futex when the pool is empty (consumers) or full
+ * (producers). Shared buffers can be handed back to the pool they came from once their last view is released.
+ *
+ * @tparam T Buffer class.
+ * @tparam Q Ring queue used to store the buffers, use SPSCRingQueue only if there is a single producer and single consumer.
+ */
+template <typename T, typename Q = MPMCRingQueue<std::unique_ptr<T>>> class BufferPool : public BufferReleaser {
 	public:
 		inline BufferPool(std::size_t buffer_size);
 		inline BufferPool(std::size_t buffer_size, std::size_t num_buffers);
+		inline BufferPool(std::size_t buffer_size, std::size_t num_buffers, std::size_t capacity,
+						  BufferPoolAllocation allocation = BufferPoolAllocation::HEAP);
+
+		~BufferPool();
 
-		~BufferPool() = default;
+		void setThreadCacheSize(size_t size);
 
 		std::unique_ptr<T> pop();
 		std::deque<std::unique_ptr<T>> pop(size_t count);
+		size_t pop(std::deque<std::unique_ptr<T>> &results, size_t count);
 		std::unique_ptr<T> pop_wait();
+		bool tryPop(std::unique_ptr<T> &buffer);
 
-		void push(T &buffer);
 		void push(std::unique_ptr<T> buffer);
 		void push(std::deque<std::unique_ptr<T>> &buffers);
+		void push(std::vector<std::unique_ptr<T>> &buffers);
+
+		void releaseBuffer(Buffer *buffer) override;
 
 		size_t getBufferCount() const;
+		size_t getCapacity() const;
+		BufferPoolCacheStats getCacheStats() const;
+		const BufferArena *getArena() const;
 
 		void wait(std::deque<std::unique_ptr<T>> &results);
 		std::deque<std::unique_ptr<T>> wait();
@@ -40,21 +134,72 @@ template <typename T> class BufferPool {
 		std::deque<std::unique_ptr<T>> wait_for(std::chrono::milliseconds duration);
 
 	private:
-		std::deque<std::unique_ptr<T>> pool;
+		/**
+		 * @brief Magazine of buffers owned by a single thread.
+		 *
+		 */
+		struct ThreadCache : public BufferPoolThreadCacheBase {
+				ThreadCache(BufferPool *owner) : BufferPoolThreadCacheBase(owner->pool_id), pool(owner) {
+					buffers.reserve(owner->cache_size);
+				}
+
+				void release() override;
+
+				// Protects the pool pointer when the thread exits at the same time as the pool is destroyed
+				std::mutex mtx;
+				BufferPool *pool;
+				std::vector<std::unique_ptr<T>> buffers;
+
+				// Counters are only written by the owning thread
+				std::atomic<uint64_t> hits{0};
+				std::atomic<uint64_t> misses{0};
+				std::atomic<uint64_t> refills{0};
+				std::atomic<uint64_t> spills{0};
+				std::atomic<size_t> cached{0};
+		};
+
+		// Arena our buffers were allocated from, if any
+		BufferArena *arena;
+
+		Q pool;
 		std::size_t buffer_size;
-		mutable std::shared_mutex mtx;
-		std::condition_variable_any cv;
 
-		void _pop(std::deque<std::unique_ptr<T>> &result, size_t count);
-		std::deque<std::unique_ptr<T>> _pop(size_t count);
+		// Events used to park consumers when we're empty and producers when we're full
+		FutexEvent items_event;
+		FutexEvent space_event;
+
+		// Per-thread cache, a cache size of 0 disables caching
+		const uint64_t pool_id;
+		size_t cache_size;
+		mutable std::mutex caches_mtx;
+		std::vector<std::shared_ptr<ThreadCache>> caches;
+		// Statistics of caches belonging to threads that have exited
+		BufferPoolCacheStats retired_stats;
+
+		void _checkBufferSize(const std::unique_ptr<T> &buffer) const;
+		size_t _pop(std::deque<std::unique_ptr<T>> &results, size_t count);
+		template <typename Container> void _push(Container &buffers);
+
+		ThreadCache *_getThreadCache();
+		bool _cachePop(std::unique_ptr<T> &buffer);
+		void _cachePush(std::unique_ptr<T> buffer);
+		void _spill(ThreadCache &cache, size_t count);
 };
 
+/**
+ * @brief Buffer pool which may only be used by a single producer thread and a single consumer thread.
+ *
+ * @tparam T Buffer class.
+ */
+template <typename T> using SPSCBufferPool = BufferPool<T, SPSCRingQueue<std::unique_ptr<T>>>;
+
 /**
  * @brief Construct a new Buffer Pool:: Buffer Pool object
  *
  * @param buffer_size
  */
-template <typename T> BufferPool<T>::BufferPool(std::size_t buffer_size) : buffer_size(buffer_size) {}
+template <typename T, typename Q>
+BufferPool<T, Q>::BufferPool(std::size_t buffer_size) : BufferPool(buffer_size, 0, BUFFER_POOL_DEFAULT_CAPACITY) {}
 
 /**
  * @brief Construct a new Buffer Pool< T>:: Buffer Pool object
@@ -63,45 +208,120 @@ template <typename T> BufferPool<T>::BufferPool(std::size_t buffer_size) : buffe
  * @param buffer_size Size of the buffers we'll be using.
  * @param num_buffers Number of buffers to place in the pool apon construction.
  */
-template <typename T> BufferPool<T>::BufferPool(std::size_t buffer_size, std::size_t num_buffers) : BufferPool(buffer_size) {
-	// Allocate the number of buffers specified
-	for (std::size_t i = 0; i < num_buffers; ++i) {
-		auto buffer = std::make_unique<T>(buffer_size);
-		pool.push_back(std::move(buffer));
+template <typename T, typename Q>
+BufferPool<T, Q>::BufferPool(std::size_t buffer_size, std::size_t num_buffers)
+	: BufferPool(buffer_size, num_buffers, std::max(num_buffers, BUFFER_POOL_DEFAULT_CAPACITY)) {}
+
+/**
+ * @brief Construct a new Buffer Pool< T>:: Buffer Pool object
+ *
+ * @tparam T Buffer class.
+ * @param buffer_size Size of the buffers we'll be using.
+ * @param num_buffers Number of buffers to place in the pool apon construction.
+ * @param capacity Maximum number of buffers the pool can hold, this is rounded up to a power of 2.
+ * @param allocation How the buffers are allocated, BufferPoolAllocation::ARENA requires T to have a constructor taking the
+ * buffer size and a pointer to external storage.
+ */
+template <typename T, typename Q>
+BufferPool<T, Q>::BufferPool(std::size_t buffer_size, std::size_t num_buffers, std::size_t capacity,
+							 BufferPoolAllocation allocation)
+	: arena(nullptr), pool(std::max(num_buffers, capacity)), buffer_size(buffer_size),
+	  pool_id(buffer_pool_next_id.fetch_add(1)), cache_size(0), retired_stats{} {
+	// Allocate the buffers individually if we're not using an arena
+	if (allocation == BufferPoolAllocation::HEAP || !num_buffers) {
+		for (std::size_t i = 0; i < num_buffers; ++i) {
+			auto buffer = std::make_unique<T>(buffer_size);
+			pool.tryPush(std::move(buffer));
+		}
+		return;
+	}
+
+	if constexpr (std::is_constructible_v<T, std::size_t, char *>) {
+		// Construct the buffer objects in the arena object array, each holds a reference to the arena which is released
+		// when the buffer is deleted
+		arena = BufferArena::create(sizeof(T), alignof(T), buffer_size, num_buffers);
+		for (std::size_t i = 0; i < num_buffers; ++i) {
+			arena->retain();
+			auto buffer = std::unique_ptr<T>(new (arena->getObject(i)) T(buffer_size, arena->getStorage(i)));
+			pool.tryPush(std::move(buffer));
+		}
+	} else {
+		throw std::invalid_argument("Buffer type does not support arena allocation");
 	}
 }
 
 /**
- * @brief Internal method to pop a number of buffers without locking.
+ * @brief Destroy the Buffer Pool< T>:: Buffer Pool object, detaching any thread caches still alive.
  *
  * @tparam T Buffer class.
- * @param count Number of buffers to pop.
- * @return std::deque<std::unique_ptr<T>> Buffers that were popped.
  */
-template <typename T> std::deque<std::unique_ptr<T>> BufferPool<T>::_pop(size_t count) {
-	std::deque<std::unique_ptr<T>> result;
-	_pop(result, count);
-	return result;
+template <typename T, typename Q> BufferPool<T, Q>::~BufferPool() {
+	// The arena lives on until all its buffers are deleted
+	if (arena) {
+		arena->release();
+	}
+
+	std::vector<std::shared_ptr<ThreadCache>> detach;
+	{
+		std::lock_guard<std::mutex> lock(caches_mtx);
+		detach.swap(caches);
+	}
+	// Buffers left in the caches are freed when their threads exit
+	for (auto &cache : detach) {
+		std::lock_guard<std::mutex> lock(cache->mtx);
+		cache->pool = nullptr;
+		cache->detached.store(true, std::memory_order_release);
+	}
 }
 
 /**
- * @brief Internal method to pop a number of buffers or all buffers without locking.
+ * @brief Enable per-thread caching of buffers.
+ *
+ * Each thread using the pool gets its own magazine of buffers which is refilled from and spilled to the shared pool in batches
+ * of half the cache size, so most pops and pushes never touch the shared pool. This must only be used on pools acting as free
+ * lists, as buffer order is not preserved, and must be called before the pool is shared between threads.
  *
  * @tparam T Buffer class.
- * @param result Result to place buffers in which are popped.
- * @param count Number of buffers to pop or BUFFER_POOL_POP_ALL for all of them.
+ * @param size Number of buffers each thread may cache, 0 disables caching.
  */
-template <typename T> void BufferPool<T>::_pop(std::deque<std::unique_ptr<T>> &result, size_t count) {
-	// Grab iterator on first buffer in pool
-	auto iterator = pool.begin();
+template <typename T, typename Q> void BufferPool<T, Q>::setThreadCacheSize(size_t size) {
+	if (size == 1) {
+		throw std::invalid_argument("Buffer pool thread cache size must be 0 or greater than 1");
+	}
+	cache_size = size;
+}
 
-	// We now look while count==0, or i < count, making sure we've not reached the pool end
-	for (size_t i = 0; (!count || i < count) && iterator != pool.end(); ++i, ++iterator) {
-		result.push_back(std::move(*iterator));
+/**
+ * @brief Internal method to make sure a buffer matches the pool buffer size.
+ *
+ * Views are sized to the data they reference and are allowed through, they can only be passed along pools used as queues.
+ *
+ * @tparam T Buffer class.
+ * @param buffer Buffer to check.
+ * @exception std::invalid_argument Buffer is of the wrong size.
+ */
+template <typename T, typename Q> void BufferPool<T, Q>::_checkBufferSize(const std::unique_ptr<T> &buffer) const {
+	if (buffer->getBufferSize() != buffer_size && !buffer->isView()) {
+		std::ostringstream oss;
+		oss << "Buffer is of incorrect size " << buffer->getBufferSize() << " (buffer) vs. " << buffer_size << " (pool)";
+		throw std::invalid_argument(oss.str());
 	}
+}
 
-	// Erase the buffers that we moved from the list
-	pool.erase(pool.begin(), iterator);
+/**
+ * @brief Internal method to pop a number of buffers or all buffers and wake up any blocked producers.
+ *
+ * @tparam T Buffer class.
+ * @param results Result to place buffers in which are popped.
+ * @param count Number of buffers to pop or BUFFER_POOL_POP_ALL for all of them.
+ * @return size_t Number of buffers popped.
+ */
+template <typename T, typename Q> size_t BufferPool<T, Q>::_pop(std::deque<std::unique_ptr<T>> &results, size_t count) {
+	size_t popped = pool.popBulk(results, count ? count : pool.capacity());
+	if (popped) {
+		space_event.notify_all();
+	}
+	return popped;
 }
 
 /**
@@ -110,13 +330,11 @@ template <typename T> void BufferPool<T>::_pop(std::deque<std::unique_ptr<T>> &r
  * @return std::unique_ptr<T> Buffer popped from the pool.
  * @exception std::bad_alloc No buffers were available to pop.
  */
-template <typename T> std::unique_ptr<T> BufferPool<T>::pop() {
-	std::unique_lock<std::shared_mutex> lock(mtx);
-	if (pool.empty()) {
+template <typename T, typename Q> std::unique_ptr<T> BufferPool<T, Q>::pop() {
+	std::unique_ptr<T> buffer;
+	if (!tryPop(buffer)) {
 		throw std::bad_alloc();
 	}
-	auto buffer = std::move(pool.front());
-	pool.pop_front();
 	return buffer;
 }
 
@@ -126,69 +344,150 @@ template <typename T> std::unique_ptr<T> BufferPool<T>::pop() {
  * @param count Number of buffers to pop from pool, using a count of `accl::BUFFER_POOL_POP_ALL` will pop all buffers.
  * @return std::deque<std::unique_ptr<T>> Vector of popped buffers.
  */
-template <typename T> std::deque<std::unique_ptr<T>> BufferPool<T>::pop(size_t count) {
-	std::unique_lock<std::shared_mutex> lock(mtx);
-	return _pop(count);
+template <typename T, typename Q> std::deque<std::unique_ptr<T>> BufferPool<T, Q>::pop(size_t count) {
+	std::deque<std::unique_ptr<T>> results;
+	_pop(results, count);
+	return results;
+}
+
+/**
+ * @brief Pop buffers from the pool without waiting, adding them to an existing list.
+ *
+ * @param results List to add the popped buffers to.
+ * @param count Number of buffers to pop from pool, using a count of `accl::BUFFER_POOL_POP_ALL` will pop all buffers.
+ * @return size_t Number of buffers popped.
+ */
+template <typename T, typename Q> size_t BufferPool<T, Q>::pop(std::deque<std::unique_ptr<T>> &results, size_t count) {
+	return _pop(results, count);
+}
+
+/**
+ * @brief Try pop a single buffer from the pool without waiting.
+ *
+ * @param buffer Buffer popped from the pool.
+ * @return true A buffer was popped.
+ * @return false No buffers were available to pop.
+ */
+template <typename T, typename Q> bool BufferPool<T, Q>::tryPop(std::unique_ptr<T> &buffer) {
+	if (cache_size) {
+		return _cachePop(buffer);
+	}
+	if (!pool.tryPop(buffer)) {
+		return false;
+	}
+	space_event.notify_all();
+	return true;
 }
 
 /**
  * @brief Pop a single buffer from the pool, waiting if there are none available.
  *
  * @return std::unique_ptr<T> Buffer popped from the pool.
- * @exception std::bad_alloc No buffers were available to pop.
  */
-template <typename T> std::unique_ptr<T> BufferPool<T>::pop_wait() {
-	std::unique_lock<std::shared_mutex> lock(mtx);
-	// We only need to wait if the pool is empty
-	if (pool.empty())
-		cv.wait(lock);
-	auto buffer = std::move(pool.front());
-	pool.pop_front();
+template <typename T, typename Q> std::unique_ptr<T> BufferPool<T, Q>::pop_wait() {
+	std::unique_ptr<T> buffer;
+	if (cache_size && _cachePop(buffer)) {
+		return buffer;
+	}
+	while (!pool.tryPop(buffer)) {
+		// Register as a waiter and check again so we don't miss a push that happened in between
+		uint32_t seq = items_event.prepareWait();
+		if (pool.tryPop(buffer)) {
+			items_event.cancelWait();
+			break;
+		}
+		items_event.wait(seq, std::chrono::nanoseconds::zero());
+	}
+	space_event.notify_all();
 	return buffer;
 }
 
 /**
- * @brief Push a buffer into the pool
+ * @brief Push a buffer into the pool, waiting for space if the pool is full.
  *
  * @tparam T Buffer class.
  * @param buffer Buffer to push into the pool.
  */
-template <typename T> void BufferPool<T>::push(std::unique_ptr<T> buffer) {
+template <typename T, typename Q> void BufferPool<T, Q>::push(std::unique_ptr<T> buffer) {
 	// Make sure buffer size matches
-	if (buffer->getBufferSize() != buffer_size) {
-		std::ostringstream oss;
-		oss << "Buffer is of incorrect size " << buffer->getBufferSize() << " (buffer) vs. " << buffer_size << " (pool)";
-		throw std::invalid_argument(oss.str());
+	_checkBufferSize(buffer);
+
+	if (cache_size) {
+		_cachePush(std::move(buffer));
+		return;
+	}
+
+	while (!pool.tryPush(std::move(buffer))) {
+		uint32_t seq = space_event.prepareWait();
+		if (pool.tryPush(std::move(buffer))) {
+			space_event.cancelWait();
+			break;
+		}
+		space_event.wait(seq, std::chrono::nanoseconds::zero());
 	}
-	std::unique_lock<std::shared_mutex> lock(mtx);
-	pool.push_back(std::move(buffer));
 
-	cv.notify_one(); // Notify listener thread
+	items_event.notify_one(); // Notify listener thread
 }
 
 /**
- * @brief Push a number of buffers into the pool.
+ * @brief Push a number of buffers into the pool, waiting for space if the pool is full.
  *
  * @tparam T Buffer class.
  * @param buffers Buffers to push into the pool.
  */
-template <typename T> void BufferPool<T>::push(std::deque<std::unique_ptr<T>> &buffers) {
-	// We can check all the buffers before doing the lock to save on how long we hold the lock
+template <typename T, typename Q> void BufferPool<T, Q>::push(std::deque<std::unique_ptr<T>> &buffers) {
+	_push(buffers);
+}
+
+/**
+ * @brief Push a number of buffers into the pool, waiting for space if the pool is full.
+ *
+ * The vector keeps its capacity once the buffers are pushed, so it can be reused for the next batch without allocating.
+ *
+ * @tparam T Buffer class.
+ * @param buffers Buffers to push into the pool.
+ */
+template <typename T, typename Q> void BufferPool<T, Q>::push(std::vector<std::unique_ptr<T>> &buffers) {
+	_push(buffers);
+}
+
+/**
+ * @brief Internal method to push a number of buffers into the pool, waiting for space if the pool is full.
+ *
+ * @tparam Container Container type supporting begin(), erase() and empty().
+ * @param buffers Buffers to push into the pool, these are erased from the container.
+ */
+template <typename T, typename Q> template <typename Container> void BufferPool<T, Q>::_push(Container &buffers) {
+	// We can check all the buffers before pushing so we don't end up with a partial push
 	for (auto &buffer : buffers) {
-		// Make sure buffer size matches
-		if (buffer->getBufferSize() != buffer_size) {
-			std::ostringstream oss;
-			oss << "Buffer is of incorect size " << buffer->getBufferSize() << " vs. " << buffer_size;
-			throw std::invalid_argument(oss.str());
+		_checkBufferSize(buffer);
+	}
+
+	// Move all buffers into the pool in as few goes as possible, waking up listeners once per batch
+	while (!buffers.empty()) {
+		if (pool.pushBulk(buffers)) {
+			items_event.notify_one(); // Notify listener thread
+			continue;
+		}
+		uint32_t seq = space_event.prepareWait();
+		if (pool.pushBulk(buffers)) {
+			space_event.cancelWait();
+			items_event.notify_one();
+			continue;
 		}
+		space_event.wait(seq, std::chrono::nanoseconds::zero());
 	}
-	// Lock the pool
-	std::unique_lock<std::shared_mutex> lock(mtx);
-	// Move all buffers into the pool in one go
-	std::move(buffers.begin(), buffers.end(), std::back_inserter(pool));
-	// Clear the old buffer list
-	buffers.clear();
-	cv.notify_one(); // Notify listener threa
+}
+
+/**
+ * @brief Push a shared buffer back into the pool once the last view of it is released, the buffer is cleared.
+ *
+ * @tparam T Buffer class.
+ * @param buffer Buffer to push into the pool, this must be a T.
+ */
+template <typename T, typename Q> void BufferPool<T, Q>::releaseBuffer(Buffer *buffer) {
+	buffer->clear();
+	push(std::unique_ptr<T>(static_cast<T *>(buffer)));
 }
 
 /**
@@ -197,9 +496,41 @@ template <typename T> void BufferPool<T>::push(std::deque<std::unique_ptr<T>> &b
  * @tparam T Buffer class.
  * @return size_t Number of buffers in the pool.
  */
-template <typename T> size_t BufferPool<T>::getBufferCount() const {
-	std::shared_lock<std::shared_mutex> lock(mtx);
-	return pool.size();
+template <typename T, typename Q> size_t BufferPool<T, Q>::getBufferCount() const { return pool.size(); }
+
+/**
+ * @brief Get the maximum number of buffers the pool can hold.
+ *
+ * @tparam T Buffer class.
+ * @return size_t Capacity of the pool.
+ */
+template <typename T, typename Q> size_t BufferPool<T, Q>::getCapacity() const { return pool.capacity(); }
+
+/**
+ * @brief Get the arena the pool buffers were allocated from.
+ *
+ * @tparam T Buffer class.
+ * @return const BufferArena* Arena or nullptr if the buffers were allocated on the heap.
+ */
+template <typename T, typename Q> const BufferArena *BufferPool<T, Q>::getArena() const { return arena; }
+
+/**
+ * @brief Get the statistics of the per-thread caches.
+ *
+ * @tparam T Buffer class.
+ * @return BufferPoolCacheStats Cache statistics, including those of threads that have exited.
+ */
+template <typename T, typename Q> BufferPoolCacheStats BufferPool<T, Q>::getCacheStats() const {
+	std::lock_guard<std::mutex> lock(caches_mtx);
+	BufferPoolCacheStats stats = retired_stats;
+	for (auto &cache : caches) {
+		stats.hits += cache->hits.load(std::memory_order_relaxed);
+		stats.misses += cache->misses.load(std::memory_order_relaxed);
+		stats.refills += cache->refills.load(std::memory_order_relaxed);
+		stats.spills += cache->spills.load(std::memory_order_relaxed);
+		stats.cached += cache->cached.load(std::memory_order_relaxed);
+	}
+	return stats;
 }
 
 /**
@@ -208,12 +539,8 @@ template <typename T> size_t BufferPool<T>::getBufferCount() const {
  * @tparam T Buffer class.
  * @param results Resuts list to push buffers into.
  */
-template <typename T> void BufferPool<T>::wait(std::deque<std::unique_ptr<T>> &results) {
-	std::unique_lock<std::shared_mutex> lock(mtx);
-	// We only really need to wait if the pool is empty
-	if (pool.empty())
-		cv.wait(lock);
-	_pop(results, BUFFER_POOL_POP_ALL);
+template <typename T, typename Q> void BufferPool<T, Q>::wait(std::deque<std::unique_ptr<T>> &results) {
+	wait_for(std::chrono::milliseconds::zero(), results);
 }
 
 /**
@@ -222,7 +549,7 @@ template <typename T> void BufferPool<T>::wait(std::deque<std::unique_ptr<T>> &r
  * @tparam T Buffer class.
  * @return std::deque<std::unique_ptr<T>>
  */
-template <typename T> std::deque<std::unique_ptr<T>> BufferPool<T>::wait() {
+template <typename T, typename Q> std::deque<std::unique_ptr<T>> BufferPool<T, Q>::wait() {
 	std::deque<std::unique_ptr<T>> results;
 	wait(results);
 	return results;
@@ -232,34 +559,45 @@ template <typename T> std::deque<std::unique_ptr<T>> BufferPool<T>::wait() {
  * @brief Wait for a duration and push the buffers into a results list.
  *
  * @tparam T Buffer class.
- * @param duration Duration in milliseconds to wait.
+ * @param duration Duration in milliseconds to wait, a zero duration will wait indefinitely.
  * @param results Results list.
  * @return true If we got buffers.
  * @return false If we timed out.
  */
-template <typename T> bool BufferPool<T>::wait_for(std::chrono::milliseconds duration, std::deque<std::unique_ptr<T>> &results) {
-	std::unique_lock<std::shared_mutex> lock(mtx);
-
+template <typename T, typename Q>
+bool BufferPool<T, Q>::wait_for(std::chrono::milliseconds duration, std::deque<std::unique_ptr<T>> &results) {
 	// If we have items we don't have to wait
-	if (!pool.empty()) {
-		_pop(results, BUFFER_POOL_POP_ALL);
+	if (_pop(results, BUFFER_POOL_POP_ALL)) {
 		return true;
 	}
 
-	// If we have a zero tick count, wait indefinitely
-	if (!duration.count()) {
-		cv.wait(lock);
-		_pop(results, BUFFER_POOL_POP_ALL);
-		return true;
-	}
+	auto deadline = std::chrono::steady_clock::now() + duration;
+	while (true) {
+		// Register as a waiter and check again so we don't miss a push that happened in between
+		uint32_t seq = items_event.prepareWait();
+		if (_pop(results, BUFFER_POOL_POP_ALL)) {
+			items_event.cancelWait();
+			return true;
+		}
 
-	// Wait for a duration
-	if (cv.wait_for(lock, duration) == std::cv_status::no_timeout) {
-		_pop(results, BUFFER_POOL_POP_ALL);
-		return true;
-	}
+		// If we have a zero tick count, wait indefinitely
+		std::chrono::nanoseconds remaining = std::chrono::nanoseconds::zero();
+		if (duration.count()) {
+			remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining.count() <= 0) {
+				items_event.cancelWait();
+				return false;
+			}
+		}
 
-	return false;
+		bool woken = items_event.wait(seq, remaining);
+		if (_pop(results, BUFFER_POOL_POP_ALL)) {
+			return true;
+		}
+		if (!woken) {
+			return false;
+		}
+	}
 }
 
 /**
@@ -269,10 +607,150 @@ template <typename T> bool BufferPool<T>::wait_for(std::chrono::milliseconds dur
  * @param duration Duration to wait in milliseconds.
  * @return std::deque<std::unique_ptr<T>> List of buffers returned.
  */
-template <typename T> std::deque<std::unique_ptr<T>> BufferPool<T>::wait_for(std::chrono::milliseconds duration) {
+template <typename T, typename Q> std::deque<std::unique_ptr<T>> BufferPool<T, Q>::wait_for(std::chrono::milliseconds duration) {
 	std::deque<std::unique_ptr<T>> results;
 	wait_for(duration, results);
 	return results;
 }
 
+/**
+ * @brief Release a thread cache back to its pool, this is called when the owning thread exits.
+ *
+ * @tparam T Buffer class.
+ */
+template <typename T, typename Q> void BufferPool<T, Q>::ThreadCache::release() {
+	std::lock_guard<std::mutex> lock(mtx);
+
+	// If the pool is gone, our buffers are simply freed
+	if (!pool) {
+		buffers.clear();
+		return;
+	}
+
+	pool->_spill(*this, buffers.size());
+
+	// Fold our statistics into the pool and remove ourselves from it
+	std::lock_guard<std::mutex> caches_lock(pool->caches_mtx);
+	pool->retired_stats.hits += hits.load(std::memory_order_relaxed);
+	pool->retired_stats.misses += misses.load(std::memory_order_relaxed);
+	pool->retired_stats.refills += refills.load(std::memory_order_relaxed);
+	pool->retired_stats.spills += spills.load(std::memory_order_relaxed);
+	std::erase_if(pool->caches, [this](const std::shared_ptr<ThreadCache> &cache) { return cache.get() == this; });
+	pool = nullptr;
+}
+
+/**
+ * @brief Internal method to get the cache of the calling thread, creating it if need be.
+ *
+ * @tparam T Buffer class.
+ * @return ThreadCache* Cache of the calling thread.
+ */
+template <typename T, typename Q> typename BufferPool<T, Q>::ThreadCache *BufferPool<T, Q>::_getThreadCache() {
+	auto &thread_caches = buffer_pool_thread_caches.caches;
+
+	for (auto &cache : thread_caches) {
+		if (cache->pool_id == pool_id) {
+			return static_cast<ThreadCache *>(cache.get());
+		}
+	}
+
+	// Drop caches of pools that have been destroyed before we add a new one
+	std::erase_if(thread_caches, [](const std::shared_ptr<BufferPoolThreadCacheBase> &cache) {
+		return cache->detached.load(std::memory_order_acquire);
+	});
+
+	auto cache = std::make_shared<ThreadCache>(this);
+	{
+		std::lock_guard<std::mutex> lock(caches_mtx);
+		caches.push_back(cache);
+	}
+	thread_caches.push_back(cache);
+
+	return cache.get();
+}
+
+/**
+ * @brief Internal method to pop a buffer using the thread cache, refilling the cache from the shared pool if its empty.
+ *
+ * @tparam T Buffer class.
+ * @param buffer Buffer popped.
+ * @return true If we got a buffer.
+ * @return false If both the cache and the shared pool are empty.
+ */
+template <typename T, typename Q> bool BufferPool<T, Q>::_cachePop(std::unique_ptr<T> &buffer) {
+	ThreadCache *cache = _getThreadCache();
+
+	if (cache->buffers.empty()) {
+		cache->misses.fetch_add(1, std::memory_order_relaxed);
+		if (!pool.popBulk(cache->buffers, cache_size / 2)) {
+			return false;
+		}
+		cache->refills.fetch_add(1, std::memory_order_relaxed);
+		space_event.notify_all();
+	} else {
+		cache->hits.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	buffer = std::move(cache->buffers.back());
+	cache->buffers.pop_back();
+	cache->cached.store(cache->buffers.size(), std::memory_order_relaxed);
+	return true;
+}
+
+/**
+ * @brief Internal method to push a buffer using the thread cache, spilling half the cache to the shared pool if its full.
+ *
+ * @tparam T Buffer class.
+ * @param buffer Buffer to push.
+ */
+template <typename T, typename Q> void BufferPool<T, Q>::_cachePush(std::unique_ptr<T> buffer) {
+	ThreadCache *cache = _getThreadCache();
+
+	if (cache->buffers.size() == cache_size) {
+		cache->misses.fetch_add(1, std::memory_order_relaxed);
+		cache->spills.fetch_add(1, std::memory_order_relaxed);
+		_spill(*cache, cache_size / 2);
+	} else {
+		cache->hits.fetch_add(1, std::memory_order_relaxed);
+	}
+	cache->buffers.push_back(std::move(buffer));
+
+	// If there are threads waiting on the shared pool, don't hold onto buffers they need
+	if (items_event.hasWaiters()) {
+		_spill(*cache, cache->buffers.size());
+	}
+
+	cache->cached.store(cache->buffers.size(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Internal method to move buffers from a thread cache into the shared pool, waiting for space if need be.
+ *
+ * @tparam T Buffer class.
+ * @param cache Cache to take the buffers from.
+ * @param count Number of buffers to move.
+ */
+template <typename T, typename Q> void BufferPool<T, Q>::_spill(ThreadCache &cache, size_t count) {
+	for (size_t i = 0; i < count;) {
+		if (pool.tryPush(std::move(cache.buffers.back()))) {
+			cache.buffers.pop_back();
+			++i;
+			continue;
+		}
+		uint32_t seq = space_event.prepareWait();
+		if (pool.tryPush(std::move(cache.buffers.back()))) {
+			space_event.cancelWait();
+			cache.buffers.pop_back();
+			++i;
+			continue;
+		}
+		// Let the consumers know about what we pushed so far before we wait for space
+		items_event.notify_all();
+		space_event.wait(seq, std::chrono::nanoseconds::zero());
+	}
+	if (count) {
+		items_event.notify_all();
+	}
+}
+
 } // namespace accl
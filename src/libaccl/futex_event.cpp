@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "futex_event.hpp"
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace accl {
+
+FutexEvent::FutexEvent() : sequence(0), waiters(0) {}
+
+/**
+ * @brief Internal method to bump the sequence and wake up waiters.
+ *
+ * @param count Number of waiters to wake up.
+ */
+void FutexEvent::_wake(int count) {
+	sequence.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(&sequence), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+/**
+ * @brief Wait for the event to be notified.
+ *
+ * @param seq Sequence returned by prepareWait().
+ * @param duration Maximum duration to wait for, a zero duration waits indefinitely.
+ * @return true If we were woken up or the sequence already changed.
+ * @return false If we timed out.
+ */
+bool FutexEvent::wait(uint32_t seq, std::chrono::nanoseconds duration) {
+	struct timespec timeout;
+	struct timespec *timeout_ptr = nullptr;
+
+	if (duration.count() > 0) {
+		auto secs = std::chrono::duration_cast<std::chrono::seconds>(duration);
+		timeout.tv_sec = secs.count();
+		timeout.tv_nsec = (duration - secs).count();
+		timeout_ptr = &timeout;
+	}
+
+	long res = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&sequence), FUTEX_WAIT_PRIVATE, seq, timeout_ptr, nullptr, 0);
+	int err = errno;
+
+	waiters.fetch_sub(1, std::memory_order_relaxed);
+
+	return !(res == -1 && err == ETIMEDOUT);
+}
+
+} // namespace accl
@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace accl {
+
+/**
+ * @brief Lightweight event used to park threads on a futex.
+ *
+ * Waiters take a snapshot of the event sequence using prepareWait(), re-check their condition and then call wait() with the
+ * snapshot. Notifiers bump the sequence and only issue a syscall if there are threads actually waiting, which keeps the
+ * uncontended notify path free of syscalls.
+ */
+class FutexEvent {
+	private:
+		std::atomic<uint32_t> sequence;
+		std::atomic<uint32_t> waiters;
+
+		void _wake(int count);
+
+	public:
+		FutexEvent();
+
+		inline uint32_t prepareWait();
+		inline void cancelWait();
+		inline bool hasWaiters() const;
+		bool wait(uint32_t seq, std::chrono::nanoseconds duration);
+
+		inline void notify_one();
+		inline void notify_all();
+};
+
+/**
+ * @brief Register as a waiter and return the current event sequence.
+ *
+ * @return uint32_t Sequence to pass to wait().
+ */
+inline uint32_t FutexEvent::prepareWait() {
+	waiters.fetch_add(1, std::memory_order_seq_cst);
+	return sequence.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Cancel a wait that was prepared using prepareWait() but will not be carried out.
+ *
+ */
+inline void FutexEvent::cancelWait() { waiters.fetch_sub(1, std::memory_order_relaxed); }
+
+/**
+ * @brief Check if there are any threads waiting on the event.
+ *
+ * @return true If there are threads waiting.
+ * @return false If there are no threads waiting.
+ */
+inline bool FutexEvent::hasWaiters() const { return waiters.load(std::memory_order_relaxed); }
+
+/**
+ * @brief Wake up a single waiter, if there are any.
+ *
+ */
+inline void FutexEvent::notify_one() {
+	// Pairs with the seq_cst increment of waiters in prepareWait()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiters.load(std::memory_order_relaxed)) {
+		_wake(1);
+	}
+}
+
+/**
+ * @brief Wake up all waiters, if there are any.
+ *
+ */
+inline void FutexEvent::notify_all() {
+	// Pairs with the seq_cst increment of waiters in prepareWait()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiters.load(std::memory_order_relaxed)) {
+		_wake(INT32_MAX);
+	}
+}
+
+} // namespace accl
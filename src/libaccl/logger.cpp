@@ -5,8 +5,11 @@
  */
 
 #include "logger.hpp"
+#include <algorithm>
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 namespace accl {
 
@@ -47,43 +50,213 @@ std::string Logger::_logLevelToString(const LogLevel level) const {
 }
 
 /**
- * @brief Internal method that does most of the logging.
+ * @brief Construct a new LogRecordStream object.
+ *
+ */
+LogRecordStream::LogRecordStream() : std::ostream(&buffer) {}
+
+/**
+ * @brief Begin a new log record, the log line is then written to the stream.
  *
  * @param level Log level.
  * @param file File name that the log method is called from.
  * @param func Function or method that the log method is called from.
  * @param line Line number from where the log method is called.
- * @param logline The line to log.
+ * @param suppressed Number of messages from the same call site suppressed by rate limiting before this one.
+ */
+void LogRecordStream::begin(const LogLevel level, const char *file, const char *func, const unsigned int line,
+							const uint32_t suppressed) {
+	record.level = level;
+	record.file = file;
+	record.func = func;
+	record.line = line;
+	record.time = std::chrono::system_clock::now();
+	record.suppressed = suppressed;
+
+	// Reset any formatting the last log line left behind
+	buffer.reset(record.text, sizeof(record.text));
+	clear();
+	flags(std::ios_base::dec | std::ios_base::skipws);
+	precision(6);
+	width(0);
+	fill(' ');
+}
+
+/**
+ * @brief Finish the log record.
+ *
+ * @return LogRecord& Log record.
+ */
+LogRecord &LogRecordStream::finish() {
+	record.truncated = buffer.overflowed;
+	record.length = buffer.size();
+	return record;
+}
+
+/**
+ * @brief Construct a new LogThreadQueue object.
+ *
+ */
+LogThreadQueue::LogThreadQueue() : records(LOG_THREAD_QUEUE_SIZE), dropped(0), exited(false) {}
+
+/**
+ * @brief Holder of the queue of the current thread, which flags the queue when the thread exits.
+ *
+ */
+struct LogThreadQueueHolder {
+		std::shared_ptr<LogThreadQueue> queue;
+
+		~LogThreadQueueHolder() {
+			if (queue) {
+				queue->exited.store(true, std::memory_order_release);
+			}
+		}
+};
+
+// Log record stream and log queue of the current thread
+static thread_local LogRecordStream thread_stream;
+static thread_local LogThreadQueueHolder thread_queue_holder;
+
+/**
+ * @brief Internal method to get the log record stream of the current thread.
+ *
+ * @return LogRecordStream& Log record stream of the current thread.
+ */
+LogRecordStream &Logger::_getThreadStream() { return thread_stream; }
+
+/**
+ * @brief Internal method to get the queue of the current thread, registering it with the logger thread the first time.
+ *
+ * @return LogThreadQueue& Queue of the current thread.
+ */
+LogThreadQueue &Logger::_getThreadQueue() {
+	if (!thread_queue_holder.queue) {
+		auto queue = std::make_shared<LogThreadQueue>();
+		std::lock_guard<std::mutex> lock(queues_mutex);
+		queues.push_back(queue);
+		thread_queue_holder.queue = queue;
+	}
+	return *thread_queue_holder.queue;
+}
+
+/**
+ * @brief Internal method to log a record, it is queued for the logger thread if it is running.
+ *
+ * @param record Log record.
+ */
+void Logger::_log(LogRecord &record) {
+	if (!async.load(std::memory_order_acquire)) {
+		_write(record);
+		return;
+	}
+
+	// Check again once we're counted as a producer, either stop() sees us and waits for the push, or we see it is stopping
+	producers.fetch_add(1, std::memory_order_seq_cst);
+	if (!async.load(std::memory_order_seq_cst)) {
+		producers.fetch_sub(1, std::memory_order_release);
+		_write(record);
+		return;
+	}
+
+	LogThreadQueue &queue = _getThreadQueue();
+	if (!queue.records.tryPush(std::move(record))) {
+		queue.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	producers.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+ * @brief Internal method to write a log record.
+ *
+ * @param record Log record.
+ */
+void Logger::_write(const LogRecord &record) {
+	std::ostringstream stream;
+
+	// Output time
+	if (log_time) {
+		auto time = std::chrono::system_clock::to_time_t(record.time);
+		std::tm utc_tm;
+		gmtime_r(&time, &utc_tm);
+		stream << std::put_time(&utc_tm, "%Y-%m-%d %H:%M:%S ");
+	}
+	// Output log level
+	std::string levelStr = _logLevelToString(record.level);
+	stream << std::setfill(' ') << "[" << levelStr << std::setw(7 - levelStr.size()) << ""
+		   << "] ";
+	// If we're debugging output the func, file and line
+	if (log_level == LogLevel::DEBUGGING) {
+		stream << "(" << record.func << ":" << record.file << ":" << record.line << ") ";
+	}
+	stream.write(record.text, record.length);
+	if (record.truncated) {
+		stream << "...";
+	}
+	if (record.suppressed) {
+		stream << " (" << record.suppressed << " similar messages suppressed)";
+	}
+	// Log mutex
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::cerr << stream.str() << std::endl;
+}
+
+/**
+ * @brief Internal method to write all the queued log records, queues of threads that have exited are removed once empty.
+ *
+ * @return size_t Number of log records written.
  */
-void Logger::_log(const LogLevel level, const std::string file, const std::string func, const unsigned int line,
-				  std::string logline) {
-	if (level >= log_level) {
-		std::ostringstream stream;
+size_t Logger::_drain() {
+	std::lock_guard<std::mutex> lock(queues_mutex);
+
+	size_t count = 0;
+	LogRecord record;
+	for (auto it = queues.begin(); it != queues.end();) {
+		LogThreadQueue &queue = **it;
+		bool exited = queue.exited.load(std::memory_order_acquire);
 
-		// Grab current time
-		auto now_utc = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-		std::tm *utc_tm = std::gmtime(&now_utc);
+		while (queue.records.tryPop(record)) {
+			_write(record);
+			++count;
+		}
+
+		uint64_t dropped = queue.dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped) {
+			LogRecordStream &stream = _getThreadStream();
+			stream.begin(LogLevel::WARNING, __FILE__, __func__, __LINE__, 0);
+			stream << "Dropped " << dropped << " log messages, the log queue of a thread was full";
+			_write(stream.finish());
+			++count;
+		}
+
+		if (exited) {
+			it = queues.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	return count;
+}
 
-		// Output time
-		if (log_time) {
-			stream << std::put_time(utc_tm, "%Y-%m-%d %H:%M:%S ");
+/**
+ * @brief Internal method run by the logger thread.
+ *
+ */
+void Logger::_threadHandler() {
+	while (!stopping.load(std::memory_order_acquire)) {
+		if (_drain()) {
+			continue;
 		}
-		// Output log level
-		std::string levelStr = _logLevelToString(level);
-		stream << std::setfill(' ') << "[" << levelStr << std::setw(7 - levelStr.size()) << ""
-			   << "] ";
-		// If we're debugging output the func, file and line
-		if (log_level == LogLevel::DEBUGGING) {
-			stream << "(" << func << ":" << file << ":" << line << ") ";
+		uint32_t seq = stop_event.prepareWait();
+		if (stopping.load(std::memory_order_seq_cst)) {
+			stop_event.cancelWait();
+			break;
 		}
-		stream << logline;
-		// Log mutex
-		std::lock_guard<std::mutex> lock(mutex_);
-		std::cerr << stream.str() << std::endl;
+		stop_event.wait(seq, LOG_THREAD_POLL_INTERVAL);
 	}
 }
 
-Logger::Logger() {
+Logger::Logger() : async(false), stopping(false), producers(0) {
 #if defined(DEBUG)
 	log_level_default = LogLevel::DEBUGGING;
 #else
@@ -98,6 +271,48 @@ Logger::Logger() {
 	}
 }
 
+/**
+ * @brief Destroy the Logger object, stopping the logger thread if it is running.
+ *
+ */
+Logger::~Logger() { stop(); }
+
+/**
+ * @brief Start the logger thread, from now on threads queue their log records for it instead of writing them.
+ *
+ */
+void Logger::start() {
+	if (thread) {
+		return;
+	}
+	stopping.store(false, std::memory_order_seq_cst);
+	thread = std::make_unique<std::thread>(&Logger::_threadHandler, this);
+	async.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Stop the logger thread once it has written all queued log records, from now on log records are written straight away.
+ *
+ */
+void Logger::stop() {
+	if (!thread) {
+		return;
+	}
+	async.store(false, std::memory_order_seq_cst);
+	stopping.store(true, std::memory_order_seq_cst);
+	stop_event.notify_all();
+	thread->join();
+	thread.reset();
+
+	// Wait for threads which were already pushing a log record when we stopped
+	while (producers.load(std::memory_order_seq_cst)) {
+		std::this_thread::yield();
+	}
+
+	// Write anything queued while the logger thread was exiting
+	_drain();
+}
+
 /**
  * @brief Set logging level.
  *
@@ -6,10 +6,24 @@
 
 #pragma once
 
+#include "futex_event.hpp"
+#include "ring_queue.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <sstream>
+#include <ostream>
+#include <streambuf>
 #include <string>
+#include <thread>
+#include <vector>
+
+// Minimum log level compiled in, logging below this level is removed at compile time no matter what the log level is set to
+#ifndef ACCL_LOG_MIN_LEVEL
+#define ACCL_LOG_MIN_LEVEL 1
+#endif
 
 namespace accl {
 
@@ -17,6 +31,182 @@ enum class LogLevel { DEBUGGING = 1, INFO = 2, NOTICE = 3, WARNING = 4, ERROR =
 
 extern std::map<std::string, LogLevel> logLevelMap;
 
+// Minimum log level compiled in
+inline constexpr LogLevel LOG_LEVEL_MIN{static_cast<LogLevel>(ACCL_LOG_MIN_LEVEL)};
+
+// Size of the text of a log record, longer log lines are truncated
+inline constexpr size_t LOG_RECORD_TEXT_SIZE{512};
+// Number of log records each thread can have queued for the logger thread, records logged while the queue is full are dropped
+inline constexpr size_t LOG_THREAD_QUEUE_SIZE{256};
+// How often the logger thread checks the thread queues for log records
+inline constexpr std::chrono::milliseconds LOG_THREAD_POLL_INTERVAL{10};
+
+// Number of messages each call site can log per interval, messages over this are suppressed and counted
+inline constexpr uint32_t LOG_RATE_LIMIT_BURST{10};
+inline constexpr std::chrono::seconds LOG_RATE_LIMIT_INTERVAL{1};
+
+/**
+ * @brief Log line along with where and when it was logged.
+ *
+ */
+struct LogRecord {
+		LogLevel level;
+		const char *file;
+		const char *func;
+		unsigned int line;
+		std::chrono::system_clock::time_point time;
+		// Number of messages from the same call site suppressed by rate limiting before this one
+		uint32_t suppressed;
+		// Set if the text did not fit and was truncated
+		bool truncated;
+		size_t length;
+		char text[LOG_RECORD_TEXT_SIZE];
+};
+
+/**
+ * @brief Output stream formatting a log line straight into a log record, so no memory is allocated.
+ *
+ */
+class LogRecordStream : public std::ostream {
+	private:
+		class Buffer : public std::streambuf {
+			public:
+				bool overflowed;
+
+				inline void reset(char *data, size_t size);
+				inline size_t size() const;
+
+			protected:
+				inline int_type overflow(int_type ch) override;
+		};
+
+		Buffer buffer;
+
+	public:
+		LogRecord record;
+
+		LogRecordStream();
+
+		void begin(const LogLevel level, const char *file, const char *func, const unsigned int line, const uint32_t suppressed);
+		LogRecord &finish();
+};
+
+/**
+ * @brief Reset the buffer to write to the given memory.
+ *
+ * @param data Memory to write to.
+ * @param size Size of the memory.
+ */
+inline void LogRecordStream::Buffer::reset(char *data, size_t size) {
+	overflowed = false;
+	setp(data, data + size);
+}
+
+/**
+ * @brief Get the number of characters written to the buffer.
+ *
+ * @return size_t Number of characters written.
+ */
+inline size_t LogRecordStream::Buffer::size() const { return pptr() - pbase(); }
+
+/**
+ * @brief Called when the buffer is full, the character is dropped and the stream stops accepting output.
+ *
+ * @param ch Character that did not fit.
+ * @return int_type End of file to indicate failure.
+ */
+inline LogRecordStream::Buffer::int_type LogRecordStream::Buffer::overflow(int_type ch) {
+	if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+		overflowed = true;
+	}
+	return traits_type::eof();
+}
+
+/**
+ * @brief Rate limiter for a log call site.
+ *
+ * Each call site gets its own rate limiter, which allows a burst of messages per interval. Messages over the burst are
+ * suppressed and counted, the count is reported along with the first message allowed in a later interval. All state is kept
+ * in atomics so call sites can be shared between threads without taking a lock.
+ */
+class LogRateLimiter {
+	private:
+		const uint32_t burst;
+		const int64_t interval;
+
+		// Start of the current interval in steady clock ticks
+		std::atomic<int64_t> interval_start;
+		std::atomic<uint32_t> count;
+		std::atomic<uint32_t> suppressed;
+
+	public:
+		/**
+		 * @brief Construct a new LogRateLimiter object.
+		 *
+		 * @param burst Number of messages allowed per interval, 0 allows all messages.
+		 * @param interval Length of the interval.
+		 */
+		constexpr LogRateLimiter(uint32_t burst = LOG_RATE_LIMIT_BURST,
+								 std::chrono::steady_clock::duration interval = LOG_RATE_LIMIT_INTERVAL)
+			: burst(burst), interval(interval.count()), interval_start(0), count(0), suppressed(0) {}
+
+		inline bool allow(uint32_t &suppressed_count);
+};
+
+/**
+ * @brief Check if a message may be logged.
+ *
+ * @param suppressed_count Set to the number of messages suppressed since the last message allowed.
+ * @return true If the message may be logged.
+ * @return false If the message is suppressed.
+ */
+inline bool LogRateLimiter::allow(uint32_t &suppressed_count) {
+	suppressed_count = 0;
+	if (!burst) {
+		return true;
+	}
+
+	// Start a new interval if the current one is over, only the thread which starts it picks up the suppressed count
+	int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+	int64_t start = interval_start.load(std::memory_order_relaxed);
+	if (now - start >= interval && interval_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+		count.store(0, std::memory_order_relaxed);
+		suppressed_count = suppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+	if (count.fetch_add(1, std::memory_order_relaxed) < burst) {
+		return true;
+	}
+	// Hand back the count we picked up, so it is reported with the next message allowed
+	suppressed.fetch_add(suppressed_count + 1, std::memory_order_relaxed);
+	suppressed_count = 0;
+	return false;
+}
+
+/**
+ * @brief Queue of the log records of a thread, only that thread pushes to it and only the logger thread pops from it.
+ *
+ */
+struct LogThreadQueue {
+		LogThreadQueue();
+
+		SPSCRingQueue<LogRecord> records;
+		// Number of records dropped because the queue was full
+		std::atomic<uint64_t> dropped;
+		// Set once the thread has exited, the queue is removed once it is empty
+		std::atomic<bool> exited;
+};
+
+/**
+ * @brief Get the number of messages per interval a call site can log at a log level.
+ *
+ * @param level Log level.
+ * @return uint32_t Number of messages per interval, 0 if not rate limited as we want to see all debug logging.
+ */
+constexpr uint32_t log_rate_limit_burst(const LogLevel level) {
+	return level == LogLevel::DEBUGGING ? 0 : LOG_RATE_LIMIT_BURST;
+}
+
 class Logger {
 
 	private:
@@ -24,17 +214,36 @@ class Logger {
 		LogLevel log_level_default;
 		bool log_time;
 
+		// Output mutex
 		std::mutex mutex_;
 
+		// Queues of the threads which logged while the logger thread was running
+		std::mutex queues_mutex;
+		std::vector<std::shared_ptr<LogThreadQueue>> queues;
+
+		// Logger thread, log records are written by this thread while it is running
+		std::unique_ptr<std::thread> thread;
+		std::atomic<bool> async;
+		std::atomic<bool> stopping;
+		FutexEvent stop_event;
+		// Number of threads busy pushing a log record onto their queue, stop() waits for these before its final drain
+		std::atomic<size_t> producers;
+
 		std::string _getLogLevelString(LogLevel level) const;
 
 		std::string _logLevelToString(const LogLevel level) const;
 
-		void _log(const LogLevel level, const std::string file, const std::string func, const unsigned int line,
-				  std::string logline);
+		void _log(LogRecord &record);
+		void _write(const LogRecord &record);
+
+		LogRecordStream &_getThreadStream();
+		LogThreadQueue &_getThreadQueue();
+		size_t _drain();
+		void _threadHandler();
 
 	public:
 		Logger();
+		~Logger();
 
 		inline void setLogLevel(const LogLevel level);
 
@@ -42,12 +251,18 @@ class Logger {
 
 		inline LogLevel getLogLevel() const;
 
+		inline bool isEnabled(const LogLevel level) const;
+
 		inline std::string getLogLevelDefaultString() const;
 
 		inline std::string getLogLevelString() const;
 
+		void start();
+		void stop();
+
 		template <typename... Args>
-		void log(const LogLevel level, const std::string file, const std::string func, const unsigned int line, Args... args);
+		void log(const LogLevel level, const char *file, const char *func, const unsigned int line, const uint32_t suppressed,
+				 const Args &...args);
 };
 
 // Global logger instance
@@ -67,6 +282,15 @@ inline void Logger::setLogLevel(const LogLevel level) { log_level = level; };
  */
 inline LogLevel Logger::getLogLevel() const { return log_level; };
 
+/**
+ * @brief Check if messages of a log level are logged.
+ *
+ * @param level Log level.
+ * @return true If messages of the log level are logged.
+ * @return false If messages of the log level are dropped.
+ */
+inline bool Logger::isEnabled(const LogLevel level) const { return level >= log_level; }
+
 /**
  * @brief Get log level default as a string in lowercase.
  *
@@ -84,37 +308,58 @@ inline std::string Logger::getLogLevelString() const { return _getLogLevelString
 /**
  * @brief Log something.
  *
+ * The log line is formatted by the calling thread into a log record, while the logger thread is running the record is queued
+ * for it without taking any locks, otherwise it is written straight away.
+ *
  * @tparam Args Variable number of arguments.
  * @param level Log level.
  * @param file File name that the log method is called from.
  * @param func Function or method that the log method is called from.
  * @param line Line number from where the log method is called.
+ * @param suppressed Number of messages from the same call site suppressed by rate limiting before this one.
  * @param args Arguments comprising of items to be concatenated to log.
  */
 template <typename... Args>
-void Logger::log(const LogLevel level, const std::string file, const std::string func, const unsigned int line, Args... args) {
-	if (level >= log_level) {
-		std::ostringstream stream;
+void Logger::log(const LogLevel level, const char *file, const char *func, const unsigned int line, const uint32_t suppressed,
+				 const Args &...args) {
+	if (isEnabled(level)) {
+		LogRecordStream &stream = _getThreadStream();
+		stream.begin(level, file, func, line, suppressed);
 		(stream << ... << args);
-		_log(level, file, func, line, stream.str());
+		_log(stream.finish());
 	}
 }
 
 } // namespace accl
 
+// Log a message, levels below the compiled in minimum are removed at compile time and the arguments are only evaluated if the
+// log level is enabled. Each call site is rate limited, so a flood of errors can't turn logging into a bottleneck
+#define ACCL_LOG(level, ...)                                                                                                       \
+	do {                                                                                                                           \
+		if constexpr ((level) >= accl::LOG_LEVEL_MIN) {                                                                            \
+			if (accl::logger.isEnabled(level)) {                                                                                   \
+				static accl::LogRateLimiter accl_log_rate_limiter(accl::log_rate_limit_burst(level));                              \
+				uint32_t accl_log_suppressed;                                                                                      \
+				if (accl_log_rate_limiter.allow(accl_log_suppressed)) {                                                            \
+					accl::logger.log(level, __FILE__, __func__, __LINE__, accl_log_suppressed, __VA_ARGS__);                       \
+				}                                                                                                                  \
+			}                                                                                                                      \
+		}                                                                                                                          \
+	} while (0)
+
 // The LOG_DEBUG_INTERNAL will be factored out of the code if compiled without debugging
 #ifdef DEBUG
-#define LOG_DEBUG_INTERNAL(...) accl::logger.log(accl::LogLevel::DEBUGGING, __FILE__, __func__, __LINE__, __VA_ARGS__);
+#define LOG_DEBUG_INTERNAL(...) ACCL_LOG(accl::LogLevel::DEBUGGING, __VA_ARGS__)
 #else
-#define LOG_DEBUG_INTERNAL(...) ((void)0);
+#define LOG_DEBUG_INTERNAL(...) ((void)0)
 #endif
 
 // Helper macro's for all the types of logging
-#define LOG_DEBUG(...) accl::logger.log(accl::LogLevel::DEBUGGING, __FILE__, __func__, __LINE__, __VA_ARGS__);
-#define LOG_INFO(...) accl::logger.log(accl::LogLevel::INFO, __FILE__, __func__, __LINE__, __VA_ARGS__);
-#define LOG_NOTICE(...) accl::logger.log(accl::LogLevel::NOTICE, __FILE__, __func__, __LINE__, __VA_ARGS__);
-#define LOG_WARNING(...) accl::logger.log(accl::LogLevel::WARNING, __FILE__, __func__, __LINE__, __VA_ARGS__);
-#define LOG_ERROR(...) accl::logger.log(accl::LogLevel::ERROR, __FILE__, __func__, __LINE__, __VA_ARGS__);
+#define LOG_DEBUG(...) ACCL_LOG(accl::LogLevel::DEBUGGING, __VA_ARGS__)
+#define LOG_INFO(...) ACCL_LOG(accl::LogLevel::INFO, __VA_ARGS__)
+#define LOG_NOTICE(...) ACCL_LOG(accl::LogLevel::NOTICE, __VA_ARGS__)
+#define LOG_WARNING(...) ACCL_LOG(accl::LogLevel::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) ACCL_LOG(accl::LogLevel::ERROR, __VA_ARGS__)
 
 #ifdef UNIT_TESTING
 #define UT_ASSERT(...) assert(__VA_ARGS__)
@@ -0,0 +1,388 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace accl {
+
+// Size we align our hot atomics to, to prevent false sharing between producers and consumers
+inline constexpr std::size_t RING_QUEUE_CACHELINE_SIZE{64};
+
+/**
+ * @brief Round a ring capacity up to the next power of 2.
+ *
+ * @param capacity Requested capacity.
+ * @return std::size_t Capacity rounded up to a power of 2.
+ */
+inline std::size_t ring_queue_capacity(std::size_t capacity) {
+	if (!capacity) {
+		throw std::invalid_argument("Ring queue capacity must be greater than 0");
+	}
+	std::size_t result = 1;
+	while (result < capacity) {
+		result <<= 1;
+	}
+	return result;
+}
+
+/**
+ * @brief Bounded lock-free single-producer single-consumer ring queue.
+ *
+ * @tparam T Type of item stored in the queue, this must be movable.
+ */
+template <typename T> class SPSCRingQueue {
+	private:
+		std::vector<T> ring;
+		std::size_t mask;
+
+		// Consumer side
+		alignas(RING_QUEUE_CACHELINE_SIZE) std::atomic<std::size_t> head;
+		std::size_t cached_tail;
+		// Producer side
+		alignas(RING_QUEUE_CACHELINE_SIZE) std::atomic<std::size_t> tail;
+		std::size_t cached_head;
+
+	public:
+		SPSCRingQueue(std::size_t capacity);
+
+		bool tryPush(T &&item);
+		bool tryPop(T &item);
+
+		template <typename Container> std::size_t pushBulk(Container &items);
+		template <typename Container> std::size_t popBulk(Container &results, std::size_t count);
+
+		inline std::size_t size() const;
+		inline std::size_t capacity() const;
+		inline bool empty() const;
+};
+
+/**
+ * @brief Construct a new SPSCRingQueue object.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @param capacity Capacity of the queue, this is rounded up to a power of 2.
+ */
+template <typename T>
+SPSCRingQueue<T>::SPSCRingQueue(std::size_t capacity)
+	: ring(ring_queue_capacity(capacity)), mask(ring.size() - 1), head(0), cached_tail(0), tail(0), cached_head(0) {}
+
+/**
+ * @brief Try push an item into the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @param item Item to push, this is only moved from if the push succeeds.
+ * @return true If the item was pushed.
+ * @return false If the queue is full.
+ */
+template <typename T> bool SPSCRingQueue<T>::tryPush(T &&item) {
+	std::size_t cur_tail = tail.load(std::memory_order_relaxed);
+	// Only refresh our view of the consumer if we look full
+	if (cur_tail - cached_head == ring.size()) {
+		cached_head = head.load(std::memory_order_acquire);
+		if (cur_tail - cached_head == ring.size()) {
+			return false;
+		}
+	}
+	ring[cur_tail & mask] = std::move(item);
+	tail.store(cur_tail + 1, std::memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Try pop an item from the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @param item Item popped.
+ * @return true If an item was popped.
+ * @return false If the queue is empty.
+ */
+template <typename T> bool SPSCRingQueue<T>::tryPop(T &item) {
+	std::size_t cur_head = head.load(std::memory_order_relaxed);
+	// Only refresh our view of the producer if we look empty
+	if (cur_head == cached_tail) {
+		cached_tail = tail.load(std::memory_order_acquire);
+		if (cur_head == cached_tail) {
+			return false;
+		}
+	}
+	item = std::move(ring[cur_head & mask]);
+	head.store(cur_head + 1, std::memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Push as many items as will fit from the front of a container, publishing them all at once.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @tparam Container Container type supporting begin() and erase().
+ * @param items Items to push, the items pushed are erased from the container.
+ * @return std::size_t Number of items pushed.
+ */
+template <typename T> template <typename Container> std::size_t SPSCRingQueue<T>::pushBulk(Container &items) {
+	std::size_t cur_tail = tail.load(std::memory_order_relaxed);
+	cached_head = head.load(std::memory_order_acquire);
+
+	std::size_t count = std::min(items.size(), ring.size() - (cur_tail - cached_head));
+	auto iterator = items.begin();
+	for (std::size_t i = 0; i < count; ++i, ++iterator) {
+		ring[(cur_tail + i) & mask] = std::move(*iterator);
+	}
+	tail.store(cur_tail + count, std::memory_order_release);
+
+	items.erase(items.begin(), iterator);
+	return count;
+}
+
+/**
+ * @brief Pop a number of items from the queue in one go.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @tparam Container Container type supporting push_back().
+ * @param results Container to add the items to.
+ * @param count Maximum number of items to pop.
+ * @return std::size_t Number of items popped.
+ */
+template <typename T> template <typename Container> std::size_t SPSCRingQueue<T>::popBulk(Container &results, std::size_t count) {
+	std::size_t cur_head = head.load(std::memory_order_relaxed);
+	cached_tail = tail.load(std::memory_order_acquire);
+
+	count = std::min(count, cached_tail - cur_head);
+	for (std::size_t i = 0; i < count; ++i) {
+		results.push_back(std::move(ring[(cur_head + i) & mask]));
+	}
+	head.store(cur_head + count, std::memory_order_release);
+
+	return count;
+}
+
+/**
+ * @brief Get the number of items in the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @return std::size_t Number of items, this is only a snapshot if the queue is in use.
+ */
+template <typename T> inline std::size_t SPSCRingQueue<T>::size() const {
+	return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Get the capacity of the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @return std::size_t Capacity.
+ */
+template <typename T> inline std::size_t SPSCRingQueue<T>::capacity() const { return ring.size(); }
+
+/**
+ * @brief Check if the queue is empty.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @return true If the queue is empty.
+ * @return false If the queue has items.
+ */
+template <typename T> inline bool SPSCRingQueue<T>::empty() const {
+	return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer ring queue.
+ *
+ * This is based on Dmitry Vyukov's bounded MPMC queue, each cell carries its own sequence number so producers and consumers
+ * only contend on a single CAS of their respective position.
+ *
+ * @tparam T Type of item stored in the queue, this must be movable.
+ */
+template <typename T> class MPMCRingQueue {
+	private:
+		struct Cell {
+				std::atomic<std::size_t> sequence;
+				T data;
+		};
+
+		std::unique_ptr<Cell[]> ring;
+		std::size_t ring_size;
+		std::size_t mask;
+
+		alignas(RING_QUEUE_CACHELINE_SIZE) std::atomic<std::size_t> enqueue_pos;
+		alignas(RING_QUEUE_CACHELINE_SIZE) std::atomic<std::size_t> dequeue_pos;
+
+	public:
+		MPMCRingQueue(std::size_t capacity);
+
+		bool tryPush(T &&item);
+		bool tryPop(T &item);
+
+		template <typename Container> std::size_t pushBulk(Container &items);
+		template <typename Container> std::size_t popBulk(Container &results, std::size_t count);
+
+		inline std::size_t size() const;
+		inline std::size_t capacity() const;
+		inline bool empty() const;
+};
+
+/**
+ * @brief Construct a new MPMCRingQueue object.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @param capacity Capacity of the queue, this is rounded up to a power of 2.
+ */
+template <typename T>
+MPMCRingQueue<T>::MPMCRingQueue(std::size_t capacity)
+	: ring_size(ring_queue_capacity(capacity)), mask(ring_size - 1), enqueue_pos(0), dequeue_pos(0) {
+	ring = std::make_unique<Cell[]>(ring_size);
+	for (std::size_t i = 0; i < ring_size; ++i) {
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * @brief Try push an item into the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @param item Item to push, this is only moved from if the push succeeds.
+ * @return true If the item was pushed.
+ * @return false If the queue is full.
+ */
+template <typename T> bool MPMCRingQueue<T>::tryPush(T &&item) {
+	Cell *cell;
+	std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		cell = &ring[pos & mask];
+		std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+		if (diff == 0) {
+			// Cell is free, try claim it
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// Cell still holds an item from the previous lap, we're full
+			return false;
+		} else {
+			// Another producer beat us to it
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+	cell->data = std::move(item);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Try pop an item from the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @param item Item popped.
+ * @return true If an item was popped.
+ * @return false If the queue is empty.
+ */
+template <typename T> bool MPMCRingQueue<T>::tryPop(T &item) {
+	Cell *cell;
+	std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		cell = &ring[pos & mask];
+		std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+		if (diff == 0) {
+			// Cell has an item, try claim it
+			if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// Cell has not been filled yet, we're empty
+			return false;
+		} else {
+			// Another consumer beat us to it
+			pos = dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+	item = std::move(cell->data);
+	cell->sequence.store(pos + mask + 1, std::memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Push as many items as will fit from the front of a container.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @tparam Container Container type supporting begin() and erase().
+ * @param items Items to push, the items pushed are erased from the container.
+ * @return std::size_t Number of items pushed.
+ */
+template <typename T> template <typename Container> std::size_t MPMCRingQueue<T>::pushBulk(Container &items) {
+	std::size_t count = 0;
+	auto iterator = items.begin();
+	for (; iterator != items.end(); ++iterator, ++count) {
+		if (!tryPush(std::move(*iterator))) {
+			break;
+		}
+	}
+	items.erase(items.begin(), iterator);
+	return count;
+}
+
+/**
+ * @brief Pop a number of items from the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @tparam Container Container type supporting push_back().
+ * @param results Container to add the items to.
+ * @param count Maximum number of items to pop.
+ * @return std::size_t Number of items popped.
+ */
+template <typename T> template <typename Container> std::size_t MPMCRingQueue<T>::popBulk(Container &results, std::size_t count) {
+	std::size_t popped = 0;
+	T item;
+	while (popped < count && tryPop(item)) {
+		results.push_back(std::move(item));
+		++popped;
+	}
+	return popped;
+}
+
+/**
+ * @brief Get the number of items in the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @return std::size_t Number of items, this is only a snapshot if the queue is in use.
+ */
+template <typename T> inline std::size_t MPMCRingQueue<T>::size() const {
+	std::size_t dequeued = dequeue_pos.load(std::memory_order_acquire);
+	std::size_t enqueued = enqueue_pos.load(std::memory_order_acquire);
+	// Producers and consumers may have moved between the two loads
+	return enqueued > dequeued ? std::min(enqueued - dequeued, ring_size) : 0;
+}
+
+/**
+ * @brief Get the capacity of the queue.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @return std::size_t Capacity.
+ */
+template <typename T> inline std::size_t MPMCRingQueue<T>::capacity() const { return ring_size; }
+
+/**
+ * @brief Check if the queue is empty.
+ *
+ * @tparam T Type of item stored in the queue.
+ * @return true If the queue is empty.
+ * @return false If the queue has items.
+ */
+template <typename T> inline bool MPMCRingQueue<T>::empty() const {
+	std::size_t pos = dequeue_pos.load(std::memory_order_acquire);
+	return ring[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+} // namespace accl
@@ -8,8 +8,32 @@
 
 namespace accl {
 
-StreamCompressor::StreamCompressor() : compression_level(5) {}
+StreamCompressor::StreamCompressor() : compression_level(5), dictionary_enabled(true) {}
 
 StreamCompressor::~StreamCompressor() = default;
 
+/**
+ * @brief Set the compression level, this can be changed between inputs without resetting the compression stream.
+ *
+ * What the level means depends on the algorithm, for LZ4 it is the acceleration where higher is faster but compresses less, for
+ * ZSTD higher compresses better but is slower.
+ *
+ * @param level Compression level.
+ */
+void StreamCompressor::setCompressionLevel(int level) { compression_level = level; }
+
+/**
+ * @brief Set the dictionary used to prime the compression and decompression streams, both streams are reset.
+ *
+ * Small inputs compress poorly as there is little history to find matches in, a dictionary trained on similar data gives
+ * the compressor history to work with from the start. Data must be decompressed with the same dictionary it was compressed with.
+ *
+ * @param dictionary Dictionary, this is copied.
+ */
+void StreamCompressor::setDictionary(const std::string &dictionary) {
+	this->dictionary = dictionary;
+	resetCompressionStream();
+	resetDecompressionStream();
+}
+
 } // namespace accl
\ No newline at end of file
@@ -15,10 +15,23 @@ class StreamCompressor {
 	protected:
 		int compression_level;
 
+		// Dictionary the streams are primed with, this is empty if we don't have one
+		std::string dictionary;
+		bool dictionary_enabled;
+
 	public:
 		StreamCompressor();
 		virtual ~StreamCompressor();
 
+		virtual void setCompressionLevel(int level);
+		inline int getCompressionLevel() const;
+
+		virtual void setDictionary(const std::string &dictionary);
+		inline bool hasDictionary() const;
+
+		inline void setDictionaryEnabled(bool enabled);
+		inline bool getDictionaryEnabled() const;
+
 		virtual void resetCompressionStream() = 0;
 		virtual void resetDecompressionStream() = 0;
 
@@ -28,4 +41,36 @@ class StreamCompressor {
 		virtual const std::string strerror(int err) = 0;
 };
 
+/**
+ * @brief Get the compression level.
+ *
+ * @return int Compression level.
+ */
+inline int StreamCompressor::getCompressionLevel() const { return compression_level; }
+
+/**
+ * @brief Check if we have a dictionary.
+ *
+ * @return true If a dictionary was set.
+ * @return false If we don't have a dictionary.
+ */
+inline bool StreamCompressor::hasDictionary() const { return !dictionary.empty(); }
+
+/**
+ * @brief Enable or disable the use of the dictionary, this takes effect when the streams are next reset.
+ *
+ * This allows data compressed without a dictionary to be decompressed while we have one.
+ *
+ * @param enabled Use the dictionary.
+ */
+inline void StreamCompressor::setDictionaryEnabled(bool enabled) { dictionary_enabled = enabled; }
+
+/**
+ * @brief Check if the dictionary is enabled.
+ *
+ * @return true If the dictionary is used when we have one.
+ * @return false If the dictionary is not used.
+ */
+inline bool StreamCompressor::getDictionaryEnabled() const { return dictionary_enabled; }
+
 } // namespace accl
\ No newline at end of file
@@ -5,6 +5,7 @@
  */
 
 #include "stream_compressor_lz4.hpp"
+#include <cstring>
 #include <stdexcept>
 
 extern "C" {
@@ -13,7 +14,7 @@ extern "C" {
 
 namespace accl {
 
-StreamCompressorLZ4::StreamCompressorLZ4() : StreamCompressor() {
+StreamCompressorLZ4::StreamCompressorLZ4() : StreamCompressor(), lz4DictStream(nullptr) {
 	// Create stream tracking contexts
 	if (!(lz4Stream = LZ4_createStream())) {
 		throw std::runtime_error("Failed to create LZ4 stream");
@@ -27,11 +28,51 @@ StreamCompressorLZ4::~StreamCompressorLZ4() {
 	// Free stream tracking contexts
 	LZ4_freeStreamDecode(lz4StreamDecode);
 	LZ4_freeStream(lz4Stream);
+	if (lz4DictStream) {
+		LZ4_freeStream(lz4DictStream);
+	}
+}
+
+void StreamCompressorLZ4::setDictionary(const std::string &dictionary) {
+	// LZ4 can only reference the last 64KB of history
+	const size_t max_dictionary_size = 64 * 1024;
+	if (dictionary.size() > max_dictionary_size) {
+		this->dictionary = dictionary.substr(dictionary.size() - max_dictionary_size);
+	} else {
+		this->dictionary = dictionary;
+	}
+
+	// Load the dictionary once, copying the loaded stream is much cheaper than loading the dictionary on each reset
+	if (lz4DictStream) {
+		LZ4_freeStream(lz4DictStream);
+		lz4DictStream = nullptr;
+	}
+	if (!this->dictionary.empty()) {
+		if (!(lz4DictStream = LZ4_createStream())) {
+			throw std::runtime_error("Failed to create LZ4 dictionary stream");
+		}
+		LZ4_loadDict(lz4DictStream, this->dictionary.data(), static_cast<int>(this->dictionary.size()));
+	}
+
+	resetCompressionStream();
+	resetDecompressionStream();
 }
 
-void StreamCompressorLZ4::resetCompressionStream() { LZ4_resetStream_fast(lz4Stream); }
+void StreamCompressorLZ4::resetCompressionStream() {
+	if (lz4DictStream && dictionary_enabled) {
+		std::memcpy(lz4Stream, lz4DictStream, sizeof(*lz4Stream));
+	} else {
+		LZ4_resetStream_fast(lz4Stream);
+	}
+}
 
-void StreamCompressorLZ4::resetDecompressionStream() { LZ4_setStreamDecode(lz4StreamDecode, NULL, 0); }
+void StreamCompressorLZ4::resetDecompressionStream() {
+	if (!dictionary.empty() && dictionary_enabled) {
+		LZ4_setStreamDecode(lz4StreamDecode, dictionary.data(), static_cast<int>(dictionary.size()));
+	} else {
+		LZ4_setStreamDecode(lz4StreamDecode, NULL, 0);
+	}
+}
 
 int StreamCompressorLZ4::compress(const char *input, size_t input_size, char *output, size_t max_output_size) {
 	//	return LZ4_compress_default(input, output, static_cast<int>(input_size), static_cast<int>(max_output_size));
@@ -17,12 +17,16 @@ namespace accl {
 class StreamCompressorLZ4 : public StreamCompressor {
 		LZ4_stream_t *lz4Stream;
 		LZ4_streamDecode_t *lz4StreamDecode;
+		// Stream with the dictionary loaded, this is copied over the compression stream when its reset
+		LZ4_stream_t *lz4DictStream;
 
 	public:
 		StreamCompressorLZ4();
 
 		~StreamCompressorLZ4() override;
 
+		void setDictionary(const std::string &dictionary) override;
+
 		void resetCompressionStream() override;
 		void resetDecompressionStream() override;
 
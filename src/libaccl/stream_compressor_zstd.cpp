@@ -13,7 +13,7 @@ extern "C" {
 
 namespace accl {
 
-StreamCompressorZSTD::StreamCompressorZSTD() : StreamCompressor() {
+StreamCompressorZSTD::StreamCompressorZSTD() : StreamCompressor(), cdict(nullptr), ddict(nullptr) {
 	// Create stream tracking contexts
 	if (!(cctx = ZSTD_createCCtx())) {
 		throw std::runtime_error("Failed to create ZSTD compression context");
@@ -25,21 +25,68 @@ StreamCompressorZSTD::StreamCompressorZSTD() : StreamCompressor() {
 
 StreamCompressorZSTD::~StreamCompressorZSTD() {
 	// Free stream tracking contexts
+	_freeDictionary();
 	ZSTD_freeDCtx(dctx);
 	ZSTD_freeCCtx(cctx);
 }
 
+void StreamCompressorZSTD::_freeDictionary() {
+	ZSTD_freeCDict(cdict);
+	ZSTD_freeDDict(ddict);
+	cdict = nullptr;
+	ddict = nullptr;
+}
+
+void StreamCompressorZSTD::setCompressionLevel(int level) {
+	StreamCompressor::setCompressionLevel(level);
+
+	// The compression level is baked into the digested dictionary
+	if (cdict) {
+		ZSTD_freeCDict(cdict);
+		if (!(cdict = ZSTD_createCDict(this->dictionary.data(), this->dictionary.size(), compression_level))) {
+			_freeDictionary();
+			throw std::runtime_error("Failed to create ZSTD dictionary");
+		}
+	}
+}
+
+void StreamCompressorZSTD::setDictionary(const std::string &dictionary) {
+	_freeDictionary();
+	this->dictionary = dictionary;
+
+	// Digest the dictionary once, so it doesn't need to be loaded for each input
+	if (!this->dictionary.empty()) {
+		cdict = ZSTD_createCDict(this->dictionary.data(), this->dictionary.size(), compression_level);
+		ddict = ZSTD_createDDict(this->dictionary.data(), this->dictionary.size());
+		if (!cdict || !ddict) {
+			_freeDictionary();
+			throw std::runtime_error("Failed to create ZSTD dictionary");
+		}
+	}
+
+	resetCompressionStream();
+	resetDecompressionStream();
+}
+
 void StreamCompressorZSTD::resetCompressionStream() { ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters); }
 
 void StreamCompressorZSTD::resetDecompressionStream() { ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters); }
 
 int StreamCompressorZSTD::compress(const char *input, size_t input_size, char *output, size_t max_output_size) {
 	//	return ZSTD_compress_default(input, output, static_cast<int>(input_size), static_cast<int>(max_output_size));
+	if (cdict && dictionary_enabled) {
+		return ZSTD_compress_usingCDict(cctx, output, static_cast<int>(max_output_size), input, static_cast<int>(input_size),
+										cdict);
+	}
 	return ZSTD_compressCCtx(cctx, output, static_cast<int>(max_output_size), input, static_cast<int>(input_size),
 							 compression_level);
 }
 
 int StreamCompressorZSTD::decompress(const char *input, size_t input_size, char *output, size_t max_output_size) {
+	if (ddict && dictionary_enabled) {
+		return ZSTD_decompress_usingDDict(dctx, output, static_cast<int>(max_output_size), input, static_cast<int>(input_size),
+										  ddict);
+	}
 	return ZSTD_decompressDCtx(dctx, output, static_cast<int>(max_output_size), input, static_cast<int>(input_size));
 }
 
@@ -17,12 +17,21 @@ namespace accl {
 class StreamCompressorZSTD : public StreamCompressor {
 		ZSTD_CCtx *cctx;
 		ZSTD_DCtx *dctx;
+		// Digested dictionaries, these are nullptr if we don't have a dictionary
+		ZSTD_CDict *cdict;
+		ZSTD_DDict *ddict;
+
+		void _freeDictionary();
 
 	public:
 		StreamCompressorZSTD();
 
 		~StreamCompressorZSTD() override;
 
+		void setCompressionLevel(int level) override;
+
+		void setDictionary(const std::string &dictionary) override;
+
 		void resetCompressionStream() override;
 		void resetDecompressionStream() override;
 
@@ -0,0 +1,324 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "task_scheduler.hpp"
+#include <limits>
+#include <stdexcept>
+
+namespace accl {
+
+// Value of Task::worker before the task has been queued for the first time
+static constexpr size_t TASK_NO_WORKER{std::numeric_limits<size_t>::max()};
+
+// Scheduler and worker index of the current thread, if it is a worker
+static thread_local const TaskScheduler *current_scheduler{nullptr};
+static thread_local size_t current_worker{0};
+
+/**
+ * @brief Get the current time in steady clock ticks.
+ *
+ * @return int64_t Ticks.
+ */
+static inline int64_t now_ticks() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+Task::Task() : state(TaskState::IDLE), worker(TASK_NO_WORKER), deadline(0), timer_armed(false) {}
+
+/**
+ * @brief Construct a new TaskScheduler object, the workers are only started once start() is called.
+ *
+ * @param workers Number of worker threads.
+ * @exception std::invalid_argument The number of workers is 0.
+ */
+TaskScheduler::TaskScheduler(size_t workers) : queued(0), next_worker(0), stopping(false) {
+	if (!workers) {
+		throw std::invalid_argument("Task scheduler must have at least 1 worker");
+	}
+	for (size_t i = 0; i < workers; ++i) {
+		this->workers.push_back(std::make_unique<Worker>());
+	}
+}
+
+/**
+ * @brief Destroy the TaskScheduler object, stopping the workers if they are running.
+ *
+ */
+TaskScheduler::~TaskScheduler() { stop(); }
+
+/**
+ * @brief Start the worker threads, tasks scheduled before this are run once the workers start.
+ *
+ */
+void TaskScheduler::start() {
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i]->thread = std::make_unique<std::thread>(&TaskScheduler::_workerHandler, this, i);
+	}
+}
+
+/**
+ * @brief Stop the worker threads and wait for them to exit, tasks still queued are not run.
+ *
+ */
+void TaskScheduler::stop() {
+	stopping.store(true, std::memory_order_seq_cst);
+	work_event.notify_all();
+
+	for (auto &worker : workers) {
+		if (worker->thread && worker->thread->joinable()) {
+			worker->thread->join();
+		}
+	}
+}
+
+/**
+ * @brief Schedule a task to be run.
+ *
+ * Anything the task needs to process must be made visible to it before it is scheduled, the task is guaranteed to run at
+ * least once after this call.
+ *
+ * @param task Task to schedule.
+ */
+void TaskScheduler::schedule(Task *task) {
+	// Pairs with the fence in _runTask(), so either we see the task is running or it sees what we handed it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	TaskState state = task->state.load(std::memory_order_relaxed);
+	while (true) {
+		if (state == TaskState::IDLE) {
+			if (task->state.compare_exchange_weak(state, TaskState::QUEUED, std::memory_order_acq_rel)) {
+				break;
+			}
+		} else if (state == TaskState::RUNNING) {
+			// The worker running the task will queue it again once it finishes
+			if (task->state.compare_exchange_weak(state, TaskState::RUNNING_AGAIN, std::memory_order_acq_rel)) {
+				return;
+			}
+		} else {
+			// Task is already going to run
+			return;
+		}
+	}
+
+	// Queue on the current worker if we're one of ours, otherwise on the worker the task last ran on
+	size_t index;
+	if (current_scheduler == this) {
+		index = current_worker;
+	} else {
+		index = task->worker.load(std::memory_order_relaxed);
+		if (index == TASK_NO_WORKER) {
+			index = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+			task->worker.store(index, std::memory_order_relaxed);
+		}
+	}
+	_enqueue(index, task);
+}
+
+/**
+ * @brief Get the number of times tasks have been run.
+ *
+ * @return uint64_t Number of task runs.
+ */
+uint64_t TaskScheduler::getRunCount() const {
+	uint64_t runs = 0;
+	for (auto &worker : workers) {
+		runs += worker->runs.load(std::memory_order_relaxed);
+	}
+	return runs;
+}
+
+/**
+ * @brief Get the number of tasks workers have stolen from other workers.
+ *
+ * @return uint64_t Number of tasks stolen.
+ */
+uint64_t TaskScheduler::getStealCount() const {
+	uint64_t steals = 0;
+	for (auto &worker : workers) {
+		steals += worker->steals.load(std::memory_order_relaxed);
+	}
+	return steals;
+}
+
+/**
+ * @brief Internal method run by each worker thread.
+ *
+ * @param index Index of the worker.
+ */
+void TaskScheduler::_workerHandler(size_t index) {
+	current_scheduler = this;
+	current_worker = index;
+
+	Worker &worker = *workers[index];
+	while (!stopping.load(std::memory_order_acquire)) {
+		Task *task = _dequeue(index);
+		if (!task) {
+			task = _steal(index);
+		}
+		if (task) {
+			_runTask(index, task);
+			// Timers are checked between tasks so a busy worker doesn't hold them up
+			if (!worker.timers.empty()) {
+				_fireTimers(index);
+			}
+			continue;
+		}
+
+		// Nothing to run, fire any timers that are due and park until there is work or the next timer is due
+		std::chrono::nanoseconds timeout = _fireTimers(index);
+		uint32_t seq = work_event.prepareWait();
+		if (queued.load(std::memory_order_seq_cst) || stopping.load(std::memory_order_seq_cst)) {
+			work_event.cancelWait();
+			continue;
+		}
+		work_event.wait(seq, timeout);
+	}
+
+	current_scheduler = nullptr;
+}
+
+/**
+ * @brief Internal method to queue a task on a worker and wake up a worker to run it.
+ *
+ * @param index Index of the worker.
+ * @param task Task to queue, this must be in the TaskState::QUEUED state.
+ */
+void TaskScheduler::_enqueue(size_t index, Task *task) {
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->mtx);
+		workers[index]->queue.push_back(task);
+	}
+	queued.fetch_add(1, std::memory_order_seq_cst);
+	// If this isn't the worker the task was queued on, it will steal it
+	work_event.notify_one();
+}
+
+/**
+ * @brief Internal method to take the next task off the front of the queue of a worker.
+ *
+ * @param index Index of the worker.
+ * @return Task* Task or nullptr if the queue is empty.
+ */
+Task *TaskScheduler::_dequeue(size_t index) {
+	Worker &worker = *workers[index];
+	std::lock_guard<std::mutex> lock(worker.mtx);
+	if (worker.queue.empty()) {
+		return nullptr;
+	}
+	Task *task = worker.queue.front();
+	worker.queue.pop_front();
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	return task;
+}
+
+/**
+ * @brief Internal method to steal a task off the back of the queue of another worker.
+ *
+ * @param index Index of the worker doing the stealing.
+ * @return Task* Task or nullptr if there was nothing to steal.
+ */
+Task *TaskScheduler::_steal(size_t index) {
+	if (!queued.load(std::memory_order_relaxed)) {
+		return nullptr;
+	}
+
+	for (size_t i = 1; i < workers.size(); ++i) {
+		Worker &victim = *workers[(index + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mtx);
+		if (victim.queue.empty()) {
+			continue;
+		}
+		Task *task = victim.queue.back();
+		victim.queue.pop_back();
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		workers[index]->steals.fetch_add(1, std::memory_order_relaxed);
+		return task;
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Internal method to run a task, queueing it again if it was scheduled while running.
+ *
+ * @param index Index of the worker running the task.
+ * @param task Task to run.
+ */
+void TaskScheduler::_runTask(size_t index, Task *task) {
+	Worker &worker = *workers[index];
+
+	task->worker.store(index, std::memory_order_relaxed);
+	task->state.store(TaskState::RUNNING, std::memory_order_seq_cst);
+	// Pairs with the fence in schedule(), so either the scheduler sees the task is running or we see what it handed us
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	task->deadline.store(0, std::memory_order_seq_cst);
+	std::chrono::nanoseconds delay = task->run();
+	worker.runs.fetch_add(1, std::memory_order_relaxed);
+
+	// Add a timer if the task wants to be run again later, if it already has one it is moved to the new deadline when it fires
+	if (delay.count() > 0) {
+		int64_t deadline = now_ticks() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay).count();
+		task->deadline.store(deadline, std::memory_order_seq_cst);
+		if (!task->timer_armed.exchange(true, std::memory_order_seq_cst)) {
+			worker.timers.emplace_back(deadline, task);
+		}
+	}
+
+	TaskState state = TaskState::RUNNING;
+	if (!task->state.compare_exchange_strong(state, TaskState::IDLE, std::memory_order_acq_rel)) {
+		// We were scheduled while running, so we need to run again, behind whatever else is queued on this worker
+		task->state.store(TaskState::QUEUED, std::memory_order_relaxed);
+		_enqueue(index, task);
+	}
+}
+
+/**
+ * @brief Internal method to schedule the tasks whose timers are due.
+ *
+ * @param index Index of the worker.
+ * @return std::chrono::nanoseconds Time until the next timer is due, zero if there are no timers left.
+ */
+std::chrono::nanoseconds TaskScheduler::_fireTimers(size_t index) {
+	Worker &worker = *workers[index];
+	if (worker.timers.empty()) {
+		return std::chrono::nanoseconds::zero();
+	}
+
+	int64_t now = now_ticks();
+	int64_t next = std::numeric_limits<int64_t>::max();
+	for (size_t i = 0; i < worker.timers.size();) {
+		auto &[timer_deadline, task] = worker.timers[i];
+
+		int64_t deadline = task->deadline.load(std::memory_order_seq_cst);
+		// If the task ran again since the timer was added, move the timer to the new deadline
+		if (deadline > now) {
+			timer_deadline = deadline;
+			next = std::min(next, deadline);
+			++i;
+			continue;
+		}
+
+		Task *fire_task = task;
+		worker.timers[i] = worker.timers.back();
+		worker.timers.pop_back();
+
+		fire_task->timer_armed.store(false, std::memory_order_seq_cst);
+		if (deadline) {
+			schedule(fire_task);
+		} else if (fire_task->deadline.load(std::memory_order_seq_cst) &&
+				   !fire_task->timer_armed.exchange(true, std::memory_order_seq_cst)) {
+			// The task set a new deadline after we looked but before we disarmed, so it is relying on our timer
+			worker.timers.emplace_back(now, fire_task);
+		}
+	}
+
+	if (next == std::numeric_limits<int64_t>::max()) {
+		return worker.timers.empty() ? std::chrono::nanoseconds::zero() : std::chrono::nanoseconds(1);
+	}
+	return std::max(std::chrono::nanoseconds(1),
+					std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration(next - now)));
+}
+
+} // namespace accl
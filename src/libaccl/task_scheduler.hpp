@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "futex_event.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace accl {
+
+class TaskScheduler;
+
+/**
+ * @brief Scheduling state of a task.
+ *
+ */
+enum class TaskState : uint8_t {
+	// Not queued or running
+	IDLE,
+	// Waiting in the queue of a worker
+	QUEUED,
+	// Being run by a worker
+	RUNNING,
+	// Being run by a worker and was scheduled again while running, it is queued again once it finishes
+	RUNNING_AGAIN,
+};
+
+/**
+ * @brief Unit of work run by a TaskScheduler.
+ *
+ * A task is only ever run by one worker at a time, scheduling it while it is queued does nothing and scheduling it while it
+ * is running queues it again once it has finished. Work handed to a task in order is therefore processed in order, no matter
+ * which workers end up running it.
+ *
+ * Tasks must outlive the scheduler they are scheduled on, or at least until it is stopped.
+ */
+class Task {
+	public:
+		Task();
+		virtual ~Task() = default;
+
+		Task(const Task &) = delete;
+		Task &operator=(const Task &) = delete;
+
+	protected:
+		/**
+		 * @brief Run the task.
+		 *
+		 * @return std::chrono::nanoseconds Delay after which the task wants to be run again if it was not scheduled before
+		 * then, zero if it does not.
+		 */
+		virtual std::chrono::nanoseconds run() = 0;
+
+	private:
+		friend class TaskScheduler;
+
+		std::atomic<TaskState> state;
+		// Worker the task last ran on, it is queued there if it is scheduled from outside the scheduler
+		std::atomic<size_t> worker;
+		// Time the task wants to be run again in steady clock ticks, 0 if it does not
+		std::atomic<int64_t> deadline;
+		// Set while a worker has a timer for this task
+		std::atomic<bool> timer_armed;
+};
+
+/**
+ * @brief Fixed size pool of worker threads running tasks.
+ *
+ * Each worker has its own queue of tasks, tasks scheduled by a worker are queued on that worker and tasks scheduled from
+ * outside the scheduler are queued on the worker they last ran on to keep their data in the same CPU cache. Workers which run
+ * out of work steal tasks from the back of the queues of the other workers, and park on a futex once there is nothing left.
+ */
+class TaskScheduler {
+	public:
+		TaskScheduler(size_t workers);
+		~TaskScheduler();
+
+		TaskScheduler(const TaskScheduler &) = delete;
+		TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+		void start();
+		void stop();
+
+		void schedule(Task *task);
+
+		inline size_t getWorkerCount() const;
+		inline std::thread &getWorkerThread(size_t worker);
+
+		uint64_t getRunCount() const;
+		uint64_t getStealCount() const;
+
+	private:
+		/**
+		 * @brief Worker thread along with its task queue and timers.
+		 *
+		 */
+		struct Worker {
+				std::unique_ptr<std::thread> thread;
+
+				// Queue of tasks, the worker takes tasks from the front and other workers steal from the back
+				std::mutex mtx;
+				std::deque<Task *> queue;
+
+				// Timers of tasks which want to be run again, these are only used by the worker itself
+				std::vector<std::pair<int64_t, Task *>> timers;
+
+				// Counters are only written by the worker itself
+				std::atomic<uint64_t> runs{0};
+				std::atomic<uint64_t> steals{0};
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+
+		// Number of tasks queued on all the workers
+		std::atomic<size_t> queued;
+		// Next worker to queue a task on which has never run
+		std::atomic<size_t> next_worker;
+
+		// Event used to park workers with nothing to do
+		FutexEvent work_event;
+		std::atomic<bool> stopping;
+
+		void _workerHandler(size_t index);
+
+		void _enqueue(size_t index, Task *task);
+		Task *_dequeue(size_t index);
+		Task *_steal(size_t index);
+		void _runTask(size_t index, Task *task);
+		std::chrono::nanoseconds _fireTimers(size_t index);
+};
+
+/**
+ * @brief Get the number of worker threads.
+ *
+ * @return size_t Number of workers.
+ */
+inline size_t TaskScheduler::getWorkerCount() const { return workers.size(); }
+
+/**
+ * @brief Get the thread of a worker, this is only valid once the scheduler has been started.
+ *
+ * @param worker Index of the worker.
+ * @return std::thread& Worker thread.
+ */
+inline std::thread &TaskScheduler::getWorkerThread(size_t worker) { return *workers[worker]->thread; }
+
+} // namespace accl
@@ -6,12 +6,16 @@
 
 #include "codec.hpp"
 #include "common.hpp"
+#include "compression_dictionary.hpp"
 #include "config.hpp"
 #include "exceptions.hpp"
 #include "libaccl/logger.hpp"
+#include "packet_switch_options.hpp"
 #include "superethd.hpp"
 #include "util.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <boost/optional.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <filesystem>
@@ -19,6 +23,7 @@
 #include <getopt.h>
 #include <iostream>
 #include <net/if.h>
+#include <sched.h>
 #include <string.h>
 #include <string>
 
@@ -27,7 +32,8 @@ static struct option long_options[] = {{"version", no_argument, 0, 'v'},		   {"h
 									   {"ifname", required_argument, 0, 'i'},	   {"src", required_argument, 0, 's'},
 									   {"dst", required_argument, 0, 'd'},		   {"port", required_argument, 0, 'p'},
 									   {"mtu", required_argument, 0, 'm'},		   {"tsize", required_argument, 0, 't'},
-									   {"compression", required_argument, 0, 'a'}, {0, 0, 0, 0}};
+									   {"compression", required_argument, 0, 'a'}, {"train-dictionary", required_argument, 0, 'T'},
+									   {0, 0, 0, 0}};
 
 void print_help() {
 	std::cerr << "Usage:" << std::endl;
@@ -58,9 +64,13 @@ void print_help() {
 	std::cerr << std::format("                                  characters (default is \"{}\")", SETH_DEFAULT_TUNNEL_NAME)
 			  << std::endl;
 	std::cerr << "    -a, --compression=<COMPR>     Specify compression algorithm to use, valid" << std::endl;
-	std::cerr << std::format("                                  values: none, lz4, zstd (default: \"{}\")",
+	std::cerr << "                                  values: none, lz4, zstd, lz4-batch, zstd-batch" << std::endl;
+	std::cerr << std::format("                                  (default: \"{}\")",
 							 PacketHeaderOptionFormatTypeToString(SETH_DEFAULT_PACKET_FORMAT))
 			  << std::endl;
+	std::cerr << "    -T, --train-dictionary=<FILE> Capture frames from the interface and train a" << std::endl;
+	std::cerr << "                                  compression dictionary on them, saving it to" << std::endl;
+	std::cerr << "                                  FILE and exiting. The tunnel is not started." << std::endl;
 	std::cerr << std::endl;
 }
 
@@ -76,6 +86,8 @@ int main(int argc, char *argv[]) {
 	std::string cfg_ifname{SETH_DEFAULT_TUNNEL_NAME};
 	std::string cfg_packet_format_str{"lz4"};
 	PacketHeaderOptionFormatType cfg_packet_format;
+	PacketSwitchOptions cfg_options;
+	std::string cfg_train_dictionary;
 
 	std::cerr << std::format("Super Ethernet Tunnel v{} - Copyright (c) 2023-2024, AllWorldIT.", VERSION) << std::endl;
 	std::cerr << std::endl;
@@ -93,9 +105,34 @@ int main(int argc, char *argv[]) {
 		std::vector<std::string> cmdline_tunnel_dst, conffile_tunnel_dst;
 		std::string cmdline_ifname, conffile_ifname;
 		std::string cmdline_packet_format, conffile_packet_format;
+		std::string conffile_txmode;
+		std::string conffile_rxmode;
+		int conffile_socket_read_threads{1};
+		std::string conffile_ioengine;
+		int conffile_tap_queues{0};
+		bool conffile_tap_offload{false};
+		int conffile_worker_threads{0};
+		int conffile_worker_priority{0};
+		int conffile_channels{1};
+		bool conffile_flood_encode{true};
+		bool conffile_zero_copy_encode{true};
+		bool conffile_zero_copy_decode{true};
+		bool conffile_zero_copy_send{false};
+		bool conffile_adaptive_compression{true};
+		std::string conffile_compression_dictionary;
+		int conffile_compression_dictionary_id{0};
+		int conffile_compression_level{0};
+		std::string conffile_control_socket;
+		// Compression settings from the destination sections, the algorithm is empty if it was not given
+		struct ConffileNodeCompression {
+				std::string destination;
+				std::string packet_format;
+				boost::optional<int> level;
+		};
+		std::vector<ConffileNodeCompression> conffile_node_compression;
 
 		while (1) {
-			c = getopt_long(argc, argv, "vhc:l:m:t:s:r:d:p:i:a:", long_options, &option_index);
+			c = getopt_long(argc, argv, "vhc:l:m:t:s:r:d:p:i:a:T:", long_options, &option_index);
 
 			// Detect end of the options
 			if (c == -1) {
@@ -145,6 +182,9 @@ int main(int argc, char *argv[]) {
 			case 'a': // Handling the compression option
 				cmdline_packet_format.assign(optarg);
 				break;
+			case 'T':
+				cfg_train_dictionary.assign(optarg);
+				break;
 			case '?':
 				return 1;
 			default:
@@ -222,6 +262,125 @@ int main(int argc, char *argv[]) {
 			} catch (boost::property_tree::ptree_bad_path &e) {
 				// Ignore if its not found
 			}
+			// Check if the socket write mode is available in the config
+			try {
+				conffile_txmode = pt.get<std::string>("txmode").c_str();
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the socket read mode is available in the config
+			try {
+				conffile_rxmode = pt.get<std::string>("rxmode").c_str();
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the number of socket read threads is available in the config
+			try {
+				conffile_socket_read_threads = pt.get<int>("socketreadthreads");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the I/O engine is available in the config
+			try {
+				conffile_ioengine = pt.get<std::string>("ioengine").c_str();
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the number of TAP queues is available in the config
+			try {
+				conffile_tap_queues = pt.get<int>("tapqueues");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if TAP offloads are available in the config
+			try {
+				conffile_tap_offload = pt.get<bool>("tapoffload");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the number of worker threads is available in the config
+			try {
+				conffile_worker_threads = pt.get<int>("workerthreads");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the worker thread priority is available in the config
+			try {
+				conffile_worker_priority = pt.get<int>("workerpriority");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the number of channels is available in the config
+			try {
+				conffile_channels = pt.get<int>("channels");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if flood encoding is available in the config
+			try {
+				conffile_flood_encode = pt.get<bool>("floodencode");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if zero-copy encoding is available in the config
+			try {
+				conffile_zero_copy_encode = pt.get<bool>("zerocopyencode");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if zero-copy decoding is available in the config
+			try {
+				conffile_zero_copy_decode = pt.get<bool>("zerocopydecode");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if zero-copy sending is available in the config
+			try {
+				conffile_zero_copy_send = pt.get<bool>("zerocopysend");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if adaptive compression is available in the config
+			try {
+				conffile_adaptive_compression = pt.get<bool>("adaptivecompression");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the compression dictionary is available in the config
+			try {
+				conffile_compression_dictionary = pt.get<std::string>("compressiondictionary").c_str();
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the compression dictionary ID is available in the config
+			try {
+				conffile_compression_dictionary_id = pt.get<int>("compressiondictionaryid");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the compression level is available in the config
+			try {
+				conffile_compression_level = pt.get<int>("compressionlevel");
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check if the control socket is available in the config
+			try {
+				conffile_control_socket = pt.get<std::string>("controlsocket").c_str();
+			} catch (boost::property_tree::ptree_bad_path &e) {
+				// Ignore if its not found
+			}
+			// Check for destinations with their own compression settings, these are in sections named "destination <ADDRESS>"
+			for (auto &[section, section_pt] : pt) {
+				if (section.rfind("destination ", 0) != 0 || section_pt.empty()) {
+					continue;
+				}
+				ConffileNodeCompression node_compression;
+				node_compression.destination = section.substr(section.find_first_not_of(' ', 12));
+				node_compression.packet_format = section_pt.get<std::string>("compression", "");
+				node_compression.level = section_pt.get_optional<int>("compressionlevel");
+				conffile_node_compression.push_back(node_compression);
+			}
 		}
 
 		// Work out what log level we're using,
@@ -271,8 +430,8 @@ int main(int argc, char *argv[]) {
 		} else if (conffile_tunnel_dst.size() > 0) {
 			cfg_tunnel_dst = conffile_tunnel_dst;
 		}
-		// Check if mandatory options src and dst are provided
-		if (!cfg_tunnel_dst.size()) {
+		// Check if mandatory options src and dst are provided, we don't need them to train a dictionary
+		if (!cfg_tunnel_dst.size() && cfg_train_dictionary.empty()) {
 			std::cerr << "ERROR: Tunnel destination(s) are mandatory and must be present in" << std::endl;
 			std::cerr << "       either the config file or on the command line." << std::endl;
 			return 1;
@@ -313,17 +472,164 @@ int main(int argc, char *argv[]) {
 		} else if (conffile_packet_format.length() > 0) {
 			cfg_packet_format_str = conffile_packet_format;
 		}
-		if (cfg_packet_format_str.compare("none") == 0) {
-			cfg_packet_format = PacketHeaderOptionFormatType::NONE;
-		} else if (cfg_packet_format_str.compare("lz4") == 0) {
-			cfg_packet_format = PacketHeaderOptionFormatType::COMPRESSED_LZ4;
-
-		} else if (cfg_packet_format_str.compare("zstd") == 0) {
-			cfg_packet_format = PacketHeaderOptionFormatType::COMPRESSED_ZSTD;
-		} else {
+		if (!PacketHeaderOptionFormatTypeFromString(cfg_packet_format_str, cfg_packet_format)) {
 			std::cerr << std::format("ERROR: Invalid compression algorithm '{}'.", cfg_packet_format_str) << std::endl;
 			return 1;
 		}
+
+		// Work out what compression level we're using
+		if (!CompressionLevelIsValid(cfg_packet_format, conffile_compression_level)) {
+			std::cerr << std::format("ERROR: Invalid compression level {} for {}.", conffile_compression_level,
+									 cfg_packet_format_str)
+					  << std::endl;
+			return 1;
+		}
+		cfg_options.compression_level = conffile_compression_level;
+
+		// Work out which destinations have their own compression settings
+		for (auto &node_compression : conffile_node_compression) {
+			if (std::find(cfg_tunnel_dst.begin(), cfg_tunnel_dst.end(), node_compression.destination) == cfg_tunnel_dst.end()) {
+				std::cerr << std::format("ERROR: Compression settings given for '{}' which is not a destination.",
+										 node_compression.destination)
+						  << std::endl;
+				return 1;
+			}
+			// Destinations which only set a level use the global compression algorithm
+			CompressionSettings compression{cfg_packet_format, cfg_options.compression_level};
+			if (!node_compression.packet_format.empty()) {
+				if (!PacketHeaderOptionFormatTypeFromString(node_compression.packet_format, compression.packet_format)) {
+					std::cerr << std::format("ERROR: Invalid compression algorithm '{}' for '{}'.", node_compression.packet_format,
+											 node_compression.destination)
+							  << std::endl;
+					return 1;
+				}
+				compression.level = 0;
+			}
+			if (node_compression.level) {
+				compression.level = *node_compression.level;
+			}
+			if (!CompressionLevelIsValid(compression.packet_format, compression.level)) {
+				std::cerr << std::format("ERROR: Invalid compression level {} for '{}'.", compression.level,
+										 node_compression.destination)
+						  << std::endl;
+				return 1;
+			}
+			try {
+				cfg_options.node_compression[get_key_from_sockaddr(to_sockaddr_storage(node_compression.destination).get())] =
+					compression;
+			} catch (SuperEthernetTunnelException &e) {
+				std::cerr << std::format("ERROR: Failed to convert destination address '{}': {}", node_compression.destination,
+										 e.what())
+						  << std::endl;
+				return 1;
+			}
+		}
+
+		// Work out what socket write mode we're using
+		if (conffile_txmode.length() > 0 && !SocketWriteModeFromString(conffile_txmode, cfg_options.socket_write_mode)) {
+			std::cerr << std::format("ERROR: Invalid socket write mode '{}'.", conffile_txmode) << std::endl;
+			return 1;
+		}
+
+		// Work out what socket read mode we're using
+		if (conffile_rxmode.length() > 0 && !SocketReadModeFromString(conffile_rxmode, cfg_options.socket_read_mode)) {
+			std::cerr << std::format("ERROR: Invalid socket read mode '{}'.", conffile_rxmode) << std::endl;
+			return 1;
+		}
+
+		// Work out how many sockets we're reading from
+		if (conffile_socket_read_threads < 1 || static_cast<size_t>(conffile_socket_read_threads) > SETH_MAX_SOCKET_READ_THREADS) {
+			std::cerr << std::format("ERROR: Invalid socket read thread count. It should be between 1 and {}.",
+									 SETH_MAX_SOCKET_READ_THREADS)
+					  << std::endl;
+			return 1;
+		}
+		cfg_options.socket_read_threads = conffile_socket_read_threads;
+
+		// Work out what I/O engine we're using
+		if (conffile_ioengine.length() > 0 && !IOEngineFromString(conffile_ioengine, cfg_options.io_engine)) {
+			std::cerr << std::format("ERROR: Invalid I/O engine '{}'.", conffile_ioengine) << std::endl;
+			return 1;
+		}
+
+		// Work out how many TAP queues we're using
+		if (conffile_tap_queues > 0) {
+			cfg_options.tap_queues = conffile_tap_queues;
+		}
+		if (conffile_tap_queues < 0 || cfg_options.tap_queues > SETH_MAX_TAP_QUEUES) {
+			std::cerr << std::format("ERROR: Invalid TAP queue count. It should be between 1 and {}.", SETH_MAX_TAP_QUEUES)
+					  << std::endl;
+			return 1;
+		}
+
+		// Work out if we're using TAP offloads
+		cfg_options.tap_offload = conffile_tap_offload;
+
+		// Work out how many worker threads we're using, 0 uses one per CPU core
+		if (conffile_worker_threads < 0 || static_cast<size_t>(conffile_worker_threads) > SETH_MAX_WORKER_THREADS) {
+			std::cerr << std::format("ERROR: Invalid worker thread count. It should be between 0 and {}.", SETH_MAX_WORKER_THREADS)
+					  << std::endl;
+			return 1;
+		}
+		cfg_options.worker_threads = conffile_worker_threads;
+
+		// Work out the realtime priority of the worker threads, 0 leaves them at normal priority
+		int max_worker_priority = sched_get_priority_max(SCHED_RR);
+		if (conffile_worker_priority < 0 || conffile_worker_priority > max_worker_priority) {
+			std::cerr << std::format("ERROR: Invalid worker thread priority. It should be between 0 and {}.", max_worker_priority)
+					  << std::endl;
+			return 1;
+		}
+		cfg_options.worker_priority = conffile_worker_priority;
+
+		// Work out how many channels we're using for each remote node
+		if (conffile_channels < 1 || static_cast<size_t>(conffile_channels) > SETH_MAX_CHANNELS) {
+			std::cerr << std::format("ERROR: Invalid channel count. It should be between 1 and {}.", SETH_MAX_CHANNELS)
+					  << std::endl;
+			return 1;
+		}
+		cfg_options.channels = conffile_channels;
+
+		// Work out if we're encoding flooded frames once for all the remote nodes
+		cfg_options.flood_encode = conffile_flood_encode;
+
+		// Work out if we're referencing frames from the encoded packets instead of copying them
+		cfg_options.zero_copy_encode = conffile_zero_copy_encode;
+
+		// Work out if we're writing frames to the TAP interface straight out of the packets they were received in
+		cfg_options.zero_copy_decode = conffile_zero_copy_decode;
+
+		// Work out if we're sending large packets using MSG_ZEROCOPY
+		cfg_options.zero_copy_send = conffile_zero_copy_send;
+
+		// Work out if we're skipping compression for flows that don't compress
+		cfg_options.adaptive_compression = conffile_adaptive_compression;
+
+		// Work out if we're using a control socket
+		cfg_options.control_socket = conffile_control_socket;
+
+		// Load the compression dictionary if we're using one
+		if (conffile_compression_dictionary.length() > 0 && cfg_train_dictionary.empty()) {
+			try {
+				cfg_options.compression_dictionary =
+					std::make_shared<const std::string>(load_compression_dictionary(conffile_compression_dictionary));
+			} catch (SuperEthernetTunnelException &e) {
+				std::cerr << std::format("ERROR: {}.", e.what()) << std::endl;
+				return 1;
+			}
+		}
+
+		// Work out the ID of the compression dictionary, 0 derives it from the dictionary
+		if (conffile_compression_dictionary_id < 0 || conffile_compression_dictionary_id > 255) {
+			std::cerr << "ERROR: Invalid compression dictionary ID. It should be between 0 and 255." << std::endl;
+			return 1;
+		}
+		cfg_options.compression_dictionary_id = conffile_compression_dictionary_id;
+	}
+
+	// Train a compression dictionary instead of starting the tunnel
+	if (!cfg_train_dictionary.empty()) {
+		return train_seth_dictionary(cfg_ifname, cfg_mtu, cfg_train_dictionary);
 	}
 
 	/*
@@ -343,7 +649,6 @@ int main(int argc, char *argv[]) {
 
 	// Convert remote address to a IPv6 sockaddr
 	std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs;
-	std::vector<std::string> dst_addr_strs;
 	for (auto &dst : cfg_tunnel_dst) {
 		std::shared_ptr<struct sockaddr_storage> dst_addr;
 		try {
@@ -354,8 +659,6 @@ int main(int argc, char *argv[]) {
 		}
 		// Add to destination address list
 		dst_addrs.push_back(dst_addr);
-		// Add to string list too
-		dst_addr_strs.push_back(get_ipstr(dst_addr.get()));
 	}
 
 	// Set our log level
@@ -365,17 +668,26 @@ int main(int argc, char *argv[]) {
 	std::cerr << std::format("Interface...: {}", cfg_ifname) << std::endl;
 	std::cerr << std::format("Source......: {}", src_addr_str) << std::endl;
 	std::cerr << std::format("Destinations:") << std::endl;
-	for (auto &ipstr : dst_addr_strs) {
-		std::cerr << std::format("    - {}", ipstr) << std::endl;
+	for (auto &dst_addr : dst_addrs) {
+		auto node_compression = cfg_options.node_compression.find(get_key_from_sockaddr(dst_addr.get()));
+		if (node_compression != cfg_options.node_compression.end()) {
+			std::cerr << std::format("    - {} (compression: {})", get_ipstr(dst_addr.get()),
+									 CompressionSettingsToString(node_compression->second))
+					  << std::endl;
+		} else {
+			std::cerr << std::format("    - {}", get_ipstr(dst_addr.get())) << std::endl;
+		}
 	}
 	std::cerr << std::format("UDP Port....: {}", cfg_tunnel_port) << std::endl;
 	std::cerr << std::format("MTU.........: {}", cfg_mtu) << std::endl;
 	std::cerr << std::format("TX Size.....: {}", cfg_txsize) << std::endl;
-	std::cerr << std::format("Format......: {}", PacketHeaderOptionFormatTypeToString(cfg_packet_format)) << std::endl;
+	std::cerr << std::format("Format......: {}",
+							 CompressionSettingsToString(CompressionSettings{cfg_packet_format, cfg_options.compression_level}))
+			  << std::endl;
 	std::cerr << std::endl;
 
 	// Start SETH
-	start_seth(cfg_ifname, cfg_mtu, cfg_txsize, cfg_packet_format, src_addr, dst_addrs, cfg_tunnel_port);
+	start_seth(cfg_ifname, cfg_mtu, cfg_txsize, cfg_packet_format, src_addr, dst_addrs, cfg_tunnel_port, cfg_options);
 
 	return 0;
 }
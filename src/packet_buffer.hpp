@@ -8,8 +8,12 @@
 
 #include "libaccl/buffer.hpp"
 #include <cstdint>
+#include <memory>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <utility>
+#include <vector>
 
 /**
  * @brief PacketBuffer class
@@ -18,6 +22,14 @@
 class PacketBuffer : public accl::Buffer {
 	public:
 		inline PacketBuffer(std::size_t size);
+		inline PacketBuffer(std::size_t size, char *external_storage);
+		inline PacketBuffer(PacketBuffer *backing, std::size_t offset, std::size_t size);
+
+		static inline std::unique_ptr<PacketBuffer> createView(accl::BufferArena *arena, PacketBuffer *backing, std::size_t offset,
+															   std::size_t size);
+
+		inline PacketBuffer(const PacketBuffer &other);
+		inline PacketBuffer &operator=(const PacketBuffer &other);
 
 		inline uint32_t getPacketSequenceKey() const;
 		inline void setPacketSequenceKey(uint32_t k);
@@ -31,11 +43,35 @@ class PacketBuffer : public accl::Buffer {
 
 		inline bool operator<(const PacketBuffer &other) const;
 
+		/**
+		 * @brief Buffer referenced by a packet instead of being copied into it.
+		 *
+		 */
+		struct Fragment {
+				// Offset of our own data the fragment is sent after
+				std::size_t offset;
+				std::unique_ptr<PacketBuffer> buffer;
+		};
+
+		inline void appendFragment(std::unique_ptr<PacketBuffer> buffer);
+		inline std::vector<Fragment> &getFragments();
+		inline void clearFragments();
+		inline bool hasFragments() const;
+
+		inline std::size_t getPacketSize() const;
+		inline std::size_t getIOVecCount() const;
+		inline std::size_t getIOVecs(iovec *iovs);
+
 	private:
 		uint32_t packet_sequence_key;
 
 		sockaddr_storage source;
 		uint64_t source_key;
+
+		// Buffers sent along with our own data, making up the packet together with it
+		std::vector<Fragment> fragments;
+		// Total size of the data in the fragments
+		std::size_t fragment_size;
 };
 
 /**
@@ -43,7 +79,77 @@ class PacketBuffer : public accl::Buffer {
  *
  * @param size Packet buffer size.
  */
-inline PacketBuffer::PacketBuffer(std::size_t size) : Buffer(size), packet_sequence_key(0), source_key(0){};
+inline PacketBuffer::PacketBuffer(std::size_t size) : Buffer(size), packet_sequence_key(0), source_key(0), fragment_size(0){};
+
+/**
+ * @brief Construct a new PacketBuffer::PacketBuffer object using external storage, this is used by arena allocated pools.
+ *
+ * @param size Packet buffer size.
+ * @param external_storage Storage to use for the packet data.
+ */
+inline PacketBuffer::PacketBuffer(std::size_t size, char *external_storage)
+	: Buffer(size, external_storage), packet_sequence_key(0), source_key(0), fragment_size(0){};
+
+/**
+ * @brief Construct a new PacketBuffer::PacketBuffer object which is a view of part of another packet buffer.
+ *
+ * The packet source is copied from the backing buffer, the packet data is not.
+ *
+ * @param backing Packet buffer to create a view of.
+ * @param offset Offset of the view in the backing buffer.
+ * @param size Size of the view.
+ */
+inline PacketBuffer::PacketBuffer(PacketBuffer *backing, std::size_t offset, std::size_t size)
+	: Buffer(backing, offset, size), packet_sequence_key(0), source(backing->source), source_key(backing->source_key),
+	  fragment_size(0){};
+
+/**
+ * @brief Create a view of part of another packet buffer in a free object of an arena, so no heap allocation is needed.
+ *
+ * The object goes back to the arena when the view is deleted. If the arena has no free objects the view is allocated on the heap.
+ *
+ * @param arena Arena created using accl::BufferArena::createSlots() to hold PacketBuffer objects.
+ * @param backing Packet buffer to create a view of, this must be shared or be a view.
+ * @param offset Offset of the view in the backing buffer.
+ * @param size Size of the view.
+ * @return std::unique_ptr<PacketBuffer> View.
+ */
+inline std::unique_ptr<PacketBuffer> PacketBuffer::createView(accl::BufferArena *arena, PacketBuffer *backing, std::size_t offset,
+															  std::size_t size) {
+	void *slot = arena->allocateSlot();
+	if (!slot) {
+		return std::make_unique<PacketBuffer>(backing, offset, size);
+	}
+	try {
+		return std::unique_ptr<PacketBuffer>(new (slot) PacketBuffer(backing, offset, size));
+	} catch (...) {
+		accl::BufferArena::releaseObject(slot);
+		throw;
+	}
+}
+
+/**
+ * @brief Construct a new PacketBuffer::PacketBuffer object, fragments belong to a single buffer so they are not copied.
+ *
+ * @param other Packet buffer to copy.
+ */
+inline PacketBuffer::PacketBuffer(const PacketBuffer &other)
+	: Buffer(other), packet_sequence_key(other.packet_sequence_key), source(other.source), source_key(other.source_key),
+	  fragment_size(0){};
+
+/**
+ * @brief Copy assignment operator, fragments belong to a single buffer so they are not copied and ours are kept.
+ *
+ * @param other Packet buffer to copy.
+ * @return PacketBuffer& Reference to this packet buffer.
+ */
+inline PacketBuffer &PacketBuffer::operator=(const PacketBuffer &other) {
+	Buffer::operator=(other);
+	this->packet_sequence_key = other.packet_sequence_key;
+	this->source = other.source;
+	this->source_key = other.source_key;
+	return *this;
+}
 
 /**
  * @brief Get the packet sequence key
@@ -104,3 +210,77 @@ inline void PacketBuffer::setPacketSourceKey(uint64_t key) { this->source_key =
 inline bool PacketBuffer::operator<(const PacketBuffer &other) const {
 	return this->packet_sequence_key < other.packet_sequence_key;
 }
+
+/**
+ * @brief Append a buffer to the packet without copying it, it is sent after the data currently in the packet buffer.
+ *
+ * Data appended to the packet buffer afterwards is sent after the fragment. The fragment is owned by the packet buffer until it is
+ * released using clearFragments().
+ *
+ * @param buffer Buffer to append.
+ */
+inline void PacketBuffer::appendFragment(std::unique_ptr<PacketBuffer> buffer) {
+	this->fragment_size += buffer->getDataSize();
+	this->fragments.push_back(Fragment{this->getDataSize(), std::move(buffer)});
+}
+
+/**
+ * @brief Get the fragments of the packet, the buffers they hold can be moved out before clearing them with clearFragments().
+ *
+ * @return std::vector<Fragment>& Fragments.
+ */
+inline std::vector<PacketBuffer::Fragment> &PacketBuffer::getFragments() { return this->fragments; }
+
+/**
+ * @brief Clear the fragments of the packet, leaving the packet with only our own data.
+ *
+ * The fragments are cleared in place, so the capacity of the vector is kept for the next time the packet buffer is used.
+ */
+inline void PacketBuffer::clearFragments() {
+	this->fragment_size = 0;
+	this->fragments.clear();
+}
+
+/**
+ * @brief Check if the packet has fragments.
+ *
+ * @return true If the packet is made up of our data and fragments.
+ * @return false If the packet is only our data.
+ */
+inline bool PacketBuffer::hasFragments() const { return !this->fragments.empty(); }
+
+/**
+ * @brief Get the size of the packet, this is the size of our data and the fragments.
+ *
+ * @return std::size_t Packet size.
+ */
+inline std::size_t PacketBuffer::getPacketSize() const { return this->getDataSize() + this->fragment_size; }
+
+/**
+ * @brief Get the maximum number of IO vectors needed to send the packet.
+ *
+ * @return std::size_t Number of IO vectors.
+ */
+inline std::size_t PacketBuffer::getIOVecCount() const { return (this->fragments.size() * 2) + 1; }
+
+/**
+ * @brief Fill in the IO vectors to send the packet, our data is split up around the fragments.
+ *
+ * @param iovs IO vectors to fill in, there must be at least getIOVecCount() of them.
+ * @return std::size_t Number of IO vectors filled in.
+ */
+inline std::size_t PacketBuffer::getIOVecs(iovec *iovs) {
+	std::size_t count = 0;
+	std::size_t offset = 0;
+	for (auto &fragment : this->fragments) {
+		if (fragment.offset > offset) {
+			iovs[count++] = iovec{this->getData() + offset, fragment.offset - offset};
+			offset = fragment.offset;
+		}
+		iovs[count++] = iovec{fragment.buffer->getData(), fragment.buffer->getDataSize()};
+	}
+	if (this->getDataSize() > offset || !count) {
+		iovs[count++] = iovec{this->getData() + offset, this->getDataSize() - offset};
+	}
+	return count;
+}
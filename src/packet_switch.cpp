@@ -7,26 +7,38 @@
 #include "packet_switch.hpp"
 #include "common.hpp"
 #include "exceptions.hpp"
-#include "fdb_entry.hpp"
+#include "io_uring_engine.hpp"
 #include "libaccl/buffer_pool.hpp"
 #include "libaccl/logger.hpp"
 #include "libsethnetkit/ethernet_packet.hpp"
 #include "packet_buffer.hpp"
+#include "socket_reader.hpp"
 #include "threads.hpp"
 #include "util.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <charconv>
 #include <cstddef>
 #include <cstring>
+#include <format>
 #include <memory>
+#include <pthread.h>
 #include <sched.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef HAVE_LIBURING
+// Index of the files registered with our io_uring engines
+static constexpr unsigned int IO_URING_FILE_TAP{0};
+static constexpr unsigned int IO_URING_FILE_SOCKET{1};
+#endif
+
 PacketSwitch::PacketSwitch(const std::string ifname, int mtu, int tx_size, PacketHeaderOptionFormatType packet_format,
 						   std::shared_ptr<struct sockaddr_storage> src_addr,
-						   std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs, int port) {
+						   std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs, int port,
+						   const PacketSwitchOptions &options) {
 	// MTU
 	this->mtu = mtu;
 	if (this->mtu > SETH_MAX_MTU_SIZE) {
@@ -52,11 +64,27 @@ PacketSwitch::PacketSwitch(const std::string ifname, int mtu, int tx_size, Packe
 	// Set up packet format
 	this->packet_format = packet_format;
 
+	// Set up advanced options
+	this->options = options;
+
+	// Fall back to blocking I/O if we can't use io_uring
+	if (this->options.io_engine == IOEngine::IO_URING) {
+#ifdef HAVE_LIBURING
+		if (!IOUringEngine::isSupported()) {
+			LOG_NOTICE("io_uring is not supported, falling back to blocking I/O");
+			this->options.io_engine = IOEngine::BLOCKING;
+		}
+#else
+		LOG_NOTICE("io_uring support was not compiled in, falling back to blocking I/O");
+		this->options.io_engine = IOEngine::BLOCKING;
+#endif
+	}
+
 	// Set up our source address
 	this->src_addr = src_addr;
 
 	// Create TAP interface
-	this->tap_interface = std::make_unique<TAPInterface>(ifname);
+	this->tap_interface = std::make_unique<TAPInterface>(ifname, this->options.tap_queues, this->options.tap_offload);
 	this->tap_interface->setMTU(this->mtu);
 
 	// Initialize the udp socket to 0 to indicate its not been setup
@@ -72,49 +100,163 @@ PacketSwitch::PacketSwitch(const std::string ifname, int mtu, int tx_size, Packe
 	// Get maximum ethernet frame size we can get
 	this->l2mtu = get_l2mtu_from_mtu(mtu);
 
+	// With TAP offloads the frames have a virtio-net header in front of them and can be GSO frames, these can be up to the maximum
+	// packet size we can encode
+	this->max_frame_size = this->options.tap_offload ? SETH_PACKET_MAX_SIZE : this->l2mtu;
+
 	// Add on 10% of the buffer size to cater for compression overhead
-	int buffer_size = this->l2mtu + (this->l2mtu / 10);
+	int buffer_size = this->max_frame_size + (this->max_frame_size / 10);
 
-	// Work out buffer count
-	int buffer_count = SETH_BUFFER_COUNT * dst_addrs.size();
+	// Work out the buffer count of each remote node
+	int node_buffer_count = SETH_BUFFER_COUNT;
 
-	// Multiply buffer size by the number of packets taken to construct the interface MTU size
-	if (int mtu_mutiplier = this->mtu / this->tx_size > 0) {
-		buffer_count *= mtu_mutiplier;
+	if (this->options.tap_offload) {
+		// Our buffers are much larger with TAP offloads, so we use less of them
+		node_buffer_count = SETH_TAP_OFFLOAD_BUFFER_COUNT;
+	} else if (int mtu_mutiplier = this->mtu / this->tx_size > 0) {
+		// Multiply buffer size by the number of packets taken to construct the interface MTU size
+		node_buffer_count *= mtu_mutiplier;
 	}
 
-	// Available RX and TX buffer pools
-	this->available_rx_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, buffer_count);
-	this->available_tx_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, buffer_count);
-	this->tap_write_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size);
+	// The shared available buffer pools hold the buffers of all the remote nodes, the queues of each node and channel only need
+	// room for the nodes share so their memory doesn't grow with the square of the number of nodes
+	int buffer_count = node_buffer_count * dst_addrs.size();
+
+	// Available RX and TX buffer pools, these are carved out of hugepage-backed arenas to keep the buffers contiguous
+	this->available_rx_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(
+		buffer_size, buffer_count, buffer_count, accl::BufferPoolAllocation::ARENA);
+	this->available_tx_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(
+		buffer_size, buffer_count, buffer_count, accl::BufferPoolAllocation::ARENA);
+	LOG_INFO("Allocated 2x ", buffer_count, " buffers of ", buffer_size, " bytes in ",
+			 this->available_rx_buffer_pool->getArena()->isHugePages() ? "hugepage" : "transparent hugepage", " arenas");
+	// Give each thread its own cache of available buffers so most pops and pushes don't touch the shared pools
+	this->available_rx_buffer_pool->setThreadCacheSize(SETH_BUFFER_CACHE_SIZE);
+	this->available_tx_buffer_pool->setThreadCacheSize(SETH_BUFFER_CACHE_SIZE);
+	// Each TAP queue has its own write pool, each of these can hold all the buffers in flight along with all the frame views the
+	// decoders can have out when zero-copy decoding, so the workers running the decoders never wait for space
+	size_t tap_write_pool_capacity = buffer_count;
+	if (this->options.zero_copy_decode) {
+		tap_write_pool_capacity += dst_addrs.size() * this->options.channels * SETH_ZERO_COPY_VIEW_COUNT;
+	}
+	for (size_t queue = 0; queue < this->tap_interface->getQueueCount(); ++queue) {
+		this->tap_write_pools.push_back(std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, 0, tap_write_pool_capacity));
+	}
 
-	// Create UDP socket
-	this->_create_udp_socket();
+	// Create the scheduler running the encoders and decoders of all the remote nodes, with a worker per CPU core by default
+	size_t worker_threads = this->options.worker_threads;
+	if (!worker_threads) {
+		worker_threads = std::max(std::thread::hardware_concurrency(), 1U);
+	}
+	this->scheduler = std::make_shared<accl::TaskScheduler>(worker_threads);
+
+	// Create UDP sockets
+	this->_create_udp_sockets();
+	// Large packets can be sent straight out of our buffers, the kernel tells us on the socket when it is done with them
+	if (this->options.zero_copy_send) {
+		this->zero_copy_tracker = std::make_shared<ZeroCopyTracker>(this->udp_socket);
+	}
 
 	// Loop with dst_addrs and crate RemoteNodes to be added to our remote_nodes map
 	for (auto &dst_addr : dst_addrs) {
+		// Use the global compression settings unless the node has its own
+		CompressionSettings compression{this->packet_format, this->options.compression_level};
+		auto node_compression = this->options.node_compression.find(get_key_from_sockaddr(dst_addr.get()));
+		if (node_compression != this->options.node_compression.end()) {
+			compression = node_compression->second;
+		}
 		// Create remote node
-		auto remote_node = std::make_shared<RemoteNode>(this->udp_socket, dst_addr, this->tx_size, this->l2mtu, buffer_size,
-														this->packet_format, this->tap_write_pool, this->available_rx_buffer_pool,
-														this->available_tx_buffer_pool, &this->stop_flag);
-		// Add to our remote nodes map
+		auto remote_node = std::make_shared<RemoteNode>(
+			this->udp_socket, dst_addr, this->tx_size, this->max_frame_size, buffer_size, node_buffer_count, compression,
+			this->options, this->tap_write_pools, this->available_rx_buffer_pool, this->available_tx_buffer_pool, this->scheduler);
+		remote_node->setZeroCopyTracker(this->zero_copy_tracker);
+		// Add to our remote nodes map and table
 		this->remote_nodes[remote_node->getNodeKey()] = remote_node;
+		this->remote_node_table.add(remote_node);
+	}
+
+	// With multiple remote nodes flooded frames are queued to each of them as views, these come out of an arena shared by all the
+	// threads flooding frames so flooding doesn't allocate
+	this->flood_view_arena = nullptr;
+	if (this->remote_nodes.size() > 1) {
+		this->flood_view_arena = accl::BufferArena::createSlots(sizeof(PacketBuffer), alignof(PacketBuffer),
+																 SETH_FLOOD_VIEW_COUNT * this->remote_nodes.size());
+	}
+
+	// With multiple remote nodes each TAP queue gets a flood task, so flooded frames are encoded once for all of them, the
+	// packets need to fit the smallest L4MTU of the nodes, flood packets use the global compression settings as each one holds a
+	// single frame which any node can decode
+	if (this->options.flood_encode && this->remote_nodes.size() > 1) {
+		uint16_t flood_l4mtu = UINT16_MAX;
+		for (auto &[node_key, remote_node] : this->remote_nodes) {
+			flood_l4mtu = std::min(flood_l4mtu, remote_node->getL4MTUSize());
+			this->flood_addrs.push_back(remote_node->getNodeAddr());
+		}
+		for (size_t queue = 0; queue < this->tap_interface->getQueueCount(); ++queue) {
+			this->flood_tasks.push_back(std::make_unique<FloodTask>(this, flood_l4mtu, buffer_size, buffer_count));
+		}
+	}
+
+	// Create the control socket, commands are only accepted once we're started
+	if (!this->options.control_socket.empty()) {
+		this->control_socket = std::make_unique<ControlSocket>(
+			this->options.control_socket, [this](const std::vector<std::string> &args) { return this->_control_command(args); });
 	}
 }
 
 PacketSwitch::~PacketSwitch() {
 	// FIXME
 	LOG_WARNING("NKDEBUG: NOT YET IMPLEMENTED");
+	// Views still queued keep the arena around until they are released
+	if (this->flood_view_arena) {
+		this->flood_view_arena->release();
+	}
 }
 
 void PacketSwitch::start() {
 	LOG_DEBUG_INTERNAL("Starting packet switch...");
 
-	// Initialize threads
-	this->tunnel_tap_read_thread = std::make_unique<std::thread>(&PacketSwitch::tunnel_tap_read_handler, this);
-	this->tunnel_socket_read_thread = std::make_unique<std::thread>(&PacketSwitch::tunnel_socket_read_handler, this);
-	this->tunnel_tap_write_thread = std::make_unique<std::thread>(&PacketSwitch::tunnel_tap_write_handler, this);
+	// Loop with remote nodes and start them, this needs to be done before we start reading frames and packets for them
+	for (auto &remote_node : this->remote_nodes) {
+		remote_node.second->start();
+	}
+
+	// Start the workers running the remote node encoders and decoders, these stay at normal priority unless configured otherwise as
+	// they busy all the CPU cores and would starve everything else at the highest realtime priority
+	this->scheduler->start();
+	if (this->options.worker_priority) {
+		for (size_t worker = 0; worker < this->scheduler->getWorkerCount(); ++worker) {
+			this->_set_thread_priority(this->scheduler->getWorkerThread(worker), "worker", this->options.worker_priority);
+		}
+	}
+
+	// Initialize threads, each TAP queue gets its own read and write thread, when using io_uring a single thread per TAP queue
+	// reads from the TAP queue and the socket with the same index
+	for (size_t queue = 0; queue < this->tap_interface->getQueueCount(); ++queue) {
+		if (this->options.io_engine == IOEngine::IO_URING) {
+#ifdef HAVE_LIBURING
+			this->tunnel_io_uring_threads.push_back(
+				std::make_unique<std::thread>(&PacketSwitch::tunnel_io_uring_handler, this, queue));
+#endif
+		} else {
+			this->tunnel_tap_read_threads.push_back(
+				std::make_unique<std::thread>(&PacketSwitch::tunnel_tap_read_handler, this, queue));
+		}
+		this->tunnel_tap_write_threads.push_back(
+			std::make_unique<std::thread>(&PacketSwitch::tunnel_tap_write_handler, this, queue));
+	}
+	// Each socket not read by an io_uring thread gets its own read thread
+	size_t first_socket_read = 0;
+	if (this->options.io_engine == IOEngine::IO_URING) {
+		first_socket_read = std::min(this->tap_interface->getQueueCount(), this->udp_sockets.size());
+	}
+	for (size_t index = first_socket_read; index < this->udp_sockets.size(); ++index) {
+		this->tunnel_socket_read_threads.push_back(
+			std::make_unique<std::thread>(&PacketSwitch::tunnel_socket_read_handler, this, index));
+	}
 	this->fdb_thread = std::make_unique<std::thread>(&PacketSwitch::fdb_handler, this);
+	if (this->control_socket) {
+		this->control_socket->start();
+	}
 
 	// Set process nice value
 	int niceValue = -10;
@@ -122,25 +264,35 @@ void PacketSwitch::start() {
 		throw SuperEthernetTunnelRuntimeException("Could not set process nice value: " + std::string(strerror(errno)));
 	}
 
-	// Setup priority for a thread
-	int policy = SCHED_RR;
-	struct sched_param param;
-	param.sched_priority = sched_get_priority_max(SCHED_RR);
-	if (pthread_setschedparam(tunnel_tap_read_thread->native_handle(), policy, &param)) {
-		LOG_NOTICE("Could not set TAP device thread priority: ", std::strerror(errno));
+	// Setup priority for the threads, with multiple TAP queues we also pin the threads of each queue to their own core
+	bool pin_threads = this->tap_interface->getQueueCount() > 1;
+	for (size_t queue = 0; queue < this->tunnel_tap_read_threads.size(); ++queue) {
+		this->_set_thread_priority(*this->tunnel_tap_read_threads[queue], "TAP device");
+		if (pin_threads) {
+			this->_set_thread_cpu(*this->tunnel_tap_read_threads[queue], queue, "TAP device");
+		}
 	}
-	if (pthread_setschedparam(tunnel_socket_read_thread->native_handle(), policy, &param)) {
-		LOG_NOTICE("Could not set socket read thread priority: ", std::strerror(errno));
+	// With multiple sockets the socket read threads are pinned to the cores after the ones used by the TAP queues
+	for (size_t index = 0; index < this->tunnel_socket_read_threads.size(); ++index) {
+		this->_set_thread_priority(*this->tunnel_socket_read_threads[index], "socket read");
+		if (this->udp_sockets.size() > 1) {
+			this->_set_thread_cpu(*this->tunnel_socket_read_threads[index], this->tap_interface->getQueueCount() + index,
+								  "socket read");
+		}
 	}
-	if (pthread_setschedparam(tunnel_tap_write_thread->native_handle(), policy, &param)) {
-		LOG_NOTICE("Could not set TAP write thread priority: ", std::strerror(errno));
+	for (size_t queue = 0; queue < this->tunnel_io_uring_threads.size(); ++queue) {
+		this->_set_thread_priority(*this->tunnel_io_uring_threads[queue], "io_uring");
+		if (pin_threads) {
+			this->_set_thread_cpu(*this->tunnel_io_uring_threads[queue], queue, "io_uring");
+		}
 	}
-	// NOTE: We don't need to change the priority of the FDB thread as its not in a critical path
-
-	// Loop with remote nodes and start them
-	for (auto &remote_node : this->remote_nodes) {
-		remote_node.second->start();
+	for (size_t queue = 0; queue < this->tunnel_tap_write_threads.size(); ++queue) {
+		this->_set_thread_priority(*this->tunnel_tap_write_threads[queue], "TAP write");
+		if (pin_threads) {
+			this->_set_thread_cpu(*this->tunnel_tap_write_threads[queue], queue, "TAP write");
+		}
 	}
+	// NOTE: We don't need to change the priority of the FDB thread as its not in a critical path
 
 	// Bring the TAP interface online
 	this->tap_interface->start();
@@ -151,15 +303,25 @@ void PacketSwitch::start() {
  */
 void PacketSwitch::wait() {
 	// Join all threads and wait for them to exit
-	this->tunnel_tap_read_thread->join();
-	this->tunnel_socket_read_thread->join();
-	this->tunnel_tap_write_thread->join();
+	for (auto &thread : this->tunnel_tap_read_threads) {
+		thread->join();
+	}
+	for (auto &thread : this->tunnel_socket_read_threads) {
+		thread->join();
+	}
+	for (auto &thread : this->tunnel_io_uring_threads) {
+		thread->join();
+	}
+	for (auto &thread : this->tunnel_tap_write_threads) {
+		thread->join();
+	}
 	this->fdb_thread->join();
-
-	// Loop with each node and wait for it to exit
-	for (auto &remote_node : this->remote_nodes) {
-		remote_node.second->wait();
+	if (this->control_socket) {
+		this->control_socket->wait();
 	}
+
+	// Stop the workers once nothing can queue work for them anymore
+	this->scheduler->stop();
 }
 
 /**
@@ -168,6 +330,9 @@ void PacketSwitch::wait() {
 void PacketSwitch::stop() {
 	LOG_NOTICE("Stopping packet switch...");
 	this->stop_flag = true;
+	if (this->control_socket) {
+		this->control_socket->stop();
+	}
 }
 
 /**
@@ -188,12 +353,16 @@ uint16_t get_l2mtu_from_mtu(uint16_t mtu) {
 }
 
 /**
- * @brief Thread responsible for reading from the TAP interface.
+ * @brief Thread responsible for reading from a TAP interface queue.
  *
- * @param arg Thread data.
+ * The kernel picks the queue of each frame using its flow, so the frames of a flow are always read by the same thread.
+ *
+ * @param queue TAP interface queue.
  */
-void PacketSwitch::tunnel_tap_read_handler() {
-	LOG_DEBUG_INTERNAL("TAP READ: Starting TAP read thread");
+void PacketSwitch::tunnel_tap_read_handler(size_t queue) {
+	LOG_DEBUG_INTERNAL("TAP READ: Starting TAP read thread for queue ", queue);
+
+	int tap_fd = this->tap_interface->getFD(queue);
 
 	// Loop and read data from TAP device
 	while (true) {
@@ -206,78 +375,155 @@ void PacketSwitch::tunnel_tap_read_handler() {
 		LOG_DEBUG_INTERNAL("AVAIL POOL: Buffer pool count: ", this->available_rx_buffer_pool->getBufferCount(), ", taking one");
 		auto buffer = this->available_rx_buffer_pool->pop_wait();
 
-	loop_restart:
-		// Read data from TAP interface
-		ssize_t bytes_read = read(this->tap_interface->getFD(), buffer->getData(), buffer->getBufferSize());
-		if (bytes_read == -1) {
-			LOG_ERROR("Got an error read()'ing TAP device: ", strerror(errno));
-			exit(EXIT_FAILURE);
-		} else if (bytes_read == 0) {
-			LOG_ERROR("Got EOF from TAP device: ", strerror(errno));
-			exit(EXIT_FAILURE);
-		}
-
-		LOG_DEBUG_INTERNAL("TAP READ: Read ", bytes_read, " bytes from TAP");
-		buffer->setDataSize(bytes_read);
-
-		// Overlay ethernet header ontop of the packet
-		const ethernet_header_t *ethernet_packet = (ethernet_header_t *)buffer->getData();
-		// Do a quick sanity check on the source MAC
-		if (ethernet_packet->src_mac[0] & 0x01) {
-			LOG_ERROR("Packet from ethernet device has a source MAC which is a multicast group address, DROPPING!");
-			goto loop_restart;
-		}
-
-		// Update FDB entry if we found one, we do this in a separate scope to clear the mutex
-		std::shared_ptr<FDBEntry> fdb_entry;
-		{
-			std::shared_lock<std::shared_mutex> lock(this->fdb_mtx);
-			fdb_entry = this->fdb->get((const FDBMACAddress *)&ethernet_packet->src_mac);
-			if (fdb_entry) {
-				// std::unique_lock<std::shared_mutex> lock(fdb_mtx);
-				fdb_entry->updateLastSeen();
+		// Read frames into the buffer until one is forwarded
+		do {
+			// Read data from TAP interface
+			ssize_t bytes_read = read(tap_fd, buffer->getData(), buffer->getBufferSize());
+			if (bytes_read == -1) {
+				LOG_ERROR("Got an error read()'ing TAP device: ", strerror(errno));
+				exit(EXIT_FAILURE);
+			} else if (bytes_read == 0) {
+				LOG_ERROR("Got EOF from TAP device: ", strerror(errno));
+				exit(EXIT_FAILURE);
 			}
+
+			LOG_DEBUG_INTERNAL("TAP READ: Read ", bytes_read, " bytes from TAP");
+			buffer->setDataSize(bytes_read);
+		} while (!this->_tap_read_frame(queue, buffer));
+	}
+
+	LOG_DEBUG_INTERNAL("TAP READ: Exiting TAP read thread for queue ", queue);
+}
+
+/**
+ * @brief Internal method to switch a frame read from the TAP interface to the remote nodes.
+ *
+ * @param queue TAP interface queue the frame was read from.
+ * @param buffer Buffer holding the frame, this is moved out of if the frame was queued for the remote nodes.
+ * @return true If the frame was queued for the remote nodes.
+ * @return false If the frame was dropped or already sent, the buffer can be reused.
+ */
+bool PacketSwitch::_tap_read_frame(size_t queue, std::unique_ptr<PacketBuffer> &buffer) {
+	// Make sure the frame fits within the limits of what we can encode
+	size_t header_size = this->tap_interface->getHeaderSize();
+	if (buffer->getDataSize() < header_size + sizeof(ethernet_header_t) || buffer->getDataSize() > this->max_frame_size) {
+		LOG_ERROR("Frame from ethernet device has an invalid size ", buffer->getDataSize(), ", DROPPING!");
+		return false;
+	}
+
+	// Overlay ethernet header ontop of the packet, skipping over the virtio-net header if we have one
+	const ethernet_header_t *ethernet_packet = (ethernet_header_t *)(buffer->getData() + header_size);
+	// Do a quick sanity check on the source MAC
+	if (ethernet_packet->src_mac[0] & 0x01) {
+		LOG_ERROR("Packet from ethernet device has a source MAC which is a multicast group address, DROPPING!");
+		return false;
+	}
+
+	// Update FDB entry if we found one, if we didn't find one, we need to create one
+	if (!this->fdb->touch((const FDBMACAddress *)&ethernet_packet->src_mac)) {
+		this->fdb->add((const FDBMACAddress *)&ethernet_packet->src_mac, nullptr);
+	}
+
+	// Check if the destination MAC is a broadcast address
+	if (ethernet_packet->dst_mac[0] & 0x01) {
+		// If there is a single node in the remote nodes list, then we can just send it to that node
+		if (this->remote_nodes.size() == 1) {
+			auto remote_node = this->remote_nodes.begin()->second;
+			remote_node->queueEncode(std::move(buffer));
+		} else if (!this->flood_tasks.empty()) {
+			// Encoding and sending flood packets is left to our flood task so we can get back to reading the TAP device
+			this->flood_tasks[queue]->queue(std::move(buffer));
+		} else {
+			this->_flood_frame(std::move(buffer));
 		}
-		// If we didn't find one, we need to create one, the lock, then add
-		if (!fdb_entry) {
-			std::unique_lock<std::shared_mutex> lock(this->fdb_mtx);
-			fdb->add((const FDBMACAddress *)&ethernet_packet->src_mac, nullptr);
+		// This is not a broadcast, so just send it to the unicast address
+	} else {
+		RemoteNode *remote_node = this->fdb->getRemoteNode((const FDBMACAddress *)ethernet_packet->dst_mac);
+		// If we don't have a target or the target is local, then we need ignore this packet and just continue
+		if (!remote_node) {
+			return false;
 		}
+		// We got a target, so queue the buffer to be encoded
+		remote_node->queueEncode(std::move(buffer));
+	}
 
-		// Check if the destination MAC is a broadcast address
-		if (ethernet_packet->dst_mac[0] & 0x01) {
-			// If there is a single node in the remote nodes list, then we can just send it to that node
-			if (this->remote_nodes.size() == 1) {
-				auto remote_node = this->remote_nodes.begin()->second;
-				remote_node->getEncoderPool()->push(std::move(buffer));
-			} else {
-				// If there are multiple nodes, then we need to send it to all nodes
-				for (auto &it : this->remote_nodes) {
-					// If this is the last node, send the original buffer
-					if (it == *this->remote_nodes.rbegin()) {
-						it.second->getEncoderPool()->push(std::move(buffer));
-					} else {
-						// Otherwise, we need to make a copy of the buffer
-						auto buffer_copy = this->available_rx_buffer_pool->pop_wait();
-						*buffer_copy = *buffer;
-						it.second->getEncoderPool()->push(std::move(buffer_copy));
-					}
-				}
-			}
-			// This is not a broadcast, so just send it to the unicast address
+	return true;
+}
+
+/**
+ * @brief Internal method to queue a frame to the encoders of all the remote nodes.
+ *
+ * Each node gets a view of the frame instead of a copy, the buffer is pushed back into the available pool once the last node is
+ * done with it. The views are created in our flood view arena, so flooding a frame makes no heap allocations.
+ *
+ * @param buffer Buffer holding the frame.
+ */
+void PacketSwitch::_flood_frame(std::unique_ptr<PacketBuffer> buffer) {
+	size_t data_size = buffer->getDataSize();
+	PacketBuffer *frame = buffer.release();
+	frame->share(this->available_rx_buffer_pool);
+	for (auto &it : this->remote_nodes) {
+		it.second->queueEncode(PacketBuffer::createView(this->flood_view_arena, frame, 0, data_size));
+	}
+	frame->unshare();
+}
+
+/**
+ * @brief Construct a new PacketSwitch::FloodTask object.
+ *
+ * Flood packets use the global compression settings as each one holds a single frame which any node can decode.
+ *
+ * @param packet_switch Packet switch we're flooding frames for.
+ * @param l4mtu Layer 4 MTU of the flood packets, this is the smallest of all the remote nodes.
+ * @param buffer_size Size of the buffers holding the frames and packets.
+ * @param buffer_count Number of frames which can be queued.
+ */
+PacketSwitch::FloodTask::FloodTask(PacketSwitch *packet_switch, uint16_t l4mtu, size_t buffer_size, size_t buffer_count)
+	: packet_switch(packet_switch),
+	  flood_pool(std::make_shared<accl::SPSCBufferPool<PacketBuffer>>(buffer_size, 0, buffer_count)),
+	  encoder(l4mtu, packet_switch->packet_format),
+	  socket_writer(packet_switch->udp_socket, packet_switch->options.socket_write_mode), packet(buffer_size) {
+	this->encoder.setCompressionLevel(packet_switch->options.compression_level);
+	this->encoder.setCompressionDictionary(packet_switch->options.compression_dictionary,
+										   packet_switch->options.compression_dictionary_id);
+}
+
+/**
+ * @brief Queue a frame to be flooded, this must only be called from the TAP read thread of the queue.
+ *
+ * @param buffer Buffer holding the frame.
+ */
+void PacketSwitch::FloodTask::queue(std::unique_ptr<PacketBuffer> buffer) {
+	this->flood_pool->push(std::move(buffer));
+	this->packet_switch->scheduler->schedule(this);
+}
+
+/**
+ * @brief Flood the frames queued to all the remote nodes.
+ *
+ * @return std::chrono::nanoseconds Always zero, the task does not need to be run again unless more frames are queued.
+ */
+std::chrono::nanoseconds PacketSwitch::FloodTask::run() {
+	// Grab a batch of frames, leaving the rest for our next run so other tasks on this worker get a look in
+	this->flood_pool->pop(this->buffers, SETH_WORKER_BATCH_SIZE);
+
+	for (auto &buffer : this->buffers) {
+		// If the frame fits into a single flood packet we send the same packet to all the nodes, if not it goes to each node
+		if (this->encoder.encode(*buffer, this->packet)) {
+			this->socket_writer.write(this->packet_switch->flood_addrs, this->packet);
+			this->packet_switch->available_rx_buffer_pool->push(std::move(buffer));
 		} else {
-			std::shared_lock<std::shared_mutex> lock(this->fdb_mtx);
-			auto fdb_entry = this->fdb->getRemoteNode((const FDBMACAddress *)ethernet_packet->dst_mac);
-			// If we don't have a target or the target is local, then we need ignore this packet and just continue
-			if (!fdb_entry) {
-				goto loop_restart;
-			}
-			// We got a target, so send the buffer to the encoder pool
-			fdb_entry->getDestination()->getEncoderPool()->push(std::move(buffer));
+			this->packet_switch->_flood_frame(std::move(buffer));
 		}
 	}
+	this->buffers.clear();
+
+	// If there are more frames waiting, run again after whatever else is queued on this worker
+	if (this->flood_pool->getBufferCount()) {
+		this->packet_switch->scheduler->schedule(this);
+	}
 
-	LOG_DEBUG_INTERNAL("TAP READ: Exiting TAP read thread");
+	return std::chrono::nanoseconds::zero();
 }
 
 /**
@@ -320,160 +566,153 @@ struct _comparePacketBuffer {
 };
 
 /**
- * @brief Thread responsible for reading data from the socket.
+ * @brief Thread responsible for reading data from a socket.
  *
- * @param arg Thread data.
+ * Remote nodes are steered to a socket by their address, so the packets of a remote node are always read by the same thread.
+ *
+ * @param index Index of the socket.
  */
-void PacketSwitch::tunnel_socket_read_handler() {
-	ssize_t sockaddr_len = sizeof(sockaddr_storage);
-	std::vector<std::unique_ptr<PacketBuffer>> recvmm_buffers(SETH_MAX_RECVMM_MESSAGES);
-	struct mmsghdr *msgs;
-	struct iovec *iovecs;
-	PacketHeader *pkthdr;
-
-	LOG_DEBUG_INTERNAL("Starting socket read thread");
-
-	// START - IO vector buffers
-
-	// Allocate memory for our IO vectors
-	msgs = (struct mmsghdr *)malloc(SETH_MAX_RECVMM_MESSAGES * sizeof(struct mmsghdr));
-	iovecs = (struct iovec *)malloc(SETH_MAX_RECVMM_MESSAGES * sizeof(struct iovec));
-
-	// Make sure memory allocation succeeded
-	if (msgs == NULL || iovecs == NULL) {
-		LOG_ERROR("Memory allocation failed for recvmm iovecs: ", strerror(errno));
-		// Clean up previously allocated memory
-		free(msgs);
-		free(iovecs);
-		// free(controls);
-		throw SuperEthernetTunnelRuntimeException("Memory allocation failed for recvmm iovecs");
-	}
-
-	// Set up iovecs and mmsghdrs
-	for (size_t i = 0; i < SETH_MAX_RECVMM_MESSAGES; ++i) {
-		recvmm_buffers[i] = this->available_tx_buffer_pool->pop_wait();
-
-		// Setup IO vectors
-		iovecs[i].iov_base = recvmm_buffers[i]->getData();
-		iovecs[i].iov_len = recvmm_buffers[i]->getBufferSize();
-		// And the associated msgs
-		msgs[i].msg_hdr.msg_iov = &iovecs[i];
-		msgs[i].msg_hdr.msg_iovlen = 1;
-		msgs[i].msg_hdr.msg_name = recvmm_buffers[i]->getPacketSourceData();
-		msgs[i].msg_hdr.msg_namelen = sockaddr_len;
-	}
-	// END - IO vector buffers
-
-	// Received buffers
-	std::map<std::array<uint8_t, 16>, std::deque<std::unique_ptr<PacketBuffer>>> received_buffers;
+void PacketSwitch::tunnel_socket_read_handler(size_t index) {
+	LOG_DEBUG_INTERNAL("Starting socket read thread for socket ", index);
+
+	// Socket reader batching our reads
+	SocketReader socket_reader(this->udp_sockets[index], this->options.socket_read_mode, this->available_tx_buffer_pool);
+
+	// Buffers read and received buffers
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	ReceivedBuffers received_buffers(this->remote_node_table.size());
 	while (1) {
 		// Check for program stop
 		if (this->stop_flag) {
 			break;
 		}
 
-		// Pull in buffers into iovecs
-		int num_received = recvmmsg(this->udp_socket, msgs, SETH_MAX_RECVMM_MESSAGES, MSG_WAITFORONE, NULL);
-		if (num_received == -1) {
-			throw SuperEthernetTunnelRuntimeException(std::format("recvmmsg failed: {}", strerror(errno)));
-		}
+		// Pull in buffers from the socket
+		socket_reader.read(buffers);
 
 		// Loop for each packet received
-		for (int i = 0; i < num_received; ++i) {
-			// Grab sockaddr storage
-			sockaddr_storage *sockaddr = (sockaddr_storage *)recvmm_buffers[i]->getPacketSourceData();
-			if (sockaddr->ss_family != AF_INET && sockaddr->ss_family != AF_INET6) {
-				LOG_ERROR("Received packet from unknown address family: ", sockaddr->ss_family);
-				continue;
+		for (auto &buffer : buffers) {
+			if (!this->_socket_read_packet(buffer, received_buffers)) {
+				socket_reader.recycle(std::move(buffer));
 			}
-			// Overlay sin6_addr ontop of sockaddr to get an IPv6 address for the source
-			const sockaddr_in6 *addr6 = reinterpret_cast<const sockaddr_in6 *>(sockaddr);
+		}
+		buffers.clear();
 
-			char ipv6_str[INET6_ADDRSTRLEN];
-			if (inet_ntop(AF_INET6, &(addr6->sin6_addr), ipv6_str, sizeof(ipv6_str)) == NULL) {
-				throw SuperEthernetTunnelRuntimeException(std::format("inet_ntop failed: {}", strerror(errno)));
-			}
-			LOG_DEBUG_INTERNAL("Received ", msgs[i].msg_len, " bytes from ", ipv6_str, ":", ntohs(addr6->sin6_port), " with flags ",
-							   msgs[i].msg_hdr.msg_flags);
-
-			// Grab key for the sender
-			std::array<uint8_t, 16> node_key = get_key_from_sockaddr(sockaddr);
-			// If the node key is not in the remote nodes map, then this host isn't in the access list
-			auto it = this->remote_nodes.find(node_key);
-			if (it == this->remote_nodes.end()) {
-				LOG_ERROR("Received packet from unknown source: ", ipv6_str, ", DROPPING!");
-				continue;
-			}
-			// Save remote node
-			auto remote_node = it->second;
+		// Push all the buffers we got
+		this->_socket_read_flush(received_buffers);
+	}
 
-			// Grab this IOV's buffer node and update the actual buffer length
-			recvmm_buffers[i]->setDataSize(msgs[i].msg_len);
+	LOG_DEBUG_INTERNAL("Exiting socket read thread for socket ", index);
+}
 
-			// Make sure the buffer is long enough for us to overlay the header
-			if (recvmm_buffers[i]->getDataSize() < sizeof(PacketHeader) + sizeof(PacketHeaderOption)) {
-				LOG_ERROR("Packet too small ", recvmm_buffers[i]->getDataSize(), " < ",
-						  sizeof(PacketHeader) + sizeof(PacketHeaderOption), ", DROPPING!!!");
-				continue;
-			}
+/**
+ * @brief Internal method to validate a packet read from the socket and queue it for the node that sent it.
+ *
+ * @param buffer Buffer holding the packet, this is moved out of if the packet was queued.
+ * @param received_buffers Buffers received for each node.
+ * @return true If the packet was queued.
+ * @return false If the packet was dropped, the buffer can be reused.
+ */
+bool PacketSwitch::_socket_read_packet(std::unique_ptr<PacketBuffer> &buffer, ReceivedBuffers &received_buffers) {
 
-			// Overlay packet header and do basic header checks
-			pkthdr = (PacketHeader *)recvmm_buffers[i]->getData();
-			// Check version is supported
-			if (pkthdr->ver > SETH_PACKET_HEADER_VERSION_V1) {
-				LOG_ERROR("Packet not supported, version ", static_cast<uint8_t>(pkthdr->ver), " vs. our version ",
-						  SETH_PACKET_HEADER_VERSION_V1, ", DROPPING!");
-				continue;
-			}
-			if (pkthdr->reserved != 0) {
-				LOG_ERROR("Packet header should not have any reserved its set, it is ", static_cast<uint8_t>(pkthdr->reserved),
-						  ", DROPPING!");
-				continue;
-			}
-			// First thing we do is validate the format
-			if (pkthdr->format != PacketHeaderFormat::ENCAPSULATED) {
-				LOG_ERROR("Packet format not supported, format ", static_cast<uint8_t>(pkthdr->format), ", DROPPING!");
-				continue;
-			}
+	// Grab sockaddr storage
+	sockaddr_storage *sockaddr = (sockaddr_storage *)buffer->getPacketSourceData();
+	if (sockaddr->ss_family != AF_INET && sockaddr->ss_family != AF_INET6) {
+		LOG_ERROR("Received packet from unknown address family: ", sockaddr->ss_family);
+		return false;
+	}
+	// The source address is only turned into a string if we're logging it
+	LOG_DEBUG_INTERNAL("Received ", buffer->getDataSize(), " bytes from ", get_ipstr(sockaddr), ":",
+					   ntohs(reinterpret_cast<const sockaddr_in6 *>(sockaddr)->sin6_port));
+
+	// Grab the node ID of the sender, if the node key is not in the remote node table then this host isn't in the access list
+	size_t node_id = this->remote_node_table.find(get_key_from_sockaddr(sockaddr));
+	if (node_id == RemoteNodeTable::npos) {
+		LOG_ERROR("Received packet from unknown source: ", get_ipstr(sockaddr), ", DROPPING!");
+		return false;
+	}
 
-			// Next check the channel is set to 0
-			if (pkthdr->channel) {
-				LOG_ERROR("Packet specifies invalid channel ", pkthdr->channel, ", DROPPING!");
-				continue;
-			}
+	// Make sure the buffer is long enough for us to overlay the header
+	if (buffer->getDataSize() < sizeof(PacketHeader) + sizeof(PacketHeaderOption)) {
+		LOG_ERROR("Packet too small ", buffer->getDataSize(), " < ", sizeof(PacketHeader) + sizeof(PacketHeaderOption),
+				  ", DROPPING!!!");
+		return false;
+	}
+
+	// Overlay packet header and do basic header checks
+	PacketHeader *pkthdr = (PacketHeader *)buffer->getData();
+	// Check version is supported
+	if (pkthdr->ver > SETH_PACKET_HEADER_VERSION_V1) {
+		LOG_ERROR("Packet not supported, version ", static_cast<uint8_t>(pkthdr->ver), " vs. our version ",
+				  SETH_PACKET_HEADER_VERSION_V1, ", DROPPING!");
+		return false;
+	}
+	if (pkthdr->reserved != 0) {
+		LOG_ERROR("Packet header should not have any reserved its set, it is ", static_cast<uint8_t>(pkthdr->reserved),
+				  ", DROPPING!");
+		return false;
+	}
+	// First thing we do is validate the format, flood packets are decoded alongside the normal packets
+	if (pkthdr->format != PacketHeaderFormat::ENCAPSULATED && pkthdr->format != PacketHeaderFormat::ENCAPSULATED_FLOOD) {
+		LOG_ERROR("Packet format not supported, format ", static_cast<uint8_t>(pkthdr->format), ", DROPPING!");
+		return false;
+	}
 
-			// Add buffer node to the received list
-			recvmm_buffers[i]->setPacketSequenceKey(accl::be_to_cpu_32(pkthdr->sequence));
+	// Next check the channel is one the node uses, the decoders are picked using the channel
+	if (pkthdr->channel >= this->remote_node_table.get(node_id)->getChannelCount()) {
+		LOG_ERROR("Packet specifies invalid channel ", static_cast<unsigned int>(pkthdr->channel), ", DROPPING!");
+		return false;
+	}
 
-			// Push the buffer into the received buffers list for the node
-			received_buffers[node_key].push_back(std::move(recvmm_buffers[i]));
+	// Add buffer node to the received list
+	buffer->setPacketSequenceKey(accl::be_to_cpu_32(pkthdr->sequence));
 
-			// Replenish the buffer
-			recvmm_buffers[i] = this->available_tx_buffer_pool->pop_wait();
-			msgs[i].msg_hdr.msg_iov->iov_base = recvmm_buffers[i]->getData();
-			msgs[i].msg_hdr.msg_name = recvmm_buffers[i]->getPacketSourceData();
-		}
-		// Push all the buffers we got
-		for (auto &received_pool : received_buffers) {
-			LOG_DEBUG_INTERNAL("Pushing ", received_pool.second.size(), " buffers to decoder pool of node");
-			remote_nodes[received_pool.first]->getDecoderPool()->push(received_pool.second);
-			received_pool.second.clear();
-		}
+	// Push the buffer into the received buffers list for the node, if the list is full we push it to the decoders now so it never
+	// grows past the room reserved for it
+	auto &node_buffers = received_buffers.buffers[node_id];
+	if (node_buffers.empty()) {
+		received_buffers.node_ids.push_back(node_id);
+	} else if (node_buffers.size() == SETH_MAX_RECVMM_MESSAGES) {
+		this->remote_node_table.get(node_id)->queueDecode(node_buffers);
 	}
-	// Free the rest of the IOV stuff
-	free(msgs);
-	free(iovecs);
+	node_buffers.push_back(std::move(buffer));
 
-	LOG_DEBUG_INTERNAL("Exiting socket read thread");
+	return true;
 }
 
 /**
- * @brief Thread responsible for writing to the TAP device.
+ * @brief Internal method to push the buffers received for each node to their decoders.
  *
- * @param arg Thread data.
+ * @param received_buffers Buffers received for each node, these are cleared.
  */
-void PacketSwitch::tunnel_tap_write_handler() {
-	LOG_DEBUG_INTERNAL("Starting TAP write thread");
+void PacketSwitch::_socket_read_flush(ReceivedBuffers &received_buffers) {
+	for (size_t node_id : received_buffers.node_ids) {
+		LOG_DEBUG_INTERNAL("Pushing ", received_buffers.buffers[node_id].size(), " buffers to decoder pool of node");
+		this->remote_node_table.get(node_id)->queueDecode(received_buffers.buffers[node_id]);
+	}
+	received_buffers.node_ids.clear();
+}
+
+/**
+ * @brief Thread responsible for writing to a TAP device queue.
+ *
+ * @param queue TAP interface queue.
+ */
+void PacketSwitch::tunnel_tap_write_handler(size_t queue) {
+	LOG_DEBUG_INTERNAL("Starting TAP write thread for queue ", queue);
+
+	int tap_fd = this->tap_interface->getFD(queue);
+	auto tap_write_pool = this->tap_write_pools[queue];
+
+#ifdef HAVE_LIBURING
+	// When using io_uring each batch of writes is submitted with a single syscall
+	std::unique_ptr<IOUringEngine> io_uring_engine;
+	if (this->options.io_engine == IOEngine::IO_URING) {
+		io_uring_engine = std::make_unique<IOUringEngine>(
+			SETH_IO_URING_ENTRIES, std::vector<int>{tap_fd},
+			std::vector<const accl::BufferArena *>{this->available_tx_buffer_pool->getArena()});
+	}
+#endif
 
 	// Loop pulling buffers off the socket write pool
 	std::deque<std::unique_ptr<PacketBuffer>> buffers;
@@ -484,58 +723,27 @@ void PacketSwitch::tunnel_tap_write_handler() {
 		}
 
 		// Wait for buffers
-		this->tap_write_pool->wait(buffers);
+		tap_write_pool->wait(buffers);
+
+#ifdef HAVE_LIBURING
+		if (io_uring_engine) {
+			this->_tap_write_io_uring(*io_uring_engine, buffers);
+			this->_tap_write_release(buffers);
+			continue;
+		}
+#endif
 
 		// Loop with buffers
 #ifdef DEBUG
 		size_t i{0};
 #endif
 		for (auto &buffer : buffers) {
-			// Overlay ethernet header ontop of the packet
-			const ethernet_header_t *ethernet_packet = (ethernet_header_t *)buffer->getData();
-
-			// Do a quick sanity check on the source MAC
-			if (ethernet_packet->src_mac[0] & 0x01) {
-				std::string ipv6_str = get_ipstr(&buffer->getPacketSource());
-				LOG_ERROR("Packet from ", ipv6_str, " has a source MAC which is a multicast group address, DROPPING!");
-				continue;
-			}
-
-			// Update FDB entry if we found one, we do this in a separate scope to clear the mutex
-			std::shared_ptr<FDBEntry> fdb_entry;
-			auto fdb_src_mac = (const FDBMACAddress *)&ethernet_packet->src_mac;
-			{
-				std::shared_lock<std::shared_mutex> lock(this->fdb_mtx);
-				LOG_DEBUG_INTERNAL("Looking for FDB entry for MAC: ", fdb_src_mac->toString());
-				fdb_entry = this->fdb->get(fdb_src_mac);
-				if (fdb_entry) {
-					LOG_DEBUG_INTERNAL("Found FDB entry for MAC: ", fdb_src_mac->toString());
-					// std::unique_lock<std::shared_mutex> lock(fdb_mtx);
-					fdb_entry->updateLastSeen();
-					LOG_DEBUG_INTERNAL("Updated FDB entry for MAC: ", fdb_src_mac->toString());
-				}
-			}
-			// If we didn't find one, we need to create one, the lock, then add
-			if (!fdb_entry) {
-				LOG_DEBUG_INTERNAL("Adding FDB entry for MAC: ", fdb_src_mac->toString());
-				const sockaddr_storage *addr = &buffer->getPacketSource();
-				// Grab node that sent this packet
-				auto node_key = get_key_from_sockaddr((sockaddr_storage *)addr);
-				auto remote_node = this->remote_nodes[node_key];
-
-				std::unique_lock<std::shared_mutex> lock(this->fdb_mtx);
-				fdb_entry = fdb->add(fdb_src_mac, remote_node);
-				LOG_DEBUG_INTERNAL(std::format("Added FDB entry for MAC: ", fdb_src_mac->toString()));
-			}
-
-			// Check if tap device is online, if not skip writing
-			if (!this->tap_interface->isOnline()) {
-				LOG_WARNING("TAP device is offline, skipping write");
+			if (!this->_tap_write_prepare(buffer)) {
 				continue;
 			}
 
 			// Write data to TAP interface
-			ssize_t bytes_written = write(this->tap_interface->getFD(), buffer->getData(), buffer->getDataSize());
+			ssize_t bytes_written = write(tap_fd, buffer->getData(), buffer->getDataSize());
 			if (bytes_written == -1) {
 				throw SuperEthernetTunnelRuntimeException(std::format("Error writing TAP device: {}", strerror(errno)));
 			}
@@ -546,13 +754,229 @@ void PacketSwitch::tunnel_tap_write_handler() {
 		}
 
 		// Push buffers into available pool
-		this->available_tx_buffer_pool->push(buffers);
-		buffers.clear();
+		this->_tap_write_release(buffers);
+	}
+
+	LOG_DEBUG_INTERNAL("Exiting TAP write thread for queue ", queue);
+}
+
+/**
+ * @brief Internal method to release the buffers we wrote to the TAP device.
+ *
+ * Frames decoded using zero-copy are views of the packets they were received in, releasing the views releases the packets once
+ * all their frames are written.
+ *
+ * @param buffers Buffers to release, this is cleared.
+ */
+void PacketSwitch::_tap_write_release(std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	std::erase_if(buffers, [](const std::unique_ptr<PacketBuffer> &buffer) { return buffer->isView(); });
+	this->available_tx_buffer_pool->push(buffers);
+	buffers.clear();
+}
+
+/**
+ * @brief Internal method to learn the source of a frame we're about to write to the TAP device.
+ *
+ * @param buffer Buffer holding the frame.
+ * @return true If the frame should be written.
+ * @return false If the frame should be dropped.
+ */
+bool PacketSwitch::_tap_write_prepare(const std::unique_ptr<PacketBuffer> &buffer) {
+	// Make sure the frame is big enough to hold the headers we expect
+	size_t header_size = this->tap_interface->getHeaderSize();
+	if (buffer->getDataSize() < header_size + sizeof(ethernet_header_t)) {
+		LOG_ERROR("Frame from ", get_ipstr(&buffer->getPacketSource()), " is too small ", buffer->getDataSize(), ", DROPPING!");
+		return false;
+	}
+
+	// Overlay ethernet header ontop of the packet, skipping over the virtio-net header if we have one
+	const ethernet_header_t *ethernet_packet = (ethernet_header_t *)(buffer->getData() + header_size);
+
+	// Do a quick sanity check on the source MAC
+	if (ethernet_packet->src_mac[0] & 0x01) {
+		LOG_ERROR("Packet from ", get_ipstr(&buffer->getPacketSource()),
+				  " has a source MAC which is a multicast group address, DROPPING!");
+		return false;
+	}
+
+	// Update FDB entry if we found one
+	auto fdb_src_mac = (const FDBMACAddress *)&ethernet_packet->src_mac;
+	LOG_DEBUG_INTERNAL("Looking for FDB entry for MAC: ", fdb_src_mac->toString());
+	if (this->fdb->touch(fdb_src_mac)) {
+		LOG_DEBUG_INTERNAL("Updated FDB entry for MAC: ", fdb_src_mac->toString());
+		// If we didn't find one, we need to create one
+	} else {
+		LOG_DEBUG_INTERNAL("Adding FDB entry for MAC: ", fdb_src_mac->toString());
+		const sockaddr_storage *addr = &buffer->getPacketSource();
+		// Grab node that sent this packet, TAP write threads run concurrently so we use the lock-free remote node table
+		size_t node_id = this->remote_node_table.find(get_key_from_sockaddr((sockaddr_storage *)addr));
+		if (node_id == RemoteNodeTable::npos) {
+			LOG_ERROR("Frame from unknown source ", get_ipstr(addr), ", DROPPING!");
+			return false;
+		}
+
+		this->fdb->add(fdb_src_mac, this->remote_node_table.getShared(node_id));
+		LOG_DEBUG_INTERNAL("Added FDB entry for MAC: ", fdb_src_mac->toString());
+	}
+
+	// Check if tap device is online, if not skip writing
+	if (!this->tap_interface->isOnline()) {
+		LOG_WARNING("TAP device is offline, skipping write");
+		return false;
+	}
+
+	return true;
+}
+
+#ifdef HAVE_LIBURING
+
+/**
+ * @brief Internal method to write a batch of frames to the TAP device using io_uring.
+ *
+ * @param io_uring_engine io_uring engine with the TAP device registered.
+ * @param buffers Buffers to write, all buffers are back in the list once their writes complete.
+ */
+void PacketSwitch::_tap_write_io_uring(IOUringEngine &io_uring_engine, std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	std::deque<IOUringCompletion> completions;
+
+	// Queue the writes, we only reap completions early if the ring has no space left
+	for (auto &buffer : buffers) {
+		if (!this->_tap_write_prepare(buffer)) {
+			continue;
+		}
+		if (io_uring_engine.getInflightCount() == io_uring_engine.getCapacity()) {
+			io_uring_engine.submitAndWait(completions);
+		}
+		io_uring_engine.write(IO_URING_FILE_TAP, std::move(buffer));
+	}
+
+	// Submit the batch and wait for all the writes to complete
+	while (io_uring_engine.getInflightCount()) {
+		io_uring_engine.submitAndWait(completions);
+	}
+	LOG_DEBUG_INTERNAL("Wrote ", completions.size(), " frames to TAP using ", io_uring_engine.getSyscallCount(),
+					   " io_uring syscalls so far");
+
+	// Take back the buffers that were written
+	std::erase(buffers, nullptr);
+	for (auto &completion : completions) {
+		if (completion.result < 0) {
+			throw SuperEthernetTunnelRuntimeException(std::format("Error writing TAP device: {}", strerror(-completion.result)));
+		}
+		buffers.push_back(std::move(completion.buffer));
+	}
+}
+
+/**
+ * @brief Thread responsible for reading from a TAP interface queue and the socket using io_uring.
+ *
+ * Reads are kept in flight on the TAP device queue, this replaces the TAP read thread of the queue. If there is a socket with the
+ * same index as the queue, receives are also kept in flight on it, replacing the read thread of the socket.
+ *
+ * @param queue TAP interface queue.
+ */
+void PacketSwitch::tunnel_io_uring_handler(size_t queue) {
+	LOG_DEBUG_INTERNAL("IO_URING: Starting io_uring read thread for queue ", queue);
+
+	// TAP reads go into RX buffers and socket receives go into TX buffers, so we register both arenas
+	bool socket_read = queue < this->udp_sockets.size();
+	int udp_socket = socket_read ? this->udp_sockets[queue] : this->udp_socket;
+	IOUringEngine io_uring_engine(SETH_IO_URING_ENTRIES, {this->tap_interface->getFD(queue), udp_socket},
+								  {this->available_rx_buffer_pool->getArena(), this->available_tx_buffer_pool->getArena()});
+	LOG_INFO("Using io_uring with ", io_uring_engine.hasFixedFiles() ? "registered" : "unregistered", " files and ",
+			 io_uring_engine.hasFixedBuffers() ? "registered" : "unregistered", " buffers");
+
+	// Fill the ring with reads
+	for (size_t i = 0; i < SETH_IO_URING_TAP_READS; ++i) {
+		io_uring_engine.read(IO_URING_FILE_TAP, this->available_rx_buffer_pool->pop_wait());
+	}
+	if (socket_read) {
+		for (size_t i = 0; i < SETH_IO_URING_SOCKET_RECVS; ++i) {
+			io_uring_engine.recvmsg(IO_URING_FILE_SOCKET, this->available_tx_buffer_pool->pop_wait());
+		}
+	}
+
+	// Completed reads and received buffers
+	std::deque<IOUringCompletion> completions;
+	ReceivedBuffers received_buffers(this->remote_node_table.size());
+	// Reads and receives waiting for a buffer to come back to the pools, we don't block while holding received buffers
+	size_t tap_reads_waiting = 0;
+	size_t socket_recvs_waiting = 0;
+	while (true) {
+		// Check for program stop
+		if (this->stop_flag) {
+			break;
+		}
+
+		// Submit the reads we requeued and wait for more to complete
+		io_uring_engine.submitAndWait(completions);
+
+		for (auto &completion : completions) {
+			auto &buffer = completion.buffer;
+
+			if (completion.file == IO_URING_FILE_TAP) {
+				if (completion.result < 0) {
+					LOG_ERROR("Got an error read()'ing TAP device: ", strerror(-completion.result));
+					exit(EXIT_FAILURE);
+				} else if (completion.result == 0) {
+					LOG_ERROR("Got EOF from TAP device");
+					exit(EXIT_FAILURE);
+				}
+				LOG_DEBUG_INTERNAL("TAP READ: Read ", completion.result, " bytes from TAP");
+
+				// If the frame was forwarded we need a new buffer, if not we can read into the same one again
+				if (this->_tap_read_frame(queue, buffer) && !this->available_rx_buffer_pool->tryPop(buffer)) {
+					++tap_reads_waiting;
+					continue;
+				}
+				io_uring_engine.read(IO_URING_FILE_TAP, std::move(buffer));
+
+			} else {
+				if (completion.result < 0) {
+					if (completion.result != -EINTR) {
+						throw SuperEthernetTunnelRuntimeException(
+							std::format("recvmsg failed: {}", strerror(-completion.result)));
+					}
+				} else if (this->_socket_read_packet(buffer, received_buffers) &&
+						   !this->available_tx_buffer_pool->tryPop(buffer)) {
+					++socket_recvs_waiting;
+					continue;
+				}
+				io_uring_engine.recvmsg(IO_URING_FILE_SOCKET, std::move(buffer));
+			}
+		}
+		completions.clear();
+
+		// Push all the buffers we got
+		this->_socket_read_flush(received_buffers);
+
+		// Requeue the reads and receives that were waiting for buffers, if nothing is left in flight we have nothing to wait
+		// on in the ring so we block on the pools, which is safe now that the received buffers were pushed
+		std::unique_ptr<PacketBuffer> buffer;
+		while (tap_reads_waiting && this->available_rx_buffer_pool->tryPop(buffer)) {
+			io_uring_engine.read(IO_URING_FILE_TAP, std::move(buffer));
+			--tap_reads_waiting;
+		}
+		while (socket_recvs_waiting && this->available_tx_buffer_pool->tryPop(buffer)) {
+			io_uring_engine.recvmsg(IO_URING_FILE_SOCKET, std::move(buffer));
+			--socket_recvs_waiting;
+		}
+		if (!io_uring_engine.getInflightCount()) {
+			if (tap_reads_waiting) {
+				io_uring_engine.read(IO_URING_FILE_TAP, this->available_rx_buffer_pool->pop_wait());
+				--tap_reads_waiting;
+			} else if (socket_recvs_waiting) {
+				io_uring_engine.recvmsg(IO_URING_FILE_SOCKET, this->available_tx_buffer_pool->pop_wait());
+				--socket_recvs_waiting;
+			}
+		}
 	}
 
-	LOG_DEBUG_INTERNAL("Exiting TAP write thread");
+	LOG_DEBUG_INTERNAL("IO_URING: Exiting io_uring read thread for queue ", queue);
 }
 
+#endif
+
 /**
  * @brief Thread responsible for handling maintenance of the FDB.
  *
@@ -567,15 +991,19 @@ void PacketSwitch::fdb_handler() {
 			break;
 		}
 
-		// Lock FDB for read and dump it
-		{
-			std::shared_lock<std::shared_mutex> lock(this->fdb_mtx);
-			this->fdb->dumpDebug();
-		}
-		// Loop with FDB entreis and remove ones that are older than 300s
-		{
-			std::unique_lock<std::shared_mutex> lock(this->fdb_mtx);
-			this->fdb->expireEntries(300);
+		// Dump the FDB
+		this->fdb->dumpDebug();
+		// Loop with FDB entreis and remove ones that are older than 300s, lookups carry on while this is done
+		this->fdb->expireEntries(300);
+
+		// Log buffer pool statistics to help with sizing the pools
+		this->_log_buffer_pool_stats("RX", this->available_rx_buffer_pool);
+		this->_log_buffer_pool_stats("TX", this->available_tx_buffer_pool);
+		LOG_DEBUG("Workers: count=", this->scheduler->getWorkerCount(), ", task runs=", this->scheduler->getRunCount(),
+				  ", tasks stolen=", this->scheduler->getStealCount());
+		// Log compression statistics so the savings of adaptive compression and the effect of the compression level can be seen
+		for (auto &[node_key, remote_node] : this->remote_nodes) {
+			this->_log_compression_stats(*remote_node);
 		}
 
 		sleep(10);
@@ -585,48 +1013,236 @@ void PacketSwitch::fdb_handler() {
 }
 
 /**
- * @brief Create a udp socket.
+ * @brief Set a thread to the highest round robin realtime priority.
  *
- * @param tdata Thread data.
+ * @param thread Thread to set the priority of.
+ * @param name Name of the thread used when logging.
  */
-void PacketSwitch::_create_udp_socket() {
-	// Creating UDP datagram socket
-	if ((this->udp_socket = socket(AF_INET6, SOCK_DGRAM, 0)) < 0) {
-		throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Socket creation failed: {}", strerror(errno)));
+void PacketSwitch::_set_thread_priority(std::thread &thread, const std::string &name) {
+	this->_set_thread_priority(thread, name, sched_get_priority_max(SCHED_RR));
+}
+
+/**
+ * @brief Set a thread to a round robin realtime priority.
+ *
+ * @param thread Thread to set the priority of.
+ * @param name Name of the thread used when logging.
+ * @param priority Realtime priority.
+ */
+void PacketSwitch::_set_thread_priority(std::thread &thread, const std::string &name, int priority) {
+	struct sched_param param;
+	param.sched_priority = priority;
+	if (pthread_setschedparam(thread.native_handle(), SCHED_RR, &param)) {
+		LOG_NOTICE("Could not set ", name, " thread priority: ", std::strerror(errno));
 	}
+}
 
-	// Set socket to be dual stack
-	int no = 0;
-	if (setsockopt(this->udp_socket, IPPROTO_IPV6, IPV6_V6ONLY, (void *)&no, sizeof(no)) == -1) {
-		int res = errno;
-		close(this->udp_socket);
-		throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set IPV6_V6ONLY: {}", strerror(res)));
+/**
+ * @brief Pin a thread to a CPU core, the threads are spread over the cores we have.
+ *
+ * @param thread Thread to pin.
+ * @param slot Slot of the thread, this is the TAP queue for TAP threads and follows on from the TAP queues for socket threads.
+ * @param name Name of the thread used when logging.
+ */
+void PacketSwitch::_set_thread_cpu(std::thread &thread, size_t slot, const std::string &name) {
+	size_t cpu_count = std::max(std::thread::hardware_concurrency(), 1U);
+	size_t cpu = slot % cpu_count;
+
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	int res = pthread_setaffinity_np(thread.native_handle(), sizeof(cpuset), &cpuset);
+	if (res) {
+		LOG_NOTICE("Could not pin ", name, " thread in slot ", slot, " to CPU ", cpu, ": ", std::strerror(res));
 	}
+}
 
-	// Set the send buffer size (SO_SNDBUF)
-	int buffer_size = this->l2mtu * 8192;
-	if (setsockopt(this->udp_socket, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size)) < 0) {
-		int res = errno;
-		close(this->udp_socket);
-		throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set send buffer size: {}", strerror(res)));
+/**
+ * @brief Log the statistics of an available buffer pool.
+ *
+ * @param name Name of the pool.
+ * @param pool Buffer pool to log the statistics of.
+ */
+void PacketSwitch::_log_buffer_pool_stats(const std::string &name, std::shared_ptr<accl::BufferPool<PacketBuffer>> pool) {
+	accl::BufferPoolCacheStats stats = pool->getCacheStats();
+	LOG_DEBUG("Available ", name, " buffer pool: shared=", pool->getBufferCount(), ", cached=", stats.cached,
+			  ", cache hits=", stats.hits, ", cache misses=", stats.misses, ", refills=", stats.refills, ", spills=", stats.spills);
+}
+
+/**
+ * @brief Log the compression statistics of a remote node.
+ *
+ * The CPU time saved by not compressing frames is estimated using the average time it took to compress a byte.
+ *
+ * @param remote_node Remote node to log the statistics of.
+ */
+void PacketSwitch::_log_compression_stats(const RemoteNode &remote_node) {
+	PacketEncoderCompressionStats stats;
+	if (!remote_node.getCompressionStats(stats)) {
+		return;
 	}
-	if (setsockopt(this->udp_socket, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)) < 0) {
-		int res = errno;
-		close(this->udp_socket);
-		throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set receive buffer size: {}", strerror(res)));
+	// Nothing to log if we never compressed anything for the node
+	uint64_t compressed_frames = stats.compressed_frames.load(std::memory_order_relaxed);
+	uint64_t bypassed_frames = stats.bypassed_frames.load(std::memory_order_relaxed);
+	if (!compressed_frames && !bypassed_frames) {
+		return;
+	}
+
+	uint64_t compressed_bytes = stats.compressed_bytes.load(std::memory_order_relaxed);
+	uint64_t compress_time = stats.compress_time.load(std::memory_order_relaxed);
+	uint64_t bypassed_bytes = stats.bypassed_bytes.load(std::memory_order_relaxed);
+	uint64_t time_saved = 0;
+	if (compressed_bytes) {
+		time_saved = static_cast<uint64_t>(static_cast<double>(bypassed_bytes) * compress_time / compressed_bytes);
+	}
+
+	LOG_DEBUG("Compression to ", get_ipstr(remote_node.getNodeAddr().get()), " (",
+			  CompressionSettingsToString(remote_node.getCompression()), "): compressed frames=", compressed_frames,
+			  ", bytes=", compressed_bytes, ", wire bytes=", stats.compressed_wire_bytes.load(std::memory_order_relaxed),
+			  ", time=", compress_time / 1000, "us, bypassed frames=", bypassed_frames, ", bytes=", bypassed_bytes,
+			  ", wire bytes delta=", stats.bypass_wire_delta.load(std::memory_order_relaxed), ", time saved=", time_saved / 1000,
+			  "us");
+}
+
+/**
+ * @brief Handle a command received on the control socket.
+ *
+ * Commands:
+ *   compression                                          List the compression settings of each remote node.
+ *   compression <DESTINATION|all> <ALGORITHM> [LEVEL]    Change the compression settings of a remote node or all of them.
+ *                                                        ALGORITHM is one of none, lz4, zstd, lz4-batch or zstd-batch.
+ *
+ * @param args Command arguments, this has at least one argument.
+ * @return std::string Reply, the last line is either OK or an error.
+ */
+std::string PacketSwitch::_control_command(const std::vector<std::string> &args) {
+	if (args[0] != "compression") {
+		return std::format("ERROR: Unknown command '{}'", args[0]);
+	}
+
+	// Without any arguments we list the compression settings of each remote node
+	if (args.size() == 1) {
+		std::string reply;
+		for (auto &[node_key, remote_node] : this->remote_nodes) {
+			reply += std::format("{} {}\n", get_ipstr(remote_node->getNodeAddr().get()),
+								 CompressionSettingsToString(remote_node->getCompression()));
+		}
+		return reply + "OK";
+	}
+	if (args.size() < 3 || args.size() > 4) {
+		return "ERROR: Usage: compression [<DESTINATION|all> <ALGORITHM> [LEVEL]]";
+	}
+
+	// Work out the compression settings
+	CompressionSettings compression;
+	if (!PacketHeaderOptionFormatTypeFromString(args[2], compression.packet_format)) {
+		return std::format("ERROR: Invalid compression algorithm '{}'", args[2]);
+	}
+	if (args.size() == 4) {
+		const std::string &level = args[3];
+		auto [end, ec] = std::from_chars(level.data(), level.data() + level.size(), compression.level);
+		if (ec != std::errc() || end != level.data() + level.size()) {
+			return std::format("ERROR: Invalid compression level '{}'", level);
+		}
+	}
+	if (!CompressionLevelIsValid(compression.packet_format, compression.level)) {
+		return std::format("ERROR: Invalid compression level {} for {}", compression.level, args[2]);
+	}
+
+	// Work out which remote nodes we're changing
+	if (args[1] == "all") {
+		for (auto &[node_key, remote_node] : this->remote_nodes) {
+			remote_node->setCompression(compression);
+		}
+		return "OK";
+	}
+	std::shared_ptr<sockaddr_storage> node_addr;
+	try {
+		node_addr = to_sockaddr_storage(args[1]);
+	} catch (SuperEthernetTunnelException &e) {
+		return std::format("ERROR: Invalid destination '{}': {}", args[1], e.what());
+	}
+	auto remote_node = this->remote_nodes.find(get_key_from_sockaddr(node_addr.get()));
+	if (remote_node == this->remote_nodes.end()) {
+		return std::format("ERROR: Unknown destination '{}'", args[1]);
+	}
+	remote_node->second->setCompression(compression);
+
+	return "OK";
+}
+
+/**
+ * @brief Create our UDP sockets, with more than one socket they share the port using SO_REUSEPORT.
+ *
+ * Remote nodes are steered to a socket by their address, so each remote node is only ever read by one thread.
+ */
+void PacketSwitch::_create_udp_sockets() {
+	for (size_t index = 0; index < this->options.socket_read_threads; ++index) {
+		// Creating UDP datagram socket
+		int udp_socket = socket(AF_INET6, SOCK_DGRAM, 0);
+		if (udp_socket < 0) {
+			int res = errno;
+			this->_destroy_udp_sockets();
+			throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Socket creation failed: {}", strerror(res)));
+		}
+		this->udp_sockets.push_back(udp_socket);
+
+		// Set socket to be dual stack
+		int no = 0;
+		if (setsockopt(udp_socket, IPPROTO_IPV6, IPV6_V6ONLY, (void *)&no, sizeof(no)) == -1) {
+			int res = errno;
+			this->_destroy_udp_sockets();
+			throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set IPV6_V6ONLY: {}", strerror(res)));
+		}
+
+		// Set the send buffer size (SO_SNDBUF)
+		int buffer_size = this->l2mtu * 8192;
+		if (setsockopt(udp_socket, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size)) < 0) {
+			int res = errno;
+			this->_destroy_udp_sockets();
+			throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set send buffer size: {}", strerror(res)));
+		}
+		if (setsockopt(udp_socket, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)) < 0) {
+			int res = errno;
+			this->_destroy_udp_sockets();
+			throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set receive buffer size: {}", strerror(res)));
+		}
+
+		// Share the port with our other sockets, this needs to be set before binding
+		int one = 1;
+		if (this->options.socket_read_threads > 1 && setsockopt(udp_socket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+			int res = errno;
+			this->_destroy_udp_sockets();
+			throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to set SO_REUSEPORT: {}", strerror(res)));
+		}
+
+		// Bind UDP socket source address
+		if (bind(udp_socket, (struct sockaddr *)this->src_addr.get(), sizeof(sockaddr_storage)) == -1) {
+			int res = errno;
+			this->_destroy_udp_sockets();
+			throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to bind UDP socket: {}", strerror(res)));
+		}
 	}
 
-	// Bind UDP socket source address
-	if (bind(this->udp_socket, (struct sockaddr *)this->src_addr.get(), sizeof(sockaddr_storage)) == -1) {
+	// Steer the remote nodes to a socket by their address, the program applies to all the sockets sharing the port
+	if (this->udp_sockets.size() > 1 && !set_socket_read_steering(this->udp_sockets[0], this->udp_sockets.size())) {
 		int res = errno;
-		close(this->udp_socket);
-		throw SuperEthernetTunnelRuntimeException(std::format("ERROR: Failed to bind UDP socket: {}", strerror(res)));
+		this->_destroy_udp_sockets();
+		throw SuperEthernetTunnelRuntimeException(
+			std::format("ERROR: Failed to attach socket steering program: {}", strerror(res)));
 	}
+
+	// We send using the first socket
+	this->udp_socket = this->udp_sockets[0];
 }
 
 /**
- * @brief Destroy a UDP socket.
+ * @brief Destroy our UDP sockets.
  *
- * @param tdata Thread data.
  */
-void PacketSwitch::_destroy_udp_socket() { close(this->udp_socket); }
+void PacketSwitch::_destroy_udp_sockets() {
+	for (int udp_socket : this->udp_sockets) {
+		close(udp_socket);
+	}
+	this->udp_sockets.clear();
+}
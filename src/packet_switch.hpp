@@ -7,22 +7,35 @@
 #pragma once
 
 #include "codec.hpp"
+#include "control_socket.hpp"
 #include "fdb.hpp"
+#include "flood_encoder.hpp"
+#include "io_uring_engine.hpp"
+#include "libaccl/buffer_arena.hpp"
 #include "libaccl/buffer_pool.hpp"
+#include "libaccl/task_scheduler.hpp"
 #include "packet_buffer.hpp"
+#include "packet_switch_options.hpp"
 #include "remote_node.hpp"
+#include "remote_node_table.hpp"
+#include "socket_writer.hpp"
 #include "tap_interface.hpp"
+#include "zero_copy_tracker.hpp"
 #include <array>
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
+#include <string>
 #include <sys/types.h>
+#include <thread>
+#include <vector>
 
 class PacketSwitch {
 	public:
 		PacketSwitch(const std::string ifname, int mtu, int tx_size, PacketHeaderOptionFormatType packet_format,
 					 std::shared_ptr<struct sockaddr_storage> src_addr,
-					 std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs, int port);
+					 std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs, int port, const PacketSwitchOptions &options);
 		~PacketSwitch();
 
 		void start();
@@ -35,55 +48,153 @@ class PacketSwitch {
 
 		inline PacketHeaderOptionFormatType getPacketFormat() { return this->packet_format; }
 
+		inline IOEngine getIOEngine() { return this->options.io_engine; }
+
+		inline unsigned int getTAPOffloads() { return this->tap_interface->getOffloads(); }
+
+		inline size_t getWorkerThreadCount() { return this->scheduler->getWorkerCount(); }
+
 	private:
-		// FDB and mutex protecting it
+		// FDB, this does its own locking
 		std::shared_ptr<FDB> fdb;
-		mutable std::shared_mutex fdb_mtx;
 		int fdb_expire_time;
 
 		int mtu;		// MTU of ethernet interface
 		int tx_size;	// Max size of packet to send
 		uint16_t l2mtu; // Internal switch L2 MTU
+		// Maximum size of the frames we read from the TAP interface, including any virtio-net header
+		uint16_t max_frame_size;
 
 		// Packet format
 		PacketHeaderOptionFormatType packet_format;
 
+		// Advanced options
+		PacketSwitchOptions options;
+
 		// Source address to bind to
 		std::shared_ptr<struct sockaddr_storage> src_addr;
 
 		// TAP interface
 		std::unique_ptr<TAPInterface> tap_interface;
 
-		// UDP socket for tunneling
+		// UDP sockets for tunneling, each is read by its own thread, with more than one they share the port using SO_REUSEPORT
+		std::vector<int> udp_sockets;
+		// UDP socket we send on, this is the first of our sockets
 		int udp_socket;
+		// Tracker of the MSG_ZEROCOPY sends on the UDP socket, this is nullptr if we're not using zero-copy sends
+		std::shared_ptr<ZeroCopyTracker> zero_copy_tracker;
 
 		// Remote nodes
 		std::map<std::array<uint8_t, 16>, std::shared_ptr<RemoteNode>> remote_nodes;
+		// Remote nodes by node ID, this is used to find the node each packet we receive is from
+		RemoteNodeTable remote_node_table;
+
+		/**
+		 * @brief Packets a socket read thread received for each remote node, these are reused for each batch of packets.
+		 *
+		 * Each node gets room for SETH_MAX_RECVMM_MESSAGES packets up front and is cleared in place, so staging a batch does not
+		 * allocate. A node which fills up is pushed to its decoders straight away.
+		 */
+		struct ReceivedBuffers {
+				ReceivedBuffers(size_t node_count) : buffers(node_count) {
+					for (auto &node_buffers : buffers) {
+						node_buffers.reserve(SETH_MAX_RECVMM_MESSAGES);
+					}
+					node_ids.reserve(node_count);
+				}
+
+				// Packets received indexed by node ID
+				std::vector<std::vector<std::unique_ptr<PacketBuffer>>> buffers;
+				// IDs of the nodes we received packets for, so we don't need to look at every node
+				std::vector<size_t> node_ids;
+		};
+
+		/**
+		 * @brief Task flooding the frames a TAP queue queued to all the remote nodes.
+		 *
+		 * Frames which fit into a single flood packet are encoded once and the packet is sent to all the nodes in one go, the rest
+		 * are queued to the encoder of each node. Flood frames keep their order amongst themselves, but are not ordered against
+		 * the unicast frames of the same TAP queue which sit in the node encoders until their packets fill up or are flushed.
+		 */
+		class FloodTask : public accl::Task {
+			public:
+				FloodTask(PacketSwitch *packet_switch, uint16_t l4mtu, size_t buffer_size, size_t buffer_count);
+
+				void queue(std::unique_ptr<PacketBuffer> buffer);
+
+			protected:
+				std::chrono::nanoseconds run() override;
+
+			private:
+				PacketSwitch *packet_switch;
+				// Buffer pool of frames to flood, this is only fed by the TAP read thread of the queue
+				std::shared_ptr<accl::SPSCBufferPool<PacketBuffer>> flood_pool;
+				FloodEncoder encoder;
+				SocketWriter socket_writer;
+				PacketBuffer packet;
+				std::deque<std::unique_ptr<PacketBuffer>> buffers;
+		};
+
+		// Addresses of all the remote nodes, flood packets are sent to all of them at once
+		std::vector<std::shared_ptr<sockaddr_storage>> flood_addrs;
+		// Flood task of each TAP queue, this is empty if we're not flood encoding
+		std::vector<std::unique_ptr<FloodTask>> flood_tasks;
+		// Arena holding the views of flooded frames queued to the remote nodes, this is nullptr with a single remote node
+		accl::BufferArena *flood_view_arena;
 
 		// Port we're using
 		int port;
 
+		// Control socket used to change settings at runtime, this is nullptr if we're not using one
+		std::unique_ptr<ControlSocket> control_socket;
+
 		// RX path
 		std::shared_ptr<accl::BufferPool<PacketBuffer>> available_rx_buffer_pool;
 		// TX path
 		std::shared_ptr<accl::BufferPool<PacketBuffer>> available_tx_buffer_pool;
-		std::shared_ptr<accl::BufferPool<PacketBuffer>> tap_write_pool;
-		// Threads
-		std::unique_ptr<std::thread> tunnel_tap_read_thread;
-		std::unique_ptr<std::thread> tunnel_socket_read_thread;
-		std::unique_ptr<std::thread> tunnel_tap_write_thread;
+		// TAP write pool for each TAP queue
+		std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> tap_write_pools;
+		// Scheduler running the encoders and decoders of all the remote nodes
+		std::shared_ptr<accl::TaskScheduler> scheduler;
+		// Threads, the TAP read, TAP write and io_uring threads are per TAP queue
+		std::vector<std::unique_ptr<std::thread>> tunnel_tap_read_threads;
+		std::vector<std::unique_ptr<std::thread>> tunnel_socket_read_threads;
+		std::vector<std::unique_ptr<std::thread>> tunnel_tap_write_threads;
+		std::vector<std::unique_ptr<std::thread>> tunnel_io_uring_threads;
 		std::unique_ptr<std::thread> fdb_thread;
 
 		// Stop everything running...
 		bool stop_flag;
 
-		void tunnel_tap_read_handler();
-		void tunnel_socket_read_handler();
-		void tunnel_tap_write_handler();
+		void tunnel_tap_read_handler(size_t queue);
+		void tunnel_socket_read_handler(size_t index);
+		void tunnel_tap_write_handler(size_t queue);
 		void fdb_handler();
-
-		void _create_udp_socket();
-		void _destroy_udp_socket();
+#ifdef HAVE_LIBURING
+		void tunnel_io_uring_handler(size_t queue);
+#endif
+
+		bool _tap_read_frame(size_t queue, std::unique_ptr<PacketBuffer> &buffer);
+		void _flood_frame(std::unique_ptr<PacketBuffer> buffer);
+		bool _socket_read_packet(std::unique_ptr<PacketBuffer> &buffer, ReceivedBuffers &received_buffers);
+		void _socket_read_flush(ReceivedBuffers &received_buffers);
+		bool _tap_write_prepare(const std::unique_ptr<PacketBuffer> &buffer);
+		void _tap_write_release(std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+#ifdef HAVE_LIBURING
+		void _tap_write_io_uring(IOUringEngine &io_uring_engine, std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+#endif
+
+		void _set_thread_priority(std::thread &thread, const std::string &name);
+		void _set_thread_priority(std::thread &thread, const std::string &name, int priority);
+		void _set_thread_cpu(std::thread &thread, size_t slot, const std::string &name);
+
+		void _log_buffer_pool_stats(const std::string &name, std::shared_ptr<accl::BufferPool<PacketBuffer>> pool);
+		void _log_compression_stats(const RemoteNode &remote_node);
+
+		std::string _control_command(const std::vector<std::string> &args);
+
+		void _create_udp_sockets();
+		void _destroy_udp_sockets();
 };
 
 uint16_t get_l4mtu(uint16_t max_packet_size, sockaddr_storage *addr);
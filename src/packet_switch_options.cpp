@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "packet_switch_options.hpp"
+#include "common.hpp"
+#include <format>
+
+/**
+ * @brief Convert a socket write mode to a string.
+ *
+ * @param mode Socket write mode.
+ * @return std::string Mode as a string.
+ */
+std::string SocketWriteModeToString(SocketWriteMode mode) {
+	switch (mode) {
+	case SocketWriteMode::SENDTO:
+		return "sendto";
+	case SocketWriteMode::SENDMMSG:
+		return "sendmmsg";
+	case SocketWriteMode::GSO:
+		return "gso";
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * @brief Parse a socket write mode from a string.
+ *
+ * @param str String to parse.
+ * @param mode Mode parsed.
+ * @return true If the string was a valid mode.
+ * @return false If the string was not a valid mode.
+ */
+bool SocketWriteModeFromString(const std::string &str, SocketWriteMode &mode) {
+	if (str == "sendto") {
+		mode = SocketWriteMode::SENDTO;
+	} else if (str == "sendmmsg") {
+		mode = SocketWriteMode::SENDMMSG;
+	} else if (str == "gso") {
+		mode = SocketWriteMode::GSO;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Convert a socket read mode to a string.
+ *
+ * @param mode Socket read mode.
+ * @return std::string Mode as a string.
+ */
+std::string SocketReadModeToString(SocketReadMode mode) {
+	switch (mode) {
+	case SocketReadMode::RECVMMSG:
+		return "recvmmsg";
+	case SocketReadMode::GRO:
+		return "gro";
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * @brief Parse a socket read mode from a string.
+ *
+ * @param str String to parse.
+ * @param mode Mode parsed.
+ * @return true If the string was a valid mode.
+ * @return false If the string was not a valid mode.
+ */
+bool SocketReadModeFromString(const std::string &str, SocketReadMode &mode) {
+	if (str == "recvmmsg") {
+		mode = SocketReadMode::RECVMMSG;
+	} else if (str == "gro") {
+		mode = SocketReadMode::GRO;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Convert compression settings to a string.
+ *
+ * @param settings Compression settings.
+ * @return std::string Settings as a string.
+ */
+std::string CompressionSettingsToString(const CompressionSettings &settings) {
+	if (settings.packet_format == PacketHeaderOptionFormatType::NONE) {
+		return PacketHeaderOptionFormatTypeToString(settings.packet_format);
+	}
+	if (!settings.level) {
+		return std::format("{} (default level)", PacketHeaderOptionFormatTypeToString(settings.packet_format));
+	}
+	return std::format("{} level {}", PacketHeaderOptionFormatTypeToString(settings.packet_format), settings.level);
+}
+
+/**
+ * @brief Check if a compression level is valid for a packet format.
+ *
+ * @param format Packet format.
+ * @param level Compression level, 0 is always valid as it uses the default level.
+ * @return true If the level is valid.
+ * @return false If the level is out of range for the compression algorithm.
+ */
+bool CompressionLevelIsValid(PacketHeaderOptionFormatType format, int level) {
+	if (!level) {
+		return true;
+	}
+	switch (PacketHeaderOptionFormatTypeUnbatched(format)) {
+	case PacketHeaderOptionFormatType::COMPRESSED_LZ4:
+		return level >= SETH_COMPRESSION_LEVEL_LZ4_MIN && level <= SETH_COMPRESSION_LEVEL_LZ4_MAX;
+	case PacketHeaderOptionFormatType::COMPRESSED_ZSTD:
+		return level >= SETH_COMPRESSION_LEVEL_ZSTD_MIN && level <= SETH_COMPRESSION_LEVEL_ZSTD_MAX;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Convert an I/O engine to a string.
+ *
+ * @param engine I/O engine.
+ * @return std::string Engine as a string.
+ */
+std::string IOEngineToString(IOEngine engine) {
+	switch (engine) {
+	case IOEngine::BLOCKING:
+		return "blocking";
+	case IOEngine::IO_URING:
+		return "io_uring";
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * @brief Parse an I/O engine from a string.
+ *
+ * @param str String to parse.
+ * @param engine Engine parsed.
+ * @return true If the string was a valid engine.
+ * @return false If the string was not a valid engine.
+ */
+bool IOEngineFromString(const std::string &str, IOEngine &engine) {
+	if (str == "blocking") {
+		engine = IOEngine::BLOCKING;
+	} else if (str == "io_uring") {
+		engine = IOEngine::IO_URING;
+	} else {
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "codec.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * @brief How encoded packets are written to the UDP socket.
+ *
+ */
+enum class SocketWriteMode {
+	// One sendto() per packet
+	SENDTO,
+	// Batches of packets using sendmmsg()
+	SENDMMSG,
+	// Same size packets are coalesced into UDP GSO super-packets and sent in batches using sendmmsg()
+	GSO,
+};
+
+/**
+ * @brief How encapsulated packets are read from the UDP socket.
+ *
+ */
+enum class SocketReadMode {
+	// Batches of packets using recvmmsg(), one packet per buffer
+	RECVMMSG,
+	// UDP GRO super-packets using recvmmsg(), split into views of their segments
+	GRO,
+};
+
+/**
+ * @brief Engine used for TAP and UDP socket I/O.
+ *
+ */
+enum class IOEngine {
+	// Blocking syscalls on dedicated threads
+	BLOCKING,
+	// io_uring with batched submissions, TAP reads and socket receives share a single thread
+	IO_URING,
+};
+
+/**
+ * @brief Compression used when encoding packets for a remote node.
+ *
+ */
+struct CompressionSettings {
+		// Packet format, this picks the compression algorithm
+		PacketHeaderOptionFormatType packet_format{PacketHeaderOptionFormatType::NONE};
+		// Compression level, 0 uses the default level of the algorithm
+		int level{0};
+};
+
+/**
+ * @brief Advanced packet switch options, these are mostly tuning options set from the configuration file.
+ *
+ */
+struct PacketSwitchOptions {
+		// Socket write mode
+		SocketWriteMode socket_write_mode{SocketWriteMode::GSO};
+		// Socket read mode
+		SocketReadMode socket_read_mode{SocketReadMode::RECVMMSG};
+		// Number of sockets we receive on using SO_REUSEPORT, each with its own read thread
+		size_t socket_read_threads{1};
+		// I/O engine
+		IOEngine io_engine{IOEngine::BLOCKING};
+		// Number of TAP interface queues
+		size_t tap_queues{1};
+		// Use virtio-net headers and offloads on the TAP interface
+		bool tap_offload{false};
+		// Number of worker threads running the encoders and decoders, 0 uses one per CPU core
+		size_t worker_threads{0};
+		// Round robin realtime priority of the worker threads, 0 leaves them at normal priority
+		int worker_priority{0};
+		// Number of channels per remote node, frames are spread over the channels by flow so they are encoded in parallel
+		size_t channels{1};
+		// Encode frames flooded to multiple remote nodes once and send the same packet to all of them
+		bool flood_encode{true};
+		// Reference frames from the encoded packets instead of copying them in, sending the packets using scatter/gather IO
+		bool zero_copy_encode{true};
+		// Write uncompressed frames to the TAP interface straight out of the packets they were received in
+		bool zero_copy_decode{true};
+		// Send large packets using MSG_ZEROCOPY, holding onto them until the kernel is done with them
+		bool zero_copy_send{false};
+		// Send frames of flows which don't compress uncompressed, checking every now and then if they compress again
+		bool adaptive_compression{true};
+		// Dictionary to prime the compressors with, this is nullptr if we're not using one
+		std::shared_ptr<const std::string> compression_dictionary;
+		// ID sent with payloads compressed with the dictionary, 0 derives the ID from the dictionary
+		uint8_t compression_dictionary_id{0};
+		// Compression level used for remote nodes without their own compression settings, 0 uses the default level
+		int compression_level{0};
+		// Compression settings of remote nodes which don't use the global settings, indexed by node key
+		std::map<std::array<uint8_t, 16>, CompressionSettings> node_compression;
+		// Path of the control socket used to change settings at runtime, this is empty if we're not using one
+		std::string control_socket;
+};
+
+extern std::string SocketWriteModeToString(SocketWriteMode mode);
+extern bool SocketWriteModeFromString(const std::string &str, SocketWriteMode &mode);
+
+extern std::string SocketReadModeToString(SocketReadMode mode);
+extern bool SocketReadModeFromString(const std::string &str, SocketReadMode &mode);
+
+extern std::string CompressionSettingsToString(const CompressionSettings &settings);
+extern bool CompressionLevelIsValid(PacketHeaderOptionFormatType format, int level);
+
+extern std::string IOEngineToString(IOEngine engine);
+extern bool IOEngineFromString(const std::string &str, IOEngine &engine);
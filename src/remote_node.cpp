@@ -5,10 +5,13 @@
  */
 
 #include "remote_node.hpp"
+#include "common.hpp"
 #include "decoder.hpp"
 #include "encoder.hpp"
 #include "libaccl/logger.hpp"
 #include "packet_buffer.hpp"
+#include "socket_writer.hpp"
+#include "tap_interface.hpp"
 #include "util.hpp"
 #include <arpa/inet.h>
 #include <cstring>
@@ -17,9 +20,11 @@
 #include <sys/types.h>
 
 RemoteNode::RemoteNode(int udp_socket, const std::shared_ptr<sockaddr_storage> node_addr, int tx_size, int l2mtu, int buffer_size,
-					   PacketHeaderOptionFormatType packet_format, std::shared_ptr<accl::BufferPool<PacketBuffer>> tap_write_pool,
+					   int buffer_count, const CompressionSettings &compression, const PacketSwitchOptions &options,
+					   const std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> &tap_write_pools,
 					   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_rx_buffer_pool,
-					   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_tx_buffer_pool, bool *stop_flag) {
+					   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_tx_buffer_pool,
+					   std::shared_ptr<accl::TaskScheduler> scheduler) {
 
 	// Set UDP socket
 	this->udp_socket = udp_socket;
@@ -44,202 +49,339 @@ RemoteNode::RemoteNode(int udp_socket, const std::shared_ptr<sockaddr_storage> n
 
 	// Set buffer size
 	this->buffer_size = buffer_size;
-	// Set packet format
-	this->packet_format = packet_format;
+	// Set buffer count, this is our share of the buffers in flight and is what our queues are sized for
+	this->buffer_count = buffer_count;
+	// Set compression settings
+	this->compression = compression;
+	// Set advanced options
+	this->options = options;
+	// With TAP offloads each frame has a virtio-net header in front of it
+	this->frame_header_size = this->options.tap_offload ? sizeof(virtio_net_header_t) : 0;
 
 	// Set this nodes key
 	this->node_key = get_key_from_sockaddr(node_addr.get());
 
-	// Decoder and encoder poools
-	this->decoder_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(this->buffer_size);
-	this->encoder_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(this->buffer_size);
+	// Packets received are split up by channel before being queued, the encoder and decoder pools belong to the channel tasks
+	this->channel_buffers.resize(this->options.channels);
+	for (auto &buffers : this->channel_buffers) {
+		buffers.reserve(SETH_MAX_RECVMM_MESSAGES);
+	}
 
-	// Socket and TAP pools
-	this->socket_write_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(this->buffer_size);
-	this->tap_write_pool = tap_write_pool;
+	// TAP pools
+	this->tap_write_pools = tap_write_pools;
 
 	// Set available buffer pool
 	this->available_rx_buffer_pool = available_rx_buffer_pool;
 	this->available_tx_buffer_pool = available_tx_buffer_pool;
 
-	// Blank the socket write thread pointer
-	this->tunnel_socket_write_thread = nullptr;
-
-	// Link stop flag
-	this->stop_flag = stop_flag;
+	// Set the scheduler our tasks run on, these are only created when we're started
+	this->scheduler = scheduler;
 }
 
 /**
- * @brief Start the remote node.
+ * @brief Send large packets using MSG_ZEROCOPY, this must be set before the node is started.
+ *
+ * @param tracker Tracker of the zero-copy sends on the socket, or nullptr to copy all packets.
+ */
+void RemoteNode::setZeroCopyTracker(std::shared_ptr<ZeroCopyTracker> tracker) { this->zero_copy_tracker = tracker; }
+
+/**
+ * @brief Start the remote node, frames and packets can only be queued once the node is started.
  */
 void RemoteNode::start() {
 	LOG_DEBUG_INTERNAL("Starting remote node ", get_ipstr(this->node_addr.get()));
 
-	// Create the socket write thread
-	this->tunnel_decoder_thread = std::make_unique<std::thread>(&RemoteNode::_tunnel_decoder_handler, this);
-	this->tunnel_encoder_thread = std::make_unique<std::thread>(&RemoteNode::_tunnel_encoder_handler, this);
-	this->tunnel_socket_write_thread = std::make_unique<std::thread>(&RemoteNode::_socket_write_handler, this);
-
-	// Setup priority for a thread
-	int policy = SCHED_RR;
-	struct sched_param param;
-	param.sched_priority = sched_get_priority_max(SCHED_RR);
-	if (pthread_setschedparam(tunnel_decoder_thread->native_handle(), policy, &param)) {
-		LOG_NOTICE("Could not set decoder thread priority: ", std::strerror(errno));
+	for (size_t channel = 0; channel < this->options.channels; ++channel) {
+		this->encoder_tasks.push_back(std::make_unique<EncoderTask>(this, channel));
+		this->decoder_tasks.push_back(std::make_unique<DecoderTask>(this, channel));
 	}
-	if (pthread_setschedparam(tunnel_encoder_thread->native_handle(), policy, &param)) {
-		LOG_NOTICE("Could not set encoder thread priority: ", std::strerror(errno));
+}
+
+/**
+ * @brief Change the compression settings, the encoder switches over at the next packet boundary.
+ *
+ * @param compression Compression settings.
+ */
+void RemoteNode::setCompression(const CompressionSettings &compression) {
+	{
+		std::lock_guard<std::mutex> lock(this->compression_lock);
+		this->compression = compression;
 	}
-	if (pthread_setschedparam(this->tunnel_socket_write_thread->native_handle(), policy, &param)) {
-		LOG_NOTICE("Could not set socket write thread priority: ", std::strerror(errno));
+
+	for (auto &encoder_task : this->encoder_tasks) {
+		encoder_task->updateCompression();
 	}
 }
 
 /**
- * @brief Stop the remote node.
+ * @brief Get the compression settings.
+ *
+ * @return CompressionSettings Compression settings.
  */
-void RemoteNode::wait() {
-	// Join the threads
-	this->tunnel_decoder_thread->join();
-	this->tunnel_encoder_thread->join();
-	this->tunnel_socket_write_thread->join();
+CompressionSettings RemoteNode::getCompression() const {
+	std::lock_guard<std::mutex> lock(this->compression_lock);
+	return this->compression;
 }
 
 /**
- * @brief Thread responsible for decoding packets.
+ * @brief Get the compression statistics of the node, these are added up over the encoders of all channels.
  *
- * @param arg Thread data.
+ * @param stats Statistics to add the compression statistics of the node to.
+ * @return true If the statistics were added.
+ * @return false If the node has not been started.
  */
-void RemoteNode::_tunnel_decoder_handler() {
-	LOG_DEBUG_INTERNAL("DECODER: Starting decoder thread");
+bool RemoteNode::getCompressionStats(PacketEncoderCompressionStats &stats) const {
+	if (this->encoder_tasks.empty()) {
+		return false;
+	}
 
-	PacketDecoder decoder(this->l2mtu, this->tap_write_pool, this->available_tx_buffer_pool);
+	for (auto &encoder_task : this->encoder_tasks) {
+		const PacketEncoderCompressionStats &channel_stats = encoder_task->getCompressionStats();
+		stats.compressed_frames += channel_stats.compressed_frames;
+		stats.compressed_bytes += channel_stats.compressed_bytes;
+		stats.compressed_wire_bytes += channel_stats.compressed_wire_bytes;
+		stats.compress_time += channel_stats.compress_time;
+		stats.bypassed_frames += channel_stats.bypassed_frames;
+		stats.bypassed_bytes += channel_stats.bypassed_bytes;
+		stats.bypass_wire_delta += channel_stats.bypass_wire_delta;
+	}
 
-	// Loop pulling buffers off the socket write pool
-	std::deque<std::unique_ptr<PacketBuffer>> buffers;
-	while (true) {
-		// Check for program stop
-		if (*this->stop_flag) {
-			break;
-		}
+	return true;
+}
 
-		// Wait for buffers
-		this->decoder_pool->wait(buffers);
+/**
+ * @brief Queue a frame to be encoded and sent to the node.
+ *
+ * @param buffer Buffer holding the frame.
+ */
+void RemoteNode::queueEncode(std::unique_ptr<PacketBuffer> buffer) {
+	// Frames are spread over the channels by flow, so the order of frames within a flow is kept
+	size_t channel = 0;
+	if (this->encoder_tasks.size() > 1 && buffer->getDataSize() > this->frame_header_size) {
+		channel = get_ethernet_flow_hash(buffer->getData() + this->frame_header_size,
+										 buffer->getDataSize() - this->frame_header_size) %
+				  this->encoder_tasks.size();
+	}
+	this->encoder_tasks[channel]->queue(std::move(buffer));
+}
+
+/**
+ * @brief Queue packets received from the node to be decoded, this must only be called from the thread reading the socket the node
+ * is steered to.
+ *
+ * @param buffers Buffers holding the packets, at most SETH_MAX_RECVMM_MESSAGES, these are cleared keeping their capacity.
+ */
+void RemoteNode::queueDecode(std::vector<std::unique_ptr<PacketBuffer>> &buffers) {
+	if (this->decoder_tasks.size() == 1) {
+		this->decoder_tasks[0]->queue(buffers);
+		return;
+	}
+
+	// Split the packets up by channel, the socket read thread already checked the channel is one of ours
+	for (auto &buffer : buffers) {
+		const PacketHeader *packet_header = reinterpret_cast<const PacketHeader *>(buffer->getData());
+		this->channel_buffers[packet_header->channel].push_back(std::move(buffer));
+	}
+	buffers.clear();
 
-		// Loop with buffers
-		for (auto &buffer : buffers) {
-			decoder.decode(std::move(buffer));
+	for (size_t channel = 0; channel < this->channel_buffers.size(); ++channel) {
+		if (!this->channel_buffers[channel].empty()) {
+			this->decoder_tasks[channel]->queue(this->channel_buffers[channel]);
 		}
-		buffers.clear();
 	}
+}
 
-	LOG_DEBUG_INTERNAL("DECODER: Exiting decoder thread for node ", get_ipstr(this->node_addr.get()));
+/**
+ * @brief Construct a new RemoteNode::EncoderTask object.
+ *
+ * @param node Remote node we're encoding for.
+ * @param channel Channel we're encoding for.
+ */
+RemoteNode::EncoderTask::EncoderTask(RemoteNode *node, uint8_t channel)
+	: node(node), encoder_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(node->buffer_size, 0, node->buffer_count)),
+	  socket_write_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(node->buffer_size, 0, node->buffer_count)),
+	  compression_changed(false), encoder(node->l2mtu, node->l4mtu, socket_write_pool, node->available_rx_buffer_pool),
+	  socket_writer(node->udp_socket, node->options.socket_write_mode) {
+	this->encoder.setChannel(channel);
+	// Set compression level and packet format
+	CompressionSettings compression = node->getCompression();
+	this->encoder.setCompressionLevel(compression.level);
+	this->encoder.setPacketFormat(compression.packet_format);
+	this->encoder.setAdaptiveCompression(node->options.adaptive_compression);
+	this->encoder.setCompressionDictionary(node->options.compression_dictionary, node->options.compression_dictionary_id);
+	this->encoder.setZeroCopy(node->options.zero_copy_encode);
+	this->socket_writer.setZeroCopy(node->zero_copy_tracker);
+	// With TAP offloads each frame has a virtio-net header in front of it
+	this->encoder.setFrameHeaderSize(node->frame_header_size);
 }
 
 /**
- * @brief Thread responsible for encoding packets.
+ * @brief Queue a frame to be encoded.
  *
- * @param arg Thread data.
+ * @param buffer Buffer holding the frame.
  */
-void RemoteNode::_tunnel_encoder_handler() {
-	LOG_DEBUG_INTERNAL("ENCODER: Starting encoder thread");
+void RemoteNode::EncoderTask::queue(std::unique_ptr<PacketBuffer> buffer) {
+	this->encoder_pool->push(std::move(buffer));
+	this->node->scheduler->schedule(this);
+}
 
-	// Packet encoder
-	PacketEncoder encoder(this->l2mtu, this->l4mtu, this->socket_write_pool, this->available_rx_buffer_pool);
+/**
+ * @brief Pick up the current compression settings of the node on our next run.
+ *
+ */
+void RemoteNode::EncoderTask::updateCompression() {
+	this->compression_changed = true;
+	// Run the encoder so the settings are picked up even if we're not sending anything
+	this->node->scheduler->schedule(this);
+}
 
-	// Set packet format
-	encoder.setPacketFormat(this->packet_format);
+/**
+ * @brief Encode the frames queued for the node and write out the encoded packets.
+ *
+ * If no frames are queued we flush the encoder once SETH_ENCODER_FLUSH_TIMEOUT has passed since the last frame, so a partially
+ * filled packet is not held back for long. While packets sent using zero-copy are in flight we keep running every
+ * SETH_ENCODER_FLUSH_TIMEOUT to release them once the kernel is done with them.
+ *
+ * @return std::chrono::nanoseconds Time until the encoder needs to be flushed.
+ */
+std::chrono::nanoseconds RemoteNode::EncoderTask::run() {
+	auto now = std::chrono::steady_clock::now();
+
+	// Switch over to new compression settings before encoding anything else
+	if (this->compression_changed.exchange(false)) {
+		this->_updateCompression();
+	}
 
-	// Statistics thread
-	// std::thread stats_thread(tunnel_encoder_stats_handler, &encoder, tdata);
+	// Grab a batch of frames, leaving the rest for our next run so other tasks on this worker get a look in
+	this->encoder_pool->pop(this->buffers, SETH_WORKER_BATCH_SIZE);
 
-	// Loop pulling buffers off the encoder pool
-	std::chrono::milliseconds timeout = std::chrono::milliseconds(1);
-	std::deque<std::unique_ptr<PacketBuffer>> buffers;
-	while (true) {
-		// Check for program stop
-		if (*this->stop_flag) {
-			break;
+	// If there were no frames, we were woken up to flush the encoder
+	if (this->buffers.empty()) {
+		if (now < this->flush_time) {
+			return this->flush_time - now;
 		}
-
-		// Check if we timed out
-		if (!this->encoder_pool->wait_for(timeout, buffers)) {
-			// If we did, flush the encoder and zero the wait so we wait indefinitely
-			encoder.flush();
-			timeout = std::chrono::milliseconds::zero();
-			continue;
+		this->encoder.flush();
+		this->_write();
+		if (this->socket_writer.getZeroCopyPendingCount()) {
+			return SETH_ENCODER_FLUSH_TIMEOUT;
 		}
+		return std::chrono::nanoseconds::zero();
+	}
 
-		LOG_DEBUG_INTERNAL("NKDEBUG: Got ", buffers.size(), " buffers from encoder pool");
+	LOG_DEBUG_INTERNAL("ENCODER: Got ", this->buffers.size(), " buffers from encoder pool");
 
-		// Loop with the buffers we got
-		for (auto &buffer : buffers) {
-			encoder.encode(std::move(buffer));
+	// Loop with the buffers we got
+	for (auto &buffer : this->buffers) {
+		this->encoder.encode(std::move(buffer));
+		// Write out a full batch as soon as we have one rather than holding onto the buffers
+		if (this->socket_write_pool->getBufferCount() >= SETH_MAX_SENDMM_MESSAGES) {
+			this->_write();
 		}
-		// Clear buffers
-		buffers.clear();
+	}
+	this->buffers.clear();
+	this->_write();
+
+	// If there are more frames waiting, run again after whatever else is queued on this worker
+	if (this->encoder_pool->getBufferCount()) {
+		this->node->scheduler->schedule(this);
+	}
+
+	this->flush_time = now + SETH_ENCODER_FLUSH_TIMEOUT;
+	return SETH_ENCODER_FLUSH_TIMEOUT;
+}
+
+/**
+ * @brief Internal method to switch the encoder over to the current compression settings of the node.
+ *
+ * The packet being encoded is flushed and written out first, so the compression changes at a packet boundary.
+ */
+void RemoteNode::EncoderTask::_updateCompression() {
+	CompressionSettings compression = this->node->getCompression();
+
+	this->encoder.flush();
+	this->_write();
+
+	this->encoder.setCompressionLevel(compression.level);
+	if (compression.packet_format != this->encoder.getPacketFormat()) {
+		this->encoder.setPacketFormat(compression.packet_format);
+	}
+
+	LOG_NOTICE("Compression for ", get_ipstr(this->node->node_addr.get()), " set to ", CompressionSettingsToString(compression));
+}
 
-		// Set timeout to 1ms
-		timeout = std::chrono::milliseconds(1);
+/**
+ * @brief Internal method to write the encoded packets to the socket.
+ *
+ */
+void RemoteNode::EncoderTask::_write() {
+	if (this->socket_write_pool->pop(this->write_buffers, accl::BUFFER_POOL_POP_ALL)) {
+		LOG_DEBUG_INTERNAL("SOCKET WRITE: Writing ", this->write_buffers.size(), " buffers to SOCKET => ",
+						   get_ipstr(this->node->node_addr.get()));
+		this->socket_writer.write(this->node->node_addr.get(), this->write_buffers);
 	}
 
-	// Wait for stats thread to finish
-	// stats_thread.join();
+	// Buffers sent using zero-copy are held by the socket writer until the kernel is done with them
+	this->socket_writer.reapZeroCopy(this->write_buffers);
+	if (this->write_buffers.empty()) {
+		return;
+	}
 
-	LOG_DEBUG_INTERNAL("ENCODER: Exiting encoder thread for node ", get_ipstr(this->node_addr.get()));
+	// Push buffers into available pool, along with the frames they reference
+	this->encoder.releaseTxBuffers(this->write_buffers);
 }
 
 /**
- * @brief Thread responsible for writing encoded packets to the socket.
+ * @brief Construct a new RemoteNode::DecoderTask object.
+ *
+ * Our pool holds packets read into buffers of the available TX buffer pool, or when using UDP GRO views of the segments of the
+ * super-packets, so it has room for our share of the buffers along with all the GRO views.
  *
- * @param arg Thread data.
+ * @param node Remote node we're decoding for.
+ * @param channel Channel we're decoding for.
  */
-void RemoteNode::_socket_write_handler() {
-	LOG_DEBUG_INTERNAL("SOCKET WRITE: Starting socket write thread");
+RemoteNode::DecoderTask::DecoderTask(RemoteNode *node, uint8_t channel)
+	: node(node),
+	  decoder_pool(std::make_shared<accl::SPSCBufferPool<PacketBuffer>>(
+		  node->buffer_size, 0,
+		  node->buffer_count + (node->options.socket_read_mode == SocketReadMode::GRO ? SETH_GRO_VIEW_COUNT : 0))),
+	  decoder(node->l2mtu, node->tap_write_pools, node->available_tx_buffer_pool) {
+	this->decoder.setChannel(channel);
+	// Payloads compressed with our dictionary can only be decompressed with it
+	this->decoder.setCompressionDictionary(node->options.compression_dictionary, node->options.compression_dictionary_id);
+	this->decoder.setZeroCopy(node->options.zero_copy_decode);
+	// Frames are spread over the TAP queues by flow, so the order of frames within a flow is kept
+	this->decoder.setFrameHeaderSize(node->frame_header_size);
+}
 
-	// Constant used below
-	socklen_t addrlen = sizeof(struct sockaddr_in6);
-	// sendto() flags
-	int flags = 0;
+/**
+ * @brief Queue packets to be decoded, this must only be called from the socket read thread.
+ *
+ * @param buffers Buffers holding the packets, these are cleared.
+ */
+void RemoteNode::DecoderTask::queue(std::vector<std::unique_ptr<PacketBuffer>> &buffers) {
+	this->decoder_pool->push(buffers);
+	this->node->scheduler->schedule(this);
+}
 
-	// Loop pulling buffers off the socket write pool
-	std::deque<std::unique_ptr<PacketBuffer>> buffers;
-	while (true) {
-		// Check for program stop
-		if (*this->stop_flag) {
-			break;
-		}
+/**
+ * @brief Decode the packets received from the node.
+ *
+ * @return std::chrono::nanoseconds Always zero, the decoder does not need to be run again unless more packets arrive.
+ */
+std::chrono::nanoseconds RemoteNode::DecoderTask::run() {
+	// Grab a batch of packets, leaving the rest for our next run so other tasks on this worker get a look in
+	this->decoder_pool->pop(this->buffers, SETH_WORKER_BATCH_SIZE);
 
-		// Wait for buffers
-		this->socket_write_pool->wait(buffers);
-
-		// Loop with the buffers we got
-#ifdef DEBUG
-		size_t i{0};
-#endif
-		for (auto &buffer : buffers) {
-
-			// FIXME
-			const sockaddr_storage *addr = this->node_addr.get();
-
-			std::string ipstr = get_ipstr(addr);
-			LOG_DEBUG_INTERNAL("SOCKET WRITE: Writing ", buffer->getDataSize(), " bytes to SOCKET => ", ipstr);
-
-			// Write data out
-			ssize_t bytes_written =
-				sendto(this->udp_socket, buffer->getData(), buffer->getDataSize(), flags, (struct sockaddr *)addr, addrlen);
-			if (bytes_written == -1) {
-				LOG_ERROR("Got an error in sendto(): ", strerror(errno));
-			}
-#ifdef DEBUG
-			i++;
-			LOG_DEBUG_INTERNAL("Wrote ", bytes_written, " bytes to tunnel [buffer: ", i, "/", buffers.size(), "]");
-#endif
-		}
+	// Loop with buffers
+	for (auto &buffer : this->buffers) {
+		this->decoder.decode(std::move(buffer));
+	}
+	this->buffers.clear();
 
-		// Push buffers into available pool
-		this->available_rx_buffer_pool->push(buffers);
+	// If there are more packets waiting, run again after whatever else is queued on this worker
+	if (this->decoder_pool->getBufferCount()) {
+		this->node->scheduler->schedule(this);
 	}
 
-	LOG_DEBUG_INTERNAL("SOCKET WRITE: Exiting socket write thread for node ", get_ipstr(this->node_addr.get()));
+	return std::chrono::nanoseconds::zero();
 }
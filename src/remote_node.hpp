@@ -7,61 +7,137 @@
 #pragma once
 
 #include "codec.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "packet_switch_options.hpp"
+#include "socket_writer.hpp"
+#include "zero_copy_tracker.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <libaccl/buffer_pool.hpp>
+#include <libaccl/task_scheduler.hpp>
 #include <memory>
+#include <mutex>
 #include <netinet/in.h>
 #include <packet_buffer.hpp>
+#include <vector>
 
 class RemoteNode {
 	public:
 		RemoteNode(int udp_socket, const std::shared_ptr<sockaddr_storage> node_addr, int tx_size, int l2mtu, int buffer_size,
-				   PacketHeaderOptionFormatType packet_format, std::shared_ptr<accl::BufferPool<PacketBuffer>> tap_write_pool,
+				   int buffer_count, const CompressionSettings &compression, const PacketSwitchOptions &options,
+				   const std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> &tap_write_pools,
 				   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_rx_buffer_pool,
-				   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_tx_buffer_pool, bool *stop_flag);
+				   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_tx_buffer_pool,
+				   std::shared_ptr<accl::TaskScheduler> scheduler);
 
+		void setZeroCopyTracker(std::shared_ptr<ZeroCopyTracker> tracker);
 		void start();
-		void wait();
+
+		void queueEncode(std::unique_ptr<PacketBuffer> buffer);
+		void queueDecode(std::vector<std::unique_ptr<PacketBuffer>> &buffers);
 
 		inline const std::array<uint8_t, 16> &getNodeKey() const;
 		inline const std::shared_ptr<sockaddr_storage> getNodeAddr() const;
+		inline uint16_t getL4MTUSize() const;
+		inline size_t getChannelCount() const;
 
-		inline std::shared_ptr<accl::BufferPool<PacketBuffer>> getDecoderPool();
-		inline std::shared_ptr<accl::BufferPool<PacketBuffer>> getEncoderPool();
-		inline std::shared_ptr<accl::BufferPool<PacketBuffer>> getSocketWritePool();
+		void setCompression(const CompressionSettings &compression);
+		CompressionSettings getCompression() const;
+		bool getCompressionStats(PacketEncoderCompressionStats &stats) const;
 
 	private:
 		int udp_socket;
+		// Tracker of the MSG_ZEROCOPY sends on the socket, this is nullptr if we're not using zero-copy sends
+		std::shared_ptr<ZeroCopyTracker> zero_copy_tracker;
 		std::shared_ptr<sockaddr_storage> node_addr;
 		uint16_t tx_size;
 		uint16_t l2mtu;
 		uint16_t l4mtu;
 		int buffer_size;
-		PacketHeaderOptionFormatType packet_format;
+		int buffer_count;
+		PacketSwitchOptions options;
+		// Size of the header in front of each frame, this is skipped when working out the flow of a frame
+		size_t frame_header_size;
+
+		// Compression settings, these can be changed at runtime and are picked up by the encoder task on its next run
+		CompressionSettings compression;
+		mutable std::mutex compression_lock;
 
 		// Node key used to index this node
 		std::array<uint8_t, 16> node_key;
 
-		// Buffer pool for decoder and encoder
-		std::shared_ptr<accl::BufferPool<PacketBuffer>> decoder_pool;
-		std::shared_ptr<accl::BufferPool<PacketBuffer>> encoder_pool;
-		// Buffer pool for socket write
-		std::shared_ptr<accl::BufferPool<PacketBuffer>> socket_write_pool;
-		std::shared_ptr<accl::BufferPool<PacketBuffer>> tap_write_pool;
+		// Packets received for each channel, these are only used by the socket read thread to split up the packets it queues, each
+		// has room for SETH_MAX_RECVMM_MESSAGES packets which is the most we're given at once
+		std::vector<std::vector<std::unique_ptr<PacketBuffer>>> channel_buffers;
+		// Buffer pool for TAP write of each TAP queue
+		std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> tap_write_pools;
 		// Available buffer pools
 		std::shared_ptr<accl::BufferPool<PacketBuffer>> available_rx_buffer_pool;
 		std::shared_ptr<accl::BufferPool<PacketBuffer>> available_tx_buffer_pool;
 
-		// Buffer pool write thread
-		std::unique_ptr<std::thread> tunnel_decoder_thread;
-		std::unique_ptr<std::thread> tunnel_encoder_thread;
-		std::unique_ptr<std::thread> tunnel_socket_write_thread;
-
-		// Stop flag
-		bool *stop_flag;
-
-		void _tunnel_decoder_handler();
-		void _tunnel_encoder_handler();
-		void _socket_write_handler();
+		/**
+		 * @brief Task encoding the frames queued for a channel of the node and writing the encoded packets to the socket.
+		 *
+		 */
+		class EncoderTask : public accl::Task {
+			public:
+				EncoderTask(RemoteNode *node, uint8_t channel);
+
+				void queue(std::unique_ptr<PacketBuffer> buffer);
+				void updateCompression();
+
+				inline const PacketEncoderCompressionStats &getCompressionStats() const;
+
+			protected:
+				std::chrono::nanoseconds run() override;
+
+			private:
+				RemoteNode *node;
+				// Buffer pool for encoder, this is fed by the TAP read thread of each TAP queue
+				std::shared_ptr<accl::BufferPool<PacketBuffer>> encoder_pool;
+				// Buffer pool for socket write, this is fed by the encoder and written out by us
+				std::shared_ptr<accl::BufferPool<PacketBuffer>> socket_write_pool;
+				// Set when the compression settings of the node change, these are picked up on our next run
+				std::atomic<bool> compression_changed;
+				PacketEncoder encoder;
+				SocketWriter socket_writer;
+				std::deque<std::unique_ptr<PacketBuffer>> buffers;
+				std::deque<std::unique_ptr<PacketBuffer>> write_buffers;
+				// Time the encoder is flushed if no more frames are queued
+				std::chrono::steady_clock::time_point flush_time;
+
+				void _updateCompression();
+				void _write();
+		};
+
+		/**
+		 * @brief Task decoding the packets received from the node on a channel.
+		 *
+		 */
+		class DecoderTask : public accl::Task {
+			public:
+				DecoderTask(RemoteNode *node, uint8_t channel);
+
+				void queue(std::vector<std::unique_ptr<PacketBuffer>> &buffers);
+
+			protected:
+				std::chrono::nanoseconds run() override;
+
+			private:
+				RemoteNode *node;
+				// Buffer pool for decoder, this is only fed by the socket read thread
+				std::shared_ptr<accl::SPSCBufferPool<PacketBuffer>> decoder_pool;
+				PacketDecoder decoder;
+				std::deque<std::unique_ptr<PacketBuffer>> buffers;
+		};
+
+		// Scheduler running our tasks, so the number of threads doesn't depend on the number of nodes
+		std::shared_ptr<accl::TaskScheduler> scheduler;
+		// Encoder and decoder tasks of each channel, the frames of a flow always go over the same channel
+		std::vector<std::unique_ptr<EncoderTask>> encoder_tasks;
+		std::vector<std::unique_ptr<DecoderTask>> decoder_tasks;
 };
 
 /**
@@ -79,22 +155,24 @@ inline const std::array<uint8_t, 16> &RemoteNode::getNodeKey() const { return th
 inline const std::shared_ptr<sockaddr_storage> RemoteNode::getNodeAddr() const { return this->node_addr; }
 
 /**
- * @brief Return this nodes decoder pool
+ * @brief Get the maximum layer 4 segment size we can send to the node.
  *
- * @return std::shared_ptr<accl::BufferPool<PacketBuffer>>
+ * @return uint16_t L4MTU size.
  */
-inline std::shared_ptr<accl::BufferPool<PacketBuffer>> RemoteNode::getDecoderPool() { return this->decoder_pool; }
+inline uint16_t RemoteNode::getL4MTUSize() const { return this->l4mtu; }
 
 /**
- * @brief Return this nodes encoder pool
+ * @brief Get the number of channels the node sends and receives packets on.
  *
- * @return std::shared_ptr<accl::BufferPool<PacketBuffer>>
+ * @return size_t Number of channels.
  */
-inline std::shared_ptr<accl::BufferPool<PacketBuffer>> RemoteNode::getEncoderPool() { return this->encoder_pool; }
+inline size_t RemoteNode::getChannelCount() const { return this->options.channels; }
 
 /**
- * @brief Return this nodes socket write pool
+ * @brief Get the compression statistics of the encoder.
  *
- * @return std::shared_ptr<accl::BufferPool<PacketBuffer>>
+ * @return const PacketEncoderCompressionStats& Compression statistics.
  */
-inline std::shared_ptr<accl::BufferPool<PacketBuffer>> RemoteNode::getSocketWritePool() { return this->socket_write_pool; }
+inline const PacketEncoderCompressionStats &RemoteNode::EncoderTask::getCompressionStats() const {
+	return this->encoder.getCompressionStats();
+}
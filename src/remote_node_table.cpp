@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "remote_node_table.hpp"
+#include <bit>
+
+/**
+ * @brief Construct a new RemoteNodeTable object.
+ *
+ */
+RemoteNodeTable::RemoteNodeTable() : slots(2), mask(1) {}
+
+/**
+ * @brief Add a remote node, this must be done before any lookups are made.
+ *
+ * @param remote_node Remote node to add.
+ * @return size_t Node ID of the remote node, if the node was already added this is its existing node ID.
+ */
+size_t RemoteNodeTable::add(std::shared_ptr<RemoteNode> remote_node) {
+	const std::array<uint8_t, 16> &node_key = remote_node->getNodeKey();
+	size_t node_id = this->find(node_key);
+	if (node_id != npos) {
+		return node_id;
+	}
+
+	node_id = this->nodes.size();
+	this->nodes.push_back(remote_node);
+
+	// Keep the table at most half full, growing it means adding all the nodes again
+	if (this->nodes.size() * 2 > this->slots.size()) {
+		this->slots.assign(std::bit_ceil(this->nodes.size() * 2), Slot{});
+		this->mask = this->slots.size() - 1;
+		for (size_t id = 0; id < this->nodes.size(); ++id) {
+			this->_insert(this->nodes[id]->getNodeKey(), id);
+		}
+	} else {
+		this->_insert(node_key, node_id);
+	}
+
+	return node_id;
+}
+
+/**
+ * @brief Internal method to insert a node key into the first free slot of its probe sequence.
+ *
+ * @param node_key Node key.
+ * @param node_id Node ID.
+ */
+void RemoteNodeTable::_insert(const std::array<uint8_t, 16> &node_key, size_t node_id) {
+	size_t slot = _hash(node_key) & this->mask;
+	while (this->slots[slot].node_id) {
+		slot = (slot + 1) & this->mask;
+	}
+	this->slots[slot].node_key = node_key;
+	this->slots[slot].node_id = node_id + 1;
+}
\ No newline at end of file
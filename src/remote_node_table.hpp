@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "remote_node.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Table of the remote nodes used to find the node a packet was received from.
+ *
+ * Each node gets a node ID in the order it was added, these are used to index arrays held for each node. The node keys are
+ * stored inline in an open-addressing hash table using linear probing, which is kept at most half full. Nodes are only added
+ * while setting up, so lookups never take a lock.
+ */
+class RemoteNodeTable {
+	public:
+		// Node ID returned when a node is not found
+		static constexpr size_t npos = SIZE_MAX;
+
+		RemoteNodeTable();
+
+		size_t add(std::shared_ptr<RemoteNode> remote_node);
+		inline size_t find(const std::array<uint8_t, 16> &node_key) const;
+
+		inline RemoteNode *get(size_t node_id) const;
+		inline const std::shared_ptr<RemoteNode> &getShared(size_t node_id) const;
+		inline size_t size() const;
+
+	private:
+		struct Slot {
+				std::array<uint8_t, 16> node_key;
+				// Node ID plus one, this is 0 if the slot is empty
+				size_t node_id;
+		};
+
+		// Slots of the hash table, the size is always a power of 2
+		std::vector<Slot> slots;
+		size_t mask;
+
+		// Nodes indexed by their node ID
+		std::vector<std::shared_ptr<RemoteNode>> nodes;
+
+		static inline size_t _hash(const std::array<uint8_t, 16> &node_key);
+		void _insert(const std::array<uint8_t, 16> &node_key, size_t node_id);
+};
+
+/**
+ * @brief Internal method to hash a node key, the two halves of the key are folded together and mixed.
+ *
+ * @param node_key Node key.
+ * @return size_t Hash of the node key.
+ */
+inline size_t RemoteNodeTable::_hash(const std::array<uint8_t, 16> &node_key) {
+	uint64_t high, low;
+	std::memcpy(&high, node_key.data(), sizeof(high));
+	std::memcpy(&low, node_key.data() + sizeof(high), sizeof(low));
+	return ((high ^ low) * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+/**
+ * @brief Find the node ID of a remote node.
+ *
+ * @param node_key Node key of the remote node.
+ * @return size_t Node ID, or npos if there is no such node.
+ */
+inline size_t RemoteNodeTable::find(const std::array<uint8_t, 16> &node_key) const {
+	// There is always an empty slot, so we're sure to stop
+	for (size_t slot = _hash(node_key) & mask;; slot = (slot + 1) & mask) {
+		const Slot &entry = slots[slot];
+		if (!entry.node_id) {
+			return npos;
+		}
+		if (entry.node_key == node_key) {
+			return entry.node_id - 1;
+		}
+	}
+}
+
+/**
+ * @brief Get a remote node using its node ID.
+ *
+ * @param node_id Node ID.
+ * @return RemoteNode* Remote node.
+ */
+inline RemoteNode *RemoteNodeTable::get(size_t node_id) const { return nodes[node_id].get(); }
+
+/**
+ * @brief Get a remote node using its node ID, for when we need to hold on to it.
+ *
+ * @param node_id Node ID.
+ * @return const std::shared_ptr<RemoteNode>& Remote node.
+ */
+inline const std::shared_ptr<RemoteNode> &RemoteNodeTable::getShared(size_t node_id) const { return nodes[node_id]; }
+
+/**
+ * @brief Get the number of remote nodes, node IDs are below this.
+ *
+ * @return size_t Number of remote nodes.
+ */
+inline size_t RemoteNodeTable::size() const { return nodes.size(); }
\ No newline at end of file
@@ -0,0 +1,245 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "socket_reader.hpp"
+#include "common.hpp"
+#include "exceptions.hpp"
+#include "libaccl/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+/**
+ * @brief Construct a new SocketReader object.
+ *
+ * @param udp_socket UDP socket to read from.
+ * @param mode Socket read mode.
+ * @param available_buffer_pool Pool to get receive buffers from, buffers read are pushed back into this pool once used.
+ */
+SocketReader::SocketReader(int udp_socket, SocketReadMode mode,
+						   std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool)
+	: udp_socket(udp_socket), mode(mode), available_buffer_pool(available_buffer_pool), view_arena(nullptr), syscall_count(0),
+	  packet_count(0) {
+
+	// Enable UDP GRO on the socket, if we can't we fall back to recvmmsg()
+	if (this->mode == SocketReadMode::GRO) {
+		int enable = 1;
+		if (setsockopt(this->udp_socket, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == -1) {
+			LOG_NOTICE("UDP GRO is not supported, falling back to recvmmsg(): ", strerror(errno));
+			this->mode = SocketReadMode::RECVMMSG;
+		}
+	}
+
+	// Work out where our receive buffers come from
+	size_t msg_count;
+	if (this->mode == SocketReadMode::GRO) {
+		msg_count = SETH_MAX_GRO_MESSAGES;
+		this->receive_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(
+			SETH_GRO_BUFFER_SIZE, SETH_GRO_BUFFER_COUNT, SETH_GRO_BUFFER_COUNT, accl::BufferPoolAllocation::ARENA);
+		this->view_arena = accl::BufferArena::createSlots(sizeof(PacketBuffer), alignof(PacketBuffer), SETH_GRO_VIEW_COUNT);
+	} else {
+		msg_count = SETH_MAX_RECVMM_MESSAGES;
+		this->receive_buffer_pool = this->available_buffer_pool;
+	}
+
+	// Set up messages and grab a buffer for each
+	this->msgs.resize(msg_count);
+	this->iovs.resize(msg_count);
+	this->controls.resize(msg_count);
+	this->msg_buffers.resize(msg_count);
+	for (size_t i = 0; i < msg_count; ++i) {
+		this->msg_buffers[i] = this->receive_buffer_pool->pop_wait();
+		_setupMessage(i);
+	}
+}
+
+/**
+ * @brief Destroy the SocketReader object, returning our receive buffers to their pool.
+ *
+ */
+SocketReader::~SocketReader() {
+	for (auto &buffer : this->msg_buffers) {
+		if (buffer) {
+			this->receive_buffer_pool->push(std::move(buffer));
+		}
+	}
+	// Segments still out there keep the arena around until they are released
+	if (this->view_arena) {
+		this->view_arena->release();
+	}
+}
+
+/**
+ * @brief Read packets from the socket, blocking until at least one is available.
+ *
+ * @param buffers List to add the packets read to, the source of each packet is set.
+ * @return size_t Number of packets read.
+ * @exception SuperEthernetTunnelRuntimeException Reading from the socket failed.
+ */
+size_t SocketReader::read(std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	int num_received = recvmmsg(this->udp_socket, this->msgs.data(), this->msgs.size(), MSG_WAITFORONE, nullptr);
+	++this->syscall_count;
+	if (num_received == -1) {
+		if (errno == EINTR) {
+			return 0;
+		}
+		throw SuperEthernetTunnelRuntimeException(std::format("recvmmsg failed: {}", strerror(errno)));
+	}
+
+	size_t count = buffers.size();
+	for (int i = 0; i < num_received; ++i) {
+		// Set the amount of data we got
+		auto &buffer = this->msg_buffers[i];
+		buffer->setDataSize(this->msgs[i].msg_len);
+
+		if (this->mode == SocketReadMode::GRO) {
+			_splitSegments(std::move(buffer), this->msgs[i].msg_hdr, buffers);
+		} else {
+			buffers.push_back(std::move(buffer));
+		}
+
+		// Replenish the buffer
+		this->msg_buffers[i] = this->receive_buffer_pool->pop_wait();
+		_setupMessage(i);
+	}
+	count = buffers.size() - count;
+
+	this->packet_count += count;
+	return count;
+}
+
+/**
+ * @brief Recycle a buffer we read that is not going to be used.
+ *
+ * @param buffer Buffer to recycle, views are released and other buffers are pushed back into the available buffer pool.
+ */
+void SocketReader::recycle(std::unique_ptr<PacketBuffer> buffer) {
+	if (buffer->isView()) {
+		return;
+	}
+	this->available_buffer_pool->push(std::move(buffer));
+}
+
+/**
+ * @brief Internal method to point a message at its receive buffer.
+ *
+ * @param index Message index.
+ */
+void SocketReader::_setupMessage(size_t index) {
+	auto &buffer = this->msg_buffers[index];
+
+	this->iovs[index].iov_base = buffer->getData();
+	this->iovs[index].iov_len = buffer->getBufferSize();
+
+	msghdr &hdr = this->msgs[index].msg_hdr;
+	hdr.msg_name = buffer->getPacketSourceData();
+	hdr.msg_namelen = sizeof(sockaddr_storage);
+	hdr.msg_iov = &this->iovs[index];
+	hdr.msg_iovlen = 1;
+	hdr.msg_flags = 0;
+	// We only need control messages to get the GRO segment size
+	if (this->mode == SocketReadMode::GRO) {
+		hdr.msg_control = this->controls[index].data;
+		hdr.msg_controllen = sizeof(this->controls[index].data);
+	} else {
+		hdr.msg_control = nullptr;
+		hdr.msg_controllen = 0;
+	}
+}
+
+/**
+ * @brief Internal method to split a GRO super-packet into views of its segments.
+ *
+ * @param buffer Buffer the super-packet was received into.
+ * @param hdr Message header the super-packet was received with.
+ * @param buffers List to add the segment views to.
+ */
+void SocketReader::_splitSegments(std::unique_ptr<PacketBuffer> buffer, const msghdr &hdr,
+								  std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	size_t data_size = buffer->getDataSize();
+
+	// If the kernel coalesced the packet, it tells us the segment size, if not its a single packet
+	size_t segment_size = data_size;
+	for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+			int gso_size;
+			std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+			if (gso_size > 0) {
+				segment_size = gso_size;
+			}
+			break;
+		}
+	}
+
+	// Share the buffer, it is pushed back into its pool when the last view is released
+	PacketBuffer *backing = buffer.release();
+	backing->share(this->receive_buffer_pool);
+
+	LOG_DEBUG_INTERNAL("SOCKET READ: Splitting ", data_size, " bytes into segments of ", segment_size);
+
+	// Create a view for each segment, the last segment may be shorter
+	for (size_t offset = 0; offset < data_size; offset += segment_size) {
+		buffers.push_back(
+			PacketBuffer::createView(this->view_arena, backing, offset, std::min(segment_size, data_size - offset)));
+	}
+
+	// Let go of our share, if there were no segments this pushes the buffer straight back into its pool
+	backing->unshare();
+}
+
+/**
+ * @brief Get the offset a classic BPF program loads from to read the packet relative to its network header.
+ *
+ * @param offset Offset into the network header.
+ * @return uint32_t BPF load offset.
+ */
+static constexpr uint32_t bpf_net_offset(int offset) { return static_cast<uint32_t>(SKF_NET_OFF + offset); }
+
+/**
+ * @brief Steer the packets received on a group of SO_REUSEPORT sockets by their source address.
+ *
+ * All the packets of a remote node are received on the same socket, so they are read by a single thread. Without this the kernel
+ * picks the socket using a hash of the addresses and ports, which moves a remote node to another socket if its source port changes.
+ *
+ * @param udp_socket Any socket in the group.
+ * @param socket_count Number of sockets in the group, the sockets are indexed in the order they were bound.
+ * @return true If the steering program was attached.
+ * @return false If the steering program could not be attached, errno is set.
+ */
+bool set_socket_read_steering(int udp_socket, size_t socket_count) {
+	// Classic BPF program returning the index of the socket, the source address is loaded relative to the network header as the
+	// packet data starts at the UDP payload, IPv6 addresses have their 4 words XOR'd together
+	sock_filter code[] = {
+		// Get the IP version
+		BPF_STMT(BPF_LD | BPF_B | BPF_ABS, bpf_net_offset(0)),
+		BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 2, 0),
+		// IPv4 source address
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, bpf_net_offset(12)),
+		BPF_STMT(BPF_JMP | BPF_JA, 10),
+		// IPv6 source address
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, bpf_net_offset(8)),
+		BPF_STMT(BPF_MISC | BPF_TAX, 0),
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, bpf_net_offset(12)),
+		BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+		BPF_STMT(BPF_MISC | BPF_TAX, 0),
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, bpf_net_offset(16)),
+		BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+		BPF_STMT(BPF_MISC | BPF_TAX, 0),
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, bpf_net_offset(20)),
+		BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+		// Return the index of the socket
+		BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(socket_count)),
+		BPF_STMT(BPF_RET | BPF_A, 0),
+	};
+	sock_fprog prog{static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+
+	return setsockopt(udp_socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
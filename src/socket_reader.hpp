@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "libaccl/buffer_pool.hpp"
+#include "packet_buffer.hpp"
+#include "packet_switch_options.hpp"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <sys/socket.h>
+#include <vector>
+
+/**
+ * @brief Reads batches of encapsulated packets from a UDP socket.
+ *
+ * When using UDP GRO the kernel hands us super-packets made up of same size segments, each segment is returned as a view into
+ * the buffer the super-packet was received into. The receive buffer is returned to its pool once all its views are released. The
+ * views are created in an arena of their own, so receiving needs no allocation.
+ */
+class SocketReader {
+	public:
+		SocketReader(int udp_socket, SocketReadMode mode, std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool);
+		~SocketReader();
+
+		size_t read(std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+		void recycle(std::unique_ptr<PacketBuffer> buffer);
+
+		inline SocketReadMode getMode() const;
+		inline uint64_t getSyscallCount() const;
+		inline uint64_t getPacketCount() const;
+
+	private:
+		// Control message buffer used to get the UDP GRO segment size
+		struct GROControl {
+				alignas(cmsghdr) char data[CMSG_SPACE(sizeof(int))];
+		};
+
+		int udp_socket;
+		SocketReadMode mode;
+
+		// Pool we get our receive buffers from, in GRO mode this is our own pool of large buffers
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> available_buffer_pool;
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> receive_buffer_pool;
+		// Arena the GRO segment views are created in
+		accl::BufferArena *view_arena;
+
+		// Message, IO vector and control buffers, these are allocated once and reused
+		std::vector<mmsghdr> msgs;
+		std::vector<iovec> iovs;
+		std::vector<GROControl> controls;
+		// Buffers the messages are received into
+		std::vector<std::unique_ptr<PacketBuffer>> msg_buffers;
+
+		uint64_t syscall_count;
+		uint64_t packet_count;
+
+		void _setupMessage(size_t index);
+		void _splitSegments(std::unique_ptr<PacketBuffer> buffer, const msghdr &hdr,
+							std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+};
+
+bool set_socket_read_steering(int udp_socket, size_t socket_count);
+
+/**
+ * @brief Get the socket read mode, this may change from GRO to RECVMMSG if the kernel does not support GRO.
+ *
+ * @return SocketReadMode Socket read mode.
+ */
+inline SocketReadMode SocketReader::getMode() const { return mode; }
+
+/**
+ * @brief Get the number of receive syscalls made.
+ *
+ * @return uint64_t Number of syscalls.
+ */
+inline uint64_t SocketReader::getSyscallCount() const { return syscall_count; }
+
+/**
+ * @brief Get the number of packets read, each GRO segment counts as a packet.
+ *
+ * @return uint64_t Number of packets.
+ */
+inline uint64_t SocketReader::getPacketCount() const { return packet_count; }
@@ -0,0 +1,326 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "socket_writer.hpp"
+#include "common.hpp"
+#include "libaccl/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+/**
+ * @brief Construct a new SocketWriter object.
+ *
+ * @param udp_socket UDP socket to write to.
+ * @param mode Socket write mode.
+ */
+SocketWriter::SocketWriter(int udp_socket, SocketWriteMode mode)
+	: udp_socket(udp_socket), mode(mode), msgs(SETH_MAX_SENDMM_MESSAGES), iovs(SETH_MAX_SENDMM_IOVECS),
+	  controls(SETH_MAX_SENDMM_MESSAGES), msg_buffer_index(SETH_MAX_SENDMM_MESSAGES), syscall_count(0), packet_count(0),
+	  zero_copy_count(0) {
+
+	// Check the kernel supports UDP GSO, if it doesn't we fall back to sendmmsg()
+	if (this->mode == SocketWriteMode::GSO) {
+		int gso_size = 0;
+		socklen_t gso_size_len = sizeof(gso_size);
+		if (getsockopt(this->udp_socket, SOL_UDP, UDP_SEGMENT, &gso_size, &gso_size_len) == -1) {
+			LOG_NOTICE("UDP GSO is not supported, falling back to sendmmsg(): ", strerror(errno));
+			this->mode = SocketWriteMode::SENDMMSG;
+		}
+	}
+}
+
+/**
+ * @brief Send large messages using MSG_ZEROCOPY, buffers sent this way are held until the kernel is done with them.
+ *
+ * @param tracker Tracker of the zero-copy sends on our socket.
+ */
+void SocketWriter::setZeroCopy(std::shared_ptr<ZeroCopyTracker> tracker) { this->zero_copy_tracker = tracker; }
+
+/**
+ * @brief Hand back the buffers sent using zero-copy which the kernel is done with.
+ *
+ * @param buffers Buffers the kernel is done with are added to this.
+ */
+void SocketWriter::reapZeroCopy(std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	if (this->zero_copy_buffers.empty()) {
+		return;
+	}
+
+	this->zero_copy_tracker->reap();
+	// Our messages are numbered in the order we sent them
+	while (!this->zero_copy_buffers.empty() && this->zero_copy_tracker->isComplete(this->zero_copy_buffers.front().id)) {
+		buffers.push_back(std::move(this->zero_copy_buffers.front().buffer));
+		this->zero_copy_buffers.pop_front();
+	}
+}
+
+/**
+ * @brief Write buffers to the socket.
+ *
+ * @param addr Address to send the buffers to.
+ * @param buffers Buffers to write, buffers sent using zero-copy are removed and handed back by reapZeroCopy().
+ */
+void SocketWriter::write(const sockaddr_storage *addr, std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	if (this->mode == SocketWriteMode::SENDTO) {
+		_writeSendto(addr, buffers);
+	} else {
+		size_t index = 0;
+		while (index < buffers.size()) {
+			index = _writeBatch(addr, buffers, index);
+		}
+	}
+
+	if (this->zero_copy_tracker) {
+		std::erase(buffers, nullptr);
+	}
+}
+
+/**
+ * @brief Write the same buffer to multiple addresses, this is used to flood a packet to all the remote nodes.
+ *
+ * A message is created for each address, all pointing to the same buffer, so the data is only built once.
+ *
+ * @param addrs Addresses to send the buffer to.
+ * @param buffer Buffer to write.
+ */
+void SocketWriter::write(const std::vector<std::shared_ptr<sockaddr_storage>> &addrs, PacketBuffer &buffer) {
+	if (this->mode == SocketWriteMode::SENDTO) {
+		for (auto &addr : addrs) {
+			ssize_t bytes_written = sendto(this->udp_socket, buffer.getData(), buffer.getDataSize(), 0,
+										   reinterpret_cast<const sockaddr *>(addr.get()), sizeof(sockaddr_in6));
+			++this->syscall_count;
+			if (bytes_written == -1) {
+				LOG_ERROR("Got an error in sendto(): ", strerror(errno));
+				continue;
+			}
+			++this->packet_count;
+		}
+		return;
+	}
+
+	// All the messages share the one IO vector
+	this->iovs[0].iov_base = buffer.getData();
+	this->iovs[0].iov_len = buffer.getDataSize();
+
+	for (size_t start = 0; start < addrs.size(); start += SETH_MAX_SENDMM_MESSAGES) {
+		size_t msg_count = std::min<size_t>(addrs.size() - start, SETH_MAX_SENDMM_MESSAGES);
+		for (size_t i = 0; i < msg_count; ++i) {
+			msghdr &hdr = this->msgs[i].msg_hdr;
+			hdr.msg_name = addrs[start + i].get();
+			hdr.msg_namelen = sizeof(sockaddr_in6);
+			hdr.msg_iov = &this->iovs[0];
+			hdr.msg_iovlen = 1;
+			hdr.msg_control = nullptr;
+			hdr.msg_controllen = 0;
+			hdr.msg_flags = 0;
+		}
+
+		size_t sent = 0;
+		while (sent < msg_count) {
+			int res = sendmmsg(this->udp_socket, &this->msgs[sent], msg_count - sent, 0);
+			++this->syscall_count;
+			if (res == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				LOG_ERROR("Got an error in sendmmsg(): ", strerror(errno));
+				// Skip the message that failed
+				++sent;
+				continue;
+			}
+			this->packet_count += res;
+			sent += res;
+		}
+	}
+}
+
+/**
+ * @brief Internal method to send messages using sendmmsg(), using zero-copy if asked to.
+ *
+ * @param msgs Messages to send.
+ * @param count Number of messages.
+ * @param zero_copy Send the messages using zero-copy, this is cleared if the kernel can't pin any more memory and we copy them.
+ * @param first_id Set to the number of the first message sent using zero-copy.
+ * @return int Number of messages sent, or -1 on error.
+ */
+int SocketWriter::_send(mmsghdr *msgs, unsigned int count, bool &zero_copy, uint32_t &first_id) {
+	if (zero_copy) {
+		int res = this->zero_copy_tracker->sendmmsg(msgs, count, first_id);
+		if (res != -1 || errno != ENOBUFS) {
+			return res;
+		}
+		++this->syscall_count;
+		zero_copy = false;
+	}
+	return sendmmsg(this->udp_socket, msgs, count, 0);
+}
+
+/**
+ * @brief Internal method to write buffers to the socket using one sendto() per buffer.
+ *
+ * @param addr Address to send the buffers to.
+ * @param buffers Buffers to write.
+ */
+void SocketWriter::_writeSendto(const sockaddr_storage *addr, std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+	for (auto &buffer : buffers) {
+		ssize_t bytes_written;
+		bool zero_copy = this->_useZeroCopy(buffer->getPacketSize());
+		// Large packets are sent using zero-copy, they're held until the kernel is done with them
+		if (zero_copy) {
+			msghdr &hdr = this->msgs[0].msg_hdr;
+			hdr.msg_name = const_cast<sockaddr_storage *>(addr);
+			hdr.msg_namelen = sizeof(sockaddr_in6);
+			hdr.msg_iov = &this->iovs[0];
+			hdr.msg_iovlen = buffer->getIOVecs(&this->iovs[0]);
+			hdr.msg_control = nullptr;
+			hdr.msg_controllen = 0;
+			hdr.msg_flags = 0;
+			uint32_t id;
+			bytes_written = this->_send(&this->msgs[0], 1, zero_copy, id);
+			if (bytes_written == 1 && zero_copy) {
+				this->zero_copy_buffers.push_back({id, std::move(buffer)});
+				++this->zero_copy_count;
+			}
+			// Packets referencing other buffers are sent using their IO vectors
+		} else if (buffer->hasFragments()) {
+			msghdr hdr{};
+			hdr.msg_name = const_cast<sockaddr_storage *>(addr);
+			hdr.msg_namelen = sizeof(sockaddr_in6);
+			hdr.msg_iov = &this->iovs[0];
+			hdr.msg_iovlen = buffer->getIOVecs(&this->iovs[0]);
+			bytes_written = sendmsg(this->udp_socket, &hdr, 0);
+		} else {
+			bytes_written = sendto(this->udp_socket, buffer->getData(), buffer->getDataSize(), 0,
+								   reinterpret_cast<const sockaddr *>(addr), sizeof(sockaddr_in6));
+		}
+		++this->syscall_count;
+		if (bytes_written == -1) {
+			LOG_ERROR("Got an error in sendto(): ", strerror(errno));
+			continue;
+		}
+		++this->packet_count;
+	}
+}
+
+/**
+ * @brief Internal method to write a batch of buffers to the socket using sendmmsg(), coalescing them using UDP GSO if enabled.
+ *
+ * Consecutive buffers of the same size are sent as one UDP GSO message, the last segment of a GSO message may be shorter. Buffers
+ * referencing other buffers are sent using scatter/gather IO, the kernel splits GSO messages by size so this works for them too.
+ * Zero-copy applies to a whole sendmmsg() call, so a batch ends where messages switch between being sent using zero-copy or not.
+ *
+ * @param addr Address to send the buffers to.
+ * @param buffers Buffers to write.
+ * @param start Index of the first buffer to write.
+ * @return size_t Index of the next buffer to write.
+ */
+size_t SocketWriter::_writeBatch(const sockaddr_storage *addr, std::deque<std::unique_ptr<PacketBuffer>> &buffers,
+								 size_t start) {
+	bool use_gso = this->mode == SocketWriteMode::GSO;
+	bool zero_copy = false;
+
+	// Build the messages
+	size_t msg_count = 0;
+	size_t iov_count = 0;
+	size_t index = start;
+	while (index < buffers.size() && msg_count < SETH_MAX_SENDMM_MESSAGES &&
+		   iov_count + buffers[index]->getIOVecCount() <= this->iovs.size()) {
+		size_t segment_size = buffers[index]->getPacketSize();
+		size_t msg_size = 0;
+		size_t msg_iov_start = iov_count;
+
+		this->msg_buffer_index[msg_count] = index;
+		do {
+			size_t size = buffers[index]->getPacketSize();
+			iov_count += buffers[index]->getIOVecs(&this->iovs[iov_count]);
+			++index;
+			msg_size += size;
+			// A shorter segment ends the GSO message
+			if (size < segment_size) {
+				break;
+			}
+		} while (use_gso && index < buffers.size() && iov_count + buffers[index]->getIOVecCount() <= this->iovs.size() &&
+				 index - this->msg_buffer_index[msg_count] < SETH_MAX_GSO_SEGMENTS &&
+				 buffers[index]->getPacketSize() <= segment_size &&
+				 msg_size + buffers[index]->getPacketSize() <= SETH_MAX_GSO_SIZE);
+
+		// Leave the message for the next batch if it needs to be sent differently
+		bool msg_zero_copy = this->_useZeroCopy(msg_size);
+		if (!msg_count) {
+			zero_copy = msg_zero_copy;
+		} else if (msg_zero_copy != zero_copy) {
+			index = this->msg_buffer_index[msg_count];
+			iov_count = msg_iov_start;
+			break;
+		}
+
+		msghdr &hdr = this->msgs[msg_count].msg_hdr;
+		hdr.msg_name = const_cast<sockaddr_storage *>(addr);
+		hdr.msg_namelen = sizeof(sockaddr_in6);
+		hdr.msg_iov = &this->iovs[msg_iov_start];
+		hdr.msg_iovlen = iov_count - msg_iov_start;
+		hdr.msg_flags = 0;
+
+		// If we have more than one segment, we need to tell the kernel the segment size
+		if (index - this->msg_buffer_index[msg_count] > 1) {
+			hdr.msg_control = this->controls[msg_count].data;
+			hdr.msg_controllen = sizeof(this->controls[msg_count].data);
+			cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t gso_size = segment_size;
+			std::memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+		} else {
+			hdr.msg_control = nullptr;
+			hdr.msg_controllen = 0;
+		}
+
+		++msg_count;
+	}
+
+	// Send the messages
+	size_t sent = 0;
+	while (sent < msg_count) {
+		uint32_t first_id;
+		int res = this->_send(&this->msgs[sent], msg_count - sent, zero_copy, first_id);
+		++this->syscall_count;
+		if (res == -1) {
+			int err = errno;
+			if (err == EINTR) {
+				continue;
+			}
+			// If the kernel or device refuses GSO, disable it and resend from the message that failed
+			if (this->msgs[sent].msg_hdr.msg_control && (err == EIO || err == EINVAL || err == ENOPROTOOPT)) {
+				LOG_NOTICE("UDP GSO send failed, falling back to sendmmsg(): ", strerror(err));
+				this->mode = SocketWriteMode::SENDMMSG;
+				return this->msg_buffer_index[sent];
+			}
+			LOG_ERROR("Got an error in sendmmsg(): ", strerror(err));
+			// Skip the message that failed
+			++sent;
+			continue;
+		}
+		// Count the packets in the messages we sent, holding onto those sent using zero-copy
+		for (int i = 0; i < res; ++i) {
+			size_t msg_end = sent + i + 1 < msg_count ? this->msg_buffer_index[sent + i + 1] : index;
+			this->packet_count += msg_end - this->msg_buffer_index[sent + i];
+			if (!zero_copy) {
+				continue;
+			}
+			for (size_t buffer_index = this->msg_buffer_index[sent + i]; buffer_index < msg_end; ++buffer_index) {
+				this->zero_copy_buffers.push_back({first_id + static_cast<uint32_t>(i), std::move(buffers[buffer_index])});
+				++this->zero_copy_count;
+			}
+		}
+		sent += res;
+	}
+
+	return index;
+}
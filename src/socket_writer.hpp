@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "common.hpp"
+#include "packet_buffer.hpp"
+#include "packet_switch_options.hpp"
+#include "zero_copy_tracker.hpp"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <sys/socket.h>
+#include <vector>
+
+/**
+ * @brief Writes batches of encoded packets to a UDP socket.
+ *
+ */
+class SocketWriter {
+	public:
+		SocketWriter(int udp_socket, SocketWriteMode mode);
+
+		void write(const sockaddr_storage *addr, std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+		void write(const std::vector<std::shared_ptr<sockaddr_storage>> &addrs, PacketBuffer &buffer);
+
+		void setZeroCopy(std::shared_ptr<ZeroCopyTracker> tracker);
+		void reapZeroCopy(std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+		inline size_t getZeroCopyPendingCount() const;
+
+		inline SocketWriteMode getMode() const;
+		inline uint64_t getSyscallCount() const;
+		inline uint64_t getPacketCount() const;
+		inline uint64_t getZeroCopyCount() const;
+
+	private:
+		// Buffer sent using zero-copy, along with the number of the message it was sent in
+		struct ZeroCopyBuffer {
+				uint32_t id;
+				std::unique_ptr<PacketBuffer> buffer;
+		};
+
+		// Control message buffer used to pass the UDP GSO segment size
+		struct GSOControl {
+				alignas(cmsghdr) char data[CMSG_SPACE(sizeof(uint16_t))];
+		};
+
+		int udp_socket;
+		SocketWriteMode mode;
+
+		// Message, IO vector and control buffers, these are allocated once and reused
+		std::vector<mmsghdr> msgs;
+		std::vector<iovec> iovs;
+		std::vector<GSOControl> controls;
+		// Index of the first buffer in each message
+		std::vector<size_t> msg_buffer_index;
+
+		// Tracker of the zero-copy sends on the socket, this is nullptr if we're not using zero-copy
+		std::shared_ptr<ZeroCopyTracker> zero_copy_tracker;
+		// Buffers sent using zero-copy which the kernel may still be sending from, in the order they were sent
+		std::deque<ZeroCopyBuffer> zero_copy_buffers;
+
+		uint64_t syscall_count;
+		uint64_t packet_count;
+		uint64_t zero_copy_count;
+
+		inline bool _useZeroCopy(size_t size) const;
+		int _send(mmsghdr *msgs, unsigned int count, bool &zero_copy, uint32_t &first_id);
+		void _writeSendto(const sockaddr_storage *addr, std::deque<std::unique_ptr<PacketBuffer>> &buffers);
+		size_t _writeBatch(const sockaddr_storage *addr, std::deque<std::unique_ptr<PacketBuffer>> &buffers, size_t start);
+};
+
+/**
+ * @brief Get the number of buffers sent using zero-copy which are not released yet.
+ *
+ * @return size_t Number of buffers.
+ */
+inline size_t SocketWriter::getZeroCopyPendingCount() const { return zero_copy_buffers.size(); }
+
+/**
+ * @brief Get the socket write mode, this may change from GSO to SENDMMSG if the kernel does not support GSO.
+ *
+ * @return SocketWriteMode Socket write mode.
+ */
+inline SocketWriteMode SocketWriter::getMode() const { return mode; }
+
+/**
+ * @brief Get the number of send syscalls made.
+ *
+ * @return uint64_t Number of syscalls.
+ */
+inline uint64_t SocketWriter::getSyscallCount() const { return syscall_count; }
+
+/**
+ * @brief Get the number of packets written.
+ *
+ * @return uint64_t Number of packets.
+ */
+inline uint64_t SocketWriter::getPacketCount() const { return packet_count; }
+
+/**
+ * @brief Get the number of packets written using zero-copy.
+ *
+ * @return uint64_t Number of packets.
+ */
+inline uint64_t SocketWriter::getZeroCopyCount() const { return zero_copy_count; }
+
+/**
+ * @brief Internal method to check if a message should be sent using zero-copy, small messages are cheaper to copy.
+ *
+ * @param size Size of the message.
+ * @return true If the message should be sent using zero-copy.
+ * @return false If the message should be copied.
+ */
+inline bool SocketWriter::_useZeroCopy(size_t size) const {
+	return zero_copy_tracker && size >= SETH_ZERO_COPY_SEND_MIN_SIZE && zero_copy_tracker->isEnabled();
+}
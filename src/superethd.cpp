@@ -5,9 +5,12 @@
  */
 
 #include "codec.hpp"
+#include "common.hpp"
+#include "compression_dictionary.hpp"
 #include "exceptions.hpp"
 #include "libaccl/logger.hpp"
 #include "packet_switch.hpp"
+#include "tap_interface.hpp"
 #include "threads.hpp"
 #include <arpa/inet.h>
 #include <cstring>
@@ -18,7 +21,10 @@
 #include <netinet/in.h>
 #include <ostream>
 #include <signal.h>
+#include <string>
 #include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
 
 // Global packet switch, so we can interface with it from the signal handler
 std::unique_ptr<PacketSwitch> global_packet_switch;
@@ -44,11 +50,12 @@ void handleSIGUSR1(int signum) {
  * @param mtu SET ethernet device MTU.
  * @param tx_size Maximum transmission packet size.
  * @param packet_format Packet format.
+ * @param options Advanced packet switch options.
  * @return int
  */
 int start_seth(const std::string ifname, int mtu, int tx_size, PacketHeaderOptionFormatType packet_format,
 			   std::shared_ptr<struct sockaddr_storage> src_addr, std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs,
-			   int port) {
+			   int port, const PacketSwitchOptions &options) {
 
 	// Register the signal handler for SIGUSR1
 	if (signal(SIGUSR1, handleSIGUSR1) == SIG_ERR) {
@@ -58,7 +65,8 @@ int start_seth(const std::string ifname, int mtu, int tx_size, PacketHeaderOptio
 
 	// Initialize packet switch
 	try {
-		global_packet_switch = std::make_unique<PacketSwitch>(ifname, mtu, tx_size, packet_format, src_addr, dst_addrs, port);
+		global_packet_switch = std::make_unique<PacketSwitch>(ifname, mtu, tx_size, packet_format, src_addr, dst_addrs, port,
+															options);
 	} catch (SuperEthernetTunnelException &e) {
 		std::cerr << std::format("Failed to initialize packet switch: {}", e.what()) << std::endl;
 		exit(EXIT_FAILURE);
@@ -71,8 +79,45 @@ int start_seth(const std::string ifname, int mtu, int tx_size, PacketHeaderOptio
 	 * End thread data setup
 	 */
 	std::cerr << std::format("Packet format            : {}",
-							 PacketHeaderOptionFormatTypeToString(global_packet_switch->getPacketFormat()))
+							 CompressionSettingsToString(
+								 CompressionSettings{global_packet_switch->getPacketFormat(), options.compression_level}))
 			  << std::endl;
+	std::cerr << std::format("Socket write mode        : {}", SocketWriteModeToString(options.socket_write_mode))
+			  << std::endl;
+	std::cerr << std::format("Socket read mode         : {}", SocketReadModeToString(options.socket_read_mode))
+			  << std::endl;
+	std::cerr << std::format("Socket read threads      : {}", options.socket_read_threads) << std::endl;
+	std::cerr << std::format("I/O engine               : {}", IOEngineToString(global_packet_switch->getIOEngine()))
+			  << std::endl;
+	std::cerr << std::format("TAP queues               : {}", options.tap_queues) << std::endl;
+	std::cerr << std::format("TAP offloads             : {}", global_packet_switch->getTAPOffloads() ? "enabled" : "disabled")
+			  << std::endl;
+	std::cerr << std::format("Worker threads           : {}", global_packet_switch->getWorkerThreadCount()) << std::endl;
+	std::cerr << std::format("Channels                 : {}", options.channels) << std::endl;
+	std::cerr << std::format("Flood encoding           : {}", options.flood_encode ? "enabled" : "disabled") << std::endl;
+	std::cerr << std::format("Zero-copy encoding       : {}", options.zero_copy_encode ? "enabled" : "disabled") << std::endl;
+	std::cerr << std::format("Zero-copy decoding       : {}", options.zero_copy_decode ? "enabled" : "disabled") << std::endl;
+	std::cerr << std::format("Zero-copy sending        : {}", options.zero_copy_send ? "enabled" : "disabled") << std::endl;
+	std::cerr << std::format("Adaptive compression     : {}", options.adaptive_compression ? "enabled" : "disabled")
+			  << std::endl;
+	if (options.compression_dictionary) {
+		// The full hash is logged so nodes can check they have the same dictionary, the ID alone can collide
+		const std::string &dictionary = *options.compression_dictionary;
+		uint8_t dictionary_id =
+			options.compression_dictionary_id ? options.compression_dictionary_id : get_compression_dictionary_id(dictionary);
+		std::cerr << std::format("Compression dictionary   : {} bytes (id {}{}, hash {:016x})", dictionary.size(), dictionary_id,
+								 options.compression_dictionary_id ? " configured" : "",
+								 get_compression_dictionary_hash(dictionary))
+				  << std::endl;
+	} else {
+		std::cerr << "Compression dictionary   : none" << std::endl;
+	}
+
+	std::cerr << std::format("Control socket           : {}", options.control_socket.empty() ? "none" : options.control_socket)
+			  << std::endl;
+
+	// Start the logger thread, so the packet switch threads never block writing log lines
+	accl::logger.start();
 
 	// Start the packet switch
 	global_packet_switch->start();
@@ -82,5 +127,58 @@ int start_seth(const std::string ifname, int mtu, int tx_size, PacketHeaderOptio
 
 	LOG_NOTICE("NORMAL EXIT");
 
+	// Stop the logger thread, this writes out any log lines still queued
+	accl::logger.stop();
+
+	return 0;
+}
+
+/**
+ * @brief Capture frames from the TAP interface and train a compression dictionary on them.
+ *
+ * The interface is brought up without starting the tunnel, traffic which would normally go over the tunnel needs to be sent to
+ * it while we capture, eg. by routing it over the interface.
+ *
+ * @param ifname Interface name.
+ * @param mtu Interface MTU.
+ * @param path Path to save the dictionary to.
+ * @return int Exit code.
+ */
+int train_seth_dictionary(const std::string ifname, int mtu, const std::string &path) {
+	std::vector<std::string> samples;
+	samples.reserve(SETH_COMPRESSION_DICTIONARY_SAMPLES);
+
+	try {
+		TAPInterface tap_interface(ifname);
+		tap_interface.setMTU(mtu);
+		tap_interface.start();
+
+		std::cerr << std::format("Capturing {} frames from '{}' to train a compression dictionary",
+								 SETH_COMPRESSION_DICTIONARY_SAMPLES, ifname)
+				  << std::endl;
+
+		std::string buffer(SETH_MAX_MTU_SIZE + SETH_PACKET_ETHERNET_HEADER_LEN, '\0');
+		while (samples.size() < SETH_COMPRESSION_DICTIONARY_SAMPLES) {
+			ssize_t bytes_read = read(tap_interface.getFD(), buffer.data(), buffer.size());
+			if (bytes_read < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw SuperEthernetTunnelRuntimeException(std::format("Failed to read from TAP interface: {}", strerror(errno)));
+			}
+			samples.emplace_back(buffer.data(), bytes_read);
+		}
+
+		std::string dictionary = train_compression_dictionary(samples, SETH_COMPRESSION_DICTIONARY_SIZE);
+		save_compression_dictionary(path, dictionary);
+
+		std::cerr << std::format("Saved {} byte compression dictionary (id {}, hash {:016x}) to '{}'", dictionary.size(),
+								 get_compression_dictionary_id(dictionary), get_compression_dictionary_hash(dictionary), path)
+				  << std::endl;
+	} catch (SuperEthernetTunnelException &e) {
+		std::cerr << std::format("ERROR: {}", e.what()) << std::endl;
+		return 1;
+	}
+
 	return 0;
 }
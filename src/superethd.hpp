@@ -7,6 +7,7 @@
 #pragma once
 
 #include "codec.hpp"
+#include "packet_switch_options.hpp"
 #include <memory>
 #include <netinet/in.h>
 #include <string>
@@ -14,4 +15,6 @@
 
 int start_seth(const std::string ifname, int mtu, int tx_size, PacketHeaderOptionFormatType packet_format,
 			   std::shared_ptr<struct sockaddr_storage> src_addr, std::vector<std::shared_ptr<struct sockaddr_storage>> dst_addrs,
-			   int port);
+			   int port, const PacketSwitchOptions &options);
+
+int train_seth_dictionary(const std::string ifname, int mtu, const std::string &path);
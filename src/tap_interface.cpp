@@ -22,35 +22,85 @@
  * @brief Construct a new TAPInterface::TAPInterface object
  *
  * @param ifname Interface name
+ * @param queues Number of queues to open, more than one queue creates a multi-queue interface
+ * @param offload Enable virtio-net headers and offloads so the kernel can hand us unsegmented frames without checksums
  */
-TAPInterface::TAPInterface(const std::string &ifname) {
-	// Open TUN/TAP device file to create an interface
-	if ((this->fd = open("/dev/net/tun", O_RDWR)) < 0) {
-		throw SuperEthernetTunnelRuntimeException("Cannot open TUN/TAP device file: " + std::string(strerror(errno)));
+TAPInterface::TAPInterface(const std::string &ifname, size_t queues, bool offload) {
+	if (queues < 1) {
+		throw SuperEthernetTunnelConfigException("TAP interface needs at least 1 queue");
 	}
 
 	// Save interface name
 	this->ifname = ifname;
 	this->mtu = 1500;
+	this->header_size = 0;
+	this->offloads = 0;
 
-	// Create TAP interface
+	// Create TAP interface, with multiple queues each queue is attached by opening the device file and setting the same interface
 	struct ifreq ifr;
 	memset(&ifr, 0, sizeof(ifr));
 	memcpy(ifr.ifr_name, this->ifname.data(), this->ifname.length());
 	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
-	if (ioctl(this->fd, TUNSETIFF, (void *)&ifr) == -1) {
-		int res = errno;
-		close(this->fd);
-		throw SuperEthernetTunnelRuntimeException("Cannot ioctl TUNSETIFF on '" + ifname + "': " + std::string(strerror(res)));
+	if (queues > 1) {
+		ifr.ifr_flags |= IFF_MULTI_QUEUE;
+	}
+	if (offload) {
+		ifr.ifr_flags |= IFF_VNET_HDR;
+	}
+	for (size_t queue = 0; queue < queues; ++queue) {
+		// Open TUN/TAP device file to create an interface queue
+		int fd = open("/dev/net/tun", O_RDWR);
+		if (fd < 0) {
+			int res = errno;
+			this->_closeFDs();
+			throw SuperEthernetTunnelRuntimeException("Cannot open TUN/TAP device file: " + std::string(strerror(res)));
+		}
+		this->fds.push_back(fd);
+
+		if (ioctl(fd, TUNSETIFF, (void *)&ifr) == -1) {
+			int res = errno;
+			this->_closeFDs();
+			throw SuperEthernetTunnelRuntimeException("Cannot ioctl TUNSETIFF on '" + ifname +
+													  "' queue " + std::to_string(queue) + ": " + std::string(strerror(res)));
+		}
+	}
+
+	// Set up the virtio-net header and the offloads we can handle, we carry the frames as is and the remote TAP interface or kernel
+	// finishes the segmentation and checksumming
+	if (offload) {
+		int header_size = sizeof(virtio_net_header_t);
+		if (ioctl(this->fds[0], TUNSETVNETHDRSZ, &header_size) == -1) {
+			int res = errno;
+			this->_closeFDs();
+			throw SuperEthernetTunnelRuntimeException("Cannot set virtio-net header size on '" + this->ifname +
+													  "': " + std::string(strerror(res)));
+		}
+		this->header_size = header_size;
+
+		unsigned int offloads = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+		bool offloads_set = false;
+#ifdef TUN_F_USO4
+		// UDP segmentation offload was only added in Linux 6.2, so fall back to just TCP if its not supported
+		if (ioctl(this->fds[0], TUNSETOFFLOAD, offloads | TUN_F_USO4 | TUN_F_USO6) == 0) {
+			offloads |= TUN_F_USO4 | TUN_F_USO6;
+			offloads_set = true;
+		}
+#endif
+		if (!offloads_set && ioctl(this->fds[0], TUNSETOFFLOAD, offloads) == -1) {
+			LOG_NOTICE("Cannot enable offloads on TAP interface '", this->ifname, "', frames will be segmented by the kernel: ",
+					   strerror(errno));
+			offloads = 0;
+		}
+		this->offloads = offloads;
 	}
 
 	// Grab hardware address
 	struct ifreq ifr_hw;
 	memset(&ifr_hw, 0, sizeof(ifr_hw));
 	memcpy(ifr_hw.ifr_name, this->ifname.data(), this->ifname.length());
-	if (ioctl(this->fd, SIOCGIFHWADDR, &ifr_hw) == -1) {
+	if (ioctl(this->fds[0], SIOCGIFHWADDR, &ifr_hw) == -1) {
 		int res = errno;
-		close(this->fd);
+		this->_closeFDs();
 		throw SuperEthernetTunnelRuntimeException("Cannot get link-layer address: " + std::string(strerror(res)));
 	}
 
@@ -61,17 +111,13 @@ TAPInterface::TAPInterface(const std::string &ifname) {
 	LOG_INFO(
 		"Created TAP interface '", this->ifname, "' with MAC address '",
 		std::format("{:02X}:{:02X}:{:02X}:{:02X}:{:02X}:{:02X}", hwaddr[0], hwaddr[1], hwaddr[2], hwaddr[3], hwaddr[4], hwaddr[5]),
-		"'");
+		"' and ", queues, queues > 1 ? " queues" : " queue");
 }
 
 /**
  * @brief Destroy the TAP interface.
  */
-TAPInterface::~TAPInterface() {
-	if (this->fd) {
-		close(this->fd);
-	}
-}
+TAPInterface::~TAPInterface() { this->_closeFDs(); }
 
 /**
  * @brief Set the MTU of the interface.
@@ -146,3 +192,13 @@ void TAPInterface::start() {
 	// Interface is now online
 	this->online = true;
 }
+
+/**
+ * @brief Internal method to close all the queue file descriptors.
+ */
+void TAPInterface::_closeFDs() {
+	for (auto fd : this->fds) {
+		close(fd);
+	}
+	this->fds.clear();
+}
@@ -14,17 +14,36 @@
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <cstdint>
 #include <string>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief virtio-net header in front of each frame when offloads are enabled, this matches struct virtio_net_hdr which we cannot
+ * include as linux/virtio_net.h is not valid C++.
+ *
+ */
+struct virtio_net_header_t {
+		uint8_t flags;		  // VIRTIO_NET_HDR_F_* flags, eg. the frame needs a checksum
+		uint8_t gso_type;	  // VIRTIO_NET_HDR_GSO_* type of segmentation needed
+		uint16_t hdr_len;	  // Length of the ethernet, IP and TCP/UDP headers
+		uint16_t gso_size;	  // Size of each segment
+		uint16_t csum_start;  // Position to start checksumming from
+		uint16_t csum_offset; // Offset after csum_start to place the checksum
+};
 
 class TAPInterface {
 	public:
-		TAPInterface(const std::string &ifname);
+		TAPInterface(const std::string &ifname, size_t queues = 1, bool offload = false);
 		~TAPInterface();
 
-		inline const int getFD() const;
+		inline const int getFD(size_t queue = 0) const;
+		inline size_t getQueueCount() const;
+		inline size_t getHeaderSize() const;
+		inline unsigned int getOffloads() const;
 
 		void setMTU(int mtu);
 		inline uint16_t getMTU();
@@ -34,19 +53,33 @@ class TAPInterface {
 		void start();
 
 	private:
-		int fd;
+		// One file descriptor per queue
+		std::vector<int> fds;
 		unsigned char hwaddr[ETHER_ADDR_LEN];
 		std::string ifname;
 		uint16_t mtu;
 		bool online;
+		// Size of the virtio-net header in front of each frame and the offloads enabled, these are 0 without offloading
+		size_t header_size;
+		unsigned int offloads;
+
+		void _closeFDs();
 };
 
 /**
- * @brief Return FD for the TAP interface
+ * @brief Return FD for a queue of the TAP interface
  *
+ * @param queue Queue number.
  * @return const int File descriptor
  */
-inline const int TAPInterface::getFD() const { return this->fd; };
+inline const int TAPInterface::getFD(size_t queue) const { return this->fds[queue]; };
+
+/**
+ * @brief Return the number of queues the TAP interface has
+ *
+ * @return size_t Number of queues
+ */
+inline size_t TAPInterface::getQueueCount() const { return this->fds.size(); };
 
 /**
  * @brief Return MTU for the TAP interface
@@ -62,3 +95,17 @@ inline uint16_t TAPInterface::getMTU() { return this->mtu; };
  * @return false
  */
 inline bool TAPInterface::isOnline() { return this->online; };
+
+/**
+ * @brief Return the size of the virtio-net header in front of each frame read from or written to the TAP interface
+ *
+ * @return size_t Header size, this is 0 if offloading is not enabled
+ */
+inline size_t TAPInterface::getHeaderSize() const { return this->header_size; };
+
+/**
+ * @brief Return the TUN_F_* offloads enabled on the TAP interface
+ *
+ * @return unsigned int Offloads
+ */
+inline unsigned int TAPInterface::getOffloads() const { return this->offloads; };
@@ -13,6 +13,7 @@
 #include "libaccl/logger.hpp"
 #include "packet_buffer.hpp"
 #include "threads.hpp"
+#include "util.hpp"
 #include <arpa/inet.h>
 #include <chrono>
 #include <cstring>
@@ -257,16 +258,12 @@ void tunnel_socket_read_handler(void *arg) {
 		}
 
 		for (int i = 0; i < num_received; ++i) {
-			char ipv6_str[INET6_ADDRSTRLEN];
-			if (inet_ntop(AF_INET6, &controls[i].sin6_addr, ipv6_str, sizeof(ipv6_str)) == NULL) {
-				LOG_ERROR("inet_ntop failed: ", strerror(errno));
-				exit(EXIT_FAILURE);
-			}
-			LOG_DEBUG_INTERNAL("Received ", msgs[i].msg_len, " bytes from ", ipv6_str, ":", ntohs(controls[i].sin6_port),
-							   " with flags ", msgs[i].msg_hdr.msg_flags);
+			// The source address is only turned into a string if we're logging it
+			LOG_DEBUG_INTERNAL("Received ", msgs[i].msg_len, " bytes from ", get_ipv6_str(&controls[i]), ":",
+							   ntohs(controls[i].sin6_port), " with flags ", msgs[i].msg_hdr.msg_flags);
 			// Compare to see if this is the remote system IP
 			if (memcmp(&tdata->remote_addr.sin6_addr, &controls[i].sin6_addr, sizeof(struct in6_addr))) {
-				LOG_ERROR("Source address is incorrect: ", ipv6_str);
+				LOG_ERROR("Source address is incorrect: ", get_ipv6_str(&controls[i]));
 				continue;
 			}
 
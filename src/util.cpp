@@ -7,8 +7,10 @@
 #include "util.hpp"
 #include "exceptions.hpp"
 #include "libaccl/logger.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <array>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -263,3 +265,119 @@ std::shared_ptr<struct sockaddr_storage> to_sockaddr_storage_ipv6(const std::sha
 
 	return result;
 }
+
+/**
+ * @brief Internal function to mix bytes into a FNV-1a hash.
+ *
+ * @param hash Hash to mix the bytes into.
+ * @param data Bytes to mix in.
+ * @param length Number of bytes.
+ * @return uint32_t Updated hash.
+ */
+static inline uint32_t _flow_hash_mix(uint32_t hash, const uint8_t *data, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= data[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+/**
+ * @brief Get a hash of the flow an ethernet frame belongs to.
+ *
+ * IPv4 and IPv6 frames are hashed on their addresses, protocol and TCP/UDP ports, any other frame is hashed on its MAC addresses
+ * and ethertype. VLAN tags are skipped over. Frames of the same flow always get the same hash.
+ *
+ * @param frame Ethernet frame.
+ * @param size Size of the frame.
+ * @return uint32_t Flow hash.
+ */
+uint32_t get_ethernet_flow_hash(const char *frame, size_t size) {
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(frame);
+	uint32_t hash = 2166136261;
+
+	// Frames too short to have an ethernet header all end up in the same flow
+	if (size < 14) {
+		return hash;
+	}
+
+	// Skip over any 802.1Q or 802.1ad VLAN tags to get to the real ethertype
+	size_t pos = 12;
+	uint16_t ethertype = (data[pos] << 8) | data[pos + 1];
+	while ((ethertype == 0x8100 || ethertype == 0x88A8) && pos + 6 <= size) {
+		pos += 4;
+		ethertype = (data[pos] << 8) | data[pos + 1];
+	}
+	pos += 2;
+
+	// Work out where the addresses and protocol are for IP frames
+	size_t addr_pos{0}, addr_len{0}, l4_pos{0};
+	uint8_t protocol{0};
+	if (ethertype == 0x0800 && pos + 20 <= size) {
+		addr_pos = pos + 12;
+		addr_len = 8;
+		protocol = data[pos + 9];
+		// Only the first fragment has the ports
+		if (!((data[pos + 6] & 0x1F) | data[pos + 7])) {
+			l4_pos = pos + (data[pos] & 0x0F) * 4;
+		}
+	} else if (ethertype == 0x86DD && pos + 40 <= size) {
+		addr_pos = pos + 8;
+		addr_len = 32;
+		protocol = data[pos + 6];
+		l4_pos = pos + 40;
+	} else {
+		// Not an IP frame, so use the MAC addresses and ethertype
+		hash = _flow_hash_mix(hash, data, 12);
+		return _flow_hash_mix(hash, reinterpret_cast<const uint8_t *>(&ethertype), sizeof(ethertype));
+	}
+
+	hash = _flow_hash_mix(hash, data + addr_pos, addr_len);
+	hash = _flow_hash_mix(hash, &protocol, sizeof(protocol));
+	// Add the ports for TCP and UDP
+	if ((protocol == IPPROTO_TCP || protocol == IPPROTO_UDP) && l4_pos && l4_pos + 4 <= size) {
+		hash = _flow_hash_mix(hash, data + l4_pos, 4);
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Estimate the Shannon entropy of a block of bytes.
+ *
+ * Random, encrypted and already compressed data comes out close to 8 bits per byte, while data which compresses well comes out
+ * much lower. Only the first 256 bytes are looked at, which is enough to tell them apart.
+ *
+ * @param data Bytes to estimate the entropy of.
+ * @param size Number of bytes.
+ * @return float Entropy in bits per byte, between 0 and 8.
+ */
+float get_byte_entropy(const char *data, size_t size) {
+	const size_t max_size = 256;
+	// Table of n * log2(n) for each count a byte can have in our sample, so we don't need a log2() per byte value
+	static const std::array<float, max_size + 1> nlog2n = []() {
+		std::array<float, max_size + 1> table{};
+		for (size_t n = 1; n <= max_size; ++n) {
+			table[n] = static_cast<float>(n) * std::log2(static_cast<float>(n));
+		}
+		return table;
+	}();
+
+	size = std::min(size, max_size);
+	if (!size) {
+		return 0;
+	}
+
+	std::array<uint16_t, 256> counts{};
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; ++i) {
+		++counts[bytes[i]];
+	}
+
+	// H = log2(N) - sum(c * log2(c)) / N
+	float sum = 0;
+	for (uint16_t count : counts) {
+		sum += nlog2n[count];
+	}
+	return (nlog2n[size] - sum) / static_cast<float>(size);
+}
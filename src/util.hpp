@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <netinet/in.h>
@@ -42,3 +44,7 @@ std::array<uint8_t, 16> get_key_from_sockaddr(sockaddr_storage *sockaddr);
 void dumpSockaddr(const sockaddr *sa);
 
 std::shared_ptr<struct sockaddr_storage> to_sockaddr_storage_ipv6(const std::shared_ptr<sockaddr_storage> addr);
+
+uint32_t get_ethernet_flow_hash(const char *frame, size_t size);
+
+float get_byte_entropy(const char *data, size_t size);
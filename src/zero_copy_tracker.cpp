@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "zero_copy_tracker.hpp"
+#include "libaccl/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+
+/**
+ * @brief Construct a new ZeroCopyTracker object, this enables zero-copy on the socket.
+ *
+ * @param udp_socket UDP socket to send on.
+ */
+ZeroCopyTracker::ZeroCopyTracker(int udp_socket) : udp_socket(udp_socket), enabled(true), next_id(0), complete_id(0) {
+	int one = 1;
+	if (setsockopt(this->udp_socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1) {
+		LOG_NOTICE("MSG_ZEROCOPY is not supported, falling back to copying: ", strerror(errno));
+		this->enabled = false;
+	}
+}
+
+/**
+ * @brief Send messages using zero-copy, the data sent must not be touched until the messages are complete.
+ *
+ * @param msgs Messages to send.
+ * @param count Number of messages.
+ * @param first_id Set to the number of the first message sent, the messages that follow are numbered in order.
+ * @return int Number of messages sent, or -1 on error with errno set like sendmmsg().
+ */
+int ZeroCopyTracker::sendmmsg(mmsghdr *msgs, unsigned int count, uint32_t &first_id) {
+	std::lock_guard<std::mutex> lock(this->send_lock);
+
+	int res = ::sendmmsg(this->udp_socket, msgs, count, MSG_ZEROCOPY);
+	// The kernel only numbers the messages it sent
+	if (res > 0) {
+		first_id = this->next_id;
+		this->next_id += res;
+	}
+
+	return res;
+}
+
+/**
+ * @brief Pick up the completions the kernel reported on the socket error queue, this never blocks.
+ *
+ * If another thread is busy reaping the completions this returns straight away, as it picks them up for everyone.
+ */
+void ZeroCopyTracker::reap() {
+	std::unique_lock<std::mutex> lock(this->reap_lock, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		return;
+	}
+
+	while (true) {
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(sock_extended_err)) + CMSG_SPACE(sizeof(sockaddr_in6))];
+		msghdr msg{};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(this->udp_socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				LOG_ERROR("Got an error reading zero-copy completions: ", strerror(errno));
+			}
+			return;
+		}
+
+		// The completion is reported using the protocol of the message, IPv4 mapped addresses use IPv4
+		for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+				!(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+				continue;
+			}
+			sock_extended_err serr;
+			std::memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+			if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			// If the device can't send straight out of our buffers the kernel copies them, which is slower than a normal send
+			if ((serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && this->enabled.exchange(false)) {
+				LOG_NOTICE("MSG_ZEROCOPY sends are being copied by the kernel, falling back to copying");
+			}
+			// The range holds the numbers of the first and last message completed
+			this->_complete(serr.ee_info, serr.ee_data);
+		}
+	}
+}
+
+/**
+ * @brief Internal method to mark a range of messages as complete.
+ *
+ * @param first_id Number of the first message completed.
+ * @param last_id Number of the last message completed.
+ */
+void ZeroCopyTracker::_complete(uint32_t first_id, uint32_t last_id) {
+	if (first_id != this->complete_id) {
+		this->completed_ranges.emplace_back(first_id, last_id);
+		return;
+	}
+
+	uint32_t id = last_id + 1;
+	// Pick up the ranges that completed before this one
+	while (true) {
+		auto range = std::find_if(this->completed_ranges.begin(), this->completed_ranges.end(),
+								  [id](const std::pair<uint32_t, uint32_t> &range) { return range.first == id; });
+		if (range == this->completed_ranges.end()) {
+			break;
+		}
+		id = range->second + 1;
+		this->completed_ranges.erase(range);
+	}
+	this->complete_id = id;
+}
\ No newline at end of file
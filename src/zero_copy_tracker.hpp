@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Tracks MSG_ZEROCOPY sends on a UDP socket until the kernel is done with the data sent.
+ *
+ * The kernel numbers each message sent using MSG_ZEROCOPY on a socket and reports the numbers it is done with on the socket error
+ * queue. As the numbering is shared by everyone sending on the socket, sends are serialized so each writer knows the numbers of
+ * its messages, and the completions are reaped on behalf of all of them.
+ */
+class ZeroCopyTracker {
+	public:
+		ZeroCopyTracker(int udp_socket);
+
+		ZeroCopyTracker(const ZeroCopyTracker &) = delete;
+		ZeroCopyTracker &operator=(const ZeroCopyTracker &) = delete;
+
+		inline bool isEnabled() const;
+
+		int sendmmsg(mmsghdr *msgs, unsigned int count, uint32_t &first_id);
+
+		void reap();
+		inline bool isComplete(uint32_t id) const;
+
+	private:
+		int udp_socket;
+		// Cleared if the socket doesn't support zero-copy or the kernel ends up copying the data anyway
+		std::atomic<bool> enabled;
+
+		// Number of the next message sent, sends hold the lock so the numbers match those of the kernel
+		std::mutex send_lock;
+		uint32_t next_id;
+
+		// All messages before this one are complete, ranges completed out of order are held until the ones before them complete
+		std::mutex reap_lock;
+		std::atomic<uint32_t> complete_id;
+		std::vector<std::pair<uint32_t, uint32_t>> completed_ranges;
+
+		void _complete(uint32_t first_id, uint32_t last_id);
+};
+
+/**
+ * @brief Check if messages should be sent using zero-copy.
+ *
+ * @return true If zero-copy is enabled.
+ * @return false If messages should be copied.
+ */
+inline bool ZeroCopyTracker::isEnabled() const { return enabled; }
+
+/**
+ * @brief Check if the kernel is done with a message sent using zero-copy, completions are only picked up by reap().
+ *
+ * @param id Number of the message.
+ * @return true If the data of the message can be reused.
+ * @return false If the message is still in flight.
+ */
+inline bool ZeroCopyTracker::isComplete(uint32_t id) const { return static_cast<int32_t>(id - complete_id) < 0; }
\ No newline at end of file
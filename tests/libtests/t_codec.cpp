@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "t_codec.hpp"
+#include "libaccl/sequence_data_generator.hpp"
+#include "libsethnetkit/udp_packet.hpp"
+#include "packet_switch.hpp"
+
+/**
+ * @brief Build a UDPv4 frame, the source port picks the flow of the frame.
+ *
+ * @param src_port Source port.
+ * @param payload Payload of the frame.
+ * @param dst_port Destination port.
+ * @return std::string Frame.
+ */
+std::string build_udp_frame(uint16_t src_port, const std::vector<uint8_t> &payload, uint16_t dst_port) {
+	UDPv4Packet packet;
+
+	packet.setDstMac({0x01, 0x02, 0x03, 0x04, 0x05, 0x06});
+	packet.setSrcMac({0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f});
+	packet.setDstAddr({192, 168, 10, 1});
+	packet.setSrcAddr({172, 16, 101, 102});
+	packet.setSrcPort(src_port);
+	packet.setDstPort(dst_port);
+	packet.addPayload(payload);
+
+	return packet.asBinary();
+}
+
+/**
+ * @brief Build a UDPv4 frame with a payload of sequence data, which compresses well.
+ *
+ * @param src_port Source port.
+ * @param payload_size Size of the payload.
+ * @return std::string Frame.
+ */
+std::string build_udp_frame(uint16_t src_port, size_t payload_size) {
+	return build_udp_frame(src_port, accl::SequenceDataGenerator(payload_size).asBytes());
+}
+
+/**
+ * @brief Construct a new EncoderTest object.
+ *
+ * @param buffer_count Number of buffers in the available buffer pool.
+ * @param l4mtu Layer 4 MTU the encoder encodes packets for.
+ */
+EncoderTest::EncoderTest(size_t buffer_count, uint16_t l4mtu)
+	: l2mtu(get_l2mtu_from_mtu(CODEC_TEST_MTU)), buffer_size(l2mtu + (l2mtu / 10)),
+	  avail_buffer_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, buffer_count)),
+	  enc_buffer_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size)),
+	  dec_buffer_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size)),
+	  encoder(l2mtu, l4mtu, enc_buffer_pool, avail_buffer_pool) {}
+
+/**
+ * @brief Construct a new CodecTest object.
+ *
+ * @param buffer_count Number of buffers in the available buffer pool.
+ * @param l4mtu Layer 4 MTU the encoder encodes packets for.
+ */
+CodecTest::CodecTest(size_t buffer_count, uint16_t l4mtu)
+	: EncoderTest(buffer_count, l4mtu), decoder(l2mtu, dec_buffer_pool, avail_buffer_pool) {}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "packet_buffer.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// MTU of the tunnel the codec tests encode for
+inline constexpr uint16_t CODEC_TEST_MTU = 1500;
+// Size of the UDP payload of a packet sent over IPv4 with the test MTU
+inline constexpr uint16_t CODEC_TEST_L4MTU = CODEC_TEST_MTU - 20 - 8;
+
+extern std::string build_udp_frame(uint16_t src_port, const std::vector<uint8_t> &payload, uint16_t dst_port = 54321);
+
+extern std::string build_udp_frame(uint16_t src_port, size_t payload_size);
+
+/**
+ * @brief Encoder along with the buffer pools used to test it, the decoder pool is left for a decoder to use.
+ *
+ */
+struct EncoderTest {
+		EncoderTest(size_t buffer_count, uint16_t l4mtu = CODEC_TEST_L4MTU);
+
+		uint16_t l2mtu;
+		uint16_t buffer_size;
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> avail_buffer_pool;
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> enc_buffer_pool;
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> dec_buffer_pool;
+		PacketEncoder encoder;
+};
+
+/**
+ * @brief Encoder and decoder pair along with the buffer pools they use, the available buffer pool is shared by both.
+ *
+ */
+struct CodecTest : EncoderTest {
+		CodecTest(size_t buffer_count, uint16_t l4mtu = CODEC_TEST_L4MTU);
+
+		PacketDecoder decoder;
+};
@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "t_socket.hpp"
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * @brief Create a UDP socket bound to the IPv6 loopback address.
+ *
+ * @param addr Address the socket was bound to.
+ * @return int Socket.
+ * @exception std::runtime_error The socket could not be created or bound.
+ */
+int create_loopback_socket(sockaddr_storage &addr) {
+	int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (fd == -1) {
+		throw std::runtime_error(std::format("Failed to create socket: {}", strerror(errno)));
+	}
+
+	int buffer_size = 4 * 1024 * 1024;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+	timeval timeout{1, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::memset(&addr, 0, sizeof(addr));
+	sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+	addr6->sin6_family = AF_INET6;
+	addr6->sin6_addr = in6addr_loopback;
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(sockaddr_in6)) != 0) {
+		close(fd);
+		throw std::runtime_error(std::format("Failed to bind socket: {}", strerror(errno)));
+	}
+	socklen_t addr_len = sizeof(sockaddr_in6);
+	getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+
+	return fd;
+}
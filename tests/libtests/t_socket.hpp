@@ -0,0 +1,11 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+
+extern int create_loopback_socket(sockaddr_storage &addr);
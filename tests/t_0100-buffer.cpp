@@ -6,6 +6,7 @@
 
 #include "libtests/framework.hpp"
 #include <stdexcept>
+#include <unistd.h>
 
 TEST_CASE("Check buffer usage", "[buffers]") {
 	PacketBuffer buffer = PacketBuffer(100);
@@ -90,3 +91,95 @@ TEST_CASE("Check setting data size manually exceeding the buffer size", "[buffer
 		REQUIRE_THROWS_AS(buffer.setDataSize(6), std::out_of_range);
 	}
 }
+
+TEST_CASE("Check buffer views reference the backing buffer", "[buffers]") {
+	auto pool = std::make_shared<accl::BufferPool<PacketBuffer>>(100);
+	auto buffer = std::make_unique<PacketBuffer>(100);
+	const std::string test_string = "hello world";
+	buffer->append(test_string.c_str(), test_string.length());
+
+	// Views can only be created of shared buffers
+	REQUIRE_THROWS_AS(PacketBuffer(buffer.get(), 6, 5), std::invalid_argument);
+
+	PacketBuffer *backing = buffer.release();
+	backing->share(pool);
+	auto view = std::make_unique<PacketBuffer>(backing, 6, 5);
+
+	REQUIRE(view->isView());
+	REQUIRE_FALSE(backing->isView());
+	REQUIRE(view->getData() == backing->getData() + 6);
+	REQUIRE(view->getBufferSize() == 5);
+	REQUIRE(std::string(view->getData(), view->getDataSize()) == "world");
+
+	SECTION("Expect the view keeps the backing buffer until it is released") {
+		backing->unshare();
+		REQUIRE(pool->getBufferCount() == 0);
+		view.reset();
+		REQUIRE(pool->getBufferCount() == 1);
+		REQUIRE(pool->pop()->getDataSize() == 0);
+	}
+
+	SECTION("Expect a view of a view references the backing buffer") {
+		auto view_of_view = std::make_unique<PacketBuffer>(view.get(), 1, 3);
+		REQUIRE(view_of_view->getData() == backing->getData() + 7);
+		REQUIRE(std::string(view_of_view->getData(), view_of_view->getDataSize()) == "orl");
+		backing->unshare();
+		view.reset();
+		REQUIRE(pool->getBufferCount() == 0);
+		view_of_view.reset();
+		REQUIRE(pool->getBufferCount() == 1);
+	}
+
+	SECTION("Expect a copy of a view owns its storage") {
+		PacketBuffer copy(*view);
+		REQUIRE_FALSE(copy.isView());
+		REQUIRE(copy.getData() != view->getData());
+		REQUIRE(std::string(copy.getData(), copy.getDataSize()) == "world");
+		backing->unshare();
+	}
+
+	SECTION("Expect a out_of_range is thrown if the view exceeds the backing buffer") {
+		REQUIRE_THROWS_AS(PacketBuffer(backing, 90, 11), std::out_of_range);
+		backing->unshare();
+	}
+}
+
+TEST_CASE("Check buffer views can be created in an arena without allocating", "[buffers]") {
+	auto pool = std::make_shared<accl::BufferPool<PacketBuffer>>(100);
+	accl::BufferArena *arena = accl::BufferArena::createSlots(sizeof(PacketBuffer), alignof(PacketBuffer), 2);
+	REQUIRE(arena->getFreeSlotCount() == 2);
+	// Slot arenas are small, so they don't take up a hugepage
+	REQUIRE(!arena->isHugePages());
+	REQUIRE(arena->getSlabSize() == static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+
+	PacketBuffer *backing = new PacketBuffer(100);
+	backing->append("hello world", 11);
+	backing->share(pool);
+
+	// Views come out of the arena until it runs out, after which they are allocated
+	auto view1 = PacketBuffer::createView(arena, backing, 0, 5);
+	auto view2 = PacketBuffer::createView(arena, backing, 6, 5);
+	REQUIRE(arena->getFreeSlotCount() == 0);
+	auto view3 = PacketBuffer::createView(arena, backing, 0, 11);
+	REQUIRE(std::string(view1->getData(), view1->getDataSize()) == "hello");
+	REQUIRE(std::string(view2->getData(), view2->getDataSize()) == "world");
+	REQUIRE(std::string(view3->getData(), view3->getDataSize()) == "hello world");
+	backing->unshare();
+
+	// Released views go back to the arena, the backing buffer goes back into the pool with the last view
+	view1.reset();
+	view2.reset();
+	REQUIRE(arena->getFreeSlotCount() == 2);
+	REQUIRE(pool->getBufferCount() == 0);
+	view3.reset();
+	REQUIRE(pool->getBufferCount() == 1);
+
+	// The arena is only destroyed once the views are gone
+	backing = pool->pop().release();
+	backing->share(pool);
+	auto view = PacketBuffer::createView(arena, backing, 0, 0);
+	backing->unshare();
+	arena->release();
+	view.reset();
+	REQUIRE(pool->getBufferCount() == 1);
+}
@@ -33,6 +33,21 @@ TEST_CASE("Check that we get an exception when we pop too many buffers from the
 	}
 }
 
+TEST_CASE("Check that trying to pop a buffer from an empty pool does not throw or block", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool = accl::BufferPool<PacketBuffer>(1024, 1);
+
+	std::unique_ptr<PacketBuffer> buffer;
+	REQUIRE(buffer_pool.tryPop(buffer));
+	REQUIRE(buffer);
+
+	std::unique_ptr<PacketBuffer> other;
+	REQUIRE_FALSE(buffer_pool.tryPop(other));
+	REQUIRE_FALSE(other);
+
+	buffer_pool.push(std::move(buffer));
+	REQUIRE(buffer_pool.tryPop(other));
+}
+
 TEST_CASE("Check that we can push a buffer back into the pool", "[buffers]") {
 	accl::BufferPool<PacketBuffer> buffer_pool = accl::BufferPool<PacketBuffer>(1024, 1);
 
@@ -120,3 +135,23 @@ TEST_CASE("Check we can push multiple buffers back into the pool", "[buffers]")
 	// Check the buffers were added back
 	REQUIRE(buffer_pool.getBufferCount() == 5);
 }
+
+TEST_CASE("Check we can push a vector of buffers back into the pool and reuse the vector", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool = accl::BufferPool<PacketBuffer>(1024, 5);
+
+	std::vector<std::unique_ptr<PacketBuffer>> buffers;
+	buffers.reserve(5);
+	for (auto &buffer : buffer_pool.pop(accl::BUFFER_POOL_POP_ALL)) {
+		buffers.push_back(std::move(buffer));
+	}
+
+	// Add buffers back
+	buffer_pool.push(buffers);
+
+	// Check buffers is empty and kept its capacity
+	REQUIRE(buffers.size() == 0);
+	REQUIRE(buffers.capacity() == 5);
+
+	// Check the buffers were added back
+	REQUIRE(buffer_pool.getBufferCount() == 5);
+}
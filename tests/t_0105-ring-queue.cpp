@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "libaccl/ring_queue.hpp"
+#include "libtests/framework.hpp"
+
+TEST_CASE("Check ring queue capacity is rounded up to a power of 2", "[ring_queue]") {
+	accl::SPSCRingQueue<int> spsc_queue(5);
+	accl::MPMCRingQueue<int> mpmc_queue(1000);
+
+	REQUIRE(spsc_queue.capacity() == 8);
+	REQUIRE(mpmc_queue.capacity() == 1024);
+}
+
+TEST_CASE("Check SPSC ring queue push and pop", "[ring_queue]") {
+	accl::SPSCRingQueue<int> queue(4);
+
+	REQUIRE(queue.empty());
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(queue.tryPush(std::move(i)));
+	}
+	// We should now be full
+	int extra = 99;
+	REQUIRE_FALSE(queue.tryPush(std::move(extra)));
+	REQUIRE(queue.size() == 4);
+
+	// Items must come out in order
+	int item;
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(queue.tryPop(item));
+		REQUIRE(item == i);
+	}
+	REQUIRE_FALSE(queue.tryPop(item));
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("Check MPMC ring queue push and pop", "[ring_queue]") {
+	accl::MPMCRingQueue<int> queue(4);
+
+	REQUIRE(queue.empty());
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(queue.tryPush(std::move(i)));
+	}
+	// We should now be full
+	int extra = 99;
+	REQUIRE_FALSE(queue.tryPush(std::move(extra)));
+	REQUIRE(queue.size() == 4);
+
+	// Items must come out in order
+	int item;
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(queue.tryPop(item));
+		REQUIRE(item == i);
+	}
+	REQUIRE_FALSE(queue.tryPop(item));
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("Check ring queue bulk operations wrap correctly", "[ring_queue]") {
+	accl::SPSCRingQueue<std::unique_ptr<int>> queue(8);
+
+	int next = 0;
+	int expected = 0;
+	for (int round = 0; round < 10; ++round) {
+		std::deque<std::unique_ptr<int>> items;
+		for (int i = 0; i < 6; ++i) {
+			items.push_back(std::make_unique<int>(next++));
+		}
+		REQUIRE(queue.pushBulk(items) == 6);
+		REQUIRE(items.empty());
+
+		std::deque<std::unique_ptr<int>> results;
+		REQUIRE(queue.popBulk(results, 100) == 6);
+		for (auto &result : results) {
+			REQUIRE(*result == expected++);
+		}
+	}
+
+	// Pushing more than the capacity should only push what fits
+	std::deque<std::unique_ptr<int>> items;
+	for (int i = 0; i < 10; ++i) {
+		items.push_back(std::make_unique<int>(i));
+	}
+	REQUIRE(queue.pushBulk(items) == 8);
+	REQUIRE(items.size() == 2);
+	REQUIRE(*items.front() == 8);
+}
+
+TEST_CASE("Check MPMC ring queue with multiple producers and consumers", "[ring_queue]") {
+	const int producers = 4;
+	const int consumers = 4;
+	const int items_per_producer = 100000;
+
+	accl::MPMCRingQueue<int> queue(1024);
+	std::atomic<long> total{0};
+	std::atomic<int> consumed{0};
+
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p) {
+		threads.emplace_back([&queue]() {
+			for (int i = 1; i <= items_per_producer; ++i) {
+				int item = i;
+				while (!queue.tryPush(std::move(item))) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (int c = 0; c < consumers; ++c) {
+		threads.emplace_back([&queue, &total, &consumed]() {
+			int item;
+			while (consumed.load() < producers * items_per_producer) {
+				if (queue.tryPop(item)) {
+					total += item;
+					++consumed;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	// Every item must have been consumed exactly once
+	long expected = static_cast<long>(producers) * items_per_producer * (items_per_producer + 1) / 2;
+	REQUIRE(consumed.load() == producers * items_per_producer);
+	REQUIRE(total.load() == expected);
+}
+
+TEST_CASE("Check buffer pool push blocks when full until space is available", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(1024, 2, 2);
+
+	REQUIRE(buffer_pool.getCapacity() == 2);
+
+	auto buffer = std::make_unique<PacketBuffer>(1024);
+	std::thread pusher([&buffer_pool, &buffer]() { buffer_pool.push(std::move(buffer)); });
+
+	// Give the pusher a chance to block, then make space
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	auto popped = buffer_pool.pop();
+
+	pusher.join();
+	REQUIRE(buffer_pool.getBufferCount() == 2);
+}
+
+TEST_CASE("Check SPSC buffer pool transfers buffers between threads", "[buffers]") {
+	const size_t count = 50000;
+	accl::SPSCBufferPool<PacketBuffer> buffer_pool(64, 0, 256);
+
+	std::thread producer([&buffer_pool]() {
+		for (size_t i = 0; i < count; ++i) {
+			auto buffer = std::make_unique<PacketBuffer>(64);
+			buffer->setDataSize(i % 64);
+			buffer_pool.push(std::move(buffer));
+		}
+	});
+
+	size_t received = 0;
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	while (received < count) {
+		buffer_pool.wait(buffers);
+		for (auto &buffer : buffers) {
+			REQUIRE(buffer->getDataSize() == received % 64);
+			++received;
+		}
+		buffers.clear();
+	}
+	producer.join();
+
+	REQUIRE(buffer_pool.getBufferCount() == 0);
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "libtests/framework.hpp"
+
+TEST_CASE("Check buffer pool thread cache refills in batches", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(1024, 20);
+	buffer_pool.setThreadCacheSize(8);
+
+	// First pop misses and refills half the cache size
+	auto buffer = buffer_pool.pop();
+	REQUIRE(buffer_pool.getBufferCount() == 16);
+
+	// The next 3 pops come straight from the cache
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	for (int i = 0; i < 3; ++i) {
+		buffers.push_back(buffer_pool.pop());
+	}
+	REQUIRE(buffer_pool.getBufferCount() == 16);
+
+	accl::BufferPoolCacheStats stats = buffer_pool.getCacheStats();
+	REQUIRE(stats.hits == 3);
+	REQUIRE(stats.misses == 1);
+	REQUIRE(stats.refills == 1);
+	REQUIRE(stats.cached == 0);
+
+	// Pushing back goes into the cache
+	buffer_pool.push(std::move(buffer));
+	stats = buffer_pool.getCacheStats();
+	REQUIRE(stats.cached == 1);
+	REQUIRE(buffer_pool.getBufferCount() == 16);
+}
+
+TEST_CASE("Check buffer pool thread cache spills when full", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(1024, 0);
+	buffer_pool.setThreadCacheSize(8);
+
+	for (int i = 0; i < 9; ++i) {
+		buffer_pool.push(std::make_unique<PacketBuffer>(1024));
+	}
+
+	// The 9th push should have spilled half the cache into the shared pool
+	accl::BufferPoolCacheStats stats = buffer_pool.getCacheStats();
+	REQUIRE(stats.spills == 1);
+	REQUIRE(stats.cached == 5);
+	REQUIRE(buffer_pool.getBufferCount() == 4);
+}
+
+TEST_CASE("Check buffer pool thread cache is returned when the thread exits", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(1024, 100);
+	buffer_pool.setThreadCacheSize(16);
+
+	std::thread worker([&buffer_pool]() {
+		auto buffer = buffer_pool.pop();
+		buffer_pool.push(std::move(buffer));
+	});
+	worker.join();
+
+	// All buffers must be back in the shared pool and the stats retained
+	REQUIRE(buffer_pool.getBufferCount() == 100);
+	accl::BufferPoolCacheStats stats = buffer_pool.getCacheStats();
+	REQUIRE(stats.refills == 1);
+	REQUIRE(stats.hits == 1);
+	REQUIRE(stats.cached == 0);
+}
+
+TEST_CASE("Check buffer pool thread cache hands buffers to waiting threads", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(1024, 1);
+	buffer_pool.setThreadCacheSize(16);
+
+	auto buffer = buffer_pool.pop();
+
+	std::thread waiter([&buffer_pool]() {
+		auto waited_buffer = buffer_pool.pop_wait();
+		REQUIRE(waited_buffer != nullptr);
+	});
+
+	// Give the waiter a chance to block, then push the buffer back, it must not get stuck in our cache
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	buffer_pool.push(std::move(buffer));
+
+	waiter.join();
+}
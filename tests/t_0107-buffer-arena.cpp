@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "libtests/framework.hpp"
+
+TEST_CASE("Check creating an arena backed buffer pool works", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(1500, 100, 100, accl::BufferPoolAllocation::ARENA);
+
+	REQUIRE(buffer_pool.getBufferCount() == 100);
+	REQUIRE(buffer_pool.getArena() != nullptr);
+	REQUIRE(buffer_pool.getArena()->getCount() == 100);
+
+	// Each buffer must be the right size and cache line aligned
+	auto buffers = buffer_pool.pop(accl::BUFFER_POOL_POP_ALL);
+	for (auto &buffer : buffers) {
+		REQUIRE(buffer->getBufferSize() == 1500);
+		REQUIRE(reinterpret_cast<uintptr_t>(buffer->getData()) % accl::BUFFER_ARENA_ALIGNMENT == 0);
+	}
+
+	// Buffers must be usable and not overlap
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		std::string data(1500, static_cast<char>('a' + i % 26));
+		buffers[i]->append(data.data(), data.size());
+	}
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		REQUIRE(std::string(buffers[i]->getData(), buffers[i]->getDataSize()) == std::string(1500, static_cast<char>('a' + i % 26)));
+	}
+
+	buffer_pool.push(buffers);
+	REQUIRE(buffer_pool.getBufferCount() == 100);
+}
+
+TEST_CASE("Check arena buffers can be copied", "[buffers]") {
+	accl::BufferPool<PacketBuffer> buffer_pool(64, 2, 2, accl::BufferPoolAllocation::ARENA);
+
+	auto buffer1 = buffer_pool.pop();
+	auto buffer2 = buffer_pool.pop();
+
+	const std::string test_string = "hello world";
+	buffer1->append(test_string.data(), test_string.size());
+
+	// Copying into another arena buffer must keep its own storage
+	char *storage = buffer2->getData();
+	*buffer2 = *buffer1;
+	REQUIRE(buffer2->getData() == storage);
+	REQUIRE(std::string(buffer2->getData(), buffer2->getDataSize()) == test_string);
+
+	// Copy constructing gives us a buffer with its own storage
+	PacketBuffer copy(*buffer1);
+	REQUIRE(copy.getData() != buffer1->getData());
+	REQUIRE(copy.getBufferSize() == 64);
+	REQUIRE(std::string(copy.getData(), copy.getDataSize()) == test_string);
+
+	buffer_pool.push(std::move(buffer1));
+	buffer_pool.push(std::move(buffer2));
+}
+
+TEST_CASE("Check arena buffers outliving their pool are safe to delete", "[buffers]") {
+	std::unique_ptr<PacketBuffer> buffer;
+	{
+		accl::BufferPool<PacketBuffer> buffer_pool(64, 10, 10, accl::BufferPoolAllocation::ARENA);
+		buffer = buffer_pool.pop();
+	}
+
+	// The arena must still be mapped as we hold a buffer from it
+	const std::string test_string = "hello world";
+	buffer->append(test_string.data(), test_string.size());
+	REQUIRE(std::string(buffer->getData(), buffer->getDataSize()) == test_string);
+
+	buffer.reset();
+}
@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "libaccl/ring_queue.hpp"
+#include "libaccl/task_scheduler.hpp"
+#include "libtests/framework.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Task processing numbers queued for it, checking they arrive in order and that it is never run concurrently.
+ *
+ */
+class SequenceTask : public accl::Task {
+	public:
+		SequenceTask() : queue(65536), running(false), next(0), errors(0) {}
+
+		accl::MPMCRingQueue<uint32_t> queue;
+		std::atomic<bool> running;
+		std::atomic<uint32_t> next;
+		std::atomic<uint32_t> errors;
+
+	protected:
+		std::chrono::nanoseconds run() override {
+			if (running.exchange(true)) {
+				++errors;
+			}
+			uint32_t value;
+			while (queue.tryPop(value)) {
+				if (value != next) {
+					++errors;
+				}
+				next = value + 1;
+			}
+			running = false;
+			return std::chrono::nanoseconds::zero();
+		}
+};
+
+/**
+ * @brief Task which asks to be run again after a delay a number of times.
+ *
+ */
+class TimerTask : public accl::Task {
+	public:
+		TimerTask(uint32_t count) : count(count), runs(0) {}
+
+		uint32_t count;
+		std::atomic<uint32_t> runs;
+
+	protected:
+		std::chrono::nanoseconds run() override {
+			if (++runs < count) {
+				return std::chrono::milliseconds(1);
+			}
+			return std::chrono::nanoseconds::zero();
+		}
+};
+
+/**
+ * @brief Wait for a condition to become true, giving up after 10 seconds.
+ *
+ * @param condition Condition to wait for.
+ * @return true If the condition became true.
+ * @return false If we gave up.
+ */
+template <typename F> static bool wait_until(F condition) {
+	auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (!condition()) {
+		if (std::chrono::steady_clock::now() > end) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+TEST_CASE("Check tasks process their work in order and are never run concurrently", "[task-scheduler]") {
+	accl::TaskScheduler scheduler(4);
+	scheduler.start();
+
+	const uint32_t count = 50000;
+	std::vector<std::unique_ptr<SequenceTask>> tasks;
+	for (int i = 0; i < 8; ++i) {
+		tasks.push_back(std::make_unique<SequenceTask>());
+	}
+
+	// Each task gets its own producer, like each remote node has its own queue
+	std::vector<std::thread> producers;
+	for (auto &task : tasks) {
+		producers.emplace_back([&scheduler, &task, count]() {
+			for (uint32_t value = 0; value < count; ++value) {
+				while (!task->queue.tryPush(uint32_t(value))) {
+					std::this_thread::yield();
+				}
+				scheduler.schedule(task.get());
+			}
+		});
+	}
+	for (auto &producer : producers) {
+		producer.join();
+	}
+
+	for (auto &task : tasks) {
+		REQUIRE(wait_until([&task, count]() { return task->next == count; }));
+		REQUIRE(task->errors == 0);
+	}
+
+	scheduler.stop();
+	REQUIRE(scheduler.getRunCount() > 0);
+}
+
+TEST_CASE("Check tasks are run again when their timer is due", "[task-scheduler]") {
+	accl::TaskScheduler scheduler(2);
+	scheduler.start();
+
+	TimerTask task(5);
+	scheduler.schedule(&task);
+
+	REQUIRE(wait_until([&task]() { return task.runs == 5; }));
+	// The task didn't ask to be run again after its last run
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	REQUIRE(task.runs == 5);
+
+	scheduler.stop();
+}
+
+/**
+ * @brief Task which takes a while to run.
+ *
+ */
+class SleepTask : public accl::Task {
+	public:
+		SleepTask(std::atomic<uint32_t> &done) : done(done) {}
+
+		std::atomic<uint32_t> &done;
+
+	protected:
+		std::chrono::nanoseconds run() override {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			++done;
+			return std::chrono::nanoseconds::zero();
+		}
+};
+
+/**
+ * @brief Task scheduling a number of other tasks, these are all queued on the worker running this task.
+ *
+ */
+class SpawnTask : public accl::Task {
+	public:
+		SpawnTask(accl::TaskScheduler &scheduler, std::vector<std::unique_ptr<SleepTask>> &tasks)
+			: scheduler(scheduler), tasks(tasks) {}
+
+		accl::TaskScheduler &scheduler;
+		std::vector<std::unique_ptr<SleepTask>> &tasks;
+
+	protected:
+		std::chrono::nanoseconds run() override {
+			for (auto &task : tasks) {
+				scheduler.schedule(task.get());
+			}
+			return std::chrono::nanoseconds::zero();
+		}
+};
+
+TEST_CASE("Check idle workers steal work from busy workers", "[task-scheduler]") {
+	accl::TaskScheduler scheduler(4);
+	scheduler.start();
+
+	std::atomic<uint32_t> done{0};
+	std::vector<std::unique_ptr<SleepTask>> tasks;
+	for (int i = 0; i < 32; ++i) {
+		tasks.push_back(std::make_unique<SleepTask>(done));
+	}
+	SpawnTask spawn_task(scheduler, tasks);
+	scheduler.schedule(&spawn_task);
+
+	REQUIRE(wait_until([&done]() { return done == 32; }));
+	scheduler.stop();
+	REQUIRE(scheduler.getRunCount() == 33);
+	REQUIRE(scheduler.getStealCount() > 0);
+}
@@ -87,4 +87,97 @@ TEST_CASE("StreamCompressorZSTD Error Handling", "[StreamCompressorZSTD]") {
 
 		REQUIRE(decompressed_zie == -10);
 	}
+}
+
+TEST_CASE("StreamCompressorZSTD Dictionary", "[StreamCompressorZSTD]") {
+	const std::string dictionary =
+		"GET /index.html HTTP/1.1\r\nHost: www.example.com\r\nUser-Agent: superethd\r\nAccept: */*\r\n\r\n";
+	const std::string input = "GET /index.html HTTP/1.1\r\nHost: www.example.com\r\nAccept: */*\r\n\r\n";
+	const size_t max_output_size = 200;
+	char compressed[max_output_size];
+	char output[max_output_size];
+
+	accl::StreamCompressorZSTD plain_compressor;
+	const int plain_size = plain_compressor.compress(input.data(), input.size(), compressed, max_output_size);
+	REQUIRE(plain_size > 0);
+
+	accl::StreamCompressorZSTD compressor;
+	compressor.setDictionary(dictionary);
+	REQUIRE(compressor.hasDictionary());
+
+	SECTION("Compression with a dictionary") {
+		// Each stream starts off primed with the dictionary, so every reset stream compresses the same
+		for (int i = 0; i < 3; ++i) {
+			compressor.resetCompressionStream();
+			compressor.resetDecompressionStream();
+
+			const int compressed_size = compressor.compress(input.data(), input.size(), compressed, max_output_size);
+			REQUIRE(compressed_size > 0);
+			REQUIRE(compressed_size < plain_size);
+
+			const int decompressed_size = compressor.decompress(compressed, compressed_size, output, max_output_size);
+			REQUIRE(std::string(output, decompressed_size) == input);
+		}
+	}
+
+	SECTION("Compression with the dictionary disabled") {
+		compressor.setDictionaryEnabled(false);
+		compressor.resetCompressionStream();
+		compressor.resetDecompressionStream();
+
+		const int compressed_size = compressor.compress(input.data(), input.size(), compressed, max_output_size);
+		REQUIRE(compressed_size == plain_size);
+
+		const int decompressed_size = compressor.decompress(compressed, compressed_size, output, max_output_size);
+		REQUIRE(std::string(output, decompressed_size) == input);
+	}
+
+	SECTION("Decompression without the dictionary") {
+		const int compressed_size = compressor.compress(input.data(), input.size(), compressed, max_output_size);
+		REQUIRE(compressed_size > 0);
+
+		// Data compressed against a dictionary cannot be decompressed without it
+		const int decompressed_size = plain_compressor.decompress(compressed, compressed_size, output, max_output_size);
+		REQUIRE((decompressed_size < 0 || std::string(output, decompressed_size) != input));
+	}
+
+	SECTION("Removing the dictionary") {
+		compressor.setDictionary("");
+		REQUIRE_FALSE(compressor.hasDictionary());
+
+		const int compressed_size = compressor.compress(input.data(), input.size(), compressed, max_output_size);
+		REQUIRE(compressed_size == plain_size);
+	}
+}
+TEST_CASE("StreamCompressorZSTD Compression Level", "[StreamCompressorZSTD]") {
+	const std::string dictionary =
+		"GET /index.html HTTP/1.1\r\nHost: www.example.com\r\nUser-Agent: superethd\r\nAccept: */*\r\n\r\n";
+	std::string input;
+	for (int i = 0; i < 20; ++i) {
+		input += "GET /index.html HTTP/1.1\r\nHost: www.example.com\r\nAccept: */*\r\n\r\n";
+	}
+	const size_t max_output_size = 2048;
+	char compressed[max_output_size];
+	char output[max_output_size];
+
+	accl::StreamCompressorZSTD compressor;
+	REQUIRE(compressor.getCompressionLevel() == 5);
+	compressor.setDictionary(dictionary);
+
+	// Changing the level must keep the dictionary, the stream compresses the same as a fresh one with that level
+	for (int level : {1, 9, 19}) {
+		compressor.setCompressionLevel(level);
+		REQUIRE(compressor.getCompressionLevel() == level);
+		REQUIRE(compressor.hasDictionary());
+		compressor.resetCompressionStream();
+		compressor.resetDecompressionStream();
+
+		const int compressed_size = compressor.compress(input.data(), input.size(), compressed, max_output_size);
+		REQUIRE(compressed_size > 0);
+
+		accl::StreamCompressorZSTD decompressor;
+		decompressor.setDictionary(dictionary);
+		const int decompressed_size = decompressor.decompress(compressed, compressed_size, output, max_output_size);
+		REQUIRE(std::string(output, decompressed_size) == input);
+	}
 }
\ No newline at end of file
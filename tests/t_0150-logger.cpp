@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "libaccl/logger.hpp"
+#include "libtests/framework.hpp"
+#include <sstream>
+#include <thread>
+
+/**
+ * @brief Capture what is written to std::cerr while in scope.
+ *
+ */
+struct CaptureStderr {
+		CaptureStderr() : old_buffer(std::cerr.rdbuf(output.rdbuf())) {}
+		~CaptureStderr() { std::cerr.rdbuf(old_buffer); }
+
+		/**
+		 * @brief Count the number of lines captured containing a string.
+		 *
+		 * @param text String to look for.
+		 * @return size_t Number of lines containing the string.
+		 */
+		size_t count(const std::string &text) {
+			std::istringstream lines(output.str());
+			size_t result = 0;
+			for (std::string line; std::getline(lines, line);) {
+				if (line.find(text) != std::string::npos) {
+					++result;
+				}
+			}
+			return result;
+		}
+
+		std::ostringstream output;
+		std::streambuf *old_buffer;
+};
+
+TEST_CASE("Check the rate limiter allows a burst of messages per interval", "[logger]") {
+	accl::LogRateLimiter limiter(3, std::chrono::milliseconds(50));
+
+	uint32_t suppressed;
+	for (size_t i = 0; i < 3; ++i) {
+		REQUIRE(limiter.allow(suppressed));
+		REQUIRE(suppressed == 0);
+	}
+	for (size_t i = 0; i < 5; ++i) {
+		REQUIRE(!limiter.allow(suppressed));
+		REQUIRE(suppressed == 0);
+	}
+
+	// The first message of the next interval reports how many were suppressed
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	REQUIRE(limiter.allow(suppressed));
+	REQUIRE(suppressed == 5);
+	REQUIRE(limiter.allow(suppressed));
+	REQUIRE(suppressed == 0);
+}
+
+TEST_CASE("Check a rate limiter without a burst allows all messages", "[logger]") {
+	accl::LogRateLimiter limiter(0);
+
+	uint32_t suppressed;
+	for (size_t i = 0; i < 1000; ++i) {
+		REQUIRE(limiter.allow(suppressed));
+		REQUIRE(suppressed == 0);
+	}
+}
+
+/**
+ * @brief Log an error from a single call site.
+ *
+ * @param i Number of the message.
+ */
+static void log_from_call_site(size_t i) { LOG_ERROR("Rate limited call site ", i); }
+
+TEST_CASE("Check each call site is rate limited", "[logger]") {
+	CaptureStderr capture;
+
+	for (size_t i = 0; i < accl::LOG_RATE_LIMIT_BURST * 3; ++i) {
+		log_from_call_site(i);
+		LOG_ERROR("Other rate limited call site ", i);
+	}
+	REQUIRE(capture.count("Rate limited call site") == accl::LOG_RATE_LIMIT_BURST);
+	REQUIRE(capture.count("Other rate limited call site") == accl::LOG_RATE_LIMIT_BURST);
+
+	// Once the interval is over the call site logs again, along with how many messages it suppressed
+	std::this_thread::sleep_for(accl::LOG_RATE_LIMIT_INTERVAL + std::chrono::milliseconds(100));
+	log_from_call_site(0);
+	REQUIRE(capture.count("Rate limited call site") == accl::LOG_RATE_LIMIT_BURST + 1);
+	REQUIRE(capture.count("(" + std::to_string(accl::LOG_RATE_LIMIT_BURST * 2) + " similar messages suppressed)") == 1);
+}
+
+TEST_CASE("Check log lines too long for a log record are truncated", "[logger]") {
+	CaptureStderr capture;
+
+	LOG_ERROR("Long line ", std::string(accl::LOG_RECORD_TEXT_SIZE * 2, 'x'));
+
+	std::string output = capture.output.str();
+	REQUIRE(output.find(std::string(accl::LOG_RECORD_TEXT_SIZE - 10, 'x') + "...") != std::string::npos);
+	REQUIRE(output.find(std::string(accl::LOG_RECORD_TEXT_SIZE, 'x')) == std::string::npos);
+}
+
+TEST_CASE("Check log lines from many threads are written by the logger thread", "[logger]") {
+	CaptureStderr capture;
+
+	accl::logger.start();
+
+	// Each thread logs from its own call site so none are rate limited
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < 4; ++i) {
+		threads.emplace_back([i]() {
+			switch (i) {
+			case 0:
+				LOG_ERROR("Logger thread test ", i);
+				break;
+			case 1:
+				LOG_WARNING("Logger thread test ", i);
+				break;
+			case 2:
+				LOG_ERROR("Logger thread test ", i);
+				break;
+			default:
+				LOG_WARNING("Logger thread test ", i);
+				break;
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	LOG_ERROR("Logger thread test main");
+
+	// Stopping the logger thread writes out everything that was queued
+	accl::logger.stop();
+	REQUIRE(capture.count("Logger thread test") == 5);
+	REQUIRE(capture.count("Logger thread test main") == 1);
+
+	// Once stopped log lines are written straight away again
+	LOG_ERROR("Logger thread stopped");
+	REQUIRE(capture.count("Logger thread stopped") == 1);
+}
\ No newline at end of file
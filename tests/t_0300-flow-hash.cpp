@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "libtests/framework.hpp"
+#include <set>
+
+/**
+ * @brief Build a UDP over IPv4 frame.
+ *
+ * @param src_port Source port.
+ * @param dst_port Destination port.
+ * @param payload_size Size of the payload.
+ * @return std::string Frame.
+ */
+static std::string build_udpv4_frame(uint16_t src_port, uint16_t dst_port, size_t payload_size) {
+	UDPv4Packet packet;
+
+	packet.setDstMac({0x01, 0x02, 0x03, 0x04, 0x05, 0x06});
+	packet.setSrcMac({0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f});
+	packet.setDstAddr({192, 168, 10, 1});
+	packet.setSrcAddr({172, 16, 101, 102});
+	packet.setSrcPort(src_port);
+	packet.setDstPort(dst_port);
+	packet.addPayload(accl::SequenceDataGenerator(payload_size).asBytes());
+
+	return packet.asBinary();
+}
+
+/**
+ * @brief Build a UDP over IPv6 frame.
+ *
+ * @param src_port Source port.
+ * @param dst_port Destination port.
+ * @param payload_size Size of the payload.
+ * @return std::string Frame.
+ */
+static std::string build_udpv6_frame(uint16_t src_port, uint16_t dst_port, size_t payload_size) {
+	UDPv6Packet packet;
+
+	packet.setDstMac({0x01, 0x02, 0x03, 0x04, 0x05, 0x06});
+	packet.setSrcMac({0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f});
+	packet.setDstAddr({0xfe, 0xc0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1});
+	packet.setSrcAddr({0xfe, 0xc0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2});
+	packet.setSrcPort(src_port);
+	packet.setDstPort(dst_port);
+	packet.addPayload(accl::SequenceDataGenerator(payload_size).asBytes());
+
+	return packet.asBinary();
+}
+
+TEST_CASE("Check frames of the same flow get the same hash", "[flow-hash]") {
+	std::string frame1 = build_udpv4_frame(12345, 54321, 100);
+	std::string frame2 = build_udpv4_frame(12345, 54321, 900);
+	REQUIRE(get_ethernet_flow_hash(frame1.data(), frame1.size()) == get_ethernet_flow_hash(frame2.data(), frame2.size()));
+
+	std::string frame3 = build_udpv6_frame(12345, 54321, 100);
+	std::string frame4 = build_udpv6_frame(12345, 54321, 900);
+	REQUIRE(get_ethernet_flow_hash(frame3.data(), frame3.size()) == get_ethernet_flow_hash(frame4.data(), frame4.size()));
+}
+
+TEST_CASE("Check frames of different flows get different hashes", "[flow-hash]") {
+	std::string frame1 = build_udpv4_frame(12345, 54321, 100);
+	std::string frame2 = build_udpv4_frame(12346, 54321, 100);
+	REQUIRE(get_ethernet_flow_hash(frame1.data(), frame1.size()) != get_ethernet_flow_hash(frame2.data(), frame2.size()));
+
+	std::string frame3 = build_udpv6_frame(12345, 54321, 100);
+	std::string frame4 = build_udpv6_frame(12345, 54322, 100);
+	REQUIRE(get_ethernet_flow_hash(frame3.data(), frame3.size()) != get_ethernet_flow_hash(frame4.data(), frame4.size()));
+}
+
+TEST_CASE("Check flows are spread over all queues", "[flow-hash]") {
+	const size_t queues = 4;
+
+	std::set<size_t> used_queues;
+	for (uint16_t port = 10000; port < 10064; ++port) {
+		std::string frame = build_udpv4_frame(port, 54321, 100);
+		used_queues.insert(get_ethernet_flow_hash(frame.data(), frame.size()) % queues);
+	}
+
+	REQUIRE(used_queues.size() == queues);
+}
+
+TEST_CASE("Check short frames do not get hashed past their end", "[flow-hash]") {
+	std::string frame = build_udpv4_frame(12345, 54321, 100);
+	// Cut the frame off in the middle of the IPv4 header
+	REQUIRE(get_ethernet_flow_hash(frame.data(), 20) == get_ethernet_flow_hash(frame.data(), 21));
+	REQUIRE(get_ethernet_flow_hash(frame.data(), 10) == get_ethernet_flow_hash(frame.data(), 0));
+}
@@ -0,0 +1,214 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "fdb.hpp"
+#include "libtests/framework.hpp"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Build a MAC address from a number.
+ *
+ * @param num Number to use for the lower 32 bits of the MAC address.
+ * @return FDBMACAddress MAC address.
+ */
+static FDBMACAddress build_mac(uint32_t num) {
+	FDBMACAddress mac = {{0x02, 0x00, static_cast<uint8_t>(num >> 24), static_cast<uint8_t>(num >> 16),
+						  static_cast<uint8_t>(num >> 8), static_cast<uint8_t>(num)}};
+	return mac;
+}
+
+/**
+ * @brief Create a remote node for use as an FDB destination, the node is not started.
+ *
+ * @param last_octet Last octet of the node IPv4 address.
+ * @return std::shared_ptr<RemoteNode> Remote node.
+ */
+static std::shared_ptr<RemoteNode> build_remote_node(uint8_t last_octet) {
+	auto addr = std::make_shared<sockaddr_storage>();
+	sockaddr_in *addr4 = reinterpret_cast<sockaddr_in *>(addr.get());
+	addr4->sin_family = AF_INET;
+	addr4->sin_addr.s_addr = htonl(0xC0A80A00 | last_octet);
+
+	PacketSwitchOptions options;
+	CompressionSettings compression;
+	std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> tap_write_pools;
+	return std::make_shared<RemoteNode>(-1, addr, 1500, 1500, 1600, 1, compression, options, tap_write_pools, nullptr, nullptr,
+										nullptr);
+}
+
+TEST_CASE("Check FDB entries can be added and looked up", "[fdb]") {
+	FDB fdb;
+	auto node = build_remote_node(1);
+
+	FDBMACAddress local_mac = build_mac(1);
+	FDBMACAddress remote_mac = build_mac(2);
+	FDBMACAddress unknown_mac = build_mac(3);
+
+	fdb.add(&local_mac, nullptr);
+	fdb.add(&remote_mac, node);
+	REQUIRE(fdb.getEntryCount() == 2);
+
+	FDBEntry entry;
+	REQUIRE(fdb.get(&local_mac, entry));
+	REQUIRE(entry.isLocal());
+	REQUIRE(std::memcmp(entry.getMAC().bytes, local_mac.bytes, sizeof(local_mac.bytes)) == 0);
+
+	REQUIRE(fdb.get(&remote_mac, entry));
+	REQUIRE(!entry.isLocal());
+	REQUIRE(std::memcmp(entry.getMAC().bytes, remote_mac.bytes, sizeof(remote_mac.bytes)) == 0);
+
+	REQUIRE(!fdb.get(&unknown_mac, entry));
+
+	// Local and unknown MAC addresses have no remote node
+	REQUIRE(fdb.getRemoteNode(&local_mac) == nullptr);
+	REQUIRE(fdb.getRemoteNode(&unknown_mac) == nullptr);
+	REQUIRE(fdb.getRemoteNode(&remote_mac) == node.get());
+
+	// Adding an existing MAC address leaves the entry as is
+	fdb.add(&remote_mac, nullptr);
+	REQUIRE(fdb.getEntryCount() == 2);
+	REQUIRE(fdb.getRemoteNode(&remote_mac) == node.get());
+}
+
+TEST_CASE("Check FDB grows and keeps its entries", "[fdb]") {
+	FDB fdb(16);
+	auto node1 = build_remote_node(1);
+	auto node2 = build_remote_node(2);
+
+	const uint32_t count = 10000;
+	for (uint32_t i = 0; i < count; ++i) {
+		FDBMACAddress mac = build_mac(i);
+		fdb.add(&mac, i % 2 ? node1 : node2);
+	}
+	REQUIRE(fdb.getEntryCount() == count);
+	REQUIRE(fdb.getCapacity() > count);
+
+	for (uint32_t i = 0; i < count; ++i) {
+		FDBMACAddress mac = build_mac(i);
+		REQUIRE(fdb.getRemoteNode(&mac) == (i % 2 ? node1 : node2).get());
+	}
+}
+
+TEST_CASE("Check FDB entries expire and the rest can still be found", "[fdb]") {
+	FDB fdb(16);
+
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32_t count = 1000;
+	for (uint32_t i = 0; i < count; ++i) {
+		FDBMACAddress mac = build_mac(i);
+		fdb.add(&mac, nullptr);
+	}
+
+	// Touch every third entry so it is seen later than the rest
+	for (uint32_t i = 0; i < count; i += 3) {
+		FDBMACAddress mac = build_mac(i);
+		REQUIRE(fdb.touch(&mac, start + std::chrono::seconds(200)));
+	}
+	FDBMACAddress unknown_mac = build_mac(count);
+	REQUIRE(!fdb.touch(&unknown_mac));
+
+	fdb.expireEntries(300, start + std::chrono::seconds(400));
+
+	REQUIRE(fdb.getEntryCount() == (count + 2) / 3);
+	FDBEntry entry;
+	for (uint32_t i = 0; i < count; ++i) {
+		FDBMACAddress mac = build_mac(i);
+		REQUIRE(fdb.get(&mac, entry) == (i % 3 == 0));
+	}
+
+	// Expire the rest
+	fdb.expireEntries(300, start + std::chrono::seconds(600));
+	REQUIRE(fdb.getEntryCount() == 0);
+}
+
+TEST_CASE("Check FDB lookups stay consistent while the FDB is updated", "[fdb]") {
+	FDB fdb(16);
+	auto node = build_remote_node(1);
+
+	// These entries are seen in the future so they are never expired, lookups must always find them
+	auto future = std::chrono::steady_clock::now() + std::chrono::hours(1);
+	const uint32_t stable_count = 256;
+	for (uint32_t i = 0; i < stable_count; ++i) {
+		FDBMACAddress mac = build_mac(i);
+		fdb.add(&mac, node);
+		fdb.touch(&mac, future);
+	}
+
+	std::atomic<bool> stop{false};
+	std::atomic<size_t> failures{0};
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 2; ++t) {
+		readers.emplace_back([&]() {
+			while (!stop.load()) {
+				for (uint32_t i = 0; i < stable_count; ++i) {
+					FDBMACAddress mac = build_mac(i);
+					if (fdb.getRemoteNode(&mac) != node.get() || !fdb.touch(&mac, future)) {
+						++failures;
+					}
+				}
+			}
+		});
+	}
+
+	// Keep adding and expiring other entries, growing the table and shifting the stable entries around
+	for (uint32_t round = 0; round < 20; ++round) {
+		for (uint32_t i = 0; i < 2000; ++i) {
+			FDBMACAddress mac = build_mac(0x10000000 + round * 2000 + i);
+			fdb.add(&mac, nullptr);
+		}
+		fdb.expireEntries(10, std::chrono::steady_clock::now() + std::chrono::seconds(60));
+		REQUIRE(fdb.getEntryCount() == stable_count);
+	}
+
+	stop = true;
+	for (auto &reader : readers) {
+		reader.join();
+	}
+
+	REQUIRE(failures == 0);
+}
+
+TEST_CASE("Check FDB touches are not lost while the table grows", "[fdb]") {
+	FDB fdb(16);
+
+	const uint32_t touched_count = 64;
+	auto start = std::chrono::steady_clock::now() + std::chrono::hours(1);
+	for (uint32_t i = 0; i < touched_count; ++i) {
+		FDBMACAddress mac = build_mac(i);
+		fdb.add(&mac, nullptr);
+	}
+
+	// Each pass touches the entries with a later time, by the next pass the touch must still be there even if the table grew
+	std::atomic<bool> stop{false};
+	std::atomic<size_t> failures{0};
+	std::thread toucher([&]() {
+		for (int64_t pass = 1; !stop.load(); ++pass) {
+			for (uint32_t i = 0; i < touched_count; ++i) {
+				FDBMACAddress mac = build_mac(i);
+				FDBEntry entry;
+				if (!fdb.get(&mac, entry) || (pass > 1 && entry.getLastSeen() < start + std::chrono::seconds(pass - 1)) ||
+					!fdb.touch(&mac, start + std::chrono::seconds(pass))) {
+					++failures;
+				}
+			}
+		}
+	});
+
+	// Grow the table many times while the entries are being touched
+	for (uint32_t i = 0; i < 100000; ++i) {
+		FDBMACAddress mac = build_mac(0x10000000 + i);
+		fdb.add(&mac, nullptr);
+	}
+
+	stop = true;
+	toucher.join();
+
+	REQUIRE(failures == 0);
+}
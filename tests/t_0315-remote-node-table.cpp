@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "libtests/framework.hpp"
+#include "remote_node_table.hpp"
+#include "util.hpp"
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Build a remote node, these are never started so don't need a socket or buffer pools.
+ *
+ * @param addr Address of the remote node.
+ * @return std::shared_ptr<RemoteNode> Remote node.
+ */
+static std::shared_ptr<RemoteNode> build_remote_node(std::shared_ptr<sockaddr_storage> addr) {
+	PacketSwitchOptions options;
+	CompressionSettings compression;
+	std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> tap_write_pools;
+	return std::make_shared<RemoteNode>(-1, addr, 1500, 1500, 1600, 1, compression, options, tap_write_pools, nullptr, nullptr,
+										nullptr);
+}
+
+/**
+ * @brief Build an IPv4 or IPv6 address.
+ *
+ * @param ipv6 Build an IPv6 address.
+ * @param index Index of the address, this picks the last 2 bytes of the address.
+ * @return std::shared_ptr<sockaddr_storage> Address.
+ */
+static std::shared_ptr<sockaddr_storage> build_addr(bool ipv6, uint16_t index) {
+	auto addr = std::make_shared<sockaddr_storage>();
+	std::memset(addr.get(), 0, sizeof(sockaddr_storage));
+	if (ipv6) {
+		sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(addr.get());
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_addr.s6_addr[0] = 0xfd;
+		addr6->sin6_addr.s6_addr[14] = index >> 8;
+		addr6->sin6_addr.s6_addr[15] = index & 0xff;
+	} else {
+		sockaddr_in *addr4 = reinterpret_cast<sockaddr_in *>(addr.get());
+		addr4->sin_family = AF_INET;
+		addr4->sin_addr.s_addr = htonl(0x0A000000 | index);
+	}
+	return addr;
+}
+
+TEST_CASE("Check remote nodes can be added and found", "[remote-node]") {
+	RemoteNodeTable table;
+	REQUIRE(table.size() == 0);
+	REQUIRE(table.find(get_key_from_sockaddr(build_addr(false, 1).get())) == RemoteNodeTable::npos);
+
+	// Add enough nodes for the table to grow a few times, node IDs are given out in order
+	std::vector<std::shared_ptr<RemoteNode>> nodes;
+	for (uint16_t index = 0; index < 300; ++index) {
+		nodes.push_back(build_remote_node(build_addr(index % 2, index)));
+		REQUIRE(table.add(nodes.back()) == index);
+	}
+	REQUIRE(table.size() == nodes.size());
+
+	// Each node is found using the address packets from it are received from
+	for (uint16_t index = 0; index < nodes.size(); ++index) {
+		size_t node_id = table.find(get_key_from_sockaddr(build_addr(index % 2, index).get()));
+		REQUIRE(node_id == index);
+		REQUIRE(table.get(node_id) == nodes[index].get());
+		REQUIRE(table.getShared(node_id) == nodes[index]);
+	}
+
+	// Addresses of the other family are different nodes
+	REQUIRE(table.find(get_key_from_sockaddr(build_addr(true, 0).get())) == RemoteNodeTable::npos);
+	REQUIRE(table.find(get_key_from_sockaddr(build_addr(false, 1).get())) == RemoteNodeTable::npos);
+	REQUIRE(table.find(get_key_from_sockaddr(build_addr(false, 1000).get())) == RemoteNodeTable::npos);
+}
+
+TEST_CASE("Check adding a remote node again returns its node ID", "[remote-node]") {
+	RemoteNodeTable table;
+	auto node = build_remote_node(build_addr(false, 1));
+	REQUIRE(table.add(node) == 0);
+	REQUIRE(table.add(build_remote_node(build_addr(false, 2))) == 1);
+	REQUIRE(table.add(build_remote_node(build_addr(false, 1))) == 0);
+	REQUIRE(table.size() == 2);
+	REQUIRE(table.get(0) == node.get());
+}
\ No newline at end of file
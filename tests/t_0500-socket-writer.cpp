@@ -0,0 +1,251 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "common.hpp"
+#include "libtests/framework.hpp"
+#include "socket_writer.hpp"
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Create a UDP socket bound to the IPv6 loopback address.
+ *
+ * @param addr Address the socket was bound to.
+ * @return int Socket.
+ */
+static int create_loopback_socket(sockaddr_storage &addr) {
+	int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	REQUIRE(fd != -1);
+
+	int buffer_size = 4 * 1024 * 1024;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+	timeval timeout{1, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::memset(&addr, 0, sizeof(addr));
+	sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+	addr6->sin6_family = AF_INET6;
+	addr6->sin6_addr = in6addr_loopback;
+	REQUIRE(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(sockaddr_in6)) == 0);
+	socklen_t addr_len = sizeof(sockaddr_in6);
+	getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+
+	return fd;
+}
+
+/**
+ * @brief Write a set of packets using a socket write mode and check they are all received intact.
+ *
+ * @param mode Socket write mode.
+ */
+static void check_socket_writer(SocketWriteMode mode) {
+	sockaddr_storage rx_addr, tx_addr;
+	int rx_socket = create_loopback_socket(rx_addr);
+	int tx_socket = create_loopback_socket(tx_addr);
+
+	// Mix of packet sizes so we get GSO runs, short last segments and single packets
+	std::vector<size_t> sizes{1000, 1000, 1000, 600, 1200, 1200, 1200, 1200, 100, 1400, 1400, 800};
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		auto buffer = std::make_unique<PacketBuffer>(1500);
+		std::string data(sizes[i], static_cast<char>('a' + i));
+		buffer->append(data.data(), data.size());
+		buffers.push_back(std::move(buffer));
+	}
+
+	SocketWriter writer(tx_socket, mode);
+	writer.write(&rx_addr, buffers);
+
+	REQUIRE(writer.getPacketCount() == sizes.size());
+	if (mode == SocketWriteMode::SENDTO) {
+		REQUIRE(writer.getSyscallCount() == sizes.size());
+	} else {
+		REQUIRE(writer.getSyscallCount() == 1);
+	}
+
+	// Each packet must arrive as it was written
+	char rx_buffer[2048];
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		ssize_t len = recv(rx_socket, rx_buffer, sizeof(rx_buffer), 0);
+		REQUIRE(len == static_cast<ssize_t>(sizes[i]));
+		REQUIRE(std::string(rx_buffer, len) == std::string(sizes[i], static_cast<char>('a' + i)));
+	}
+
+	close(rx_socket);
+	close(tx_socket);
+}
+
+TEST_CASE("Check socket writer using sendto", "[socket]") { check_socket_writer(SocketWriteMode::SENDTO); }
+
+TEST_CASE("Check socket writer using sendmmsg", "[socket]") { check_socket_writer(SocketWriteMode::SENDMMSG); }
+
+TEST_CASE("Check socket writer using UDP GSO", "[socket]") { check_socket_writer(SocketWriteMode::GSO); }
+
+/**
+ * @brief Write a set of packets made up of fragments using a socket write mode and check they are all received intact.
+ *
+ * @param mode Socket write mode.
+ */
+static void check_socket_writer_fragments(SocketWriteMode mode) {
+	sockaddr_storage rx_addr, tx_addr;
+	int rx_socket = create_loopback_socket(rx_addr);
+	int tx_socket = create_loopback_socket(tx_addr);
+
+	// Each packet is a header, a fragment, more data and another fragment, the same size packets are sent as a GSO run
+	std::vector<size_t> sizes{1000, 1000, 1000, 600, 1200};
+	std::vector<std::string> packets;
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		std::string data;
+		for (size_t j = 0; j < sizes[i]; ++j) {
+			data += static_cast<char>('a' + ((i + j) % 26));
+		}
+		packets.push_back(data);
+
+		size_t fragment_size = (sizes[i] - 100) / 2;
+		auto buffer = std::make_unique<PacketBuffer>(1500);
+		buffer->append(data.data(), 50);
+		auto fragment = std::make_unique<PacketBuffer>(1500);
+		fragment->append(data.data() + 50, fragment_size);
+		buffer->appendFragment(std::move(fragment));
+		buffer->append(data.data() + 50 + fragment_size, 50);
+		fragment = std::make_unique<PacketBuffer>(1500);
+		fragment->append(data.data() + 100 + fragment_size, sizes[i] - 100 - fragment_size);
+		buffer->appendFragment(std::move(fragment));
+		REQUIRE(buffer->getPacketSize() == sizes[i]);
+		buffers.push_back(std::move(buffer));
+	}
+
+	SocketWriter writer(tx_socket, mode);
+	writer.write(&rx_addr, buffers);
+
+	REQUIRE(writer.getPacketCount() == sizes.size());
+
+	// Each packet must arrive in one piece
+	char rx_buffer[2048];
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		ssize_t len = recv(rx_socket, rx_buffer, sizeof(rx_buffer), 0);
+		REQUIRE(len == static_cast<ssize_t>(sizes[i]));
+		REQUIRE(std::string(rx_buffer, len) == packets[i]);
+	}
+
+	close(rx_socket);
+	close(tx_socket);
+}
+
+TEST_CASE("Check socket writer writing fragments using sendto", "[socket]") {
+	check_socket_writer_fragments(SocketWriteMode::SENDTO);
+}
+
+TEST_CASE("Check socket writer writing fragments using sendmmsg", "[socket]") {
+	check_socket_writer_fragments(SocketWriteMode::SENDMMSG);
+}
+
+TEST_CASE("Check socket writer writing fragments using UDP GSO", "[socket]") {
+	check_socket_writer_fragments(SocketWriteMode::GSO);
+}
+
+/**
+ * @brief Write a set of packets using zero-copy and check they are all received intact and handed back once complete.
+ *
+ * @param mode Socket write mode.
+ */
+static void check_socket_writer_zero_copy(SocketWriteMode mode) {
+	sockaddr_storage rx_addr, tx_addr;
+	int rx_socket = create_loopback_socket(rx_addr);
+	int tx_socket = create_loopback_socket(tx_addr);
+	auto tracker = std::make_shared<ZeroCopyTracker>(tx_socket);
+	bool zero_copy = tracker->isEnabled();
+
+	// Jumbo packets are sent using zero-copy, the small packets in between are copied
+	std::vector<size_t> sizes{9000, 9000, 1000, 9000, 100};
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		auto buffer = std::make_unique<PacketBuffer>(9216);
+		std::string data(sizes[i], static_cast<char>('a' + i));
+		buffer->append(data.data(), data.size());
+		buffers.push_back(std::move(buffer));
+	}
+
+	SocketWriter writer(tx_socket, mode);
+	writer.setZeroCopy(tracker);
+	writer.write(&rx_addr, buffers);
+
+	REQUIRE(writer.getPacketCount() == sizes.size());
+	REQUIRE(writer.getZeroCopyPendingCount() == writer.getZeroCopyCount());
+	REQUIRE(buffers.size() + writer.getZeroCopyPendingCount() == sizes.size());
+	if (zero_copy) {
+		REQUIRE(writer.getZeroCopyCount() > 0);
+	}
+
+	// Each packet must arrive as it was written
+	char rx_buffer[16384];
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		ssize_t len = recv(rx_socket, rx_buffer, sizeof(rx_buffer), 0);
+		REQUIRE(len == static_cast<ssize_t>(sizes[i]));
+		REQUIRE(std::string(rx_buffer, len) == std::string(sizes[i], static_cast<char>('a' + i)));
+	}
+
+	// The kernel reports it is done with the packets on the socket error queue
+	for (size_t i = 0; i < 100 && writer.getZeroCopyPendingCount(); ++i) {
+		pollfd pfd{tx_socket, 0, 0};
+		poll(&pfd, 1, 10);
+		writer.reapZeroCopy(buffers);
+	}
+	REQUIRE(writer.getZeroCopyPendingCount() == 0);
+	REQUIRE(buffers.size() == sizes.size());
+
+	close(rx_socket);
+	close(tx_socket);
+}
+
+TEST_CASE("Check socket writer writing using zero-copy with sendto", "[socket]") {
+	check_socket_writer_zero_copy(SocketWriteMode::SENDTO);
+}
+
+TEST_CASE("Check socket writer writing using zero-copy with sendmmsg", "[socket]") {
+	check_socket_writer_zero_copy(SocketWriteMode::SENDMMSG);
+}
+
+TEST_CASE("Check socket writer writing using zero-copy with UDP GSO", "[socket]") {
+	check_socket_writer_zero_copy(SocketWriteMode::GSO);
+}
+
+TEST_CASE("Check socket writer writing the same packet to multiple addresses", "[socket]") {
+	// We need more receivers than fit into a single sendmmsg() batch to check we send them all
+	const size_t count = SETH_MAX_SENDMM_MESSAGES + 10;
+	std::vector<int> rx_sockets;
+	std::vector<std::shared_ptr<sockaddr_storage>> rx_addrs;
+	for (size_t i = 0; i < count; ++i) {
+		auto rx_addr = std::make_shared<sockaddr_storage>();
+		rx_sockets.push_back(create_loopback_socket(*rx_addr));
+		rx_addrs.push_back(rx_addr);
+	}
+	sockaddr_storage tx_addr;
+	int tx_socket = create_loopback_socket(tx_addr);
+
+	PacketBuffer buffer(1500);
+	std::string data(1000, 'x');
+	buffer.append(data.data(), data.size());
+
+	SocketWriter writer(tx_socket, SocketWriteMode::SENDMMSG);
+	writer.write(rx_addrs, buffer);
+
+	REQUIRE(writer.getPacketCount() == count);
+	REQUIRE(writer.getSyscallCount() == 2);
+
+	// Each receiver must get the packet
+	char rx_buffer[2048];
+	for (auto rx_socket : rx_sockets) {
+		ssize_t len = recv(rx_socket, rx_buffer, sizeof(rx_buffer), 0);
+		REQUIRE(std::string(rx_buffer, len) == data);
+		close(rx_socket);
+	}
+
+	close(tx_socket);
+}
@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "libtests/framework.hpp"
+#include "libtests/t_socket.hpp"
+#include "socket_reader.hpp"
+#include "socket_writer.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Write a set of packets using UDP GSO and check they are all read back intact using a socket read mode.
+ *
+ * @param mode Socket read mode.
+ */
+static void check_socket_reader(SocketReadMode mode) {
+	sockaddr_storage rx_addr, tx_addr;
+	int rx_socket = create_loopback_socket(rx_addr);
+	int tx_socket = create_loopback_socket(tx_addr);
+
+	auto available_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(1500, 300);
+
+	// Mix of packet sizes so we get GSO runs, short last segments and single packets
+	std::vector<size_t> sizes{1000, 1000, 1000, 600, 1200, 1200, 1200, 1200, 100, 1400, 1400, 800};
+	std::deque<std::unique_ptr<PacketBuffer>> buffers;
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		auto buffer = std::make_unique<PacketBuffer>(1500);
+		std::string data(sizes[i], static_cast<char>('a' + i));
+		buffer->append(data.data(), data.size());
+		buffers.push_back(std::move(buffer));
+	}
+
+	{
+		SocketReader reader(rx_socket, mode, available_pool);
+
+		SocketWriter writer(tx_socket, SocketWriteMode::GSO);
+		writer.write(&rx_addr, buffers);
+
+		// Read until we have all the packets
+		std::deque<std::unique_ptr<PacketBuffer>> received;
+		while (received.size() < sizes.size()) {
+			REQUIRE(reader.read(received) > 0);
+		}
+		REQUIRE(reader.getPacketCount() == sizes.size());
+
+		// Each packet must arrive as it was written and from where it was written
+		for (size_t i = 0; i < sizes.size(); ++i) {
+			REQUIRE(received[i]->getDataSize() == sizes[i]);
+			REQUIRE(std::string(received[i]->getData(), received[i]->getDataSize()) ==
+					std::string(sizes[i], static_cast<char>('a' + i)));
+			const sockaddr_in6 *src = reinterpret_cast<const sockaddr_in6 *>(&received[i]->getPacketSource());
+			REQUIRE(src->sin6_port == reinterpret_cast<const sockaddr_in6 *>(&tx_addr)->sin6_port);
+			// GRO segments are views of the super-packets received
+			REQUIRE(received[i]->isView() == (reader.getMode() == SocketReadMode::GRO));
+		}
+
+		// Only when using GRO would we read the packets with less syscalls than packets
+		if (reader.getMode() == SocketReadMode::GRO) {
+			REQUIRE(reader.getSyscallCount() < sizes.size());
+		}
+
+		// Recycle everything we read
+		for (auto &buffer : received) {
+			reader.recycle(std::move(buffer));
+		}
+	}
+
+	// All buffers taken from the available pool must have made it back
+	REQUIRE(available_pool->getBufferCount() == 300);
+
+	close(rx_socket);
+	close(tx_socket);
+}
+
+TEST_CASE("Check socket reader using recvmmsg", "[socket]") { check_socket_reader(SocketReadMode::RECVMMSG); }
+
+TEST_CASE("Check socket reader using UDP GRO", "[socket]") { check_socket_reader(SocketReadMode::GRO); }
+
+/**
+ * @brief Create a group of UDP sockets bound to the same address using SO_REUSEPORT, steered by source address.
+ *
+ * @param family Address family.
+ * @param addr Address to bind to, the port is set to the port bound.
+ * @param count Number of sockets.
+ * @return std::vector<int> Sockets, in the order they were bound.
+ */
+static std::vector<int> create_reuseport_sockets(int family, sockaddr_storage &addr, size_t count) {
+	std::vector<int> sockets;
+	socklen_t addr_len = family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+	for (size_t i = 0; i < count; ++i) {
+		int fd = socket(family, SOCK_DGRAM, 0);
+		REQUIRE(fd != -1);
+		int one = 1;
+		REQUIRE(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == 0);
+		REQUIRE(bind(fd, reinterpret_cast<sockaddr *>(&addr), addr_len) == 0);
+		// Each socket after the first binds to the port the first one got
+		getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+		sockets.push_back(fd);
+	}
+	REQUIRE(set_socket_read_steering(sockets[0], count));
+	return sockets;
+}
+
+/**
+ * @brief Send packets from a source address and check they are all received on one socket of a group.
+ *
+ * @param sockets Sockets in the group.
+ * @param dst_addr Address the group is bound to.
+ * @param src_addr Address to send from.
+ * @param expected Index of the socket the packets should be received on.
+ */
+static void check_socket_steering(const std::vector<int> &sockets, const sockaddr_storage &dst_addr, sockaddr_storage src_addr,
+								  size_t expected) {
+	socklen_t addr_len = dst_addr.ss_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+	int fd = socket(dst_addr.ss_family, SOCK_DGRAM, 0);
+	REQUIRE(fd != -1);
+	REQUIRE(bind(fd, reinterpret_cast<sockaddr *>(&src_addr), addr_len) == 0);
+
+	// Each sender gets its own port, the socket must only depend on the source address
+	for (size_t i = 0; i < 10; ++i) {
+		REQUIRE(sendto(fd, "packet", 6, 0, reinterpret_cast<const sockaddr *>(&dst_addr), addr_len) == 6);
+	}
+	close(fd);
+
+	timeval timeout{1, 0};
+	setsockopt(sockets[expected], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	char data[16];
+	for (size_t i = 0; i < 10; ++i) {
+		REQUIRE(recv(sockets[expected], data, sizeof(data), 0) == 6);
+	}
+	for (size_t i = 0; i < sockets.size(); ++i) {
+		REQUIRE(recv(sockets[i], data, sizeof(data), MSG_DONTWAIT) == -1);
+	}
+}
+
+TEST_CASE("Check IPv4 packets are steered to a socket by source address", "[socket]") {
+	sockaddr_storage addr{};
+	sockaddr_in *addr4 = reinterpret_cast<sockaddr_in *>(&addr);
+	addr4->sin_family = AF_INET;
+	addr4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	std::vector<int> sockets = create_reuseport_sockets(AF_INET, addr, 4);
+
+	// The socket is picked using the source address modulo the number of sockets
+	for (uint32_t last_octet : {2, 3, 4, 5, 9}) {
+		sockaddr_storage src_addr{};
+		sockaddr_in *src_addr4 = reinterpret_cast<sockaddr_in *>(&src_addr);
+		src_addr4->sin_family = AF_INET;
+		src_addr4->sin_addr.s_addr = htonl(0x7F000000 | last_octet);
+		check_socket_steering(sockets, addr, src_addr, (0x7F000000 | last_octet) % sockets.size());
+	}
+
+	for (int fd : sockets) {
+		close(fd);
+	}
+}
+
+TEST_CASE("Check IPv6 packets are steered to a socket by source address", "[socket]") {
+	sockaddr_storage addr{};
+	sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+	addr6->sin6_family = AF_INET6;
+	addr6->sin6_addr = in6addr_loopback;
+	std::vector<int> sockets = create_reuseport_sockets(AF_INET6, addr, 2);
+
+	// The words of ::1 XOR'd together give 1
+	sockaddr_storage src_addr = addr;
+	reinterpret_cast<sockaddr_in6 *>(&src_addr)->sin6_port = 0;
+	check_socket_steering(sockets, addr, src_addr, 1);
+
+	for (int fd : sockets) {
+		close(fd);
+	}
+}
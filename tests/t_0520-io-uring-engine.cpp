@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "io_uring_engine.hpp"
+#include "libtests/framework.hpp"
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TEST_CASE("Check io_uring engine reads and writes", "[io_uring]") {
+	if (!IOUringEngine::isSupported()) {
+		SKIP("io_uring is not supported");
+	}
+
+	int pipe_fds[2];
+	REQUIRE(pipe(pipe_fds) == 0);
+
+	// Buffers come from an arena so they are read and written using fixed buffers
+	auto pool = std::make_shared<accl::BufferPool<PacketBuffer>>(1500, 10, 10, accl::BufferPoolAllocation::ARENA);
+	IOUringEngine engine(8, {pipe_fds[0], pipe_fds[1]}, {pool->getArena()});
+	REQUIRE(engine.hasFixedFiles());
+
+	const std::string test_string = "hello world";
+	auto buffer = pool->pop();
+	buffer->append(test_string.c_str(), test_string.length());
+
+	std::deque<IOUringCompletion> completions;
+
+	// Nothing is submitted until we ask for it
+	engine.write(1, std::move(buffer));
+	REQUIRE(engine.getInflightCount() == 1);
+	REQUIRE(engine.getSyscallCount() == 0);
+
+	while (engine.getInflightCount()) {
+		engine.submitAndWait(completions);
+	}
+	REQUIRE(completions.size() == 1);
+	REQUIRE(completions[0].op == IOUringOp::WRITE);
+	REQUIRE(completions[0].file == 1);
+	REQUIRE(completions[0].result == static_cast<int>(test_string.length()));
+	pool->push(std::move(completions[0].buffer));
+	completions.clear();
+
+	engine.read(0, pool->pop());
+	while (engine.getInflightCount()) {
+		engine.submitAndWait(completions);
+	}
+	REQUIRE(completions.size() == 1);
+	REQUIRE(completions[0].op == IOUringOp::READ);
+	REQUIRE(completions[0].result == static_cast<int>(test_string.length()));
+	REQUIRE(std::string(completions[0].buffer->getData(), completions[0].buffer->getDataSize()) == test_string);
+	pool->push(std::move(completions[0].buffer));
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+}
+
+TEST_CASE("Check io_uring engine receives datagrams", "[io_uring]") {
+	if (!IOUringEngine::isSupported()) {
+		SKIP("io_uring is not supported");
+	}
+
+	// Bind receiving and sending sockets to the IPv6 loopback address
+	sockaddr_storage rx_addr, tx_addr;
+	int sockets[2];
+	for (auto [fd, addr] : {std::pair{&sockets[0], &rx_addr}, std::pair{&sockets[1], &tx_addr}}) {
+		*fd = socket(AF_INET6, SOCK_DGRAM, 0);
+		REQUIRE(*fd != -1);
+		std::memset(addr, 0, sizeof(*addr));
+		sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(addr);
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_addr = in6addr_loopback;
+		REQUIRE(bind(*fd, reinterpret_cast<sockaddr *>(addr), sizeof(sockaddr_in6)) == 0);
+		socklen_t addr_len = sizeof(sockaddr_in6);
+		getsockname(*fd, reinterpret_cast<sockaddr *>(addr), &addr_len);
+	}
+
+	// Buffers not in a registered arena are also supported
+	auto pool = std::make_shared<accl::BufferPool<PacketBuffer>>(1500, 10);
+	IOUringEngine engine(8, {sockets[0]}, {});
+	REQUIRE_FALSE(engine.hasFixedBuffers());
+
+	// Keep a few receives in flight
+	for (size_t i = 0; i < 4; ++i) {
+		engine.recvmsg(0, pool->pop());
+	}
+
+	std::vector<std::string> packets{"first", "second packet", "third"};
+	for (auto &packet : packets) {
+		REQUIRE(sendto(sockets[1], packet.data(), packet.size(), 0, reinterpret_cast<sockaddr *>(&rx_addr),
+					   sizeof(sockaddr_in6)) == static_cast<ssize_t>(packet.size()));
+	}
+
+	std::deque<IOUringCompletion> completions;
+	while (completions.size() < packets.size()) {
+		engine.submitAndWait(completions);
+	}
+	for (size_t i = 0; i < packets.size(); ++i) {
+		REQUIRE(completions[i].op == IOUringOp::RECVMSG);
+		REQUIRE(std::string(completions[i].buffer->getData(), completions[i].buffer->getDataSize()) == packets[i]);
+		const sockaddr_in6 *src = reinterpret_cast<const sockaddr_in6 *>(&completions[i].buffer->getPacketSource());
+		REQUIRE(src->sin6_port == reinterpret_cast<const sockaddr_in6 *>(&tx_addr)->sin6_port);
+		pool->push(std::move(completions[i].buffer));
+	}
+	REQUIRE(engine.getInflightCount() == 1);
+
+	close(sockets[0]);
+	close(sockets[1]);
+}
@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "control_socket.hpp"
+#include "exceptions.hpp"
+#include "libtests/framework.hpp"
+#include <cstring>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @brief Connect to a control socket.
+ *
+ * @param path Path of the control socket.
+ * @return int Client socket.
+ */
+static int connect_control_socket(const std::string &path) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	REQUIRE(fd != -1);
+
+	timeval timeout{2, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::memcpy(addr.sun_path, path.data(), path.length());
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+
+	return fd;
+}
+
+/**
+ * @brief Send a command and read back the reply.
+ *
+ * @param fd Client socket.
+ * @param command Command, including the trailing newline.
+ * @return std::string Reply, without the trailing newline.
+ */
+static std::string send_command(int fd, const std::string &command) {
+	REQUIRE(send(fd, command.data(), command.size(), 0) == static_cast<ssize_t>(command.size()));
+
+	std::string reply;
+	char c;
+	while (recv(fd, &c, 1, 0) == 1 && c != '\n') {
+		reply.push_back(c);
+	}
+	return reply;
+}
+
+TEST_CASE("Check control socket commands", "[control_socket]") {
+	std::string path = "/tmp/seth-test-control-" + std::to_string(getpid()) + ".sock";
+
+	std::vector<std::vector<std::string>> commands;
+	ControlSocket control_socket(path, [&commands](const std::vector<std::string> &args) {
+		commands.push_back(args);
+		return args[0] == "ping" ? std::string("OK") : std::string("ERROR: Unknown command");
+	});
+	control_socket.start();
+
+	// Only root may talk to the socket
+	struct stat path_stat;
+	REQUIRE(stat(path.c_str(), &path_stat) == 0);
+	REQUIRE(S_ISSOCK(path_stat.st_mode));
+	REQUIRE((path_stat.st_mode & 0777) == 0600);
+
+	int fd = connect_control_socket(path);
+	REQUIRE(send_command(fd, "ping\n") == "OK");
+	REQUIRE(send_command(fd, "  compression \t all  zstd 5\r\n") == "ERROR: Unknown command");
+	// Empty lines are ignored, commands split over multiple sends are put back together
+	REQUIRE(send(fd, "\n\npi", 4, 0) == 4);
+	REQUIRE(send_command(fd, "ng\n") == "OK");
+	// Commands which are too long get the client disconnected
+	REQUIRE(send_command(fd, std::string(2000, 'x')) == "ERROR: Command too long");
+	close(fd);
+
+	REQUIRE(commands.size() == 3);
+	REQUIRE(commands[1] == std::vector<std::string>{"compression", "all", "zstd", "5"});
+
+	// The next client is served once the previous one is gone
+	fd = connect_control_socket(path);
+	REQUIRE(send_command(fd, "ping\n") == "OK");
+	close(fd);
+
+	control_socket.stop();
+	control_socket.wait();
+}
+
+TEST_CASE("Check control socket path handling", "[control_socket]") {
+	std::string path = "/tmp/seth-test-control-" + std::to_string(getpid()) + ".sock";
+
+	// A stale socket is replaced and the socket is removed once we're done with it
+	{
+		ControlSocket stale_socket(path, [](const std::vector<std::string> &) { return std::string("OK"); });
+	}
+	REQUIRE(access(path.c_str(), F_OK) != 0);
+	{
+		ControlSocket stale_socket(path, [](const std::vector<std::string> &) { return std::string("OK"); });
+		ControlSocket control_socket(path, [](const std::vector<std::string> &) { return std::string("OK"); });
+		REQUIRE(control_socket.getPath() == path);
+	}
+
+	// Anything else at the path is left alone
+	std::ofstream(path) << "not a socket";
+	REQUIRE_THROWS_AS(ControlSocket(path, [](const std::vector<std::string> &) { return std::string("OK"); }),
+					  SuperEthernetTunnelRuntimeException);
+	unlink(path.c_str());
+
+	REQUIRE_THROWS_AS(ControlSocket(std::string(200, 'x'), [](const std::vector<std::string> &) { return std::string("OK"); }),
+					  SuperEthernetTunnelRuntimeException);
+}
\ No newline at end of file
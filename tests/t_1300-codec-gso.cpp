@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "debug.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libaccl/logger.hpp"
+#include "libsethnetkit/ethernet_packet.hpp"
+#include "libtests/framework.hpp"
+#include "packet_switch.hpp"
+
+TEST_CASE("Check encoding of a GSO frame with a virtio-net header", "[codec]") {
+
+	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> dst_mac = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> src_mac = {0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+	std::array<uint8_t, SETH_PACKET_IPV4_IP_LEN> dst_ip = {192, 168, 10, 1};
+	std::array<uint8_t, SETH_PACKET_IPV4_IP_LEN> src_ip = {172, 16, 101, 102};
+	accl::SequenceDataGenerator payloadSeq = accl::SequenceDataGenerator(60000);
+
+	std::vector<uint8_t> payloadBytes = payloadSeq.asBytes();
+
+	UDPv4Packet packet;
+
+	packet.setDstMac(dst_mac);
+	packet.setSrcMac(src_mac);
+	packet.setDstAddr(dst_ip);
+	packet.setSrcAddr(src_ip);
+
+	packet.setSrcPort(12345);
+	packet.setDstPort(54321);
+
+	packet.addPayload(payloadBytes);
+
+	// Build the frame as we'd get it from the TAP interface, with a virtio-net header in front of it
+	virtio_net_header_t vnet_header{};
+	vnet_header.flags = 1;	  // VIRTIO_NET_HDR_F_NEEDS_CSUM
+	vnet_header.gso_type = 5; // VIRTIO_NET_HDR_GSO_UDP_L4
+	vnet_header.hdr_len = 14 + 20 + 8;
+	vnet_header.gso_size = 1400;
+	vnet_header.csum_start = 14 + 20;
+	vnet_header.csum_offset = 6;
+
+	std::string frame_bin(reinterpret_cast<const char *>(&vnet_header), sizeof(vnet_header));
+	frame_bin += packet.asBinary();
+
+	/*
+	 * Test encoding
+	 */
+
+	// Lets fire up the encoder, with TAP offloads our frames can be up to the maximum packet size
+	uint16_t max_frame_size = SETH_PACKET_MAX_SIZE;
+	uint16_t l4mtu = 1500 - 20 - 8; // IPv6 is 40
+	size_t buffer_size = max_frame_size + (max_frame_size / 10);
+	std::shared_ptr<accl::BufferPool<PacketBuffer>> avail_buffer_pool =
+		std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, 100);
+	std::shared_ptr<accl::BufferPool<PacketBuffer>> enc_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size);
+
+	std::unique_ptr<PacketBuffer> packet_buffer = std::make_unique<PacketBuffer>(buffer_size);
+	packet_buffer->append(frame_bin.data(), frame_bin.length());
+
+	PacketEncoder encoder(max_frame_size, l4mtu, enc_buffer_pool, avail_buffer_pool);
+	encoder.encode(std::move(packet_buffer));
+	encoder.flush();
+
+	// The frame should be split over as many packets as needed to fit it
+	size_t payload_size = l4mtu - sizeof(PacketHeader) - sizeof(PacketHeaderOption);
+	size_t enc_count = enc_buffer_pool->getBufferCount();
+	REQUIRE(enc_count == (frame_bin.length() + payload_size - 1) / payload_size);
+
+	/*
+	 * Test decoding
+	 */
+
+	// Decode into two pools, the same as we would have with two TAP queues
+	std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> dec_buffer_pools = {
+		std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size), std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size)};
+
+	PacketDecoder decoder(max_frame_size, dec_buffer_pools, avail_buffer_pool);
+	decoder.setFrameHeaderSize(sizeof(virtio_net_header_t));
+	for (size_t i = 0; i < enc_count; ++i) {
+		decoder.decode(enc_buffer_pool->pop());
+	}
+
+	// Work out which pool the frame should have ended up in using its flow
+	std::string packet_bin = packet.asBinary();
+	size_t pool = get_ethernet_flow_hash(packet_bin.data(), packet_bin.size()) % dec_buffer_pools.size();
+
+	// Our decoded buffer pool for the flow should now have 1 packet in it
+	REQUIRE(dec_buffer_pools[pool]->getBufferCount() == 1);
+	REQUIRE(dec_buffer_pools[pool ^ 1]->getBufferCount() == 0);
+
+	// Grab buffer from the decoded buffer pool
+	auto dec_buffer = dec_buffer_pools[pool]->pop();
+
+	// Now lets convert the buffer into a std::string and compare them, the virtio-net header must be intact
+	std::string buffer_string(reinterpret_cast<const char *>(dec_buffer->getData()), dec_buffer->getDataSize());
+	REQUIRE(buffer_string == frame_bin);
+}
@@ -0,0 +1,213 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "debug.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "flood_encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libaccl/logger.hpp"
+#include "libsethnetkit/ethernet_packet.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+
+/**
+ * @brief Releaser of a shared frame which records when the frame was released, the frame is pushed back into its pool.
+ *
+ */
+struct FrameReleaser : public accl::BufferReleaser {
+		FrameReleaser(std::shared_ptr<accl::BufferPool<PacketBuffer>> pool) : pool(pool), released(false) {}
+
+		void releaseBuffer(accl::Buffer *buffer) override {
+			released = true;
+			pool->releaseBuffer(buffer);
+		}
+
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> pool;
+		bool released;
+};
+
+/**
+ * @brief Encode a frame shared by multiple encoders and check each of them encoded it.
+ *
+ * @param format Packet format the encoders use.
+ */
+static void test_shared_frame(PacketHeaderOptionFormatType format) {
+
+	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> dst_mac = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+	std::array<uint8_t, SETH_PACKET_ETHERNET_MAC_LEN> src_mac = {0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+	std::array<uint8_t, SETH_PACKET_IPV4_IP_LEN> dst_ip = {255, 255, 255, 255};
+	std::array<uint8_t, SETH_PACKET_IPV4_IP_LEN> src_ip = {172, 16, 101, 102};
+	accl::SequenceDataGenerator payloadSeq = accl::SequenceDataGenerator(100);
+
+	std::vector<uint8_t> payloadBytes = payloadSeq.asBytes();
+
+	UDPv4Packet packet;
+
+	packet.setDstMac(dst_mac);
+	packet.setSrcMac(src_mac);
+	packet.setDstAddr(dst_ip);
+	packet.setSrcAddr(src_ip);
+
+	packet.setSrcPort(12345);
+	packet.setDstPort(54321);
+
+	packet.addPayload(payloadBytes);
+
+	std::string packet_bin = packet.asBinary();
+
+	/*
+	 * Test encoding
+	 */
+
+	uint16_t l2mtu = get_l2mtu_from_mtu(1500);
+	uint16_t l4mtu = 1500 - 20 - 8; // IPv6 is 40
+	uint16_t buffer_size = l2mtu + (l2mtu / 10);
+	const size_t pool_size = 16;
+	std::shared_ptr<accl::BufferPool<PacketBuffer>> avail_buffer_pool =
+		std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size, pool_size);
+
+	// Share the frame the same way the packet switch does when flooding it to multiple remote nodes
+	std::unique_ptr<PacketBuffer> packet_buffer = avail_buffer_pool->pop();
+	packet_buffer->append(packet_bin.data(), packet_bin.length());
+	auto releaser = std::make_shared<FrameReleaser>(avail_buffer_pool);
+	PacketBuffer *frame = packet_buffer.release();
+	frame->share(releaser);
+
+	const size_t encoder_count = 3;
+	std::vector<std::shared_ptr<accl::BufferPool<PacketBuffer>>> enc_buffer_pools;
+	std::vector<std::unique_ptr<PacketEncoder>> encoders;
+	for (size_t i = 0; i < encoder_count; ++i) {
+		enc_buffer_pools.push_back(std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size));
+		encoders.push_back(std::make_unique<PacketEncoder>(l2mtu, l4mtu, enc_buffer_pools[i], avail_buffer_pool));
+		encoders[i]->setPacketFormat(format);
+		encoders[i]->encode(std::make_unique<PacketBuffer>(frame, 0, packet_bin.length()));
+	}
+	frame->unshare();
+
+	// Compressed frames are held by the encoders until they flush, the frame must only go back into the pool once the last
+	// encoder is done with it
+	for (size_t i = 0; i < encoder_count; ++i) {
+		if (format != PacketHeaderOptionFormatType::NONE) {
+			REQUIRE_FALSE(releaser->released);
+		}
+		encoders[i]->flush();
+		REQUIRE(enc_buffer_pools[i]->getBufferCount() == 1);
+	}
+	REQUIRE(releaser->released);
+
+	/*
+	 * Test decoding
+	 */
+
+	for (size_t i = 0; i < encoder_count; ++i) {
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> dec_buffer_pool =
+			std::make_shared<accl::BufferPool<PacketBuffer>>(buffer_size);
+
+		PacketDecoder decoder(l2mtu, dec_buffer_pool, avail_buffer_pool);
+		decoder.decode(enc_buffer_pools[i]->pop());
+
+		REQUIRE(dec_buffer_pool->getBufferCount() == 1);
+
+		// Each encoder must have encoded the whole frame
+		auto dec_buffer = dec_buffer_pool->pop();
+		std::string buffer_string(reinterpret_cast<const char *>(dec_buffer->getData()), dec_buffer->getDataSize());
+		REQUIRE(buffer_string == packet_bin);
+	}
+
+	// None of the views may have ended up in the available pool
+	std::deque<std::unique_ptr<PacketBuffer>> buffers = avail_buffer_pool->pop(pool_size);
+	REQUIRE_FALSE(buffers.empty());
+	for (auto &buffer : buffers) {
+		REQUIRE_FALSE(buffer->isView());
+		REQUIRE(buffer->getBufferSize() == buffer_size);
+	}
+}
+
+TEST_CASE("Check encoding a frame shared by multiple encoders", "[codec]") {
+	test_shared_frame(PacketHeaderOptionFormatType::NONE);
+}
+
+TEST_CASE("Check encoding a frame shared by multiple encoders with LZ4 compression", "[codec]") {
+	// With compression the encoders hold onto the frame until they flush
+	test_shared_frame(PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+}
+
+/**
+ * @brief Decode a flood packet in the middle of a frame split over two packets and check both frames are decoded.
+ *
+ * @param format Packet format the flood encoder uses.
+ */
+static void test_flood_packet(PacketHeaderOptionFormatType format) {
+	uint16_t l4mtu = 1000;
+	CodecTest codec(16, l4mtu);
+
+	/*
+	 * Test encoding
+	 */
+
+	// Encode a frame which is split over two packets using the normal encoder
+	std::string split_frame = build_udp_frame(12345, 1400);
+	std::unique_ptr<PacketBuffer> packet_buffer = codec.avail_buffer_pool->pop();
+	packet_buffer->append(split_frame.data(), split_frame.length());
+
+	codec.encoder.encode(std::move(packet_buffer));
+	codec.encoder.flush();
+	REQUIRE(codec.enc_buffer_pool->getBufferCount() == 2);
+
+	// Encode a small frame into a flood packet
+	std::string flood_frame = build_udp_frame(12345, 100);
+	PacketBuffer frame_buffer(codec.buffer_size);
+	frame_buffer.append(flood_frame.data(), flood_frame.length());
+
+	FloodEncoder flood_encoder(l4mtu, format);
+	auto flood_packet = codec.avail_buffer_pool->pop();
+	REQUIRE(flood_encoder.encode(frame_buffer, *flood_packet));
+	REQUIRE(flood_packet->getDataSize() <= l4mtu);
+	PacketHeader *packet_header = reinterpret_cast<PacketHeader *>(flood_packet->getData());
+	REQUIRE(packet_header->format == PacketHeaderFormat::ENCAPSULATED_FLOOD);
+	// Our payload compresses, so the frame should have been compressed
+	PacketHeaderOption *packet_header_option =
+		reinterpret_cast<PacketHeaderOption *>(flood_packet->getData() + sizeof(PacketHeader));
+	REQUIRE(packet_header_option->format == format);
+
+	// Frames which don't fit into a single flood packet are left for the remote nodes to encode
+	PacketBuffer big_frame_buffer(codec.buffer_size);
+	big_frame_buffer.append(split_frame.data(), split_frame.length());
+	FloodEncoder uncompressed_flood_encoder(l4mtu, PacketHeaderOptionFormatType::NONE);
+	REQUIRE_FALSE(uncompressed_flood_encoder.encode(big_frame_buffer, *codec.avail_buffer_pool->pop()));
+
+	/*
+	 * Test decoding
+	 */
+
+	// The flood packet arrives between the two parts of the split frame, this must not disturb the split frame
+	codec.decoder.decode(codec.enc_buffer_pool->pop());
+	codec.decoder.decode(std::move(flood_packet));
+	codec.decoder.decode(codec.enc_buffer_pool->pop());
+
+	REQUIRE(codec.dec_buffer_pool->getBufferCount() == 2);
+
+	auto dec_buffer = codec.dec_buffer_pool->pop();
+	REQUIRE(std::string(dec_buffer->getData(), dec_buffer->getDataSize()) == flood_frame);
+	dec_buffer = codec.dec_buffer_pool->pop();
+	REQUIRE(std::string(dec_buffer->getData(), dec_buffer->getDataSize()) == split_frame);
+
+	// Flood packets are not part of the packet sequence
+	REQUIRE(codec.decoder.getLastSequence() == 2);
+}
+
+TEST_CASE("Check decoding a flood packet", "[codec]") { test_flood_packet(PacketHeaderOptionFormatType::NONE); }
+
+TEST_CASE("Check decoding a flood packet with LZ4 compression", "[codec]") {
+	test_flood_packet(PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+}
+
+TEST_CASE("Check decoding a flood packet with ZSTD compression", "[codec]") {
+	test_flood_packet(PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+}
@@ -0,0 +1,164 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "common.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+#include "util.hpp"
+#include <random>
+
+/**
+ * @brief Generate random bytes, these don't compress.
+ *
+ * @param size Number of bytes.
+ * @return std::vector<uint8_t> Random bytes.
+ */
+static std::vector<uint8_t> random_bytes(size_t size) {
+	std::mt19937 generator(size);
+	std::uniform_int_distribution<int> distribution(0, 255);
+	std::vector<uint8_t> bytes(size);
+	for (auto &byte : bytes) {
+		byte = static_cast<uint8_t>(distribution(generator));
+	}
+	return bytes;
+}
+
+/**
+ * @brief Encoder and decoder pair, each frame is encoded, flushed and decoded.
+ *
+ */
+struct CodecPair : CodecTest {
+		CodecPair(PacketHeaderOptionFormatType format, bool adaptive) : CodecTest(16) {
+			encoder.setPacketFormat(format);
+			encoder.setAdaptiveCompression(adaptive);
+		}
+
+		/**
+		 * @brief Encode and decode a frame, checking the decoded frame matches.
+		 *
+		 * @param frame Frame to send.
+		 * @return PacketHeaderOptionFormatType Format the frame was encoded with.
+		 */
+		PacketHeaderOptionFormatType send(const std::string &frame) {
+			auto buffer = avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			encoder.encode(std::move(buffer));
+			encoder.flush();
+			REQUIRE(enc_buffer_pool->getBufferCount() == 1);
+
+			auto packet = enc_buffer_pool->pop();
+			PacketHeaderOption *packet_header_option =
+				reinterpret_cast<PacketHeaderOption *>(packet->getData() + sizeof(PacketHeader));
+			PacketHeaderOptionFormatType format = packet_header_option->format;
+
+			decoder.decode(std::move(packet));
+			REQUIRE(dec_buffer_pool->getBufferCount() == 1);
+			auto dec_buffer = dec_buffer_pool->pop();
+			REQUIRE(std::string(dec_buffer->getData(), dec_buffer->getDataSize()) == frame);
+			dec_buffer->clear();
+			avail_buffer_pool->push(std::move(dec_buffer));
+
+			return format;
+		}
+};
+
+TEST_CASE("Check byte entropy estimate", "[codec]") {
+	std::string zeros(256, '\0');
+	REQUIRE(get_byte_entropy(zeros.data(), zeros.size()) == 0);
+
+	// Every byte value once is exactly 8 bits per byte
+	std::string all_bytes;
+	for (int i = 0; i < 256; ++i) {
+		all_bytes.push_back(static_cast<char>(i));
+	}
+	REQUIRE(get_byte_entropy(all_bytes.data(), all_bytes.size()) == Catch::Approx(8.0f));
+
+	// Two byte values evenly spread is 1 bit per byte
+	std::string two_bytes;
+	for (int i = 0; i < 128; ++i) {
+		two_bytes.append("ab");
+	}
+	REQUIRE(get_byte_entropy(two_bytes.data(), two_bytes.size()) == Catch::Approx(1.0f));
+
+	std::vector<uint8_t> random = random_bytes(256);
+	REQUIRE(get_byte_entropy(reinterpret_cast<const char *>(random.data()), random.size()) >= SETH_COMPRESSION_ENTROPY_THRESHOLD);
+
+	REQUIRE(get_byte_entropy(zeros.data(), 0) == 0);
+}
+
+/**
+ * @brief Check random frames are sent uncompressed while a compressible flow is still compressed.
+ *
+ * @param format Packet format.
+ */
+static void test_entropy_bypass(PacketHeaderOptionFormatType format) {
+	CodecPair codec(format, true);
+	const PacketEncoderCompressionStats &stats = codec.encoder.getCompressionStats();
+
+	std::string random_frame = build_udp_frame(1000, random_bytes(1000));
+	std::string sequence_frame = build_udp_frame(2000, 1000);
+
+	for (int i = 0; i < 10; ++i) {
+		REQUIRE(codec.send(random_frame) == PacketHeaderOptionFormatType::NONE);
+		REQUIRE(codec.send(sequence_frame) == format);
+	}
+
+	REQUIRE(stats.compressed_frames == 10);
+	REQUIRE(stats.compressed_bytes == 10 * sequence_frame.length());
+	REQUIRE(stats.compressed_wire_bytes < stats.compressed_bytes);
+	REQUIRE(stats.bypassed_frames == 10);
+	REQUIRE(stats.bypassed_bytes == 10 * random_frame.length());
+}
+
+TEST_CASE("Check adaptive compression skips random frames with LZ4 compression", "[codec]") {
+	test_entropy_bypass(PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+}
+
+TEST_CASE("Check adaptive compression skips random frames with ZSTD compression", "[codec]") {
+	test_entropy_bypass(PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+}
+
+TEST_CASE("Check adaptive compression probes flows which did not compress again", "[codec]") {
+	CodecPair codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4, true);
+	const PacketEncoderCompressionStats &stats = codec.encoder.getCompressionStats();
+
+	// Small frames are too small to sample, so they're only bypassed once compressing them didn't help
+	std::string frame = build_udp_frame(1000, random_bytes(80));
+
+	// The first frame is compressed and is in the compression stream, so it must be sent compressed
+	REQUIRE(codec.send(frame) == PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+	for (size_t i = 0; i < SETH_COMPRESSION_BYPASS_FRAMES; ++i) {
+		REQUIRE(codec.send(frame) == PacketHeaderOptionFormatType::NONE);
+	}
+	// Then the flow is probed again
+	REQUIRE(codec.send(frame) == PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+	REQUIRE(codec.send(frame) == PacketHeaderOptionFormatType::NONE);
+
+	REQUIRE(stats.compressed_frames == 2);
+	REQUIRE(stats.bypassed_frames == SETH_COMPRESSION_BYPASS_FRAMES + 1);
+	// The frames grew when compressed, so sending them uncompressed saved bytes
+	REQUIRE(stats.compressed_wire_bytes > stats.compressed_bytes);
+	REQUIRE(stats.bypass_wire_delta < 0);
+}
+
+TEST_CASE("Check frames are always compressed without adaptive compression", "[codec]") {
+	CodecPair codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4, false);
+	const PacketEncoderCompressionStats &stats = codec.encoder.getCompressionStats();
+
+	std::string random_frame = build_udp_frame(1000, random_bytes(1000));
+	for (int i = 0; i < 10; ++i) {
+		REQUIRE(codec.send(random_frame) == PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+	}
+
+	REQUIRE(stats.compressed_frames == 10);
+	REQUIRE(stats.bypassed_frames == 0);
+}
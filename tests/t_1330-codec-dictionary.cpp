@@ -0,0 +1,219 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "compression_dictionary.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "exceptions.hpp"
+#include "flood_encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+#include <format>
+#include <random>
+
+/**
+ * @brief Build a UDP frame carrying a HTTP request, these look alike but differ slightly from one another.
+ *
+ * @param seed Seed used to vary the request.
+ * @return std::string Frame.
+ */
+static std::string build_frame(uint32_t seed) {
+	static const std::vector<std::string> paths = {"/", "/index.html", "/images/logo.png", "/api/v1/status", "/login"};
+	static const std::vector<std::string> agents = {"Mozilla/5.0 (X11; Linux x86_64)", "curl/8.5.0", "Wget/1.21.4"};
+
+	std::mt19937 generator(seed);
+	std::string request = std::format("GET {}?id={} HTTP/1.1\r\nHost: www{}.example.com\r\nUser-Agent: {}\r\n"
+									  "Accept: */*\r\nAccept-Encoding: gzip, deflate\r\nConnection: keep-alive\r\n\r\n",
+									  paths[generator() % paths.size()], generator() % 100000, generator() % 10,
+									  agents[generator() % agents.size()]);
+
+	return build_udp_frame(static_cast<uint16_t>(10000 + seed % 1000), std::vector<uint8_t>(request.begin(), request.end()), 80);
+}
+
+/**
+ * @brief Train a small dictionary on sample frames.
+ *
+ * @return std::shared_ptr<const std::string> Dictionary.
+ */
+static std::shared_ptr<const std::string> train_dictionary() {
+	std::vector<std::string> samples;
+	for (uint32_t i = 0; i < 2000; ++i) {
+		samples.push_back(build_frame(i));
+	}
+	return std::make_shared<const std::string>(train_compression_dictionary(samples, 4096));
+}
+
+/**
+ * @brief Encoder and decoder pair, each frame is encoded and flushed into its own packet.
+ *
+ */
+struct CodecPair : CodecTest {
+		CodecPair(PacketHeaderOptionFormatType format, std::shared_ptr<const std::string> enc_dictionary,
+				  std::shared_ptr<const std::string> dec_dictionary) : CodecTest(16) {
+			encoder.setAdaptiveCompression(false);
+			encoder.setCompressionDictionary(enc_dictionary);
+			encoder.setPacketFormat(format);
+			decoder.setCompressionDictionary(dec_dictionary);
+		}
+
+		/**
+		 * @brief Encode a frame into a packet.
+		 *
+		 * @param frame Frame to encode.
+		 * @return std::unique_ptr<PacketBuffer> Encoded packet.
+		 */
+		std::unique_ptr<PacketBuffer> encode(const std::string &frame) {
+			auto buffer = avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			encoder.encode(std::move(buffer));
+			encoder.flush();
+			REQUIRE(enc_buffer_pool->getBufferCount() == 1);
+			return enc_buffer_pool->pop();
+		}
+
+		/**
+		 * @brief Decode a packet and check if it decoded to the frame.
+		 *
+		 * @param packet Packet to decode.
+		 * @param frame Frame the packet should decode to.
+		 * @return true If the frame was decoded, false if the packet was dropped.
+		 */
+		bool decode(std::unique_ptr<PacketBuffer> packet, const std::string &frame) {
+			decoder.decode(std::move(packet));
+			if (dec_buffer_pool->getBufferCount() == 0) {
+				return false;
+			}
+			REQUIRE(dec_buffer_pool->getBufferCount() == 1);
+			auto dec_buffer = dec_buffer_pool->pop();
+			REQUIRE(std::string(dec_buffer->getData(), dec_buffer->getDataSize()) == frame);
+			dec_buffer->clear();
+			avail_buffer_pool->push(std::move(dec_buffer));
+			return true;
+		}
+};
+
+/**
+ * @brief Get the packet header option of an encoded packet.
+ *
+ * @param packet Encoded packet.
+ * @return PacketHeaderOption* Packet header option.
+ */
+static PacketHeaderOption *get_packet_header_option(PacketBuffer &packet) {
+	return reinterpret_cast<PacketHeaderOption *>(packet.getData() + sizeof(PacketHeader));
+}
+
+TEST_CASE("Check training a compression dictionary", "[codec]") {
+	std::shared_ptr<const std::string> dictionary = train_dictionary();
+
+	REQUIRE_FALSE(dictionary->empty());
+	REQUIRE(dictionary->size() <= 4096);
+	REQUIRE(get_compression_dictionary_id(*dictionary) != 0);
+	REQUIRE(get_compression_dictionary_id("") == 0);
+	REQUIRE(get_compression_dictionary_hash(*dictionary) == get_compression_dictionary_hash(std::string(*dictionary)));
+	REQUIRE(get_compression_dictionary_hash(*dictionary) != get_compression_dictionary_hash(dictionary->substr(1)));
+
+	// There is nothing to learn from a handful of samples
+	REQUIRE_THROWS_AS(train_compression_dictionary({"a", "b"}, 4096), SuperEthernetTunnelRuntimeException);
+}
+
+/**
+ * @brief Check frames compressed with a dictionary are smaller and decode with the same dictionary.
+ *
+ * @param format Packet format.
+ */
+static void test_dictionary(PacketHeaderOptionFormatType format) {
+	std::shared_ptr<const std::string> dictionary = train_dictionary();
+	uint8_t dictionary_id = get_compression_dictionary_id(*dictionary);
+
+	CodecPair codec(format, dictionary, dictionary);
+	CodecPair plain_codec(format, nullptr, nullptr);
+	REQUIRE(codec.encoder.getCompressionDictionaryID() == dictionary_id);
+	REQUIRE(plain_codec.encoder.getCompressionDictionaryID() == 0);
+
+	// Each frame is in a packet of its own, so the stream is reset for each of them and the dictionary is all there is to go on
+	for (uint32_t i = 5000; i < 5010; ++i) {
+		std::string frame = build_frame(i);
+
+		auto packet = codec.encode(frame);
+		REQUIRE(get_packet_header_option(*packet)->format == format);
+		REQUIRE(get_packet_header_option(*packet)->dictionary == dictionary_id);
+
+		auto plain_packet = plain_codec.encode(frame);
+		REQUIRE(get_packet_header_option(*plain_packet)->dictionary == 0);
+		REQUIRE(packet->getDataSize() < plain_packet->getDataSize());
+
+		REQUIRE(codec.decode(std::move(packet), frame));
+		REQUIRE(plain_codec.decode(std::move(plain_packet), frame));
+	}
+}
+
+TEST_CASE("Check encoding with a LZ4 compression dictionary", "[codec]") {
+	test_dictionary(PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+}
+
+TEST_CASE("Check encoding with a ZSTD compression dictionary", "[codec]") {
+	test_dictionary(PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+}
+
+TEST_CASE("Check decoding with a mismatched compression dictionary", "[codec]") {
+	std::shared_ptr<const std::string> dictionary = train_dictionary();
+
+	// Packets compressed with a dictionary we don't have are dropped
+	CodecPair codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4, dictionary, nullptr);
+	std::string frame = build_frame(1);
+	REQUIRE_FALSE(codec.decode(codec.encode(frame), frame));
+
+	// A decoder with a dictionary still decodes packets from encoders without one, switching back when needed
+	CodecPair mixed_codec(PacketHeaderOptionFormatType::COMPRESSED_ZSTD, nullptr, dictionary);
+	for (uint32_t i = 0; i < 4; ++i) {
+		mixed_codec.encoder.setCompressionDictionary(i % 2 ? dictionary : nullptr);
+		frame = build_frame(i);
+		REQUIRE(mixed_codec.decode(mixed_codec.encode(frame), frame));
+	}
+}
+
+TEST_CASE("Check encoding with a configured compression dictionary ID", "[codec]") {
+	std::shared_ptr<const std::string> dictionary = train_dictionary();
+	// Pick an ID that differs from the one derived from the dictionary
+	uint8_t dictionary_id = get_compression_dictionary_id(*dictionary) % 255 + 1;
+
+	CodecPair codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4, nullptr, nullptr);
+	codec.encoder.setCompressionDictionary(dictionary, dictionary_id);
+	codec.decoder.setCompressionDictionary(dictionary, dictionary_id);
+	REQUIRE(codec.encoder.getCompressionDictionaryID() == dictionary_id);
+
+	std::string frame = build_frame(1);
+	auto packet = codec.encode(frame);
+	REQUIRE(get_packet_header_option(*packet)->dictionary == dictionary_id);
+	REQUIRE(codec.decode(std::move(packet), frame));
+
+	// A decoder using the derived ID does not know the configured one and drops the packet
+	codec.decoder.setCompressionDictionary(dictionary);
+	REQUIRE_FALSE(codec.decode(codec.encode(frame), frame));
+}
+
+TEST_CASE("Check decoding a flood packet compressed with a dictionary", "[codec]") {
+	std::shared_ptr<const std::string> dictionary = train_dictionary();
+	uint8_t dictionary_id = get_compression_dictionary_id(*dictionary);
+
+	CodecPair codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4, dictionary, dictionary);
+	FloodEncoder flood_encoder(1500 - 20 - 8, PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+	flood_encoder.setCompressionDictionary(dictionary);
+
+	std::string frame = build_frame(1);
+	PacketBuffer frame_buffer(codec.buffer_size);
+	frame_buffer.append(frame.data(), frame.length());
+
+	auto flood_packet = codec.avail_buffer_pool->pop();
+	REQUIRE(flood_encoder.encode(frame_buffer, *flood_packet));
+	REQUIRE(get_packet_header_option(*flood_packet)->dictionary == dictionary_id);
+
+	REQUIRE(codec.decode(std::move(flood_packet), frame));
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "common.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+#include "packet_switch_options.hpp"
+
+TEST_CASE("Check parsing compression settings", "[codec]") {
+	PacketHeaderOptionFormatType format;
+	REQUIRE(PacketHeaderOptionFormatTypeFromString("none", format));
+	REQUIRE(format == PacketHeaderOptionFormatType::NONE);
+	REQUIRE(PacketHeaderOptionFormatTypeFromString("lz4", format));
+	REQUIRE(format == PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+	REQUIRE(PacketHeaderOptionFormatTypeFromString("zstd", format));
+	REQUIRE(format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+	REQUIRE_FALSE(PacketHeaderOptionFormatTypeFromString("gzip", format));
+
+	REQUIRE(CompressionLevelIsValid(PacketHeaderOptionFormatType::NONE, 0));
+	REQUIRE_FALSE(CompressionLevelIsValid(PacketHeaderOptionFormatType::NONE, 1));
+	REQUIRE(CompressionLevelIsValid(PacketHeaderOptionFormatType::COMPRESSED_LZ4, SETH_COMPRESSION_LEVEL_LZ4_MAX));
+	REQUIRE_FALSE(CompressionLevelIsValid(PacketHeaderOptionFormatType::COMPRESSED_LZ4, -1));
+	REQUIRE(CompressionLevelIsValid(PacketHeaderOptionFormatType::COMPRESSED_ZSTD, 3));
+	REQUIRE_FALSE(CompressionLevelIsValid(PacketHeaderOptionFormatType::COMPRESSED_ZSTD, SETH_COMPRESSION_LEVEL_ZSTD_MAX + 1));
+}
+
+TEST_CASE("Check changing the compression while encoding", "[codec]") {
+	CodecTest codec(32);
+	codec.encoder.setAdaptiveCompression(false);
+
+	// Settings we switch through, the level only changes how hard the compressor works
+	std::vector<CompressionSettings> settings = {
+		{PacketHeaderOptionFormatType::COMPRESSED_LZ4, 0},	{PacketHeaderOptionFormatType::COMPRESSED_LZ4, 20},
+		{PacketHeaderOptionFormatType::COMPRESSED_ZSTD, 1}, {PacketHeaderOptionFormatType::COMPRESSED_ZSTD, 19},
+		{PacketHeaderOptionFormatType::NONE, 0},			{PacketHeaderOptionFormatType::COMPRESSED_ZSTD, 0},
+	};
+
+	std::vector<std::string> frames;
+	for (auto &setting : settings) {
+		// Switching the format flushes out the packet being encoded with the previous format
+		codec.encoder.setCompressionLevel(setting.level);
+		codec.encoder.setPacketFormat(setting.packet_format);
+		REQUIRE(codec.encoder.getCompressionLevel() == setting.level);
+		REQUIRE(codec.encoder.getPacketFormat() == setting.packet_format);
+
+		// Two small frames which share a packet
+		for (size_t i = 0; i < 2; ++i) {
+			frames.push_back(build_udp_frame(12345, 100 + frames.size()));
+			auto buffer = codec.avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frames.back().data(), frames.back().length());
+			codec.encoder.encode(std::move(buffer));
+		}
+	}
+	codec.encoder.flush();
+
+	// Each setting got its own packet, with its frames in the format it set
+	REQUIRE(codec.enc_buffer_pool->getBufferCount() == settings.size());
+	for (auto &setting : settings) {
+		auto packet = codec.enc_buffer_pool->pop();
+		PacketHeaderOption *packet_header_option =
+			reinterpret_cast<PacketHeaderOption *>(packet->getData() + sizeof(PacketHeader));
+		REQUIRE(packet_header_option->format == setting.packet_format);
+		codec.decoder.decode(std::move(packet));
+	}
+
+	REQUIRE(codec.dec_buffer_pool->getBufferCount() == frames.size());
+	for (auto &frame : frames) {
+		auto dec_buffer = codec.dec_buffer_pool->pop();
+		REQUIRE(std::string(dec_buffer->getData(), dec_buffer->getDataSize()) == frame);
+		dec_buffer->clear();
+		codec.avail_buffer_pool->push(std::move(dec_buffer));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "common.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+#include "packet_switch_options.hpp"
+#include <random>
+
+/**
+ * @brief Generate random bytes, these don't compress.
+ *
+ * @param size Number of bytes.
+ * @return std::vector<uint8_t> Random bytes.
+ */
+static std::vector<uint8_t> random_bytes(size_t size) {
+	std::mt19937 generator(size);
+	std::uniform_int_distribution<int> distribution(0, 255);
+	std::vector<uint8_t> bytes(size);
+	for (auto &byte : bytes) {
+		byte = static_cast<uint8_t>(distribution(generator));
+	}
+	return bytes;
+}
+
+/**
+ * @brief Encoder and decoder pair, frames are encoded, flushed and the resulting packets decoded.
+ *
+ */
+struct BatchCodec : CodecTest {
+		BatchCodec(PacketHeaderOptionFormatType format, uint16_t l4mtu, bool adaptive) : CodecTest(256, l4mtu) {
+			encoder.setPacketFormat(format);
+			encoder.setAdaptiveCompression(adaptive);
+		}
+
+		/**
+		 * @brief Encode frames and flush the encoder.
+		 *
+		 * @param frames Frames to encode.
+		 * @return std::deque<std::unique_ptr<PacketBuffer>> Encoded packets.
+		 */
+		std::deque<std::unique_ptr<PacketBuffer>> encode(const std::vector<std::string> &frames) {
+			for (auto &frame : frames) {
+				auto buffer = avail_buffer_pool->pop();
+				buffer->clear();
+				buffer->append(frame.data(), frame.length());
+				encoder.encode(std::move(buffer));
+			}
+			encoder.flush();
+			return enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		}
+
+		/**
+		 * @brief Decode packets.
+		 *
+		 * @param packets Packets to decode.
+		 * @return std::vector<std::string> Decoded frames.
+		 */
+		std::vector<std::string> decode(std::deque<std::unique_ptr<PacketBuffer>> &packets) {
+			for (auto &packet : packets) {
+				decoder.decode(std::move(packet));
+			}
+			packets.clear();
+
+			std::vector<std::string> frames;
+			while (dec_buffer_pool->getBufferCount()) {
+				auto dec_buffer = dec_buffer_pool->pop();
+				frames.push_back(std::string(dec_buffer->getData(), dec_buffer->getDataSize()));
+				dec_buffer->clear();
+				avail_buffer_pool->push(std::move(dec_buffer));
+			}
+			return frames;
+		}
+};
+
+/**
+ * @brief Get the format of the first packet header option of a packet.
+ *
+ * @param packet Packet.
+ * @return PacketHeaderOptionFormatType Format.
+ */
+static PacketHeaderOptionFormatType get_packet_format(const std::unique_ptr<PacketBuffer> &packet) {
+	return reinterpret_cast<PacketHeaderOption *>(packet->getData() + sizeof(PacketHeader))->format;
+}
+
+TEST_CASE("Check batch packet formats", "[codec]") {
+	PacketHeaderOptionFormatType format;
+	REQUIRE(PacketHeaderOptionFormatTypeFromString("lz4-batch", format));
+	REQUIRE(format == PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH);
+	REQUIRE(PacketHeaderOptionFormatTypeToString(format) == "lz4-batch");
+	REQUIRE(PacketHeaderOptionFormatTypeIsBatch(format));
+	REQUIRE(PacketHeaderOptionFormatTypeUnbatched(format) == PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+
+	REQUIRE(PacketHeaderOptionFormatTypeFromString("zstd-batch", format));
+	REQUIRE(format == PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH);
+	REQUIRE(PacketHeaderOptionFormatTypeToString(format) == "zstd-batch");
+	REQUIRE(PacketHeaderOptionFormatTypeUnbatched(format) == PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+
+	REQUIRE_FALSE(PacketHeaderOptionFormatTypeIsBatch(PacketHeaderOptionFormatType::COMPRESSED_LZ4));
+	REQUIRE(PacketHeaderOptionFormatTypeUnbatched(PacketHeaderOptionFormatType::NONE) == PacketHeaderOptionFormatType::NONE);
+
+	// Levels are those of the compression algorithm
+	REQUIRE(CompressionLevelIsValid(PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH, SETH_COMPRESSION_LEVEL_ZSTD_MAX));
+	REQUIRE_FALSE(
+		CompressionLevelIsValid(PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH, SETH_COMPRESSION_LEVEL_ZSTD_MAX + 1));
+}
+
+/**
+ * @brief Check many small frames compress better in batches than one at a time.
+ *
+ * @param format Batch packet format.
+ */
+static void test_small_frames(PacketHeaderOptionFormatType format) {
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < 200; ++i) {
+		frames.push_back(build_udp_frame(1000 + (i % 8), 40 + (i % 100)));
+	}
+
+	BatchCodec frame_codec(PacketHeaderOptionFormatTypeUnbatched(format), CODEC_TEST_L4MTU, false);
+	auto frame_packets = frame_codec.encode(frames);
+	size_t frame_bytes = 0;
+	for (auto &packet : frame_packets) {
+		frame_bytes += packet->getDataSize();
+	}
+
+	BatchCodec batch_codec(format, CODEC_TEST_L4MTU, false);
+	auto batch_packets = batch_codec.encode(frames);
+	size_t batch_bytes = 0;
+	for (auto &packet : batch_packets) {
+		REQUIRE(get_packet_format(packet) == format);
+		REQUIRE(packet->getDataSize() <= CODEC_TEST_L4MTU);
+		batch_bytes += packet->getDataSize();
+	}
+	REQUIRE(batch_packets.size() <= frame_packets.size());
+	REQUIRE(batch_bytes < frame_bytes);
+
+	const PacketEncoderCompressionStats &stats = batch_codec.encoder.getCompressionStats();
+	REQUIRE(stats.compressed_frames == frames.size());
+
+	REQUIRE(batch_codec.decode(batch_packets) == frames);
+}
+
+TEST_CASE("Check batch compression of small frames with LZ4 compression", "[codec]") {
+	test_small_frames(PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH);
+}
+
+TEST_CASE("Check batch compression of small frames with ZSTD compression", "[codec]") {
+	test_small_frames(PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH);
+}
+
+TEST_CASE("Check frames sent on their own keep their order with batch compression", "[codec]") {
+	// Big frames don't fit into a packet and random frames are skipped by adaptive compression, both are sent on their own
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < 3; ++i) {
+		frames.push_back(build_udp_frame(1000, 100 + i));
+	}
+	frames.push_back(build_udp_frame(2000, 1400));
+	for (size_t i = 0; i < 3; ++i) {
+		frames.push_back(build_udp_frame(1000, 200 + i));
+	}
+	frames.push_back(build_udp_frame(3000, random_bytes(500)));
+	frames.push_back(build_udp_frame(1000, 300));
+
+	BatchCodec codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH, 1000, true);
+	auto packets = codec.encode(frames);
+	REQUIRE(codec.decode(packets) == frames);
+
+	const PacketEncoderCompressionStats &stats = codec.encoder.getCompressionStats();
+	REQUIRE(stats.bypassed_frames == 1);
+}
+
+TEST_CASE("Check frames which don't compress are sent uncompressed with batch compression", "[codec]") {
+	const uint16_t l4mtu = 1000;
+	std::vector<std::string> frames;
+	frames.push_back(build_udp_frame(1000, 100));
+	// The largest frame we batch, it grows when compressed so it cannot fit into a packet compressed
+	size_t max_frame_size = l4mtu - sizeof(PacketHeader) - sizeof(PacketHeaderOption) - sizeof(accl::be16_t);
+	size_t header_size = build_udp_frame(2000, 0).length();
+	frames.push_back(build_udp_frame(2000, random_bytes(max_frame_size - header_size)));
+	REQUIRE(frames.back().length() == max_frame_size);
+
+	BatchCodec codec(PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH, l4mtu, false);
+	auto packets = codec.encode(frames);
+	REQUIRE(packets.size() == 2);
+	REQUIRE(get_packet_format(packets[0]) == PacketHeaderOptionFormatType::COMPRESSED_ZSTD_BATCH);
+	REQUIRE(get_packet_format(packets[1]) == PacketHeaderOptionFormatType::NONE);
+
+	REQUIRE(codec.decode(packets) == frames);
+}
+
+TEST_CASE("Check invalid batches are dropped", "[codec]") {
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < 10; ++i) {
+		frames.push_back(build_udp_frame(1000, 100 + i));
+	}
+
+	BatchCodec codec(PacketHeaderOptionFormatType::COMPRESSED_LZ4_BATCH, CODEC_TEST_L4MTU, false);
+	auto packets = codec.encode(frames);
+	REQUIRE(packets.size() == 1);
+
+	// The batch no longer matches its size once decompressed
+	PacketHeaderOption *packet_header_option =
+		reinterpret_cast<PacketHeaderOption *>(packets[0]->getData() + sizeof(PacketHeader));
+	packet_header_option->packet_size = accl::cpu_to_be_16(accl::be_to_cpu_16(packet_header_option->packet_size) + 1);
+	REQUIRE(codec.decode(packets).empty());
+
+	// The next batch decodes as normal
+	packets = codec.encode(frames);
+	REQUIRE(codec.decode(packets) == frames);
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "common.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+
+/**
+ * @brief Encode frames and return the packets as they'd be sent on the wire.
+ *
+ * @param format Packet format.
+ * @param zero_copy Reference frames from the packets instead of copying them.
+ * @param frames Frames to encode.
+ * @return std::vector<std::string> Packets.
+ */
+static std::vector<std::string> encode_frames(PacketHeaderOptionFormatType format, bool zero_copy,
+											  const std::vector<std::string> &frames) {
+	std::vector<std::string> packets;
+	{
+		EncoderTest codec(100);
+		codec.encoder.setPacketFormat(format);
+		codec.encoder.setAdaptiveCompression(false);
+		codec.encoder.setZeroCopy(zero_copy);
+		REQUIRE(codec.encoder.getZeroCopy() == zero_copy);
+
+		for (auto &frame : frames) {
+			auto buffer = codec.avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			codec.encoder.encode(std::move(buffer));
+		}
+		codec.encoder.flush();
+
+		// Gather the packets the same way the socket writer does
+		std::deque<std::unique_ptr<PacketBuffer>> buffers = codec.enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		std::vector<iovec> iovs;
+		for (auto &buffer : buffers) {
+			iovs.resize(buffer->getIOVecCount());
+			size_t iov_count = buffer->getIOVecs(iovs.data());
+			std::string packet;
+			for (size_t i = 0; i < iov_count; ++i) {
+				packet.append(static_cast<const char *>(iovs[i].iov_base), iovs[i].iov_len);
+			}
+			REQUIRE(packet.length() == buffer->getPacketSize());
+			REQUIRE(packet.length() <= CODEC_TEST_L4MTU);
+			packets.push_back(packet);
+		}
+
+		// Releasing the packets must release the frames they reference too, the encoder holds onto the rest
+		codec.encoder.releaseTxBuffers(buffers);
+		REQUIRE(buffers.empty());
+	}
+
+	return packets;
+}
+
+/**
+ * @brief Check packets encoded using zero-copy are the same as those encoded by copying the frames, and decode.
+ *
+ * @param format Packet format.
+ */
+static void test_zero_copy(PacketHeaderOptionFormatType format) {
+	// Small frames are copied, big frames are referenced and the biggest are split over packets
+	std::vector<std::string> frames;
+	for (size_t payload_size : {10, 500, 20, 1000, 1400, 300, 30, 1450, 200, 800, 800, 800}) {
+		frames.push_back(build_udp_frame(12345, payload_size));
+	}
+
+	std::vector<std::string> copied_packets = encode_frames(format, false, frames);
+	std::vector<std::string> packets = encode_frames(format, true, frames);
+	REQUIRE(packets == copied_packets);
+
+	CodecTest codec(100);
+	for (auto &packet : packets) {
+		auto buffer = codec.avail_buffer_pool->pop();
+		buffer->clear();
+		buffer->append(packet.data(), packet.length());
+		codec.decoder.decode(std::move(buffer));
+	}
+
+	REQUIRE(codec.dec_buffer_pool->getBufferCount() == frames.size());
+	for (auto &frame : frames) {
+		auto dec_buffer = codec.dec_buffer_pool->pop();
+		REQUIRE(std::string(dec_buffer->getData(), dec_buffer->getDataSize()) == frame);
+	}
+}
+
+TEST_CASE("Check zero-copy encoding", "[codec]") { test_zero_copy(PacketHeaderOptionFormatType::NONE); }
+
+TEST_CASE("Check zero-copy encoding with LZ4 compression", "[codec]") {
+	test_zero_copy(PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+}
+
+TEST_CASE("Check zero-copy encoding with ZSTD compression", "[codec]") {
+	test_zero_copy(PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+}
+
+TEST_CASE("Check zero-copy encoding releases the frames it references", "[codec]") {
+	const size_t buffer_count = 20;
+	EncoderTest codec(buffer_count);
+	codec.encoder.setZeroCopy(true);
+
+	// Encode more frames than we have buffers, this only works if the frames are released along with the packets
+	std::string frame = build_udp_frame(12345, 600);
+	for (size_t i = 0; i < buffer_count * 10; ++i) {
+		auto buffer = codec.avail_buffer_pool->pop_wait();
+		buffer->clear();
+		buffer->append(frame.data(), frame.length());
+		codec.encoder.encode(std::move(buffer));
+
+		std::deque<std::unique_ptr<PacketBuffer>> buffers = codec.enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		for (auto &buffer : buffers) {
+			REQUIRE(buffer->hasFragments());
+		}
+		codec.encoder.releaseTxBuffers(buffers);
+	}
+	codec.encoder.flush();
+	std::deque<std::unique_ptr<PacketBuffer>> buffers = codec.enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+	codec.encoder.releaseTxBuffers(buffers);
+
+	// The encoder holds onto its compression buffer and the packet its filling
+	REQUIRE(codec.avail_buffer_pool->getBufferCount() == buffer_count - 2);
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "common.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+
+/**
+ * @brief Encoder and decoder pair sharing the available buffer pool.
+ *
+ */
+struct ZeroCopyCodec : CodecTest {
+		ZeroCopyCodec(PacketHeaderOptionFormatType format, bool zero_copy, size_t buffer_count = 100) : CodecTest(buffer_count) {
+			encoder.setPacketFormat(format);
+			encoder.setAdaptiveCompression(false);
+			decoder.setZeroCopy(zero_copy);
+			REQUIRE(decoder.getZeroCopy() == zero_copy);
+		}
+
+		/**
+		 * @brief Encode frames and flush the encoder.
+		 *
+		 * @param frames Frames to encode.
+		 * @return std::deque<std::unique_ptr<PacketBuffer>> Encoded packets.
+		 */
+		std::deque<std::unique_ptr<PacketBuffer>> encode(const std::vector<std::string> &frames) {
+			for (auto &frame : frames) {
+				auto buffer = avail_buffer_pool->pop();
+				buffer->clear();
+				buffer->append(frame.data(), frame.length());
+				encoder.encode(std::move(buffer));
+			}
+			encoder.flush();
+			return enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		}
+
+		/**
+		 * @brief Decode packets.
+		 *
+		 * @param packets Packets to decode.
+		 * @return std::deque<std::unique_ptr<PacketBuffer>> Decoded frames.
+		 */
+		std::deque<std::unique_ptr<PacketBuffer>> decode(std::deque<std::unique_ptr<PacketBuffer>> &packets) {
+			for (auto &packet : packets) {
+				decoder.decode(std::move(packet));
+			}
+			packets.clear();
+			return dec_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		}
+
+		/**
+		 * @brief Release decoded frames the same way the TAP write thread does.
+		 *
+		 * @param buffers Decoded frames to release.
+		 */
+		void release(std::deque<std::unique_ptr<PacketBuffer>> &buffers) {
+			std::erase_if(buffers, [](const std::unique_ptr<PacketBuffer> &buffer) { return buffer->isView(); });
+			avail_buffer_pool->push(buffers);
+			buffers.clear();
+		}
+};
+
+/**
+ * @brief Decode frames and release them again.
+ *
+ * @param format Packet format.
+ * @param zero_copy Push complete uncompressed frames as views of the packets.
+ * @param frames Frames to encode.
+ * @return size_t Number of buffers in the available buffer pool once the frames are released.
+ */
+static size_t decode_frames(PacketHeaderOptionFormatType format, bool zero_copy, const std::vector<std::string> &frames) {
+	ZeroCopyCodec codec(format, zero_copy);
+	auto packets = codec.encode(frames);
+	auto buffers = codec.decode(packets);
+
+	REQUIRE(buffers.size() == frames.size());
+	size_t view_count = 0;
+	for (size_t i = 0; i < frames.size(); ++i) {
+		REQUIRE(std::string(buffers[i]->getData(), buffers[i]->getDataSize()) == frames[i]);
+		if (buffers[i]->isView()) {
+			REQUIRE(zero_copy);
+			REQUIRE(format == PacketHeaderOptionFormatType::NONE);
+			REQUIRE(frames[i].length() >= SETH_ZERO_COPY_MIN_SIZE);
+			view_count++;
+		}
+	}
+	if (zero_copy && format == PacketHeaderOptionFormatType::NONE) {
+		REQUIRE(view_count > 0);
+	}
+
+	codec.release(buffers);
+	return codec.avail_buffer_pool->getBufferCount();
+}
+
+/**
+ * @brief Check frames decoded using zero-copy match the frames encoded, and that only complete uncompressed frames are views.
+ *
+ * @param format Packet format.
+ */
+static void test_zero_copy_decode(PacketHeaderOptionFormatType format) {
+	// Small frames are copied, big frames are views and the biggest are split over packets so need to be copied back together
+	std::vector<std::string> frames;
+	for (size_t payload_size : {10, 500, 20, 1000, 1400, 300, 30, 1450, 200, 800, 800, 800}) {
+		frames.push_back(build_udp_frame(12345, payload_size));
+	}
+
+	// Once the frames are released all the packets must be back in the pool, just like when the frames are copied
+	REQUIRE(decode_frames(format, true, frames) == decode_frames(format, false, frames));
+}
+
+TEST_CASE("Check zero-copy decoding", "[codec]") { test_zero_copy_decode(PacketHeaderOptionFormatType::NONE); }
+
+TEST_CASE("Check zero-copy decoding with LZ4 compression", "[codec]") {
+	test_zero_copy_decode(PacketHeaderOptionFormatType::COMPRESSED_LZ4);
+}
+
+TEST_CASE("Check zero-copy decoding with ZSTD compression", "[codec]") {
+	test_zero_copy_decode(PacketHeaderOptionFormatType::COMPRESSED_ZSTD);
+}
+
+TEST_CASE("Check zero-copy decoding releases packets once all their frames are released", "[codec]") {
+	// Both frames fit into a single packet
+	std::vector<std::string> frames = {build_udp_frame(12345, 600), build_udp_frame(12345, 600)};
+
+	ZeroCopyCodec codec(PacketHeaderOptionFormatType::NONE, true);
+	auto packets = codec.encode(frames);
+	REQUIRE(packets.size() == 1);
+	size_t buffer_count = codec.avail_buffer_pool->getBufferCount() + packets.size();
+
+	auto buffers = codec.decode(packets);
+	REQUIRE(buffers.size() == 2);
+	REQUIRE(buffers[0]->isView());
+	REQUIRE(buffers[1]->isView());
+	REQUIRE(codec.avail_buffer_pool->getBufferCount() == buffer_count - 1);
+
+	std::deque<std::unique_ptr<PacketBuffer>> first;
+	first.push_back(std::move(buffers[0]));
+	buffers.pop_front();
+	codec.release(first);
+	REQUIRE(codec.avail_buffer_pool->getBufferCount() == buffer_count - 1);
+
+	codec.release(buffers);
+	REQUIRE(codec.avail_buffer_pool->getBufferCount() == buffer_count);
+}
+
+TEST_CASE("Check zero-copy decoding copies frames once all the views are in use", "[codec]") {
+	// Each packet takes a view while its frames are held along with a view for each frame, so there are more frames than views
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < SETH_ZERO_COPY_VIEW_COUNT * 2; ++i) {
+		frames.push_back(build_udp_frame(12345, 600));
+	}
+
+	// Decode all the frames holding onto them, returning the number of views and the available buffers once they are released
+	auto decode_held_frames = [&frames](bool zero_copy, size_t &view_count) {
+		ZeroCopyCodec codec(PacketHeaderOptionFormatType::NONE, zero_copy, 4000);
+		auto packets = codec.encode(frames);
+		auto buffers = codec.decode(packets);
+
+		// The frames decoded after the views ran out are copies and must still match
+		REQUIRE(buffers.size() == frames.size());
+		view_count = 0;
+		for (size_t i = 0; i < frames.size(); ++i) {
+			REQUIRE(std::string(buffers[i]->getData(), buffers[i]->getDataSize()) == frames[i]);
+			view_count += buffers[i]->isView();
+		}
+
+		codec.release(buffers);
+		return codec.avail_buffer_pool->getBufferCount();
+	};
+
+	size_t view_count;
+	size_t available = decode_held_frames(false, view_count);
+	REQUIRE(decode_held_frames(true, view_count) == available);
+	REQUIRE(view_count > 0);
+	REQUIRE(view_count < SETH_ZERO_COPY_VIEW_COUNT);
+}
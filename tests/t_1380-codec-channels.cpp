@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "codec.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "packet_switch.hpp"
+
+/**
+ * @brief Encoder and decoder pair for a channel, the pairs share the available buffer pool.
+ *
+ */
+struct ChannelCodec {
+		ChannelCodec(uint8_t channel, uint16_t l2mtu, std::shared_ptr<accl::BufferPool<PacketBuffer>> avail_buffer_pool)
+			: enc_buffer_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(l2mtu + (l2mtu / 10))),
+			  dec_buffer_pool(std::make_shared<accl::BufferPool<PacketBuffer>>(l2mtu + (l2mtu / 10))),
+			  encoder(l2mtu, CODEC_TEST_L4MTU, enc_buffer_pool, avail_buffer_pool),
+			  decoder(l2mtu, dec_buffer_pool, avail_buffer_pool) {
+			encoder.setChannel(channel);
+			decoder.setChannel(channel);
+			REQUIRE(encoder.getChannel() == channel);
+			REQUIRE(decoder.getChannel() == channel);
+		}
+
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> enc_buffer_pool;
+		std::shared_ptr<accl::BufferPool<PacketBuffer>> dec_buffer_pool;
+		PacketEncoder encoder;
+		PacketDecoder decoder;
+};
+
+TEST_CASE("Check frames encoded on multiple channels are decoded by the decoder of their channel", "[codec]") {
+	uint16_t l2mtu = get_l2mtu_from_mtu(1500);
+	auto avail_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(l2mtu + (l2mtu / 10), 100);
+
+	std::vector<std::unique_ptr<ChannelCodec>> codecs;
+	for (uint8_t channel = 0; channel < 3; ++channel) {
+		codecs.push_back(std::make_unique<ChannelCodec>(channel, l2mtu, avail_buffer_pool));
+	}
+
+	// Spread the frames over the channels, each channel gets frames that are split over packets too
+	std::vector<std::vector<std::string>> frames(codecs.size());
+	for (size_t i = 0; i < 30; ++i) {
+		size_t channel = i % codecs.size();
+		std::string frame = build_udp_frame(10000 + i, (i * 97) % 1450 + 10);
+		frames[channel].push_back(frame);
+
+		auto buffer = avail_buffer_pool->pop();
+		buffer->clear();
+		buffer->append(frame.data(), frame.length());
+		codecs[channel]->encoder.encode(std::move(buffer));
+	}
+
+	// The packets of all channels arrive mixed together, each is decoded by the decoder of the channel in its header
+	std::deque<std::unique_ptr<PacketBuffer>> packets;
+	for (auto &codec : codecs) {
+		codec->encoder.flush();
+		auto channel_packets = codec->enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		REQUIRE(!channel_packets.empty());
+		for (auto &packet : channel_packets) {
+			packets.push_back(std::move(packet));
+		}
+	}
+	for (auto &packet : packets) {
+		uint8_t channel = reinterpret_cast<const PacketHeader *>(packet->getData())->channel;
+		REQUIRE(channel < codecs.size());
+		codecs[channel]->decoder.decode(std::move(packet));
+	}
+
+	for (size_t channel = 0; channel < codecs.size(); ++channel) {
+		auto buffers = codecs[channel]->dec_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+		REQUIRE(buffers.size() == frames[channel].size());
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			REQUIRE(std::string(buffers[i]->getData(), buffers[i]->getDataSize()) == frames[channel][i]);
+		}
+		avail_buffer_pool->push(buffers);
+	}
+}
+
+TEST_CASE("Check packets for another channel are dropped by the decoder", "[codec]") {
+	uint16_t l2mtu = get_l2mtu_from_mtu(1500);
+	auto avail_buffer_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(l2mtu + (l2mtu / 10), 100);
+
+	ChannelCodec codec0(0, l2mtu, avail_buffer_pool);
+	ChannelCodec codec1(1, l2mtu, avail_buffer_pool);
+
+	std::string frame = build_udp_frame(12345, 100);
+	auto buffer = avail_buffer_pool->pop();
+	buffer->clear();
+	buffer->append(frame.data(), frame.length());
+	codec1.encoder.encode(std::move(buffer));
+	codec1.encoder.flush();
+
+	auto packets = codec1.enc_buffer_pool->pop(accl::BUFFER_POOL_POP_ALL);
+	REQUIRE(packets.size() == 1);
+	REQUIRE(reinterpret_cast<const PacketHeader *>(packets[0]->getData())->channel == 1);
+
+	codec0.decoder.decode(std::move(packets[0]));
+	REQUIRE(codec0.dec_buffer_pool->getBufferCount() == 0);
+}
\ No newline at end of file
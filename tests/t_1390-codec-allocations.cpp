@@ -0,0 +1,284 @@
+/*
+ * SPDX-FileCopyrightText: 2023-2024 AllWorldIT
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "libaccl/buffer_pool.hpp"
+#include "libaccl/logger.hpp"
+#include "libtests/framework.hpp"
+#include "libtests/t_codec.hpp"
+#include "libtests/t_socket.hpp"
+#include "packet_switch.hpp"
+#include "socket_reader.hpp"
+#include "socket_writer.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <unistd.h>
+
+// Number of heap allocations made by the current thread, this is counted by our replacement of the global operator new
+static thread_local size_t allocation_count{0};
+
+// GCC can't tell our operator new and operator delete are a matching pair once they're inlined at -O2
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(std::size_t size) {
+	++allocation_count;
+	if (void *ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+#pragma GCC diagnostic pop
+
+/**
+ * @brief Count the number of times a log argument is evaluated.
+ *
+ * @param count Counter to increment.
+ * @return int Value of the counter.
+ */
+static int count_evaluation(int &count) { return ++count; }
+
+TEST_CASE("Check log arguments are only evaluated when the log level is enabled", "[logger]") {
+	accl::LogLevel log_level = accl::logger.getLogLevel();
+	accl::logger.setLogLevel(accl::LogLevel::ERROR);
+
+	int count = 0;
+	size_t allocations = allocation_count;
+	LOG_DEBUG("Count ", count_evaluation(count), " ", std::string(100, 'x'));
+	LOG_INFO("Count ", count_evaluation(count), " ", std::string(100, 'x'));
+	LOG_NOTICE("Count ", count_evaluation(count), " ", std::string(100, 'x'));
+	LOG_WARNING("Count ", count_evaluation(count), " ", std::string(100, 'x'));
+	LOG_DEBUG_INTERNAL("Count ", count_evaluation(count), " ", std::string(100, 'x'));
+	REQUIRE(allocation_count == allocations);
+	REQUIRE(count == 0);
+
+	accl::logger.setLogLevel(accl::LogLevel::DEBUGGING);
+	LOG_DEBUG("Count ", count_evaluation(count));
+	REQUIRE(count == 1);
+
+	accl::logger.setLogLevel(log_level);
+}
+
+TEST_CASE("Check logging makes no heap allocations while the logger thread is running", "[logger]") {
+	accl::logger.start();
+
+	// The first log line registers the log queue of the thread
+	LOG_WARNING("Warming up the log queue");
+
+	size_t allocations = allocation_count;
+	for (size_t i = 0; i < accl::LOG_RATE_LIMIT_BURST * 2; ++i) {
+		LOG_WARNING("Packet ", i, " dropped, ", std::fixed, std::setprecision(2), 1.5, "% of packets dropped");
+	}
+	REQUIRE(allocation_count == allocations);
+
+	accl::logger.stop();
+}
+
+TEST_CASE("Check the encoder and decoder make no heap allocations per packet in copying mode once warmed up", "[codec]") {
+	CodecTest codec(200);
+
+	// Frames of different sizes so packets are filled with several frames and frames are split over packets
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < 20; ++i) {
+		frames.push_back(build_udp_frame(10000 + i, (i * 97) % 1450 + 10));
+	}
+
+	// The deques we move buffers around with are sized by the first rounds, after this they're reused
+	std::deque<std::unique_ptr<PacketBuffer>> packets, decoded;
+
+	auto run_round = [&]() {
+		for (auto &frame : frames) {
+			auto buffer = codec.avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			codec.encoder.encode(std::move(buffer));
+		}
+		codec.encoder.flush();
+
+		codec.enc_buffer_pool->pop(packets, accl::BUFFER_POOL_POP_ALL);
+		for (auto &packet : packets) {
+			codec.decoder.decode(std::move(packet));
+		}
+		packets.clear();
+
+		codec.dec_buffer_pool->pop(decoded, accl::BUFFER_POOL_POP_ALL);
+		size_t count = decoded.size();
+		codec.avail_buffer_pool->push(decoded);
+		return count;
+	};
+
+	for (size_t round = 0; round < 10; ++round) {
+		REQUIRE(run_round() == frames.size());
+	}
+
+	size_t allocations = allocation_count;
+	size_t decoded_count = 0;
+	for (size_t round = 0; round < 100; ++round) {
+		decoded_count += run_round();
+	}
+	REQUIRE(allocation_count == allocations);
+	REQUIRE(decoded_count == frames.size() * 100);
+}
+
+TEST_CASE("Check zero-copy encoding makes no heap allocations per packet once warmed up", "[codec]") {
+	EncoderTest codec(200);
+	codec.encoder.setZeroCopy(true);
+
+	// Big frames are referenced by the packets, so the packets are released along with the frames they reference
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < 20; ++i) {
+		frames.push_back(build_udp_frame(10000 + i, (i * 97) % 1450 + 10));
+	}
+
+	std::deque<std::unique_ptr<PacketBuffer>> packets;
+
+	auto run_round = [&]() {
+		for (auto &frame : frames) {
+			auto buffer = codec.avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			codec.encoder.encode(std::move(buffer));
+		}
+		codec.encoder.flush();
+
+		codec.enc_buffer_pool->pop(packets, accl::BUFFER_POOL_POP_ALL);
+		size_t count = packets.size();
+		codec.encoder.releaseTxBuffers(packets);
+		return count;
+	};
+
+	// Each buffer allocates its fragment vector the first time it is used as a packet with fragments, the rounds need to go through
+	// all the buffers in the pool before this stops
+	for (size_t round = 0; round < 100; ++round) {
+		REQUIRE(run_round() > 0);
+	}
+
+	size_t allocations = allocation_count;
+	for (size_t round = 0; round < 100; ++round) {
+		run_round();
+	}
+	REQUIRE(allocation_count == allocations);
+}
+
+TEST_CASE("Check zero-copy decoding makes no heap allocations per packet once warmed up", "[codec]") {
+	CodecTest codec(200);
+	codec.encoder.setPacketFormat(PacketHeaderOptionFormatType::NONE);
+	codec.decoder.setZeroCopy(true);
+
+	// Complete frames are pushed as views of the packets, the rest are copied
+	std::vector<std::string> frames;
+	for (size_t i = 0; i < 20; ++i) {
+		frames.push_back(build_udp_frame(10000 + i, (i * 97) % 1450 + 10));
+	}
+
+	std::deque<std::unique_ptr<PacketBuffer>> packets, decoded;
+
+	auto run_round = [&]() {
+		for (auto &frame : frames) {
+			auto buffer = codec.avail_buffer_pool->pop();
+			buffer->clear();
+			buffer->append(frame.data(), frame.length());
+			codec.encoder.encode(std::move(buffer));
+		}
+		codec.encoder.flush();
+
+		codec.enc_buffer_pool->pop(packets, accl::BUFFER_POOL_POP_ALL);
+		for (auto &packet : packets) {
+			codec.decoder.decode(std::move(packet));
+		}
+		packets.clear();
+
+		// Releasing the views hands the packets back to the available buffer pool
+		codec.dec_buffer_pool->pop(decoded, accl::BUFFER_POOL_POP_ALL);
+		size_t views = 0;
+		for (auto &buffer : decoded) {
+			if (buffer->isView()) {
+				buffer.reset();
+				++views;
+			} else {
+				codec.avail_buffer_pool->push(std::move(buffer));
+			}
+		}
+		decoded.clear();
+		return views;
+	};
+
+	for (size_t round = 0; round < 10; ++round) {
+		REQUIRE(run_round() > 0);
+	}
+
+	// Every packet shared by the views must have found its way back to the pool
+	size_t available = codec.avail_buffer_pool->getBufferCount();
+	size_t allocations = allocation_count;
+	for (size_t round = 0; round < 100; ++round) {
+		run_round();
+	}
+	REQUIRE(allocation_count == allocations);
+	REQUIRE(codec.avail_buffer_pool->getBufferCount() == available);
+}
+
+TEST_CASE("Check receiving using UDP GRO makes no heap allocations per packet once warmed up", "[socket]") {
+	sockaddr_storage rx_addr, tx_addr;
+	int rx_socket = create_loopback_socket(rx_addr);
+	int tx_socket = create_loopback_socket(tx_addr);
+
+	auto available_pool = std::make_shared<accl::BufferPool<PacketBuffer>>(1500, 300);
+
+	// A run of same size packets is sent using UDP GSO, so it is received as GRO super-packets which are split into views
+	const size_t packet_count = 32;
+	std::deque<std::unique_ptr<PacketBuffer>> packets;
+	for (size_t i = 0; i < packet_count; ++i) {
+		auto buffer = std::make_unique<PacketBuffer>(1500);
+		std::string data(1000, static_cast<char>('a' + i % 26));
+		buffer->append(data.data(), data.size());
+		packets.push_back(std::move(buffer));
+	}
+
+	{
+		SocketReader reader(rx_socket, SocketReadMode::GRO, available_pool);
+		SocketWriter writer(tx_socket, SocketWriteMode::GSO);
+
+		// Only the reader is counted, sending is not what we're testing
+		std::deque<std::unique_ptr<PacketBuffer>> received;
+		size_t views = 0;
+		auto run_round = [&]() {
+			writer.write(&rx_addr, packets);
+
+			size_t allocations = allocation_count;
+			size_t count = 0;
+			while (count < packet_count) {
+				count += reader.read(received);
+			}
+			for (auto &buffer : received) {
+				views += buffer->isView();
+				reader.recycle(std::move(buffer));
+			}
+			received.clear();
+			return allocation_count - allocations;
+		};
+
+		for (size_t round = 0; round < 10; ++round) {
+			run_round();
+		}
+		REQUIRE(views > 0);
+
+		size_t allocations = 0;
+		for (size_t round = 0; round < 100; ++round) {
+			allocations += run_round();
+		}
+		REQUIRE(allocations == 0);
+	}
+
+	close(rx_socket);
+	close(tx_socket);
+}